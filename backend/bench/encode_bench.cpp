@@ -0,0 +1,184 @@
+// 图标编码：各尺寸下PNG（快速级别和zlib默认级别）与QOI的编码速度和大小
+// 用法: encode_bench [每个图标的编码次数]
+#include "icon_renderer.h"
+#include "image_encoder.h"
+#include <zlib.h>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+static uint32_t readBigEndian32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+// 校验用的最小PNG解码器，只支持encodePNG的输出（8位RGBA，不隔行）
+static bool decodePNG(const string& png, int width, int height, string& rgba) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(png.data());
+    string compressed;
+    for (size_t pos = 8; pos + 12 <= png.size();) {
+        uint32_t length = readBigEndian32(p + pos);
+        if (memcmp(p + pos + 4, "IDAT", 4) == 0) {
+            compressed.append(png, pos + 8, length);
+        }
+        pos += 12 + length;
+    }
+    
+    const size_t row_size = static_cast<size_t>(width) * 4;
+    string raw((row_size + 1) * height, '\0');
+    uLongf raw_size = static_cast<uLongf>(raw.size());
+    if (uncompress(reinterpret_cast<Bytef*>(&raw[0]), &raw_size,
+                   reinterpret_cast<const Bytef*>(compressed.data()),
+                   static_cast<uLong>(compressed.size())) != Z_OK || raw_size != raw.size()) {
+        return false;
+    }
+    
+    rgba.assign(row_size * height, '\0');
+    uint8_t* out = reinterpret_cast<uint8_t*>(&rgba[0]);
+    for (int y = 0; y < height; y++) {
+        const uint8_t* line = reinterpret_cast<const uint8_t*>(raw.data()) + y * (row_size + 1);
+        uint8_t* row = out + y * row_size;
+        const uint8_t* prev = y > 0 ? row - row_size : nullptr;
+        for (size_t i = 0; i < row_size; i++) {
+            int a = i >= 4 ? row[i - 4] : 0;
+            int b = prev ? prev[i] : 0;
+            int c = prev && i >= 4 ? prev[i - 4] : 0;
+            int predicted = 0;
+            switch (line[0]) {
+                case 0: break;
+                case 1: predicted = a; break;
+                case 2: predicted = b; break;
+                case 3: predicted = (a + b) / 2; break;
+                case 4: {
+                    int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+                    predicted = pa <= pb && pa <= pc ? a : (pb <= pc ? b : c);
+                    break;
+                }
+                default: return false;
+            }
+            row[i] = static_cast<uint8_t>(line[1 + i] + predicted);
+        }
+    }
+    return true;
+}
+
+static bool decodeQOI(const string& qoi, string& rgba) {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(qoi.data());
+    size_t pixels = static_cast<size_t>(readBigEndian32(p + 4)) * readBigEndian32(p + 8);
+    uint8_t index[64][4] = {};
+    uint8_t px[4] = {0, 0, 0, 255};
+    size_t pos = 14, end = qoi.size() - 8;
+    rgba.clear();
+    
+    while (rgba.size() < pixels * 4 && pos < end) {
+        uint8_t op = p[pos++];
+        int run = 1;
+        if (op == 0xFE) {
+            memcpy(px, p + pos, 3);
+            pos += 3;
+        } else if (op == 0xFF) {
+            memcpy(px, p + pos, 4);
+            pos += 4;
+        } else if ((op & 0xC0) == 0x00) {
+            memcpy(px, index[op], 4);
+        } else if ((op & 0xC0) == 0x40) {
+            px[0] += ((op >> 4) & 3) - 2;
+            px[1] += ((op >> 2) & 3) - 2;
+            px[2] += (op & 3) - 2;
+        } else if ((op & 0xC0) == 0x80) {
+            int dg = (op & 0x3F) - 32;
+            uint8_t next = p[pos++];
+            px[0] += dg - 8 + (next >> 4);
+            px[1] += dg;
+            px[2] += dg - 8 + (next & 0x0F);
+        } else {
+            run = (op & 0x3F) + 1;
+        }
+        memcpy(index[(px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64], px, 4);
+        for (int i = 0; i < run; i++) {
+            rgba.append(reinterpret_cast<const char*>(px), 4);
+        }
+    }
+    return rgba.size() == pixels * 4 && pos == end;
+}
+
+static double measureMicros(int iterations, const function<void()>& run) {
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        run();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, micro>(end - begin).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    IconRenderer renderer;
+    IconRenderer::ColorTheme theme = IconRenderer::getDayTheme();
+    const IconRenderer::IconSize sizes[] = {
+        IconRenderer::SMALL, IconRenderer::MEDIUM, IconRenderer::LARGE, IconRenderer::XLARGE
+    };
+    
+    cout << "尺寸   原始(B)   PNG快速(B)   us   PNG默认(B)   us    QOI(B)   us" << endl;
+    cout << fixed << setprecision(1);
+    size_t sink = 0;
+    for (IconRenderer::IconSize size : sizes) {
+        int px = IconRenderer::getIconWidth(size);
+        vector<shared_ptr<const string>> bitmaps;
+        for (size_t i = 0; i < ICON_COUNT; i++) {
+            bitmaps.push_back(renderer.getIconBitmap(static_cast<IconId>(i), size, theme));
+        }
+        
+        // 先校验无损，再计时；大小为全部图标的平均值
+        size_t raw_bytes = 0, png_fast_bytes = 0, png_default_bytes = 0, qoi_bytes = 0;
+        for (const auto& bitmap : bitmaps) {
+            const uint8_t* rgba = reinterpret_cast<const uint8_t*>(bitmap->data());
+            string png_fast, png_default, qoi, decoded;
+            {
+                ImageOutput a(png_fast), b(png_default), c(qoi);
+                encodePNG(rgba, px, px, a);
+                encodePNG(rgba, px, px, b, Z_DEFAULT_COMPRESSION);
+                encodeQOI(rgba, px, px, c);
+            }
+            if (!decodePNG(png_fast, px, px, decoded) || decoded != *bitmap ||
+                !decodePNG(png_default, px, px, decoded) || decoded != *bitmap ||
+                !decodeQOI(qoi, decoded) || decoded != *bitmap) {
+                cerr << px << "px: 解码结果与原图不一致" << endl;
+                return 1;
+            }
+            raw_bytes += bitmap->size();
+            png_fast_bytes += png_fast.size();
+            png_default_bytes += png_default.size();
+            qoi_bytes += qoi.size();
+        }
+        
+        // 复用同一个输出缓冲区
+        string buffer;
+        auto encodeAll = [&](int format) {
+            for (const auto& bitmap : bitmaps) {
+                buffer.clear();
+                ImageOutput out(buffer);
+                const uint8_t* rgba = reinterpret_cast<const uint8_t*>(bitmap->data());
+                if (format == 0) encodePNG(rgba, px, px, out);
+                else if (format == 1) encodePNG(rgba, px, px, out, Z_DEFAULT_COMPRESSION);
+                else encodeQOI(rgba, px, px, out);
+                sink += buffer.size();
+            }
+        };
+        double count = static_cast<double>(bitmaps.size());
+        double png_fast_us = measureMicros(iterations, [&]() { encodeAll(0); }) / count;
+        double png_default_us = measureMicros(iterations, [&]() { encodeAll(1); }) / count;
+        double qoi_us = measureMicros(iterations, [&]() { encodeAll(2); }) / count;
+        
+        cout << setw(4) << px << setw(10) << raw_bytes / bitmaps.size()
+             << setw(13) << png_fast_bytes / bitmaps.size() << setw(7) << png_fast_us
+             << setw(13) << png_default_bytes / bitmaps.size() << setw(7) << png_default_us
+             << setw(10) << qoi_bytes / bitmaps.size() << setw(7) << qoi_us << endl;
+    }
+    
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// 图标光栅化：各像素内核实现的XLARGE（128x128）渲染速度，以及批量渲染在线程池上的加速比
+// 用法: icon_bench [每个图标的渲染次数] [线程数]
+#include "icon_renderer.h"
+#include "pixel_kernels.h"
+#include "executor.h"
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+static const char* const ICONS[] = {
+    "sunny", "cloudy", "rain", "snow", "thunderstorm", "fog",
+    "partly-cloudy-day", "partly-cloudy-night", "clear-night", "unknown"
+};
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 500;
+    IconRenderer renderer;
+    IconRenderer::ColorTheme theme = IconRenderer::getDayTheme();
+    
+    // 标量实现的输出作为参照，其他实现必须逐字节相同
+    selectSpanKernels("scalar");
+    vector<vector<uint8_t>> reference;
+    for (const char* name : ICONS) {
+        reference.push_back(renderer.renderIcon(name, IconRenderer::XLARGE, theme));
+    }
+    
+    cout << fixed << setprecision(0);
+    double scalar_rate = 0.0;
+    for (const SpanKernels* kernels : availableSpanKernels()) {
+        selectSpanKernels(kernels->name);
+        
+        IconRenderer check;
+        for (size_t i = 0; i < reference.size(); i++) {
+            if (check.renderIcon(ICONS[i], IconRenderer::XLARGE, theme) != reference[i]) {
+                cerr << kernels->name << ": " << ICONS[i] << " 的输出与标量实现不一致" << endl;
+                return 1;
+            }
+        }
+        
+        // 渲染结果会被缓存，每轮使用新的渲染器，构造（路径解析）不计时
+        size_t sink = 0;
+        double seconds = 0.0;
+        for (int n = 0; n < iterations; n++) {
+            IconRenderer fresh;
+            auto begin = chrono::steady_clock::now();
+            for (const char* name : ICONS) {
+                sink += (*fresh.getIconBitmap(name, IconRenderer::XLARGE, theme))[0];
+            }
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        }
+        
+        double rate = iterations * size(ICONS) / seconds;
+        if (scalar_rate == 0.0) {
+            scalar_rate = rate;
+        }
+        cout << setw(6) << kernels->name << ": " << rate << " 次/秒（XLARGE），"
+             << setprecision(2) << rate / scalar_rate << "x" << setprecision(0)
+             << (sink == 0 ? " " : "") << endl;
+    }
+    
+    // 批量渲染全部(图标, 尺寸, 内置主题)组合，每轮使用新的渲染器，保证缓存为空
+    vector<IconRenderer::IconRequest> requests;
+    for (const auto& batch_theme : IconRenderer::getBuiltinThemes()) {
+        for (size_t i = 0; i < ICON_COUNT; i++) {
+            for (IconRenderer::IconSize size : {IconRenderer::SMALL, IconRenderer::MEDIUM,
+                                                IconRenderer::LARGE, IconRenderer::XLARGE}) {
+                requests.push_back({static_cast<IconId>(i), size, batch_theme});
+            }
+        }
+    }
+    
+    WorkStealingExecutor executor(argc > 2 ? static_cast<size_t>(atoi(argv[2])) : 0);
+    const int rounds = max(1, iterations / 50);
+    auto measureBatch = [&](WorkStealingExecutor* pool) {
+        double seconds = 0.0;
+        for (int n = 0; n < rounds; n++) {
+            IconRenderer fresh;
+            fresh.setExecutor(pool);
+            auto begin = chrono::steady_clock::now();
+            fresh.renderBatch(requests);
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        }
+        return seconds / rounds * 1000.0;
+    };
+    double serial_ms = measureBatch(nullptr);
+    double parallel_ms = measureBatch(&executor);
+    cout << setprecision(2) << "批量渲染 " << requests.size() << " 项: 单线程 " << serial_ms
+         << " ms，线程池（" << executor.threadCount() << " 线程） " << parallel_ms << " ms，"
+         << serial_ms / parallel_ms << "x" << endl;
+    
+    return 0;
+}
@@ -0,0 +1,160 @@
+// 本机IPC客户端：测量当前天气请求的往返延迟，同时作为协议的参考实现
+// 用法: ipc_client [套接字路径] [城市] [次数]
+#include "ipc_protocol.h"
+#include "weather_codec.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+static bool readFull(int fd, void* buffer, size_t size) {
+    char* p = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 接收HELLO帧和随附的环形缓冲区文件描述符
+static int receiveRing(int fd, IpcFrame& frame) {
+    iovec iov{&frame, sizeof(frame)};
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    if (recvmsg(fd, &msg, 0) != static_cast<ssize_t>(sizeof(frame)) || frame.type != IPC_HELLO) {
+        return -1;
+    }
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS) {
+        return -1;
+    }
+    int ring_fd;
+    memcpy(&ring_fd, CMSG_DATA(cmsg), sizeof(int));
+    return ring_fd;
+}
+
+int main(int argc, char* argv[]) {
+    string path = argc > 1 ? argv[1] : "/tmp/weather_service.sock";
+    string city = argc > 2 ? argv[2] : "Beijing";
+    int iterations = argc > 3 ? atoi(argv[3]) : 10000;
+    if (iterations <= 0) {
+        cerr << "用法: ipc_client [套接字路径] [城市] [次数]，次数必须为正整数" << endl;
+        return 1;
+    }
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        cerr << "连接 " << path << " 失败: " << strerror(errno) << endl;
+        return 1;
+    }
+    
+    IpcFrame hello;
+    int ring_fd = receiveRing(fd, hello);
+    if (ring_fd < 0) {
+        cerr << "握手失败" << endl;
+        return 1;
+    }
+    void* base = mmap(nullptr, hello.offset, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+    close(ring_fd);
+    auto* ring = static_cast<IpcRingHeader*>(base);
+    if (base == MAP_FAILED || ring->magic != IPC_RING_MAGIC || ring->version != IPC_PROTOCOL_VERSION) {
+        cerr << "环形缓冲区无效" << endl;
+        return 1;
+    }
+    const char* data = static_cast<const char*>(base) + IPC_RING_DATA_OFFSET;
+    
+    WeatherRequest request;
+    request.type = WeatherRequest::CURRENT_WEATHER;
+    request.city_name = city;
+    request.days = 0;
+    request.latitude = 0.0;
+    request.longitude = 0.0;
+    request.language = "zh";
+    
+    // 帧头和请求体一次发送
+    string message(sizeof(IpcFrame), '\0');
+    encodeWeatherRequest(request, message);
+    IpcFrame frame{IPC_REQUEST, 0, 0, static_cast<uint32_t>(message.size() - sizeof(IpcFrame)), 0};
+    
+    string inline_body;
+    WeatherResponse response;
+    auto roundTrip = [&](uint32_t id) -> bool {
+        frame.request_id = id;
+        memcpy(&message[0], &frame, sizeof(frame));
+        IpcFrame reply;
+        if (send(fd, message.data(), message.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(message.size()) ||
+            !readFull(fd, &reply, sizeof(reply)) || reply.request_id != id) {
+            return false;
+        }
+        
+        if (reply.type == IPC_RESPONSE) {
+            // 直接在共享内存中解码，处理完后释放空间
+            bool ok = decodeWeatherResponse(data + reply.offset % ring->capacity, reply.length, response);
+            ring->read_pos.store(reply.offset + reply.length, memory_order_release);
+            return ok;
+        }
+        inline_body.resize(reply.length);
+        return readFull(fd, &inline_body[0], reply.length) &&
+               decodeWeatherResponse(inline_body.data(), inline_body.size(), response);
+    };
+    
+    // 第一次请求可能访问上游，不计入统计
+    if (!roundTrip(0)) {
+        cerr << "请求失败" << endl;
+        return 1;
+    }
+    if (!response.success) {
+        cerr << "查询失败: " << response.error_message << endl;
+        return 1;
+    }
+    cout << response.current_weather.city << ": " << response.current_weather.temperature
+         << "°C, " << response.current_weather.condition << endl;
+    
+    vector<double> latencies;
+    latencies.reserve(iterations);
+    for (int i = 1; i <= iterations; i++) {
+        auto begin = chrono::steady_clock::now();
+        if (!roundTrip(static_cast<uint32_t>(i))) {
+            cerr << "第 " << i << " 次请求失败" << endl;
+            return 1;
+        }
+        latencies.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - begin).count());
+    }
+    
+    sort(latencies.begin(), latencies.end());
+    double total = 0;
+    for (double v : latencies) total += v;
+    auto percentile = [&](double p) {
+        return latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))];
+    };
+    
+    cout << fixed << setprecision(1);
+    cout << iterations << " 次请求: 平均 " << total / iterations << " us, p50 " << percentile(0.5)
+         << " us, p99 " << percentile(0.99) << " us, 最大 " << latencies.back() << " us" << endl;
+    
+    munmap(base, hello.offset);
+    close(fd);
+    return 0;
+}
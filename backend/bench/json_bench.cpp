@@ -0,0 +1,192 @@
+// 16天完整预报响应的JSON序列化：nlohmann DOM 与 流式JsonWriter 对比
+// 用法: json_bench [迭代次数]
+#include "weather_json.h"
+#include <nlohmann/json.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+using json = nlohmann::json;
+
+// 改用JsonWriter之前的实现
+static json weatherDataToJson(const WeatherData& data) {
+    json j;
+    j["temperature"] = data.temperature;
+    j["feels_like"] = data.feels_like;
+    j["humidity"] = data.humidity;
+    j["wind_speed"] = data.wind_speed;
+    j["wind_direction"] = data.wind_direction;
+    j["pressure"] = data.pressure;
+    j["precipitation"] = data.precipitation;
+    j["cloud_cover"] = data.cloud_cover;
+    j["uv_index"] = data.uv_index;
+    j["condition"] = data.condition;
+    j["description"] = data.description;
+    j["weather_code"] = data.weather_code;
+    j["icon_name"] = data.icon_name;
+    j["timestamp"] = data.timestamp;
+    j["city"] = data.city;
+    j["country"] = data.country;
+    j["latitude"] = data.latitude;
+    j["longitude"] = data.longitude;
+    j["timezone"] = data.timezone;
+    
+    if (!data.hourly_forecast.empty()) {
+        json hourly = json::array();
+        for (const auto& h : data.hourly_forecast) {
+            hourly.push_back({
+                {"time", h.timestamp},
+                {"temperature", h.temperature},
+                {"precipitation_probability", h.precipitation_probability},
+                {"weather_code", h.weather_code}
+            });
+        }
+        j["hourly"] = move(hourly);
+    }
+    
+    if (!data.daily_forecast.empty()) {
+        json daily = json::array();
+        for (const auto& d : data.daily_forecast) {
+            daily.push_back({
+                {"date", d.date},
+                {"temp_max", d.temp_max},
+                {"temp_min", d.temp_min},
+                {"precipitation_sum", d.precipitation_sum},
+                {"weather_code", d.weather_code},
+                {"sunrise", d.sunrise},
+                {"sunset", d.sunset}
+            });
+        }
+        j["daily"] = move(daily);
+    }
+    
+    return j;
+}
+
+static string responseToJsonDom(const WeatherResponse& response) {
+    json j;
+    j["success"] = response.success;
+    j["current"] = weatherDataToJson(response.current_weather);
+    
+    json forecast = json::array();
+    for (const auto& f : response.forecast) {
+        forecast.push_back(weatherDataToJson(f));
+    }
+    j["forecast"] = move(forecast);
+    
+    return j.dump(-1, ' ', false, json::error_handler_t::replace);
+}
+
+// 一位小数，保证两种实现输出相同的数字
+static double tenths(double value) {
+    return round(value * 10.0) / 10.0;
+}
+
+static WeatherResponse makeForecastResponse() {
+    const int days = 16;
+    const int64_t start = 1767196800;
+    
+    WeatherResponse response;
+    response.success = true;
+    
+    WeatherData& current = response.current_weather;
+    current.temperature = 21.5;
+    current.feels_like = 20.1;
+    current.humidity = 43;
+    current.wind_speed = 12.6;
+    current.wind_direction = 135;
+    current.pressure = 1012.0;
+    current.precipitation = 0.2;
+    current.cloud_cover = 75;
+    current.uv_index = 3;
+    current.condition = "多云转小雨";
+    current.description = "午后有阵雨，\"局部\"雷电";
+    current.weather_code = 61;
+    current.icon_name = "rain";
+    current.timestamp = start;
+    current.city = "北京市朝阳区";
+    current.country = "中国";
+    current.latitude = 39.9042;
+    current.longitude = 116.4074;
+    current.timezone = "Asia/Shanghai";
+    
+    for (int i = 0; i < days * 24; i++) {
+        WeatherData::HourlyData h;
+        h.timestamp = start + i * 3600;
+        h.temperature = tenths(15.0 + 8.0 * sin(i * 0.26));
+        h.precipitation_probability = (i * 7) % 100;
+        h.weather_code = (i / 6) % 4 == 0 ? 61 : 3;
+        current.hourly_forecast.push_back(h);
+    }
+    
+    for (int i = 0; i < days; i++) {
+        WeatherData::DailyData d;
+        d.date = start + i * 86400;
+        d.temp_max = tenths(24.0 + i * 0.3);
+        d.temp_min = tenths(12.0 - i * 0.2);
+        d.precipitation_sum = tenths(i * 0.7);
+        d.weather_code = i % 3 == 0 ? 61 : 2;
+        d.sunrise = to_string(d.date + 22300);
+        d.sunset = to_string(d.date + 61800);
+        current.daily_forecast.push_back(d);
+        
+        WeatherData daily;
+        daily.temperature = d.temp_max;
+        daily.weather_code = d.weather_code;
+        daily.icon_name = d.weather_code == 61 ? "rain" : "partly-cloudy-day";
+        daily.condition = d.weather_code == 61 ? "小雨" : "局部多云";
+        response.forecast.push_back(daily);
+    }
+    
+    return response;
+}
+
+template<typename F>
+static double measure(int iterations, F&& run) {
+    auto begin = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        run();
+    }
+    auto end = chrono::steady_clock::now();
+    return chrono::duration<double, nano>(end - begin).count() / iterations;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 2000;
+    WeatherResponse response = makeForecastResponse();
+    
+    string dom = responseToJsonDom(response);
+    string streamed;
+    writeWeatherResponse(streamed, response);
+    if (dom != streamed) {
+        cerr << "两种实现的输出不一致" << endl;
+        return 1;
+    }
+    
+    size_t sink = 0;
+    double dom_ns = measure(iterations, [&]() {
+        sink += responseToJsonDom(response).size();
+    });
+    
+    // 复用同一个输出缓冲区
+    string buffer;
+    double writer_ns = measure(iterations, [&]() {
+        buffer.clear();
+        writeWeatherResponse(buffer, response);
+        sink += buffer.size();
+    });
+    
+    double bytes = static_cast<double>(streamed.size());
+    cout << "响应大小: " << streamed.size() << " 字节（"
+         << response.current_weather.hourly_forecast.size() << " 小时, "
+         << response.current_weather.daily_forecast.size() << " 天）" << endl;
+    cout << fixed << setprecision(1);
+    cout << "nlohmann DOM: " << dom_ns / 1000.0 << " us/次, " << bytes / dom_ns * 1000.0 << " MB/s" << endl;
+    cout << "JsonWriter:   " << writer_ns / 1000.0 << " us/次, " << bytes / writer_ns * 1000.0 << " MB/s" << endl;
+    cout << "加速比: " << setprecision(2) << dom_ns / writer_ns << "x" << endl;
+    
+    return sink == 0 ? 1 : 0;
+}
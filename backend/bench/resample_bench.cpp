@@ -0,0 +1,154 @@
+// 图标缩放：从256x256主光栅缩小到任意尺寸的速度（各像素内核、面积平均和Lanczos3），
+// 缩小结果与按目标尺寸直接光栅化的差异，以及渲染器生成非常用尺寸的耗时
+// 用法: resample_bench [每个尺寸的缩放次数]
+#include "icon_renderer.h"
+#include "image_resampler.h"
+#include "path_rasterizer.h"
+#include "pixel_kernels.h"
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <iomanip>
+
+using namespace std;
+
+static const int SIZES[] = {24, 48, 96, 192};
+
+// 渲染器输出非预乘的RGBA，缩放前先转回预乘
+static vector<uint8_t> premultiply(const string& rgba) {
+    vector<uint8_t> out(rgba.begin(), rgba.end());
+    for (size_t i = 0; i < out.size(); i += 4) {
+        uint32_t alpha = out[i + 3];
+        for (int c = 0; c < 3; c++) {
+            out[i + c] = static_cast<uint8_t>((out[i + c] * alpha + 127) / 255);
+        }
+    }
+    return out;
+}
+
+static vector<uint8_t> resample(const vector<uint8_t>& master, int size, ResampleFilter filter) {
+    vector<uint8_t> out(static_cast<size_t>(size) * size * 4);
+    resampleRGBA(master.data(), IconRenderer::MASTER_RASTER_SIZE, IconRenderer::MASTER_RASTER_SIZE,
+                 out.data(), size, size, filter);
+    return out;
+}
+
+int main(int argc, char* argv[]) {
+    int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    IconRenderer renderer;
+    IconRenderer::ColorTheme theme = IconRenderer::getDayTheme();
+    const int master_size = IconRenderer::MASTER_RASTER_SIZE;
+    
+    vector<vector<uint8_t>> masters;
+    for (size_t i = 0; i < ICON_COUNT; i++) {
+        masters.push_back(premultiply(*renderer.getIconBitmap(static_cast<IconId>(i), master_size, theme)));
+    }
+    
+    // 与直接光栅化比较（预乘alpha）：每个通道的平均和最大绝对差（0~255）
+    cout << "与直接光栅化的差异（平均/最大）" << endl;
+    cout << fixed << setprecision(2);
+    for (int size : {16, 32, 64, 128}) {
+        cout << setw(4) << size << "px";
+        for (ResampleFilter filter : {RESAMPLE_BOX, RESAMPLE_LANCZOS3}) {
+            double total = 0.0;
+            int worst = 0;
+            size_t count = 0;
+            for (size_t i = 0; i < ICON_COUNT; i++) {
+                vector<uint8_t> scaled = resample(masters[i], size, filter);
+                vector<uint8_t> direct = premultiply(*renderer.getIconBitmap(static_cast<IconId>(i), size, theme));
+                for (size_t b = 0; b < scaled.size(); b++) {
+                    int diff = abs(static_cast<int>(scaled[b]) - direct[b]);
+                    total += diff;
+                    worst = max(worst, diff);
+                    count++;
+                }
+            }
+            cout << "  " << (filter == RESAMPLE_BOX ? "面积平均 " : "Lanczos3 ")
+                 << total / count << "/" << worst;
+        }
+        cout << endl;
+    }
+    
+    // 标量实现的输出作为参照，其他实现必须逐字节相同
+    selectSpanKernels("scalar");
+    vector<vector<uint8_t>> reference;
+    for (ResampleFilter filter : {RESAMPLE_BOX, RESAMPLE_LANCZOS3}) {
+        for (int size : SIZES) {
+            reference.push_back(resample(masters[0], size, filter));
+        }
+    }
+    
+    cout << endl << "每个图标的缩放耗时（us）" << endl;
+    cout << "内核    滤波器  ";
+    for (int size : SIZES) {
+        cout << setw(7) << size << "px";
+    }
+    cout << endl;
+    
+    size_t sink = 0;
+    for (const SpanKernels* kernels : availableSpanKernels()) {
+        selectSpanKernels(kernels->name);
+        size_t r = 0;
+        for (ResampleFilter filter : {RESAMPLE_BOX, RESAMPLE_LANCZOS3}) {
+            cout << setw(6) << kernels->name << "  " << (filter == RESAMPLE_BOX ? "box     " : "lanczos3");
+            for (int size : SIZES) {
+                if (resample(masters[0], size, filter) != reference[r++]) {
+                    cerr << endl << kernels->name << ": " << size << "px 的输出与标量实现不一致" << endl;
+                    return 1;
+                }
+                
+                vector<uint8_t> out(static_cast<size_t>(size) * size * 4);
+                auto begin = chrono::steady_clock::now();
+                for (int n = 0; n < iterations; n++) {
+                    const vector<uint8_t>& master = masters[n % ICON_COUNT];
+                    resampleRGBA(master.data(), master_size, master_size, out.data(), size, size, filter);
+                    sink += out[out.size() / 2];
+                }
+                auto end = chrono::steady_clock::now();
+                cout << setw(9) << chrono::duration<double, micro>(end - begin).count() / iterations;
+            }
+            cout << endl;
+        }
+    }
+    
+    // 渲染器生成非常用尺寸：主光栅已存在，每个尺寸第一次请求时从最接近的一级缩放
+    cout << endl << "渲染器生成新尺寸（us，主光栅已生成）" << endl << "               ";
+    {
+        IconRenderer warm;
+        const auto themes = IconRenderer::getBuiltinThemes();
+        for (const auto& each : themes) {
+            for (size_t i = 0; i < ICON_COUNT; i++) {
+                warm.getIconBitmap(static_cast<IconId>(i), IconRenderer::MIN_ICON_SIZE + 1, each);
+            }
+        }
+        for (int size : SIZES) {
+            auto begin = chrono::steady_clock::now();
+            for (const auto& each : themes) {
+                for (size_t i = 0; i < ICON_COUNT; i++) {
+                    sink += (*warm.getIconBitmap(static_cast<IconId>(i), size, each))[0];
+                }
+            }
+            auto end = chrono::steady_clock::now();
+            cout << setw(9) << chrono::duration<double, micro>(end - begin).count() / (themes.size() * ICON_COUNT);
+        }
+        cout << endl;
+    }
+    
+    // 参照：按目标尺寸直接光栅化（每轮新的渲染器，避免命中缓存）
+    cout << "直接光栅化（us）   ";
+    for (int size : {64, 128}) {
+        double seconds = 0.0;
+        for (int n = 0; n < iterations / 10 + 1; n++) {
+            IconRenderer fresh;
+            auto begin = chrono::steady_clock::now();
+            for (size_t i = 0; i < ICON_COUNT; i++) {
+                sink += (*fresh.getIconBitmap(static_cast<IconId>(i), size, theme))[0];
+            }
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+        }
+        cout << size << "px: " << seconds * 1e6 / ((iterations / 10 + 1) * ICON_COUNT) << "  ";
+    }
+    cout << endl;
+    
+    return sink == 0 ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+-- HTTP服务器压测脚本（wrk）
+-- 用法: wrk -t4 -c256 -d30s -s bench/wrk_weather.lua http://127.0.0.1:8080
+-- 环境变量:
+--   WRK_PIPELINE  每次发送的pipelining请求数（默认1）
+--   WRK_CITY      查询的城市（默认Beijing）
+
+local depth = tonumber(os.getenv("WRK_PIPELINE") or "1")
+local city = os.getenv("WRK_CITY") or "Beijing"
+
+local paths = {
+   "/api/weather?city=" .. city,
+   "/api/forecast?city=" .. city .. "&days=7",
+   "/api/forecast?city=" .. city .. "&start=24&count=48&vars=temperature",
+}
+
+local batch
+
+init = function(args)
+   local requests = {}
+   for i = 1, depth do
+      requests[i] = wrk.format("GET", paths[(i - 1) % #paths + 1])
+   end
+   batch = table.concat(requests)
+end
+
+request = function()
+   return batch
+end
+
+done = function(summary, latency, requests)
+   local seconds = summary.duration / 1000000
+   io.write(string.format("请求/秒: %.0f\n", summary.requests / seconds))
+   for _, p in ipairs({ 50, 90, 99, 99.9 }) do
+      io.write(string.format("p%g: %.3f ms\n", p, latency:percentile(p) / 1000))
+   end
+   io.write(string.format("非2xx响应: %d, 套接字错误: %d\n", summary.errors.status,
+      summary.errors.connect + summary.errors.read + summary.errors.write + summary.errors.timeout))
+end
@@ -0,0 +1,103 @@
+#ifndef ADMISSION_CONTROLLER_H
+#define ADMISSION_CONTROLLER_H
+
+#include "executor.h"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 准入控制：只作用于需要访问上游的请求，缓存命中总是放行
+// 每个客户端一个令牌桶；全局限制同时访问上游的请求数，
+// 低优先级请求只能使用一部分容量，过载时最先被拒绝
+class AdmissionController {
+public:
+    struct Options {
+        double client_rate = 10.0;            // 每客户端每秒补充的令牌数，<=0 表示不限速
+        double client_burst = 20.0;           // 令牌桶容量
+        size_t max_upstream_in_flight = 0;    // 同时访问上游的请求上限，0 表示工作线程数的3/4
+        size_t max_clients = 65536;           // 跟踪的客户端数上限，超过后淘汰已回满的桶
+    };
+    
+    enum Decision {
+        ADMITTED,
+        RATE_LIMITED,   // 客户端令牌不足
+        OVERLOADED      // 上游并发已满
+    };
+    
+    struct Statistics {
+        uint64_t admitted;
+        uint64_t rate_limited;
+        uint64_t overloaded;
+        size_t upstream_in_flight;
+        size_t upstream_limit;
+        size_t tracked_clients;
+    };
+    
+    // 上游并发许可，每个许可对应一个同时进行的上游请求，析构时归还
+    class Permit {
+    public:
+        Permit() = default;
+        Permit(Permit&& other) noexcept : owner_(other.owner_), count_(other.count_) {
+            other.owner_ = nullptr;
+            other.count_ = 0;
+        }
+        Permit& operator=(Permit&& other) noexcept;
+        ~Permit() { release(); }
+        
+        Permit(const Permit&) = delete;
+        Permit& operator=(const Permit&) = delete;
+        
+        void release();
+        
+        // 持有的许可数，调用方同时进行的上游请求不能超过它
+        size_t count() const { return count_; }
+    
+    private:
+        friend class AdmissionController;
+        AdmissionController* owner_ = nullptr;
+        size_t count_ = 0;
+    };
+    
+    AdmissionController(const Options& options, size_t worker_threads);
+    
+    // client_id 为空时不做单客户端限速（内部调用）。
+    // 会发起多个上游请求的调用（批量）传入上游请求数upstream_calls：在容量内取得1~upstream_calls个许可，
+    // 并按tokens扣除客户端令牌。令牌不少于1个即放行，不足的部分记为欠额，由之后的补充抵扣
+    Decision admit(const std::string& client_id, WorkStealingExecutor::Priority priority, Permit& permit,
+                   size_t upstream_calls = 1, double tokens = 1.0);
+    
+    Statistics getStatistics() const;
+
+private:
+    struct Bucket {
+        double tokens;
+        int64_t last_refill_ns;
+    };
+    
+    static constexpr size_t SHARD_COUNT = 16;
+    
+    struct alignas(64) Shard {
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, Bucket> buckets;
+    };
+    
+    size_t acquireUpstream(WorkStealingExecutor::Priority priority, size_t wanted);
+    bool takeToken(const std::string& client_id, double tokens);
+    void evictIdle(Shard& shard, int64_t now_ns);
+    
+    Options options_;
+    size_t upstream_limit_;
+    std::atomic<size_t> upstream_in_flight_{0};
+    
+    std::atomic<uint64_t> admitted_{0};
+    std::atomic<uint64_t> rate_limited_{0};
+    std::atomic<uint64_t> overloaded_{0};
+    // 各分片中桶数之和，在持有分片锁时更新，读取统计时不用逐个加锁
+    std::atomic<size_t> tracked_clients_{0};
+    
+    Shard shards_[SHARD_COUNT];
+};
+
+#endif // ADMISSION_CONTROLLER_H
@@ -1,59 +1,134 @@
-#ifndef API_CLIENT_H
-#define API_CLIENT_H
-
-#include <string>
-#include <memory>
-#include "weather_data.h"
-
-class APIClient {
-public:
-    APIClient();
-    ~APIClient();
-    
-    // 设置API端点
-    void setEndpoint(const std::string& endpoint);
-    
-    // 获取当前天气
-    WeatherData getCurrentWeather(double lat, double lon, 
-                                  const std::string& timezone = "auto",
-                                  const std::string& language = "zh");
-    
-    // 获取天气预报
-    WeatherData getForecast(double lat, double lon, 
-                            int days = 7,
-                            const std::string& timezone = "auto",
-                            const std::string& language = "zh");
-    
-    // 根据城市名获取坐标
-    std::pair<double, double> getCoordinates(const std::string& city, 
-                                             const std::string& country = "");
-    
-    // 搜索城市
-    std::vector<std::pair<std::string, std::string>> 
-    searchCity(const std::string& query, int limit = 10);
-    
-private:
-    std::string buildCurrentWeatherUrl(double lat, double lon, 
-                                       const std::string& timezone,
-                                       const std::string& language);
-    
-    std::string buildForecastUrl(double lat, double lon, int days,
-                                 const std::string& timezone,
-                                 const std::string& language);
-    
-    std::string buildGeocodingUrl(const std::string& query);
-    
-    std::string performHttpRequest(const std::string& url);
-    
-    WeatherData parseCurrentWeatherJson(const std::string& json);
-    WeatherData parseForecastJson(const std::string& json);
-    
-    std::string api_endpoint_;
-    std::string user_agent_;
-    
-    // HTTP客户端实现
-    class HttpClientImpl;
-    std::unique_ptr<HttpClientImpl> http_client_;
-};
-
-#endif // API_CLIENT_H
\ No newline at end of file
+#ifndef API_CLIENT_H
+#define API_CLIENT_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include "weather_data.h"
+#include "latency_histogram.h"
+
+// 上游请求失败的原因
+struct UpstreamError {
+    enum Kind {
+        NONE = 0,
+        NETWORK,        // 连接失败或超时
+        HTTP_STATUS,    // 非200响应，状态码见http_status
+        PARSE,          // 响应不是合法的JSON
+        INVALID,        // 缺少必需字段或数值超出合理范围
+        NOT_FOUND       // 地理编码没有匹配的城市
+    };
+    static constexpr int KIND_COUNT = NOT_FOUND + 1;
+    
+    Kind kind = NONE;
+    long http_status = 0;
+    std::string message;
+    
+    bool ok() const { return kind == NONE; }
+    // 网络错误、上游限流和5xx通常很快恢复，其余的重试也不会有不同结果
+    bool transient() const;
+};
+
+class APIClient {
+public:
+    // Open-Meteo 支持的最大预报天数
+    static constexpr int MAX_FORECAST_DAYS = 16;
+    
+    // 单次批量请求的最大坐标数（受URL长度限制）
+    static constexpr size_t MAX_BATCH_LOCATIONS = 50;
+    
+    // 上游接口，按接口分别统计
+    enum Endpoint {
+        ENDPOINT_CURRENT,
+        ENDPOINT_CURRENT_BATCH,
+        ENDPOINT_FORECAST,
+        ENDPOINT_GEOCODING,
+        ENDPOINT_SEARCH,
+        ENDPOINT_COUNT
+    };
+    
+    // 读取不加锁。耗时包括HTTP请求和解析，单位微秒；
+    // 失败按UpstreamError::Kind计数（NONE一栏不用），批量请求中个别位置的数据无效不计
+    struct Statistics {
+        LatencyHistogram latency[ENDPOINT_COUNT];
+        uint64_t errors[ENDPOINT_COUNT][UpstreamError::KIND_COUNT];
+        uint64_t in_flight;
+    };
+    
+    APIClient();
+    ~APIClient();
+    
+    // 设置API端点
+    void setEndpoint(const std::string& endpoint);
+    
+    // 以下接口失败时返回默认值，原因写入error（可为空）。
+    // 返回的天气数据都经过校验，缺少必需字段或数值不合理时按INVALID处理
+    
+    // 获取当前天气
+    WeatherData getCurrentWeather(double lat, double lon, 
+                                  const std::string& timezone = "auto",
+                                  const std::string& language = "zh",
+                                  UpstreamError* error = nullptr);
+    
+    // 批量获取当前天气，一次上游请求查询多组坐标
+    // 成功时结果与coords一一对应，请求失败时返回空数组。
+    // 个别位置的数据不合法时整体仍算成功，该位置的原因写入item_errors的对应元素
+    std::vector<WeatherData> getCurrentWeatherBatch(const std::vector<std::pair<double, double>>& coords,
+                                                    const std::string& timezone = "auto",
+                                                    const std::string& language = "zh",
+                                                    UpstreamError* error = nullptr,
+                                                    std::vector<UpstreamError>* item_errors = nullptr);
+    
+    // 获取天气预报
+    WeatherData getForecast(double lat, double lon, 
+                            int days = 7,
+                            const std::string& timezone = "auto",
+                            const std::string& language = "zh",
+                            UpstreamError* error = nullptr);
+    
+    // 根据城市名获取坐标，没有匹配的城市时为NOT_FOUND
+    std::pair<double, double> getCoordinates(const std::string& city, 
+                                             const std::string& country = "",
+                                             UpstreamError* error = nullptr);
+    
+    // 搜索城市，没有匹配结果不算失败
+    std::vector<std::pair<std::string, std::string>> 
+    searchCity(const std::string& query, int limit = 10, UpstreamError* error = nullptr);
+    
+    Statistics getStatistics() const;
+
+private:
+    // 一次上游调用的计时，析构时记录
+    class CallScope;
+    
+    std::string buildCurrentWeatherUrl(double lat, double lon, 
+                                       const std::string& timezone,
+                                       const std::string& language);
+    
+    std::string buildCurrentWeatherBatchUrl(const std::vector<std::pair<double, double>>& coords,
+                                            const std::string& timezone,
+                                            const std::string& language);
+    
+    std::string buildForecastUrl(double lat, double lon, int days,
+                                 const std::string& timezone,
+                                 const std::string& language);
+    
+    std::string buildGeocodingUrl(const std::string& query);
+    
+    std::string performHttpRequest(const std::string& url, UpstreamError& error);
+    
+    WeatherData parseCurrentWeatherJson(const std::string& json, UpstreamError& error);
+    WeatherData parseForecastJson(const std::string& json, UpstreamError& error);
+    
+    std::string api_endpoint_;
+    std::string user_agent_;
+    
+    // HTTP客户端实现
+    class HttpClientImpl;
+    std::unique_ptr<HttpClientImpl> http_client_;
+    
+    AtomicLatencyHistogram latency_[ENDPOINT_COUNT];
+    std::atomic<uint64_t> errors_[ENDPOINT_COUNT][UpstreamError::KIND_COUNT] = {};
+    std::atomic<uint64_t> in_flight_{0};
+};
+
+#endif // API_CLIENT_H
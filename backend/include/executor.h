@@ -0,0 +1,103 @@
+#ifndef EXECUTOR_H
+#define EXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 工作窃取线程池
+// 每个工作线程为每个优先级维护一个双端队列：本线程从队首取任务，
+// 空闲线程从其他线程的队尾窃取，高优先级任务总是先于低优先级任务被取走
+class WorkStealingExecutor {
+public:
+    enum Priority {
+        HIGH = 0,
+        NORMAL = 1,
+        LOW = 2
+    };
+    static constexpr int PRIORITY_COUNT = 3;
+    
+    using Task = std::function<void()>;
+    
+    struct WorkerStatistics {
+        size_t queue_depth;       // 当前排队任务数
+        uint64_t executed;        // 已执行任务数
+        uint64_t stolen;          // 从其他线程窃取的任务数
+        double utilization;       // 启动以来忙碌时间占比 (0~1)
+    };
+    
+    struct Statistics {
+        size_t queue_depth;
+        uint64_t submitted;
+        uint64_t executed;
+        uint64_t steals;
+        std::vector<WorkerStatistics> workers;
+    };
+    
+    explicit WorkStealingExecutor(size_t thread_count = 0); // 0 表示使用CPU核数
+    ~WorkStealingExecutor();
+    
+    WorkStealingExecutor(const WorkStealingExecutor&) = delete;
+    WorkStealingExecutor& operator=(const WorkStealingExecutor&) = delete;
+    
+    // 提交任务。在工作线程内提交时放入本线程队列，否则轮流分配
+    void submit(Task task, Priority priority = NORMAL);
+    
+    template <typename F>
+    auto async(F&& func, Priority priority = NORMAL) -> std::future<decltype(func())> {
+        using Result = decltype(func());
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(func));
+        std::future<Result> future = task->get_future();
+        submit([task]() { (*task)(); }, priority);
+        return future;
+    }
+    
+    // 在当前线程执行一个排队中的任务。等待子任务时调用，避免工作线程空等
+    bool runPendingTask();
+    
+    // 等待子任务完成。在工作线程中等待时顺便执行排队的任务，避免线程池被等待者占满
+    template <typename T>
+    T awaitHelping(std::future<T>& result) {
+        while (result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            if (!runPendingTask()) {
+                result.wait_for(std::chrono::milliseconds(1));
+            }
+        }
+        return result.get();
+    }
+    
+    bool isWorkerThread() const;
+    size_t threadCount() const { return workers_.size(); }
+    Statistics getStatistics() const;
+    
+    // 执行完已排队的任务后停止所有工作线程
+    void shutdown();
+
+private:
+    struct Worker;
+    
+    void workerLoop(size_t index);
+    bool findTask(size_t index, Task& task);
+    void execute(size_t index, Task& task);
+    
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::atomic<size_t> next_worker_{0};
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> sleeping_{0};
+    std::atomic<uint64_t> submitted_{0};
+    std::atomic<bool> stopping_{false};
+    
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    std::chrono::steady_clock::time_point start_time_;
+};
+
+#endif // EXECUTOR_H
@@ -0,0 +1,61 @@
+#ifndef FORECAST_DELTA_H
+#define FORECAST_DELTA_H
+
+#include "weather_data.h"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// 预报快照的增量编码
+// 快照按列量化（温度和降水量精确到0.1，其余取整），版本号是量化内容的哈希，
+// 内容相同的快照在任何进程、重启前后都得到同一版本。每个位置保留最近几个版本，
+// 客户端带上已确认的版本时只返回变化的下标和量化差值
+class ForecastDeltaEncoder {
+public:
+    struct Statistics {
+        uint64_t full_snapshots;
+        uint64_t deltas;
+        size_t locations;
+    };
+    
+    explicit ForecastDeltaEncoder(size_t versions_per_location = 8, size_t max_locations = 4096);
+    
+    // 编码forecast的前day_count天和全部逐小时数据，并记录为该位置的最新版本
+    std::shared_ptr<const ForecastDelta> encode(const std::string& cache_key,
+                                                const std::shared_ptr<const WeatherData>& forecast,
+                                                size_t day_count,
+                                                uint64_t base_version);
+    
+    Statistics getStatistics() const;
+
+private:
+    // 列式量化快照
+    struct Snapshot {
+        uint64_t version;
+        std::weak_ptr<const WeatherData> source;   // 同一份缓存数据不重复量化
+        size_t day_count;
+        std::vector<std::vector<int64_t>> hourly;
+        std::vector<std::vector<int64_t>> daily;
+    };
+    
+    static std::shared_ptr<const Snapshot> makeSnapshot(const std::shared_ptr<const WeatherData>& forecast,
+                                                        size_t day_count);
+    static std::shared_ptr<ForecastDelta> makeFull(const Snapshot& snapshot);
+    static std::shared_ptr<ForecastDelta> makeDelta(const Snapshot& base, const Snapshot& snapshot);
+    
+    size_t versions_per_location_;
+    size_t max_locations_;
+    
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, std::deque<std::shared_ptr<const Snapshot>>> history_;
+    
+    std::atomic<uint64_t> full_snapshots_{0};
+    std::atomic<uint64_t> deltas_{0};
+};
+
+#endif // FORECAST_DELTA_H
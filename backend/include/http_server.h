@@ -0,0 +1,104 @@
+#ifndef HTTP_SERVER_H
+#define HTTP_SERVER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <mutex>
+#include <functional>
+
+class WeatherService;
+class IconRenderer;
+
+// 基于epoll的非阻塞HTTP/1.1服务器
+// 边缘触发套接字，支持keep-alive和pipelining，读缓冲来自有界缓冲池
+class HttpServer {
+public:
+    struct Options {
+        int port = 8080;
+        int io_threads = 1;                   // 事件循环线程数（每线程一个epoll）
+        size_t max_connections = 10000;       // 最大并发连接数
+        size_t buffer_size = 16 * 1024;       // 每个读缓冲块大小，也是单个请求的上限
+        size_t max_buffers = 4096;            // 读缓冲池总块数
+        size_t max_pending_output = 1 << 20;  // 单连接待发送数据上限，超过后暂停处理pipelining
+        size_t max_pipelined = 128;           // 单连接同时处理中的请求数上限
+        int idle_timeout = 60;                // 空闲连接超时（秒）
+        bool reuse_port = false;              // SO_REUSEPORT，多个工作进程监听同一端口
+        // 来自这些对端IP（反向代理）的请求按X-Client-Id头限速，其他请求一律按对端IP限速
+        std::vector<std::string> trusted_proxies;
+    };
+    
+    struct Request {
+        std::string method;
+        std::string path;
+        std::vector<std::pair<std::string, std::string>> query;
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        std::string remote_address;   // 对端IP
+        bool keep_alive = true;
+        
+        const std::string* getQuery(const std::string& name) const;
+        const std::string* getHeader(const std::string& name) const; // 名称不区分大小写
+    };
+    
+    // 流式响应（SSE）的推送端。处理函数创建后放入Response::stream，
+    // 之后可在任意线程推送数据；响应头发出之前推送的数据会先缓存
+    class Stream {
+    public:
+        bool send(std::string data);   // 连接已关闭时返回false
+        void close();                  // 发送完已推送的数据后关闭连接
+        bool isOpen() const;
+        
+        // 以下由事件循环调用
+        using Sink = std::function<void(std::string data, bool end)>;
+        void attach(Sink sink);
+        void detach();
+    
+    private:
+        static constexpr size_t MAX_BUFFERED = 256;
+        
+        mutable std::mutex mutex_;
+        Sink sink_;
+        std::vector<std::string> buffered_;
+        bool closed_ = false;      // 不再接受数据
+        bool detached_ = false;    // 连接已关闭
+    };
+    
+    struct Response {
+        int status = 200;
+        std::string content_type = "application/json; charset=utf-8";
+        std::vector<std::pair<std::string, std::string>> headers;
+        std::string body;
+        std::shared_ptr<const std::string> shared_body; // 非空时代替body，与缓存共享，发送时不复制
+        std::shared_ptr<Stream> stream;   // 非空时不带Content-Length，连接专用于推送
+    };
+    
+    struct Statistics {
+        uint64_t connections_accepted;
+        uint64_t connections_rejected;
+        uint64_t requests;
+        uint64_t bad_requests;
+        uint64_t active_connections;
+        uint64_t buffers_in_use;
+        uint64_t buffers_exhausted;   // 读缓冲池耗尽而关闭的连接
+    };
+    
+    HttpServer(const Options& options,
+               WeatherService* weather_service,
+               IconRenderer* icon_renderer = nullptr);
+    ~HttpServer();
+    
+    // 在当前线程运行事件循环，直到调用Stop
+    void Start();
+    void Stop();
+    
+    Statistics GetStatistics() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+#endif // HTTP_SERVER_H
@@ -1,79 +1,259 @@
-#ifndef ICON_RENDERER_H
-#define ICON_RENDERER_H
-
-#include <string>
-#include <vector>
-#include <cstdint>
-
-// 矢量图标渲染器
-class IconRenderer {
-public:
-    // 图标大小
-    enum IconSize {
-        SMALL = 16,
-        MEDIUM = 32,
-        LARGE = 64,
-        XLARGE = 128
-    };
-    
-    // 颜色主题
-    struct ColorTheme {
-        uint32_t primary_color;
-        uint32_t secondary_color;
-        uint32_t background_color;
-        uint32_t accent_color;
-    };
-    
-    IconRenderer();
-    ~IconRenderer();
-    
-    // 渲染图标到内存
-    std::vector<uint8_t> renderIcon(const std::string& icon_name, 
-                                    IconSize size = MEDIUM,
-                                    const ColorTheme& theme = getDefaultTheme());
-    
-    // 渲染图标到文件
-    bool renderIconToFile(const std::string& icon_name, 
-                         const std::string& filename,
-                         IconSize size = MEDIUM,
-                         const ColorTheme& theme = getDefaultTheme());
-    
-    // 获取SVG路径数据（用于WPF）
-    std::string getSVGPathData(const std::string& icon_name);
-    
-    // 获取图标尺寸信息
-    static int getIconWidth(IconSize size);
-    static int getIconHeight(IconSize size);
-    
-    // 默认颜色主题
-    static ColorTheme getDefaultTheme();
-    static ColorTheme getDayTheme();
-    static ColorTheme getNightTheme();
-    static ColorTheme getRainTheme();
-    static ColorTheme getSnowTheme();
-    
-private:
-    // 内部渲染实现
-    class IconRendererImpl;
-    std::unique_ptr<IconRendererImpl> impl_;
-    
-    // 图标定义
-    struct IconDefinition {
-        std::string name;
-        std::vector<std::string> svg_paths;
-        std::vector<std::pair<double, double>> control_points;
-        bool has_fill;
-        bool has_stroke;
-    };
-    
-    static const std::vector<IconDefinition> icon_definitions_;
-    
-    const IconDefinition* findIconDefinition(const std::string& name) const;
-    std::vector<uint8_t> renderToBitmap(const IconDefinition& icon, 
-                                       IconSize size,
-                                       const ColorTheme& theme);
-    std::string renderToSVG(const IconDefinition& icon,
-                           const ColorTheme& theme);
-};
-
-#endif // ICON_RENDERER_H
\ No newline at end of file
+#ifndef ICON_RENDERER_H
+#define ICON_RENDERER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include "weather_icons.h"
+#include "latency_histogram.h"
+
+class WorkStealingExecutor;
+
+// 矢量图标渲染器
+class IconRenderer {
+public:
+    // 常用的图标大小（像素）。接口接受MIN_ICON_SIZE~MAX_ICON_SIZE之间的任意像素尺寸，
+    // 这几档直接按尺寸光栅化并在启动时预热，其他尺寸（如HiDPI的1.5x/3x）由主光栅缩小得到
+    enum IconSize {
+        SMALL = 16,
+        MEDIUM = 32,
+        LARGE = 64,
+        XLARGE = 128
+    };
+    
+    // 位图输出格式
+    enum ImageFormat {
+        FORMAT_RGBA,   // 原始RGBA像素
+        FORMAT_PNG,
+        FORMAT_QOI
+    };
+    
+    // 颜色主题
+    struct ColorTheme {
+        uint32_t primary_color;
+        uint32_t secondary_color;
+        uint32_t background_color;
+        uint32_t accent_color;
+        
+        bool operator==(const ColorTheme& other) const {
+            return primary_color == other.primary_color &&
+                   secondary_color == other.secondary_color &&
+                   background_color == other.background_color &&
+                   accent_color == other.accent_color;
+        }
+    };
+    
+    // 渲染结果缓存的统计，读取不加锁
+    struct CacheStatistics {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t evictions;   // 超出字节上限时淘汰的渲染结果和图集
+        size_t entries;
+        size_t bytes;
+        size_t atlases;
+        size_t atlas_bytes;
+        size_t masters;    // 主光栅数
+    };
+    
+    // 未命中缓存时各阶段的耗时（微秒）
+    enum RenderStage {
+        STAGE_BITMAP,     // 光栅化或从主光栅缩放
+        STAGE_ENCODE,     // PNG/QOI编码
+        STAGE_ATLAS,      // 图集打包和编码（不含其中图标的光栅化）
+        RENDER_STAGE_COUNT
+    };
+    
+    struct RenderStatistics {
+        LatencyHistogram latency[RENDER_STAGE_COUNT];
+    };
+    
+    // 批量渲染和图集中的一项
+    struct IconRequest {
+        IconId icon;
+        int size;
+        ColorTheme theme;
+        
+        bool operator==(const IconRequest& other) const {
+            return icon == other.icon && size == other.size && theme == other.theme;
+        }
+    };
+    
+    // 图集中一个图标的像素矩形和归一化纹理坐标
+    struct AtlasRect {
+        int x, y, width, height;
+        float u0, v0, u1, v1;
+    };
+    
+    // 多个图标打包成的一张图（sprite sheet）。rects与请求顺序一致，相同的请求共用一个矩形。
+    // 二进制索引（小端）：16字节头 {"ICAT", u16版本=1, u16项数, u32宽, u32高}，
+    // 每项28字节 {u8图标编号, u8保留, u16尺寸, u16 x, u16 y, u16宽, u16高, f32 u0, v0, u1, v1}
+    struct IconAtlas {
+        int width;
+        int height;
+        std::vector<IconRequest> requests;
+        std::vector<AtlasRect> rects;
+        std::shared_ptr<const std::string> image;          // 按请求的格式编码
+        std::shared_ptr<const std::string> json_index;
+        std::shared_ptr<const std::string> binary_index;
+    };
+    
+    // 渲染结果缓存的字节上限，超过时淘汰最久未使用的项。内置主题全部预热约占几MB，
+    // 上限用于约束任意尺寸和自定义主题的组合（512像素的位图就有1MB）
+    static constexpr size_t MAX_CACHED_BYTES = 32 * 1024 * 1024;
+    // 图集单独计算字节上限，同样按最久未使用淘汰。单个图集最大可达64MB（4096x4096 RGBA），
+    // 超过上限的图集不缓存
+    static constexpr size_t MAX_CACHED_ATLAS_BYTES = 64 * 1024 * 1024;
+    static constexpr size_t MAX_CACHED_ATLASES = 256;
+    static constexpr size_t MAX_ATLAS_ICONS = 256;
+    static constexpr int ATLAS_PADDING = 1;        // 图标之间的透明间隔，避免纹理过滤时串色
+    static constexpr int MAX_ATLAS_SIZE = 4096;    // 图集边长上限（常见GPU纹理尺寸限制）
+    
+    static constexpr int MIN_ICON_SIZE = 8;
+    static constexpr int MAX_ICON_SIZE = 512;
+    // 每个(图标, 主题)一张主光栅（预乘alpha，连同逐级减半的各级），首次请求非常用尺寸时生成，
+    // 之后新的尺寸只需一次缩放。比主光栅大的尺寸直接光栅化，放大会发虚
+    static constexpr int MASTER_RASTER_SIZE = 256;
+    static constexpr size_t MAX_CACHED_MASTERS = 64;
+    
+    IconRenderer();
+    ~IconRenderer();
+    
+    // 渲染图标到内存
+    std::vector<uint8_t> renderIcon(const std::string& icon_name, 
+                                    int size = MEDIUM,
+                                    const ColorTheme& theme = getDefaultTheme());
+    
+    // 渲染图标到文件，扩展名为.qoi时输出QOI，否则输出PNG
+    bool renderIconToFile(const std::string& icon_name, 
+                         const std::string& filename,
+                         int size = MEDIUM,
+                         const ColorTheme& theme = getDefaultTheme());
+    
+    // 渲染完整SVG文档
+    std::string renderIconSVG(const std::string& icon_name,
+                              const ColorTheme& theme = getDefaultTheme());
+    
+    // 缓存的渲染结果，内容不可变，多个调用方共享同一份，不需要复制。
+    // 位图为RGBA字节（每像素4字节，行优先），未知图标名使用"unknown"图标。线程安全。
+    // 尺寸超出MIN_ICON_SIZE~MAX_ICON_SIZE时抛出invalid_argument
+    std::shared_ptr<const std::string> getIconBitmap(const std::string& icon_name,
+                                                     int size = MEDIUM,
+                                                     const ColorTheme& theme = getDefaultTheme());
+    std::shared_ptr<const std::string> getIconSVG(const std::string& icon_name,
+                                                  const ColorTheme& theme = getDefaultTheme());
+    
+    // 按编号取图标，不经过名称查找（配合iconForWeather使用）
+    std::shared_ptr<const std::string> getIconBitmap(IconId id,
+                                                     int size = MEDIUM,
+                                                     const ColorTheme& theme = getDefaultTheme());
+    std::shared_ptr<const std::string> getIconSVG(IconId id,
+                                                  const ColorTheme& theme = getDefaultTheme());
+    
+    // 编码后的图标（PNG/QOI）。常用尺寸与位图一起缓存，其他尺寸只缓存编码结果
+    std::shared_ptr<const std::string> getIconImage(const std::string& icon_name,
+                                                    int size,
+                                                    ImageFormat format,
+                                                    const ColorTheme& theme = getDefaultTheme());
+    std::shared_ptr<const std::string> getIconImage(IconId id,
+                                                    int size,
+                                                    ImageFormat format,
+                                                    const ColorTheme& theme = getDefaultTheme());
+    
+    // 只查缓存，不渲染，未缓存时返回nullptr。format为FORMAT_RGBA时查位图。
+    // 未命中不计入统计（调用方随后交给线程池调用getIconImage/getIconBitmap，由那里计数）
+    std::shared_ptr<const std::string> findCachedIcon(const std::string& icon_name,
+                                                      int size,
+                                                      ImageFormat format,
+                                                      const ColorTheme& theme = getDefaultTheme()) const;
+    
+    // 设置线程池后，批量渲染中未缓存的图标分到各工作线程并行光栅化。在开始使用前调用
+    void setExecutor(WorkStealingExecutor* executor);
+    
+    // 批量取位图，结果与requests顺序一致
+    std::vector<std::shared_ptr<const std::string>> renderBatch(const std::vector<IconRequest>& requests);
+    
+    // 把一组图标打包成一张图集，结果按(请求列表, 格式)缓存。
+    // 请求为空、超过MAX_ATLAS_ICONS项或总面积超过MAX_ATLAS_SIZE的平方时抛出invalid_argument
+    std::shared_ptr<const IconAtlas> getIconAtlas(const std::vector<IconRequest>& requests,
+                                                  ImageFormat format = FORMAT_PNG);
+    
+    // 只查缓存，未缓存时返回nullptr（HTTP层据此决定是否交给线程池生成）
+    std::shared_ptr<const IconAtlas> findCachedAtlas(const std::vector<IconRequest>& requests,
+                                                     ImageFormat format) const;
+    
+    // 预先渲染全部图标在内置主题下的所有尺寸、格式和SVG
+    void prewarmCache();
+    
+    CacheStatistics getCacheStatistics() const;
+    RenderStatistics getRenderStatistics() const;
+    
+    // 获取SVG路径数据（用于WPF）
+    std::string getSVGPathData(const std::string& icon_name);
+    
+    // 获取图标尺寸信息
+    static int getIconWidth(int size);
+    static int getIconHeight(int size);
+    
+    // 是否为IconSize中的常用尺寸
+    static bool isStandardSize(int size);
+    
+    // 默认颜色主题
+    static ColorTheme getDefaultTheme();
+    static ColorTheme getDayTheme();
+    static ColorTheme getNightTheme();
+    static ColorTheme getRainTheme();
+    static ColorTheme getSnowTheme();
+    
+    // 以上全部内置主题
+    static std::vector<ColorTheme> getBuiltinThemes();
+    
+private:
+    // 内部渲染实现
+    class IconRendererImpl;
+    std::unique_ptr<IconRendererImpl> impl_;
+    WorkStealingExecutor* executor_ = nullptr;
+    
+    static constexpr size_t MAX_ICON_PATHS = 4;
+    static constexpr size_t MAX_CONTROL_POINTS = 5;
+    
+    // 图标定义，编译期常量。数组中未使用的项为空串/零
+    struct IconDefinition {
+        IconId id;
+        std::string_view svg_paths[MAX_ICON_PATHS];
+        std::pair<double, double> control_points[MAX_CONTROL_POINTS];
+        bool has_fill;
+        bool has_stroke;
+        
+        constexpr size_t pathCount() const {
+            size_t count = 0;
+            while (count < MAX_ICON_PATHS && !svg_paths[count].empty()) {
+                count++;
+            }
+            return count;
+        }
+    };
+    
+    // 按IconId顺序排列
+    static const IconDefinition icon_definitions_[ICON_COUNT];
+    
+    const IconDefinition* findIconDefinition(const std::string& name) const;
+    const IconDefinition& resolveIcon(const std::string& name) const;
+    const IconDefinition& resolveIcon(IconId id) const;
+    std::shared_ptr<const IconAtlas> buildAtlas(const std::vector<IconRequest>& requests,
+                                                ImageFormat format);
+    static std::string atlasCacheKey(const std::vector<IconRequest>& requests, ImageFormat format);
+    std::vector<uint8_t> renderToBitmap(const IconDefinition& icon, 
+                                       int size,
+                                       const ColorTheme& theme);
+    std::string renderToSVG(const IconDefinition& icon,
+                           const ColorTheme& theme);
+    static bool writeImageFile(const std::string& filename,
+                               const std::string& rgba,
+                               int width, int height,
+                               ImageFormat format);
+};
+
+#endif // ICON_RENDERER_H
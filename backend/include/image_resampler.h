@@ -0,0 +1,18 @@
+#ifndef IMAGE_RESAMPLER_H
+#define IMAGE_RESAMPLER_H
+
+#include <cstdint>
+
+// 预乘alpha的RGBA图像缩放：可分离的定点卷积，先垂直后水平，
+// 中间结果为8位。卷积由当前的像素内核执行（见pixel_kernels.h），各实现结果逐字节相同
+enum ResampleFilter {
+    RESAMPLE_BOX,       // 面积平均。缩小矢量图标时等价于在目标尺寸上按覆盖率抗锯齿，不产生振铃
+    RESAMPLE_LANCZOS3   // 更锐利，硬边缘两侧有轻微的过冲（颜色通道截断到不超过alpha）
+};
+
+// 宽高都必须为正，否则返回false。放大也可以使用，但矢量图标应直接按目标尺寸光栅化
+bool resampleRGBA(const uint8_t* src, int src_width, int src_height,
+                  uint8_t* dst, int dst_width, int dst_height,
+                  ResampleFilter filter = RESAMPLE_BOX);
+
+#endif // IMAGE_RESAMPLER_H
@@ -0,0 +1,46 @@
+#ifndef IPC_PROTOCOL_H
+#define IPC_PROTOCOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 本地IPC协议，服务端（IpcServer）和客户端共用
+// 控制消息走Unix域套接字；服务端为每个客户端创建一块共享内存环形缓冲区，
+// 连接后通过SCM_RIGHTS把文件描述符发给客户端。响应按weather_codec编码写入环形缓冲区，
+// 套接字上只发送位置，客户端在映射中原位解码，不经过内核复制。
+
+const uint32_t IPC_RING_MAGIC = 0x43504957;   // "WIPC"
+const uint32_t IPC_PROTOCOL_VERSION = 1;
+
+enum IpcFrameType : uint32_t {
+    IPC_HELLO = 1,             // 服务端→客户端，附带环形缓冲区的文件描述符，offset为映射大小
+    IPC_REQUEST = 2,           // 客户端→服务端，帧后跟length字节的编码请求
+    IPC_RESPONSE = 3,          // 服务端→客户端，响应位于环形缓冲区的[offset, offset + length)
+    IPC_RESPONSE_INLINE = 4    // 环形缓冲区空间不足，响应直接跟在帧后
+};
+
+// 套接字上的定长帧头
+struct IpcFrame {
+    uint32_t type;
+    uint32_t request_id;   // 客户端选择，响应原样带回
+    uint64_t offset;       // 环形缓冲区中的逻辑位置，对容量取模得到数据区偏移
+    uint32_t length;
+    uint32_t reserved;
+};
+
+// 位于映射开头，数据区从IPC_RING_DATA_OFFSET开始。
+// 单个响应总是连续存放，尾部放不下时跳到数据区开头
+struct IpcRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;                              // 数据区字节数
+    alignas(64) std::atomic<uint64_t> write_pos;    // 只由服务端推进
+    alignas(64) std::atomic<uint64_t> read_pos;     // 客户端处理完响应后推进到offset + length
+};
+
+const size_t IPC_RING_DATA_OFFSET = 256;
+
+static_assert(sizeof(IpcRingHeader) <= IPC_RING_DATA_OFFSET, "环形缓冲区头部过大");
+
+#endif // IPC_PROTOCOL_H
@@ -0,0 +1,45 @@
+#ifndef IPC_SERVER_H
+#define IPC_SERVER_H
+
+#include <cstdint>
+#include <string>
+#include <memory>
+
+class WeatherService;
+
+// 本机客户端（桌面前端）使用的IPC服务器，协议见 ipc_protocol.h
+// 每个客户端一个读线程，请求交给WeatherService的线程池处理，
+// 响应编码后写入该客户端的共享内存环形缓冲区。仅支持Linux
+class IpcServer {
+public:
+    struct Options {
+        std::string socket_path = "/tmp/weather_service.sock";
+        size_t ring_size = 4 * 1024 * 1024;   // 每个客户端的环形缓冲区大小
+        size_t max_clients = 64;
+        size_t max_request_size = 64 * 1024;
+        size_t max_pipelined = 128;           // 单个客户端同时处理中的请求数上限
+    };
+    
+    struct Statistics {
+        uint64_t requests;
+        uint64_t ring_responses;      // 通过环形缓冲区返回的响应
+        uint64_t inline_responses;    // 环形缓冲区空间不足、通过套接字返回的响应
+        uint64_t bad_requests;
+        size_t clients;
+    };
+    
+    IpcServer(const Options& options, WeatherService* weather_service);
+    ~IpcServer();
+    
+    // 开始监听，立即返回
+    bool Start();
+    void Stop();
+    
+    Statistics GetStatistics() const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+#endif // IPC_SERVER_H
@@ -0,0 +1,58 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// 流式JSON生成器：直接追加到调用方的缓冲区，不构建DOM
+// 调用方clear()后可以复用同一个缓冲区，避免重复分配。
+// 不检查结构是否合法，键和值必须成对、括号必须配对
+class JsonWriter {
+public:
+    // 浮点数按固定小数位输出，并去掉多余的0
+    static constexpr int DOUBLE_PRECISION = 6;
+    
+    explicit JsonWriter(std::string& out) : out_(out) {}
+    
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    
+    void key(std::string_view name);
+    
+    void value(std::string_view text);
+    void value(const char* text) { value(std::string_view(text)); }
+    void value(const std::string& text) { value(std::string_view(text)); }
+    void value(double number);
+    void value(int64_t number);
+    void value(uint64_t number);
+    void value(int number) { value(static_cast<int64_t>(number)); }
+    void value(unsigned number) { value(static_cast<uint64_t>(number)); }
+    void value(bool flag);
+    void null();
+    
+    // 键值对的简写
+    template<typename T>
+    void field(std::string_view name, const T& v) {
+        key(name);
+        value(v);
+    }
+    
+    // 追加转义后的字符串内容（不含引号）。非法UTF-8替换为U+FFFD
+    static void escape(std::string& out, std::string_view text);
+    static void appendDouble(std::string& out, double number);
+
+private:
+    void separator() {
+        if (need_comma_) {
+            out_ += ',';
+        }
+    }
+    
+    std::string& out_;
+    bool need_comma_ = false;
+};
+
+#endif // JSON_WRITER_H
@@ -0,0 +1,68 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 延迟直方图（HDR式对数-线性分桶），单位微秒。
+// 小于SUB_BUCKET_COUNT的值逐一计数；更大的值按2的幂分段，每段均分为SUB_BUCKET_COUNT/2个桶，
+// 相对误差不超过1/32。超过MAX_VALUE的值计入最后一个桶
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 6;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1ull << SUB_BUCKET_BITS;
+    static constexpr int MAX_MAGNITUDE = 32;                 // 2^32微秒，约71分钟
+    static constexpr uint64_t MAX_VALUE = (1ull << MAX_MAGNITUDE) - 1;
+    static constexpr size_t BUCKET_COUNT =
+        SUB_BUCKET_COUNT + (MAX_MAGNITUDE - SUB_BUCKET_BITS) * (SUB_BUCKET_COUNT / 2);
+    
+    LatencyHistogram();
+    
+    static size_t bucketIndex(uint64_t value);
+    // 桶内的最大值，百分位数按它报告
+    static uint64_t bucketUpperBound(size_t index);
+    
+    void record(uint64_t value);
+    void merge(const LatencyHistogram& other);
+    
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t maxValue() const { return max_; }
+    double mean() const;
+    // p取0~1，如0.99。空直方图返回0
+    uint64_t percentile(double p) const;
+    // 不超过value的记录数（只计上界不超过value的桶，最多少计value所在的一个桶）
+    uint64_t countAtOrBelow(uint64_t value) const;
+
+private:
+    friend class AtomicLatencyHistogram;
+    
+    std::vector<uint64_t> buckets_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t max_;
+};
+
+// 多线程直接写入的直方图，记录是几次relaxed原子加，读取时复制成LatencyHistogram。
+// 用于频率不高的事件（上游调用、图标渲染）；热路径上应每个线程一份（见RequestStatistics）
+class AtomicLatencyHistogram {
+public:
+    AtomicLatencyHistogram();
+    
+    AtomicLatencyHistogram(const AtomicLatencyHistogram&) = delete;
+    AtomicLatencyHistogram& operator=(const AtomicLatencyHistogram&) = delete;
+    
+    void record(uint64_t value);
+    // 累加到out，可以把多个分片合并到同一个结果中
+    void addTo(LatencyHistogram& out) const;
+    LatencyHistogram snapshot() const;
+
+private:
+    std::atomic<uint64_t> buckets_[LatencyHistogram::BUCKET_COUNT];
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> max_;
+};
+
+#endif // LATENCY_HISTOGRAM_H
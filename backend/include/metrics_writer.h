@@ -0,0 +1,47 @@
+#ifndef METRICS_WRITER_H
+#define METRICS_WRITER_H
+
+#include "latency_histogram.h"
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+
+// Prometheus文本格式（0.0.4）生成器：直接追加到调用方的缓冲区。
+// 指标名和标签名由调用方保证合法，标签值会转义。同一指标族的样本必须连续写出
+class MetricsWriter {
+public:
+    static constexpr const char* CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8";
+    
+    // 延迟直方图的桶上界（微秒），输出时换算成秒
+    static constexpr uint64_t LATENCY_BUCKETS_US[] = {
+        50, 100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000,
+        100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000
+    };
+    
+    struct Label {
+        std::string_view name;
+        std::string_view value;
+    };
+    
+    explicit MetricsWriter(std::string& out) : out_(out) {}
+    
+    // 每个指标族写一次，type为counter/gauge/histogram
+    void family(std::string_view name, std::string_view type, std::string_view help);
+    
+    void sample(std::string_view name, std::initializer_list<Label> labels, uint64_t value);
+    void sample(std::string_view name, std::initializer_list<Label> labels, double value);
+    
+    // 微秒直方图按LATENCY_BUCKETS_US换算成以秒为单位的_bucket/_sum/_count。
+    // 桶边界与直方图的分桶不对齐，每个le最多少计边界所在的一个分桶（相对误差1/32以内）
+    void histogram(std::string_view name, std::initializer_list<Label> labels,
+                   const LatencyHistogram& histogram);
+
+private:
+    void beginSample(std::string_view name, std::string_view suffix,
+                     std::initializer_list<Label> labels, const Label* extra = nullptr);
+    
+    std::string& out_;
+};
+
+#endif // METRICS_WRITER_H
@@ -0,0 +1,81 @@
+#ifndef PATH_RASTERIZER_H
+#define PATH_RASTERIZER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// SVG路径解析和扫描线光栅化（图标渲染使用）
+
+struct PathPoint {
+    float x;
+    float y;
+};
+
+// 展平后的子路径
+struct PathContour {
+    std::vector<PathPoint> points;
+    bool closed = false;
+};
+
+// 解析SVG路径数据（M/L/H/V/C/S/Q/T/A/Z及对应的相对命令），曲线按tolerance展平为折线。
+// 数据格式错误时在出错位置停止，返回已解析的部分
+std::vector<PathContour> parseSvgPath(const std::string& data, float tolerance);
+
+// 有向边，y0 < y1。winding为原始方向：向下为+1，向上为-1
+struct PathEdge {
+    float x0, y0;
+    float x1, y1;
+    int winding;
+};
+
+// 填充区域的边，未闭合的子路径按SVG规则隐式闭合
+void appendFillEdges(const std::vector<PathContour>& contours, std::vector<PathEdge>& edges);
+
+// 描边区域的边：平头端点，斜接拐角（超过斜接限制时改为斜切）。
+// 每个线段和拐角各是一个方向一致的多边形，按非零规则填充即为它们的并集
+void appendStrokeEdges(const std::vector<PathContour>& contours, float width,
+                       std::vector<PathEdge>& edges, float miter_limit = 4.0f);
+
+// 活动边表扫描线填充（非零环绕规则）。每个像素行取SUBSAMPLES条子扫描线，
+// 水平方向按跨度精确计算覆盖率，合成到预乘alpha的RGBA缓冲区。
+// 每行只处理跨度覆盖的像素区间：整像素覆盖的部分直接填充，边缘按覆盖率混合（见pixel_kernels.h）。
+// 内部缓冲区在多次fill之间复用，同一个对象不能被多个线程同时使用
+class PathRasterizer {
+public:
+    static constexpr int SUBSAMPLES = 5;
+    
+    PathRasterizer(uint8_t* rgba, int width, int height);
+    
+    // 边的坐标乘以scale后填充，color为0xRRGGBB
+    void fill(const std::vector<PathEdge>& edges, float scale, uint32_t color);
+
+private:
+    struct Crossing {
+        float x;
+        int winding;
+    };
+    
+    void addSpan(float x0, float x1);
+    void compositeRow(int y, uint32_t color);
+    
+    uint8_t* rgba_;
+    int width_;
+    int height_;
+    
+    std::vector<PathEdge> edges_;      // 缩放后按y0排序
+    std::vector<float> slopes_;        // 与edges_对应的dx/dy
+    std::vector<size_t> active_;
+    std::vector<Crossing> crossings_;
+    std::vector<float> cover_;         // 跨度两端的部分覆盖
+    std::vector<float> runs_;          // 跨度中间整像素覆盖的差分
+    std::vector<uint8_t> alpha_;       // 一行的最终覆盖率
+    int dirty_min_;
+    int dirty_max_;
+};
+
+// 预乘alpha转换为普通RGBA。完全透明的像素填入background的RGB，
+// 不支持透明的查看器显示为主题背景色
+void unpremultiplyRGBA(uint8_t* rgba, size_t pixels, uint32_t background);
+
+#endif // PATH_RASTERIZER_H
@@ -0,0 +1,55 @@
+#ifndef PIXEL_KERNELS_H
+#define PIXEL_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// RGBA像素行内核（预乘alpha），按CPU特性在运行时选择SSE2/AVX2实现，
+// 其他平台使用标量实现。各实现的结果逐字节相同
+struct SpanKernels {
+    const char* name;
+    
+    // dst的count个像素写入同一个像素值（内存中的字节序为R,G,B,A）
+    void (*fill)(uint8_t* dst, size_t count, uint32_t pixel);
+    
+    // source-over合成：dst = color*alpha + dst*(1-alpha)，alpha为每个像素的覆盖率。
+    // color为不透明的0xRRGGBB
+    void (*blend)(uint8_t* dst, const uint8_t* alpha, size_t count, uint32_t color);
+    
+    // 缩放用的定点卷积，权重为RESAMPLE_WEIGHT_BITS位小数（可以为负），
+    // 结果四舍五入并饱和到0~255。taps为任意正整数
+    // 水平：dst的第i个像素 = Σ weights[i*taps + k] * src的第(starts[i] + k)个像素
+    void (*convolveRow)(uint8_t* dst, const uint8_t* src, size_t count,
+                        const int32_t* starts, const int16_t* weights, size_t taps);
+    
+    // 垂直：dst的第j个字节 = Σ weights[k] * rows[k][j]
+    void (*combineRows)(uint8_t* dst, const uint8_t* const* rows, const int16_t* weights,
+                        size_t taps, size_t bytes);
+};
+
+const int RESAMPLE_WEIGHT_BITS = 14;
+
+// 当前使用的实现，默认为CPU支持的最快实现
+const SpanKernels& spanKernels();
+
+// CPU支持的全部实现，标量实现在最前
+const std::vector<const SpanKernels*>& availableSpanKernels();
+
+// 强制使用指定的实现（性能测试用），名称无效或CPU不支持时返回false
+bool selectSpanKernels(const std::string& name);
+
+// 不透明颜色0xRRGGBB按内存字节序R,G,B,A打包
+inline uint32_t packOpaquePixel(uint32_t color) {
+    uint8_t bytes[4] = {
+        static_cast<uint8_t>(color >> 16), static_cast<uint8_t>(color >> 8),
+        static_cast<uint8_t>(color), 255
+    };
+    uint32_t pixel;
+    std::memcpy(&pixel, bytes, 4);
+    return pixel;
+}
+
+#endif // PIXEL_KERNELS_H
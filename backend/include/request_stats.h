@@ -0,0 +1,92 @@
+#ifndef REQUEST_STATS_H
+#define REQUEST_STATS_H
+
+#include "weather_data.h"
+#include "latency_histogram.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// 请求计数和延迟统计。每个线程写自己的分片（按缓存行对齐，首次使用时分配），
+// 读取时合并全部分片，记录路径上没有锁，也没有线程间共享的缓存行
+class RequestStatistics {
+public:
+    enum Counter {
+        REQUESTS,
+        CACHE_HITS,
+        API_CALLS,
+        NEGATIVE_HITS,      // 命中负缓存，直接返回错误
+        UPSTREAM_ERRORS,    // 上游请求失败或数据无效
+        COUNTER_COUNT
+    };
+    
+    // 请求结果：未访问上游（缓存命中）、访问了上游、失败
+    enum Outcome {
+        OUTCOME_HIT,
+        OUTCOME_MISS,
+        OUTCOME_ERROR,
+        OUTCOME_COUNT
+    };
+    
+    static constexpr size_t TYPE_COUNT = WeatherRequest::BATCH + 1;
+    // 分片数上限，线程数更多时几个线程共用一个分片（计数仍是原子的）
+    static constexpr size_t MAX_SHARDS = 64;
+    
+    // 合并后的结果
+    struct Snapshot {
+        uint64_t counters[COUNTER_COUNT] = {};
+        LatencyHistogram latency[TYPE_COUNT][OUTCOME_COUNT];
+        
+        LatencyHistogram total() const;
+    };
+    
+    // 一次请求的计时，析构时按类型和结果记录延迟。在处理请求的线程上构造；
+    // awaitHelping中执行的其他请求有各自的Scope，结束后恢复外层的
+    class Scope {
+    public:
+        Scope(RequestStatistics& stats, WeatherRequest::RequestType type);
+        ~Scope();
+        
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        
+        void setError(bool error) { error_ = error; }
+        void setUpstream(bool upstream) { upstream_ = upstream; }
+        
+        // 当前线程上正在处理的请求访问了上游（没有进行中的请求时忽略）
+        static void markUpstream();
+    
+    private:
+        RequestStatistics& stats_;
+        WeatherRequest::RequestType type_;
+        int64_t start_ns_;
+        bool error_ = false;
+        bool upstream_ = false;
+        Scope* outer_;
+    };
+    
+    RequestStatistics();
+    ~RequestStatistics();
+    
+    RequestStatistics(const RequestStatistics&) = delete;
+    RequestStatistics& operator=(const RequestStatistics&) = delete;
+    
+    void add(Counter counter, uint64_t n = 1);
+    void recordLatency(WeatherRequest::RequestType type, Outcome outcome, uint64_t micros);
+    
+    Snapshot snapshot() const;
+
+private:
+    struct alignas(64) Shard {
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+        AtomicLatencyHistogram latency[TYPE_COUNT][OUTCOME_COUNT];
+        
+        Shard();
+    };
+    
+    Shard& localShard();
+    
+    std::atomic<Shard*> shards_[MAX_SHARDS];
+};
+
+#endif // REQUEST_STATS_H
@@ -0,0 +1,36 @@
+#ifndef RPC_SERVER_H
+#define RPC_SERVER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+
+class WeatherService;
+
+// 基于CompletionQueue的异步gRPC服务器（协议见 proto/weather.proto）
+// 每个轮询线程独占一个CompletionQueue，请求处理交给WeatherService的线程池
+class RPCServer {
+public:
+    struct Options {
+        std::string address = "0.0.0.0:50051";
+        int cq_threads = 0;                   // CompletionQueue轮询线程数，0表示CPU核数
+        int max_message_size = 16 * 1024 * 1024;
+        size_t forecast_chunk_hours = 24;     // GetForecast每个逐小时分块的小时数
+        bool reuse_port = false;              // 允许多个工作进程监听同一地址
+        // 来自这些对端IP（代理）的调用按x-client-id元数据限速，其他调用一律按对端IP限速
+        std::vector<std::string> trusted_proxies;
+    };
+    
+    RPCServer(const Options& options, WeatherService* weather_service);
+    ~RPCServer();
+    
+    // 启动监听和轮询线程，立即返回
+    bool Start();
+    void Stop();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+#endif // RPC_SERVER_H
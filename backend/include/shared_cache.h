@@ -0,0 +1,61 @@
+#ifndef SHARED_CACHE_H
+#define SHARED_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// 多个工作进程共享的缓存，放在POSIX共享内存段中
+// 主进程在fork之前创建，子进程继承映射；段名创建后立即删除，进程异常退出也不会残留。
+// 按键哈希分为16个分片，每个分片一把进程间共享的健壮互斥锁：持锁进程崩溃时
+// 下一个加锁者清空该分片后继续使用。分片内是开放寻址的槽位表和环形数据区，
+// 键和值一起追加到数据区，被新数据覆盖的旧项在读取时视为不存在
+class SharedMemoryCache {
+public:
+    struct Statistics {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t stores;
+        uint64_t evictions;       // 探测窗口已满时挤掉的有效项
+        uint64_t recoveries;      // 持锁进程崩溃后重置的分片数
+        size_t entries;
+        size_t slots;
+        size_t capacity_bytes;
+    };
+    
+    // 创建指定大小的共享内存段，失败时返回空
+    static std::unique_ptr<SharedMemoryCache> create(size_t bytes);
+    ~SharedMemoryCache();
+    
+    SharedMemoryCache(const SharedMemoryCache&) = delete;
+    SharedMemoryCache& operator=(const SharedMemoryCache&) = delete;
+    
+    // expiry为绝对时间（秒），超过分片数据区1/4的值不缓存
+    bool put(const std::string& key, const std::string& value, int64_t expiry);
+    // 命中时复制值到value
+    bool get(const std::string& key, std::string& value, int64_t& expiry);
+    void clear();
+    
+    Statistics getStatistics() const;
+
+private:
+    struct Header;
+    struct Shard;
+    struct Slot;
+    
+    SharedMemoryCache(void* base, size_t size);
+    
+    Shard* shardFor(uint64_t hash) const;
+    Slot* slots(Shard* shard) const;
+    char* arena(Shard* shard) const;
+    bool lock(Shard* shard) const;
+    void unlock(Shard* shard) const;
+    void resetShard(Shard* shard) const;
+    bool isLive(Shard* shard, const Slot& slot, int64_t now) const;
+    
+    Header* header_;
+    size_t size_;
+};
+
+#endif // SHARED_CACHE_H
@@ -0,0 +1,89 @@
+#ifndef SUBSCRIPTION_MANAGER_H
+#define SUBSCRIPTION_MANAGER_H
+
+#include "weather_data.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+class WeatherService;
+
+// 天气推送订阅
+// 同一位置的订阅者共享一个分发列表。后台线程定期刷新被订阅的位置，
+// 缓存过期时才会访问上游，一次刷新推送给所有订阅者；
+// 只有数据实际发生变化时才推送（其他请求引起的缓存更新同样会推送）
+class SubscriptionManager {
+public:
+    // 推送回调，返回false表示订阅者已失效
+    using Listener = std::function<bool(const std::shared_ptr<const WeatherData>&)>;
+    // 订阅者是否仍然有效，刷新线程据此清理断开的订阅
+    using AliveCheck = std::function<bool()>;
+    
+    struct Statistics {
+        size_t locations;
+        size_t subscribers;
+        uint64_t refreshes;
+        uint64_t notifications;
+    };
+    
+    explicit SubscriptionManager(WeatherService* weather_service, int refresh_interval = 30);
+    ~SubscriptionManager();
+    
+    // 订阅一个位置，缓存中已有数据时立即推送一次。返回订阅ID
+    uint64_t subscribe(const WeatherLocation& location, Listener listener, AliveCheck alive = nullptr);
+    void unsubscribe(uint64_t id);
+    
+    // 缓存中的当前天气被更新时由WeatherService调用
+    void onUpdate(const std::string& cache_key, const std::shared_ptr<const WeatherData>& data);
+    
+    void stop();
+    Statistics getStatistics() const;
+
+private:
+    struct Subscriber {
+        uint64_t id;
+        Listener listener;
+        AliveCheck alive;
+    };
+    
+    // 写时复制，推送时不持有锁
+    using SubscriberList = std::vector<Subscriber>;
+    
+    struct Topic {
+        WeatherLocation location;
+        std::shared_ptr<const SubscriberList> subscribers;
+        std::shared_ptr<const WeatherData> last;   // 最近一次推送的数据
+        int64_t last_refresh = 0;
+        bool refreshing = false;
+    };
+    
+    void refreshLoop();
+    void refresh(const std::string& cache_key, const WeatherLocation& location);
+    void removeSubscribers(const std::string& cache_key, const std::vector<uint64_t>& ids);
+    static bool changed(const WeatherData& previous, const WeatherData& current);
+    
+    WeatherService* weather_service_;
+    int refresh_interval_;
+    
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Topic> topics_;
+    std::unordered_map<uint64_t, std::string> subscription_keys_;
+    uint64_t next_id_ = 1;
+    
+    std::atomic<uint64_t> refreshes_{0};
+    std::atomic<uint64_t> notifications_{0};
+    
+    std::mutex thread_mutex_;
+    std::condition_variable stop_cv_;
+    bool stopping_ = false;
+    std::thread refresh_thread_;
+};
+
+#endif // SUBSCRIPTION_MANAGER_H
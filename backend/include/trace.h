@@ -0,0 +1,94 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// 按请求采样的分阶段追踪，导出为Chrome trace JSON（chrome://tracing、ui.perfetto.dev可直接打开）。
+// 请求入口用Trace::Request按采样率决定是否追踪，被采样的请求在同一线程上经过的Trace::Span
+// 记入该线程自己的环形缓冲区（单写者，无锁），写满后覆盖最旧的记录。
+// 未被采样（或采样率为0）时Span只读一次线程局部变量
+class Trace {
+public:
+    static constexpr size_t RING_CAPACITY = 4096;     // 每个线程保留的最近记录数，2的幂
+    
+    // 0~1，0为关闭（默认）
+    static void setSampleRate(double rate);
+    static double sampleRate();
+    
+    // 当前线程上正在追踪的请求编号，0表示没有
+    static uint64_t currentRequest() { return current_request_; }
+    
+    // 把所有线程缓冲区中的记录追加为Chrome trace JSON。与写入并发进行，
+    // 正在被覆盖的记录会被跳过。返回导出的记录数
+    static size_t exportChromeTrace(std::string& out);
+    
+    // 阶段，name必须是字符串字面量（只保存指针）
+    class Span {
+    public:
+        explicit Span(const char* name)
+            : request_(current_request_) {
+            if (request_) {
+                name_ = name;
+                start_ns_ = now();
+            }
+        }
+        
+        ~Span() {
+            if (request_) {
+                record(name_, start_ns_, request_);
+            }
+        }
+        
+        Span(const Span&) = delete;
+        Span& operator=(const Span&) = delete;
+    
+    private:
+        uint64_t request_;
+        const char* name_ = nullptr;
+        int64_t start_ns_ = 0;
+    };
+    
+    // 请求入口：按采样率决定是否追踪，并记录整个请求的Span。
+    // awaitHelping中执行的其他请求各自采样，结束后恢复外层请求
+    class Request {
+    public:
+        explicit Request(const char* name);
+        ~Request();
+        
+        Request(const Request&) = delete;
+        Request& operator=(const Request&) = delete;
+    
+    private:
+        uint64_t outer_;
+        const char* name_;
+        int64_t start_ns_ = 0;
+    };
+    
+    // 在线程池任务中延续提交方的请求：提交时取currentRequest()，任务开始时构造
+    class Adopt {
+    public:
+        explicit Adopt(uint64_t request)
+            : outer_(current_request_) {
+            current_request_ = request;
+        }
+        
+        ~Adopt() { current_request_ = outer_; }
+        
+        Adopt(const Adopt&) = delete;
+        Adopt& operator=(const Adopt&) = delete;
+    
+    private:
+        uint64_t outer_;
+    };
+
+private:
+    static int64_t now();
+    static void record(const char* name, int64_t start_ns, uint64_t request);
+    
+    static inline thread_local uint64_t current_request_ = 0;
+};
+
+#endif // TRACE_H
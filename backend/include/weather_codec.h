@@ -0,0 +1,26 @@
+#ifndef WEATHER_CODEC_H
+#define WEATHER_CODEC_H
+
+#include "weather_data.h"
+#include <string>
+
+// WeatherData/WeatherRequest/WeatherResponse的紧凑二进制编码，用于进程间共享缓存和本地IPC
+// 定长字段按小端直接写入，字符串和数组带32位长度前缀。
+// 格式带版本号，版本不匹配或数据截断时解码失败
+
+// 追加编码结果到out
+void encodeWeatherData(const WeatherData& data, std::string& out);
+
+// 解码失败时返回false，out的内容不确定
+bool decodeWeatherData(const char* data, size_t size, WeatherData& out);
+
+// 请求只编码查询参数，client_id、增量编码和预编码选项由服务端决定
+void encodeWeatherRequest(const WeatherRequest& request, std::string& out);
+bool decodeWeatherRequest(const char* data, size_t size, WeatherRequest& out);
+
+// hourly_range编码为实际的逐小时数组，解码后的视图引用新分配的数据。
+// forecast_delta和encoded_body不编码
+void encodeWeatherResponse(const WeatherResponse& response, std::string& out);
+bool decodeWeatherResponse(const char* data, size_t size, WeatherResponse& out);
+
+#endif // WEATHER_CODEC_H
@@ -0,0 +1,179 @@
+#ifndef WEATHER_CORE_H
+#define WEATHER_CORE_H
+
+// weather_core 的C接口，供进程内宿主调用（P/Invoke、Python ctypes、其他C/C++服务）
+//
+// 约定：
+// - 所有函数都不抛出异常，错误通过返回值报告
+// - 结构体的第一个字段是struct_size，调用方填写sizeof，以便以后在末尾增加字段。
+//   输入结构体只读取调用方声明的大小，旧调用方没有的字段取默认值；输出结构体只写入声明的大小
+// - 查询结果由wc_result持有，从中取得的字符串和数组都是借用的视图，
+//   在wc_result_release之前有效，且不会被服务修改（缓存中的数据不可变）
+// - wc_buffer由调用方持有，用wc_buffer_free释放
+// - wc_service可以在多个线程中同时使用
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(WEATHER_CORE_STATIC)
+#  define WC_API
+#elif defined(_WIN32)
+#  if defined(WEATHER_CORE_BUILD)
+#    define WC_API __declspec(dllexport)
+#  else
+#    define WC_API __declspec(dllimport)
+#  endif
+#elif defined(__GNUC__)
+#  define WC_API __attribute__((visibility("default")))
+#else
+#  define WC_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WC_ABI_VERSION 1
+
+typedef enum wc_status {
+    WC_OK = 0,
+    WC_ERR_INVALID_ARGUMENT = 1,
+    WC_ERR_NOT_FOUND = 2,        // 找不到城市、缓存未命中或下标越界
+    WC_ERR_FAILED = 3,           // 查询失败，详细信息见wc_result_error
+    WC_ERR_RATE_LIMITED = 4,
+    WC_ERR_OVERLOADED = 5,
+    WC_ERR_INTERNAL = 6,
+    WC_ERR_UPSTREAM = 7          // 上游服务故障或返回的数据无效
+} wc_status;
+
+typedef enum wc_request_type {
+    WC_CURRENT_WEATHER = 0,
+    WC_FORECAST = 1,
+    WC_SEARCH_CITY = 2,
+    WC_GEO_LOCATION = 3
+} wc_request_type;
+
+typedef struct wc_service wc_service;
+typedef struct wc_result wc_result;
+
+typedef struct wc_options {
+    uint32_t struct_size;
+    const char* language;      // NULL 表示 "zh"
+    const char* units;         // NULL 表示 "metric"
+    int32_t cache_ttl;         // 秒，<=0 表示默认值
+    int32_t worker_threads;    // 0 表示CPU核数
+    int32_t enable_cache;      // 非0启用
+} wc_options;
+
+typedef struct wc_request {
+    uint32_t struct_size;
+    int32_t type;              // wc_request_type
+    const char* city;          // 城市名或搜索关键字
+    const char* country;       // 可为NULL
+    double latitude;
+    double longitude;
+    int32_t days;              // 预报天数
+    const char* language;      // NULL 表示服务默认值
+    int32_t hourly_start;      // 逐小时范围查询，hourly_count为0时返回默认范围
+    int32_t hourly_count;
+    uint32_t hourly_variables; // 0 表示全部
+} wc_request;
+
+// 与服务内部的逐小时数据布局相同，wc_result_hourly直接返回缓存中的数组
+typedef struct wc_hourly {
+    int64_t timestamp;
+    double temperature;
+    double precipitation_probability;
+    int32_t weather_code;
+} wc_hourly;
+
+typedef struct wc_weather {
+    uint32_t struct_size;
+    double temperature;
+    double feels_like;
+    int32_t humidity;
+    double wind_speed;
+    int32_t wind_direction;
+    double pressure;
+    double precipitation;
+    int32_t cloud_cover;
+    int32_t uv_index;
+    int32_t weather_code;
+    int64_t timestamp;
+    double latitude;
+    double longitude;
+    const char* condition;
+    const char* description;
+    const char* icon_name;
+    const char* city;
+    const char* country;
+    const char* timezone;
+} wc_weather;
+
+typedef struct wc_daily {
+    uint32_t struct_size;
+    int64_t date;
+    double temp_max;
+    double temp_min;
+    double precipitation_sum;
+    int32_t weather_code;
+    const char* sunrise;
+    const char* sunset;
+} wc_daily;
+
+typedef struct wc_buffer {
+    uint8_t* data;
+    size_t size;
+    int32_t width;     // 图标位图的宽高，其他内容为0
+    int32_t height;
+} wc_buffer;
+
+WC_API uint32_t wc_abi_version(void);
+
+// options 可以为NULL，使用默认配置。失败返回NULL
+WC_API wc_service* wc_service_create(const wc_options* options);
+WC_API void wc_service_destroy(wc_service* service);
+
+// 同步查询。除参数错误和内部错误外都会返回结果（查询失败时可读取错误信息），
+// 调用方用wc_result_release释放
+WC_API wc_status wc_query(wc_service* service, const wc_request* request, wc_result** result);
+
+// 只读缓存，不访问上游。结果直接引用缓存中的数据，未命中返回WC_ERR_NOT_FOUND
+WC_API wc_status wc_get_cached_current(wc_service* service, const char* city, const char* country,
+                                       wc_result** result);
+
+WC_API void wc_result_release(wc_result* result);
+
+// 查询失败时的错误信息，成功时为空字符串
+WC_API const char* wc_result_error(const wc_result* result);
+
+WC_API wc_status wc_result_current(const wc_result* result, wc_weather* out);
+
+// 逐小时数据：范围查询的结果，或当前天气中的全部逐小时预报
+WC_API size_t wc_result_hourly(const wc_result* result, const wc_hourly** data);
+
+WC_API size_t wc_result_daily_count(const wc_result* result);
+WC_API wc_status wc_result_daily(const wc_result* result, size_t index, wc_daily* out);
+
+// 多日预报的每日摘要
+WC_API size_t wc_result_forecast_count(const wc_result* result);
+WC_API wc_status wc_result_forecast(const wc_result* result, size_t index, wc_weather* out);
+
+// 城市搜索结果
+WC_API size_t wc_result_city_count(const wc_result* result);
+WC_API wc_status wc_result_city(const wc_result* result, size_t index,
+                                const char** name, const char** country);
+
+// 与HTTP接口相同的JSON响应体，第一次调用时生成并由结果持有
+WC_API wc_status wc_result_json(wc_result* result, const char** data, size_t* size);
+
+// 渲染图标为RGBA位图，size为8~512像素（16/32/64/128之外的尺寸由高分辨率主光栅缩小得到）
+WC_API wc_status wc_icon_render(wc_service* service, const char* name, int32_t size, wc_buffer* out);
+WC_API wc_status wc_icon_svg(wc_service* service, const char* name, wc_buffer* out);
+WC_API void wc_buffer_free(wc_buffer* buffer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // WEATHER_CORE_H
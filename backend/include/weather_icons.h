@@ -0,0 +1,111 @@
+#ifndef WEATHER_ICONS_H
+#define WEATHER_ICONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include "weather_data.h"
+
+// 内置图标编号，值即IconRenderer图标定义表中的下标
+enum class IconId : uint8_t {
+    SUNNY,
+    CLOUDY,
+    RAIN,
+    SNOW,
+    THUNDERSTORM,
+    FOG,
+    PARTLY_CLOUDY_DAY,
+    PARTLY_CLOUDY_NIGHT,
+    CLEAR_NIGHT,
+    UNKNOWN,
+    COUNT
+};
+
+const size_t ICON_COUNT = static_cast<size_t>(IconId::COUNT);
+
+// 图标的规范名称（URL和JSON中使用）
+constexpr std::string_view iconName(IconId id) {
+    constexpr std::string_view names[ICON_COUNT] = {
+        "sunny", "cloudy", "rain", "snow", "thunderstorm", "fog",
+        "partly-cloudy-day", "partly-cloudy-night", "clear-night", "unknown"
+    };
+    return static_cast<size_t>(id) < ICON_COUNT ? names[static_cast<size_t>(id)] : "unknown";
+}
+
+// 根据WMO天气代码和白天/夜晚选择图标，与WeatherService::getIconNameFromCode一致。
+// 毛毛雨没有单独的图标，使用雨
+constexpr IconId iconForWeatherCode(int code, bool is_day) {
+    if (code == 0) return is_day ? IconId::SUNNY : IconId::CLEAR_NIGHT;
+    if (code >= 1 && code <= 3) return is_day ? IconId::PARTLY_CLOUDY_DAY : IconId::PARTLY_CLOUDY_NIGHT;
+    if (code == 45 || code == 48) return IconId::FOG;
+    if (code >= 51 && code <= 57) return IconId::RAIN;
+    if (code >= 61 && code <= 67) return IconId::RAIN;
+    if (code >= 71 && code <= 77) return IconId::SNOW;
+    if (code >= 80 && code <= 82) return IconId::RAIN;
+    if (code >= 85 && code <= 86) return IconId::SNOW;
+    if (code >= 95 && code <= 99) return IconId::THUNDERSTORM;
+    return IconId::UNKNOWN;
+}
+
+inline IconId iconForWeather(const WeatherData& data) {
+    return iconForWeatherCode(data.weather_code, data.is_day);
+}
+
+// 名称到编号的完美哈希表：槽位由首尾字符和长度决定，查找只比较一次字符串。
+// 除规范名称外还收录getIconNameFromCode产生的别名（drizzle）
+class IconNameTable {
+public:
+    static constexpr size_t SLOTS = 16;
+    
+    static constexpr size_t slot(std::string_view name) {
+        return name.empty() ? 0 :
+            (static_cast<uint8_t>(name.front()) * 13u +
+             static_cast<uint8_t>(name.back()) * 12u + name.size()) % SLOTS;
+    }
+    
+    constexpr IconNameTable() : names_(), ids_() {
+        for (size_t i = 0; i < ICON_COUNT; i++) {
+            insert(iconName(static_cast<IconId>(i)), static_cast<IconId>(i));
+        }
+        insert("drizzle", IconId::RAIN);
+    }
+    
+    // 未知名称返回false
+    constexpr bool find(std::string_view name, IconId& id) const {
+        size_t s = slot(name);
+        if (names_[s].empty() || names_[s] != name) {
+            return false;
+        }
+        id = ids_[s];
+        return true;
+    }
+    
+    // 表构建时没有发生冲突（编译期检查）
+    constexpr bool valid() const {
+        return !collision_;
+    }
+
+private:
+    constexpr void insert(std::string_view name, IconId id) {
+        size_t s = slot(name);
+        if (!names_[s].empty()) {
+            collision_ = true;
+        }
+        names_[s] = name;
+        ids_[s] = id;
+    }
+    
+    std::string_view names_[SLOTS];
+    IconId ids_[SLOTS];
+    bool collision_ = false;
+};
+
+constexpr IconNameTable ICON_NAME_TABLE;
+
+static_assert(ICON_NAME_TABLE.valid(), "图标名称哈希冲突，需要调整IconNameTable::slot的系数");
+
+inline bool findIconId(std::string_view name, IconId& id) {
+    return ICON_NAME_TABLE.find(name, id);
+}
+
+#endif // WEATHER_ICONS_H
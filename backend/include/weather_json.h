@@ -0,0 +1,22 @@
+#ifndef WEATHER_JSON_H
+#define WEATHER_JSON_H
+
+#include "weather_data.h"
+#include "json_writer.h"
+#include <string>
+
+// WeatherData/WeatherResponse的JSON序列化（HTTP接口和SSE推送使用）
+// 字段按名称排序输出，与之前基于nlohmann DOM的输出一致
+
+void writeWeatherData(JsonWriter& writer, const WeatherData& data);
+
+// 追加完整的响应体到out
+void writeWeatherResponse(std::string& out, const WeatherResponse& response);
+
+// 只含当前天气的成功响应，等价于writeWeatherResponse但不需要构造WeatherResponse
+void writeCurrentResponse(std::string& out, const WeatherData& data);
+
+// 按响应内容估算的缓冲区大小，用于预先reserve
+size_t estimateResponseSize(const WeatherResponse& response);
+
+#endif // WEATHER_JSON_H
@@ -1,90 +1,285 @@
-#ifndef WEATHER_SERVICE_H
-#define WEATHER_SERVICE_H
-
-#include "weather_data.h"
-#include <string>
-#include <memory>
-#include <mutex>
-#include <unordered_map>
-
-class WeatherCache {
-public:
-    struct CacheEntry {
-        WeatherData data;
-        int64_t timestamp;
-        int64_t expiry;
-    };
-    
-    WeatherCache(int64_t default_ttl = 300); // 5分钟默认缓存时间
-    
-    void put(const std::string& key, const WeatherData& data, int64_t ttl = 0);
-    bool get(const std::string& key, WeatherData& data);
-    void clear();
-    void cleanup(); // 清理过期缓存
-    
-private:
-    std::unordered_map<std::string, CacheEntry> cache_;
-    std::mutex mutex_;
-    int64_t default_ttl_;
-};
-
-class WeatherService {
-public:
-    WeatherService();
-    ~WeatherService();
-    
-    // 初始化服务
-    bool initialize();
-    
-    // 主要API接口
-    WeatherResponse processRequest(const WeatherRequest& request);
-    
-    // 工具函数
-    static std::string getConditionFromCode(int code, const std::string& language = "zh");
-    static std::string getIconNameFromCode(int code, bool is_day = true);
-    static std::string formatTemperature(double temp, const std::string& units = "metric");
-    static std::string formatWindSpeed(double speed, const std::string& units = "metric");
-    static std::string formatPressure(double pressure);
-    
-    // 配置
-    void setCacheEnabled(bool enabled);
-    void setCacheTTL(int64_t ttl_seconds);
-    void setLanguage(const std::string& language);
-    void setUnits(const std::string& units);
-    
-    // 统计信息
-    struct Statistics {
-        int total_requests;
-        int cache_hits;
-        int api_calls;
-        int64_t total_response_time;
-    };
-    
-    Statistics getStatistics() const;
-    
-private:
-    WeatherResponse handleCurrentWeather(const WeatherRequest& request);
-    WeatherResponse handleForecast(const WeatherRequest& request);
-    WeatherResponse handleCitySearch(const WeatherRequest& request);
-    WeatherResponse handleGeoLocation(const WeatherRequest& request);
-    
-    // 内部方法
-    std::pair<double, double> getCityCoordinates(const std::string& city, 
-                                                 const std::string& country);
-    
-    std::unique_ptr<APIClient> api_client_;
-    std::unique_ptr<WeatherCache> cache_;
-    
-    bool cache_enabled_;
-    std::string language_;
-    std::string units_;
-    
-    mutable std::mutex stats_mutex_;
-    Statistics stats_;
-    
-    // RPC服务器
-    class RPCServerImpl;
-    std::unique_ptr<RPCServerImpl> rpc_server_;
-};
-
-#endif // WEATHER_SERVICE_H
\ No newline at end of file
+#ifndef WEATHER_SERVICE_H
+#define WEATHER_SERVICE_H
+
+#include "weather_data.h"
+#include "executor.h"
+#include "admission_controller.h"
+#include "forecast_delta.h"
+#include "request_stats.h"
+#include "api_client.h"
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <functional>
+#include <unordered_map>
+
+class SubscriptionManager;
+class SharedMemoryCache;
+
+class WeatherCache {
+public:
+    struct CacheEntry {
+        std::shared_ptr<const WeatherData> data; // 不可变，读取方共享同一份
+        std::shared_ptr<const EncodedBody> encoded; // 预编码的响应体，可为空
+        int64_t timestamp;
+        int64_t expiry;
+    };
+    
+    // 计数在持有锁时更新，读取不加锁。按查找次数计
+    struct Statistics {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t shared_hits;   // 本地未命中、从共享缓存取回
+        uint64_t expired;       // 因过期移除的项
+        size_t entries;
+    };
+    
+    WeatherCache(int64_t default_ttl = 300); // 5分钟默认缓存时间
+    
+    void put(const std::string& key, const WeatherData& data, int64_t ttl = 0);
+    void put(const std::string& key, std::shared_ptr<const WeatherData> data, int64_t ttl = 0);
+    void put(const std::string& key, std::shared_ptr<const WeatherData> data,
+             std::shared_ptr<const EncodedBody> encoded, int64_t ttl = 0);
+    bool get(const std::string& key, WeatherData& data);
+    std::shared_ptr<const WeatherData> getShared(const std::string& key); // 不复制，未命中返回空
+    // 数据和预编码的响应体一次取回（只查找、计数一次），未命中时data为空，encoded可能为空
+    struct Lookup {
+        std::shared_ptr<const WeatherData> data;
+        std::shared_ptr<const EncodedBody> encoded;
+    };
+    Lookup getEntry(const std::string& key);
+    void clear();
+    void cleanup(); // 清理过期缓存
+    
+    // 多进程模式下的二级缓存：本地未命中时查共享缓存，写入时同时写入共享缓存
+    void setSharedCache(SharedMemoryCache* shared);
+    // 从共享缓存取回的数据没有预编码的响应体，由这个函数补上（返回空表示不需要）
+    using PromoteEncoder = std::function<std::shared_ptr<const EncodedBody>(const std::string& key,
+                                                                           const WeatherData& data)>;
+    void setPromoteEncoder(PromoteEncoder encoder);
+    
+    Statistics getStatistics() const;
+
+private:
+    bool loadShared(const std::string& key, CacheEntry& entry);
+    
+    std::unordered_map<std::string, CacheEntry> cache_;
+    std::mutex mutex_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> shared_hits_{0};
+    std::atomic<uint64_t> expired_{0};
+    std::atomic<size_t> entries_{0};
+    int64_t default_ttl_;
+    SharedMemoryCache* shared_ = nullptr;
+    PromoteEncoder promote_encoder_;
+};
+
+// 上游失败的负缓存：找不到的城市和上游故障在有效期内直接返回同样的错误，
+// 拼写错误或无效的查询不会每次都访问上游。多进程模式下同样写入共享缓存
+class NegativeCache {
+public:
+    struct Entry {
+        WeatherErrorCode error_code;
+        std::string error_message;
+        int64_t expiry;
+    };
+    
+    struct Statistics {
+        uint64_t evicted;       // 写满时清理掉的项（含过期项）
+        size_t entries;
+    };
+    
+    explicit NegativeCache(size_t max_entries = 10000);
+    
+    void put(const std::string& key, WeatherErrorCode code, const std::string& message, int64_t ttl);
+    bool get(const std::string& key, Entry& entry);
+    void clear();
+    size_t size();
+    
+    void setSharedCache(SharedMemoryCache* shared);
+    
+    // 不加锁
+    Statistics getStatistics() const;
+
+private:
+    static std::string sharedKey(const std::string& key);
+    
+    std::unordered_map<std::string, Entry> entries_;
+    std::mutex mutex_;
+    size_t max_entries_;
+    std::atomic<uint64_t> evicted_{0};
+    std::atomic<size_t> size_{0};
+    SharedMemoryCache* shared_ = nullptr;
+};
+
+class WeatherService {
+public:
+    WeatherService();
+    ~WeatherService();
+    
+    // 初始化服务
+    bool initialize();
+    
+    // 主要API接口
+    WeatherResponse processRequest(const WeatherRequest& request);
+    
+    // 异步接口：请求在线程池中处理，I/O线程只负责解析和分发
+    using ResponseCallback = std::function<void(WeatherResponse)>;
+    void submitRequest(const WeatherRequest& request, ResponseCallback callback);
+    std::future<WeatherResponse> processRequestAsync(const WeatherRequest& request);
+    static WorkStealingExecutor::Priority getRequestPriority(const WeatherRequest& request);
+    WorkStealingExecutor& getExecutor() { return *executor_; }
+    
+    // 单个批量请求最多包含的位置数
+    static constexpr size_t MAX_BATCH_SIZE = 200;
+    
+    // 负缓存有效期（秒）：找不到的城市、上游暂时故障（网络错误、429、5xx）、其他上游错误
+    static constexpr int64_t NOT_FOUND_TTL = 600;
+    static constexpr int64_t TRANSIENT_FAILURE_TTL = 15;
+    static constexpr int64_t UPSTREAM_FAILURE_TTL = 120;
+    // 城市坐标很少变化，解析成功的结果缓存一天
+    static constexpr int64_t COORDINATES_TTL = 86400;
+    static constexpr size_t MAX_CACHED_COORDINATES = 10000;
+    
+    // 当前天气的缓存键，以及按键读取缓存（不访问上游）
+    static std::string currentCacheKey(const WeatherLocation& location);
+    std::shared_ptr<const WeatherData> getCachedCurrent(const std::string& cache_key);
+    
+    // 响应体编码器：当前天气写入缓存时调用一次，结果随缓存项保存。在开始处理请求前设置
+    using BodyEncoder = std::function<std::shared_ptr<const EncodedBody>(const WeatherData&)>;
+    void setBodyEncoder(BodyEncoder encoder);
+    
+    // 多进程模式下各工作进程共享的缓存，在开始处理请求前设置
+    void setSharedCache(SharedMemoryCache* shared);
+    
+    // 推送订阅
+    SubscriptionManager& getSubscriptions() { return *subscriptions_; }
+    
+    // 流式预报：依次推送当前天气、每日预报和固定大小的逐小时分块
+    // 缓存中已有当前天气时在获取预报之前先推送。回调返回false时停止
+    using ForecastChunkCallback = std::function<bool(const ForecastChunk&)>;
+    void streamForecast(const WeatherRequest& request,
+                        const ForecastChunkCallback& callback,
+                        size_t hourly_chunk_size = 24);
+    
+    // 工具函数
+    static std::string getConditionFromCode(int code, const std::string& language = "zh");
+    static std::string getIconNameFromCode(int code, bool is_day = true);
+    static std::string formatTemperature(double temp, const std::string& units = "metric");
+    static std::string formatWindSpeed(double speed, const std::string& units = "metric");
+    static std::string formatPressure(double pressure);
+    
+    // 配置
+    void setCacheEnabled(bool enabled);
+    void setCacheTTL(int64_t ttl_seconds);
+    void setLanguage(const std::string& language);
+    void setUnits(const std::string& units);
+    void setWorkerThreads(size_t threads); // 0 表示使用CPU核数
+    void setAdmissionOptions(const AdmissionController::Options& options);
+    
+    // 延迟分位数，单位微秒
+    struct LatencySummary {
+        uint64_t count;
+        double mean_us;
+        uint64_t p50_us;
+        uint64_t p90_us;
+        uint64_t p99_us;
+        uint64_t p999_us;
+        uint64_t max_us;
+    };
+    
+    // 统计信息
+    struct Statistics {
+        uint64_t total_requests;
+        uint64_t cache_hits;
+        uint64_t api_calls;
+        uint64_t negative_hits;      // 命中负缓存，直接返回错误
+        uint64_t upstream_errors;    // 上游请求失败或数据无效
+        LatencySummary latency;      // 全部请求
+        // 按请求类型（WeatherRequest::RequestType）和结果（RequestStatistics::Outcome）
+        LatencySummary latency_by_type[RequestStatistics::TYPE_COUNT][RequestStatistics::OUTCOME_COUNT];
+    };
+    
+    Statistics getStatistics() const;
+    // 合并后的计数和完整直方图，供需要其他分位数或导出的调用方使用
+    RequestStatistics::Snapshot getRequestStatistics() const;
+    WorkStealingExecutor::Statistics getExecutorStatistics() const;
+    AdmissionController::Statistics getAdmissionStatistics() const;
+    ForecastDeltaEncoder::Statistics getDeltaStatistics() const;
+    // 以下统计的读取都不加锁，可以随时抓取
+    WeatherCache::Statistics getCacheStatistics() const;
+    NegativeCache::Statistics getNegativeCacheStatistics() const;
+    APIClient::Statistics getUpstreamStatistics() const;
+    
+private:
+    WeatherResponse handleCurrentWeather(const WeatherRequest& request);
+    WeatherResponse handleForecast(const WeatherRequest& request);
+    WeatherResponse handleCitySearch(const WeatherRequest& request);
+    WeatherResponse handleGeoLocation(const WeatherRequest& request);
+    WeatherResponse handleBatch(const WeatherRequest& request);
+    
+    // 内部方法
+    std::shared_ptr<const WeatherData> loadForecast(const WeatherRequest& request,
+                                                    WeatherResponse& response);
+    std::shared_ptr<const EncodedBody> storeCurrent(const std::string& cache_key,
+                                                    const std::shared_ptr<const WeatherData>& data);
+    bool admitUpstream(const WeatherRequest& request,
+                       AdmissionController::Permit& permit,
+                       WeatherResponse& response,
+                       size_t upstream_calls = 1,
+                       size_t locations = 1);
+    static std::string forecastCacheKey(const WeatherRequest& request);
+    static void fillHourlyRange(const WeatherRequest& request,
+                                const std::shared_ptr<const WeatherData>& forecast,
+                                WeatherResponse& response);
+    
+    // 城市坐标解析结果，error_code为ERR_NONE时成功
+    struct GeocodeResult {
+        std::pair<double, double> coords{0.0, 0.0};
+        WeatherErrorCode error_code = ERR_NONE;
+        std::string error_message;
+    };
+    GeocodeResult getCityCoordinates(const std::string& city, 
+                                     const std::string& country);
+    static std::string geocodeCacheKey(const std::string& city, const std::string& country);
+    
+    // 负缓存命中时填入错误并返回true
+    bool lookupFailure(const std::string& key, WeatherErrorCode& code, std::string& message);
+    // 上游失败按类型写入负缓存，返回对应的错误类型和给客户端的错误信息
+    WeatherErrorCode recordFailure(const std::string& key, const UpstreamError& error,
+                                   std::string& message);
+    
+    std::unique_ptr<APIClient> api_client_;
+    std::unique_ptr<WeatherCache> cache_;
+    std::unique_ptr<NegativeCache> negative_cache_;
+    
+    // 城市坐标缓存，键为geocodeCacheKey
+    struct CachedCoordinates {
+        std::pair<double, double> coords;
+        int64_t expiry;
+    };
+    std::unordered_map<std::string, CachedCoordinates> coordinates_;
+    std::mutex coordinates_mutex_;
+    std::unique_ptr<WorkStealingExecutor> executor_;
+    std::unique_ptr<AdmissionController> admission_;
+    AdmissionController::Options admission_options_;
+    std::unique_ptr<SubscriptionManager> subscriptions_;
+    std::unique_ptr<ForecastDeltaEncoder> delta_encoder_;
+    BodyEncoder body_encoder_;
+    
+    bool cache_enabled_;
+    std::string language_;
+    std::string units_;
+    
+    // 计数只在各线程自己的分片上累加，读取时合并
+    void countCacheHits(uint64_t hits = 1);
+    void countApiCall();
+    
+    RequestStatistics stats_;
+
+};
+
+#endif // WEATHER_SERVICE_H
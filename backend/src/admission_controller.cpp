@@ -0,0 +1,140 @@
+#include "admission_controller.h"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+
+using namespace std;
+
+static int64_t monotonicNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+AdmissionController::Permit& AdmissionController::Permit::operator=(Permit&& other) noexcept {
+    if (this != &other) {
+        release();
+        owner_ = other.owner_;
+        count_ = other.count_;
+        other.owner_ = nullptr;
+        other.count_ = 0;
+    }
+    return *this;
+}
+
+void AdmissionController::Permit::release() {
+    if (owner_) {
+        owner_->upstream_in_flight_.fetch_sub(count_, memory_order_release);
+        owner_ = nullptr;
+        count_ = 0;
+    }
+}
+
+AdmissionController::AdmissionController(const Options& options, size_t worker_threads)
+    : options_(options) {
+    // 默认给缓存命中留出至少一个工作线程，避免所有线程都阻塞在上游请求上
+    upstream_limit_ = options_.max_upstream_in_flight > 0 ?
+        options_.max_upstream_in_flight : max<size_t>(1, worker_threads * 3 / 4);
+}
+
+AdmissionController::Decision AdmissionController::admit(const string& client_id,
+                                                         WorkStealingExecutor::Priority priority,
+                                                         Permit& permit,
+                                                         size_t upstream_calls,
+                                                         double tokens) {
+    // 先检查全局容量，避免过载时还扣除客户端令牌
+    size_t acquired = acquireUpstream(priority, max<size_t>(1, upstream_calls));
+    if (acquired == 0) {
+        overloaded_.fetch_add(1, memory_order_relaxed);
+        return OVERLOADED;
+    }
+    
+    if (!client_id.empty() && options_.client_rate > 0 && !takeToken(client_id, tokens)) {
+        upstream_in_flight_.fetch_sub(acquired, memory_order_release);
+        rate_limited_.fetch_add(1, memory_order_relaxed);
+        return RATE_LIMITED;
+    }
+    
+    permit.release();
+    permit.owner_ = this;
+    permit.count_ = acquired;
+    admitted_.fetch_add(1, memory_order_relaxed);
+    return ADMITTED;
+}
+
+// 返回取得的许可数，容量已满时为0
+size_t AdmissionController::acquireUpstream(WorkStealingExecutor::Priority priority, size_t wanted) {
+    // 高优先级可用全部容量，普通3/4，低优先级1/2
+    size_t limit = upstream_limit_;
+    if (priority == WorkStealingExecutor::NORMAL) {
+        limit = max<size_t>(1, limit * 3 / 4);
+    } else if (priority == WorkStealingExecutor::LOW) {
+        limit = max<size_t>(1, limit / 2);
+    }
+    
+    size_t current = upstream_in_flight_.load(memory_order_relaxed);
+    while (current < limit) {
+        size_t acquired = min(wanted, limit - current);
+        if (upstream_in_flight_.compare_exchange_weak(current, current + acquired, memory_order_acquire)) {
+            return acquired;
+        }
+    }
+    return 0;
+}
+
+bool AdmissionController::takeToken(const string& client_id, double tokens) {
+    Shard& shard = shards_[hash<string>()(client_id) % SHARD_COUNT];
+    int64_t now = monotonicNanos();
+    
+    lock_guard<mutex> lock(shard.mutex);
+    
+    auto it = shard.buckets.find(client_id);
+    if (it == shard.buckets.end()) {
+        if (shard.buckets.size() >= options_.max_clients / SHARD_COUNT) {
+            evictIdle(shard, now);
+        }
+        it = shard.buckets.emplace(client_id, Bucket{options_.client_burst, now}).first;
+        tracked_clients_.fetch_add(1, memory_order_relaxed);
+    }
+    
+    Bucket& bucket = it->second;
+    double elapsed = (now - bucket.last_refill_ns) / 1e9;
+    bucket.tokens = min(options_.client_burst, bucket.tokens + elapsed * options_.client_rate);
+    bucket.last_refill_ns = now;
+    
+    if (bucket.tokens < 1.0) {
+        return false;
+    }
+    bucket.tokens -= tokens;
+    return true;
+}
+
+// 淘汰已经回满的桶，它们与新建的桶等价
+void AdmissionController::evictIdle(Shard& shard, int64_t now_ns) {
+    size_t before = shard.buckets.size();
+    for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+        double elapsed = (now_ns - it->second.last_refill_ns) / 1e9;
+        if (it->second.tokens + elapsed * options_.client_rate >= options_.client_burst) {
+            it = shard.buckets.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    
+    // 仍然满时随便淘汰一个，限制内存占用
+    if (shard.buckets.size() >= options_.max_clients / SHARD_COUNT && !shard.buckets.empty()) {
+        shard.buckets.erase(shard.buckets.begin());
+    }
+    tracked_clients_.fetch_sub(before - shard.buckets.size(), memory_order_relaxed);
+}
+
+AdmissionController::Statistics AdmissionController::getStatistics() const {
+    Statistics stats;
+    stats.admitted = admitted_.load(memory_order_relaxed);
+    stats.rate_limited = rate_limited_.load(memory_order_relaxed);
+    stats.overloaded = overloaded_.load(memory_order_relaxed);
+    stats.upstream_in_flight = upstream_in_flight_.load(memory_order_relaxed);
+    stats.upstream_limit = upstream_limit_;
+    
+    stats.tracked_clients = tracked_clients_.load(memory_order_relaxed);
+    return stats;
+}
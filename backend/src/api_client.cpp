@@ -1,317 +1,680 @@
-#include "api_client.h"
-#include <curl/curl.h>
-#include <nlohmann/json.hpp>
-#include <iostream>
-#include <sstream>
-#include <iomanip>
-#include <ctime>
-#include <memory>
-#include <mutex>
-
-using json = nlohmann::json;
-using namespace std;
-
-// HTTP客户端实现类
-class APIClient::HttpClientImpl {
-public:
-    HttpClientImpl() {
-        curl_global_init(CURL_GLOBAL_DEFAULT);
-        curl_ = curl_easy_init();
-        if (curl_) {
-            curl_easy_setopt(curl_, CURLOPT_USERAGENT, "WeatherApp/1.0");
-            curl_easy_setopt(curl_, CURLOPT_TIMEOUT, 10L);
-            curl_easy_setopt(curl_, CURLOPT_FOLLOWLOCATION, 1L);
-            curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYPEER, 1L);
-            curl_easy_setopt(curl_, CURLOPT_SSL_VERIFYHOST, 2L);
-        }
-    }
-    
-    ~HttpClientImpl() {
-        if (curl_) {
-            curl_easy_cleanup(curl_);
-        }
-        curl_global_cleanup();
-    }
-    
-    string performRequest(const string& url) {
-        if (!curl_) return "";
-        
-        string response;
-        curl_easy_setopt(curl_, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl_, CURLOPT_WRITEFUNCTION, writeCallback);
-        curl_easy_setopt(curl_, CURLOPT_WRITEDATA, &response);
-        
-        CURLcode res = curl_easy_perform(curl_);
-        if (res != CURLE_OK) {
-            cerr << "HTTP请求失败: " << curl_easy_strerror(res) << endl;
-            return "";
-        }
-        
-        long http_code = 0;
-        curl_easy_getinfo(curl_, CURLINFO_RESPONSE_CODE, &http_code);
-        if (http_code != 200) {
-            cerr << "HTTP错误代码: " << http_code << endl;
-            return "";
-        }
-        
-        return response;
-    }
-    
-private:
-    static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
-        size_t total_size = size * nmemb;
-        ((string*)userp)->append((char*)contents, total_size);
-        return total_size;
-    }
-    
-    CURL* curl_ = nullptr;
-};
-
-// APIClient实现
-APIClient::APIClient() 
-    : api_endpoint_("https://api.open-meteo.com/v1")
-    , user_agent_("WeatherApp/1.0")
-    , http_client_(make_unique<HttpClientImpl>()) {
-}
-
-APIClient::~APIClient() = default;
-
-void APIClient::setEndpoint(const string& endpoint) {
-    api_endpoint_ = endpoint;
-}
-
-string APIClient::buildCurrentWeatherUrl(double lat, double lon, 
-                                       const string& timezone,
-                                       const string& language) {
-    stringstream ss;
-    ss << api_endpoint_ << "/forecast?";
-    ss << "latitude=" << fixed << setprecision(6) << lat;
-    ss << "&longitude=" << fixed << setprecision(6) << lon;
-    ss << "&current=temperature_2m,relative_humidity_2m,apparent_temperature,";
-    ss << "wind_speed_10m,wind_direction_10m,pressure_msl,precipitation,";
-    ss << "cloud_cover,weather_code,is_day";
-    ss << "&timezone=" << timezone;
-    ss << "&language=" << language;
-    
-    return ss.str();
-}
-
-string APIClient::buildForecastUrl(double lat, double lon, int days,
-                                 const string& timezone,
-                                 const string& language) {
-    stringstream ss;
-    ss << api_endpoint_ << "/forecast?";
-    ss << "latitude=" << fixed << setprecision(6) << lat;
-    ss << "&longitude=" << fixed << setprecision(6) << lon;
-    ss << "&current=temperature_2m,relative_humidity_2m,apparent_temperature,";
-    ss << "wind_speed_10m,wind_direction_10m,pressure_msl,precipitation,";
-    ss << "cloud_cover,weather_code,is_day";
-    ss << "&hourly=temperature_2m,precipitation_probability,weather_code";
-    ss << "&daily=weather_code,temperature_2m_max,temperature_2m_min,";
-    ss << "precipitation_sum,sunrise,sunset";
-    ss << "&forecast_days=" << days;
-    ss << "&timezone=" << timezone;
-    ss << "&language=" << language;
-    
-    return ss.str();
-}
-
-string APIClient::buildGeocodingUrl(const string& query) {
-    stringstream ss;
-    ss << "https://geocoding-api.open-meteo.com/v1/search?";
-    ss << "name=" << query;
-    ss << "&count=10";
-    ss << "&language=zh";
-    ss << "&format=json";
-    
-    return ss.str();
-}
-
-string APIClient::performHttpRequest(const string& url) {
-    return http_client_->performRequest(url);
-}
-
-WeatherData APIClient::parseCurrentWeatherJson(const string& json_str) {
-    WeatherData data;
-    
-    try {
-        json j = json::parse(json_str);
-        
-        if (j.contains("current")) {
-            auto current = j["current"];
-            
-            data.temperature = current.value("temperature_2m", 0.0);
-            data.feels_like = current.value("apparent_temperature", 0.0);
-            data.humidity = current.value("relative_humidity_2m", 0);
-            data.wind_speed = current.value("wind_speed_10m", 0.0);
-            data.wind_direction = current.value("wind_direction_10m", 0);
-            data.pressure = current.value("pressure_msl", 1013.0);
-            data.precipitation = current.value("precipitation", 0.0);
-            data.cloud_cover = current.value("cloud_cover", 0);
-            data.weather_code = current.value("weather_code", 0);
-            data.timestamp = current.value("time", 0);
-            
-            bool is_day = current.value("is_day", 1) == 1;
-            data.icon_name = WeatherService::getIconNameFromCode(data.weather_code, is_day);
-            data.condition = WeatherService::getConditionFromCode(data.weather_code);
-        }
-        
-        if (j.contains("latitude")) {
-            data.latitude = j["latitude"];
-            data.longitude = j["longitude"];
-        }
-        
-        if (j.contains("timezone")) {
-            data.timezone = j["timezone"];
-        }
-        
-    } catch (const exception& e) {
-        cerr << "解析JSON错误: " << e.what() << endl;
-    }
-    
-    return data;
-}
-
-WeatherData APIClient::parseForecastJson(const string& json_str) {
-    WeatherData data = parseCurrentWeatherJson(json_str);
-    
-    try {
-        json j = json::parse(json_str);
-        
-        // 解析逐小时预报
-        if (j.contains("hourly")) {
-            auto hourly = j["hourly"];
-            
-            if (hourly.contains("time") && hourly.contains("temperature_2m") &&
-                hourly.contains("precipitation_probability") && hourly.contains("weather_code")) {
-                
-                auto times = hourly["time"];
-                auto temps = hourly["temperature_2m"];
-                auto precip_probs = hourly["precipitation_probability"];
-                auto weather_codes = hourly["weather_code"];
-                
-                size_t count = min({times.size(), temps.size(), 
-                                   precip_probs.size(), weather_codes.size()});
-                count = min(count, static_cast<size_t>(24)); // 限制24小时
-                
-                for (size_t i = 0; i < count; i++) {
-                    WeatherData::HourlyData hourly_data;
-                    hourly_data.timestamp = times[i];
-                    hourly_data.temperature = temps[i];
-                    hourly_data.precipitation_probability = precip_probs[i];
-                    hourly_data.weather_code = weather_codes[i];
-                    data.hourly_forecast.push_back(hourly_data);
-                }
-            }
-        }
-        
-        // 解析每日预报
-        if (j.contains("daily")) {
-            auto daily = j["daily"];
-            
-            if (daily.contains("time") && daily.contains("temperature_2m_max") &&
-                daily.contains("temperature_2m_min") && daily.contains("precipitation_sum") &&
-                daily.contains("weather_code") && daily.contains("sunrise") &&
-                daily.contains("sunset")) {
-                
-                auto dates = daily["time"];
-                auto temp_maxs = daily["temperature_2m_max"];
-                auto temp_mins = daily["temperature_2m_min"];
-                auto precip_sums = daily["precipitation_sum"];
-                auto weather_codes = daily["weather_code"];
-                auto sunrises = daily["sunrise"];
-                auto sunsets = daily["sunset"];
-                
-                size_t count = min({dates.size(), temp_maxs.size(), temp_mins.size(),
-                                   precip_sums.size(), weather_codes.size(),
-                                   sunrises.size(), sunsets.size()});
-                
-                for (size_t i = 0; i < count; i++) {
-                    WeatherData::DailyData daily_data;
-                    daily_data.date = dates[i];
-                    daily_data.temp_max = temp_maxs[i];
-                    daily_data.temp_min = temp_mins[i];
-                    daily_data.precipitation_sum = precip_sums[i];
-                    daily_data.weather_code = weather_codes[i];
-                    daily_data.sunrise = sunrises[i];
-                    daily_data.sunset = sunsets[i];
-                    data.daily_forecast.push_back(daily_data);
-                }
-            }
-        }
-        
-    } catch (const exception& e) {
-        cerr << "解析预报JSON错误: " << e.what() << endl;
-    }
-    
-    return data;
-}
-
-WeatherData APIClient::getCurrentWeather(double lat, double lon, 
-                                       const string& timezone,
-                                       const string& language) {
-    string url = buildCurrentWeatherUrl(lat, lon, timezone, language);
-    string json_str = performHttpRequest(url);
-    return parseCurrentWeatherJson(json_str);
-}
-
-WeatherData APIClient::getForecast(double lat, double lon, 
-                                 int days,
-                                 const string& timezone,
-                                 const string& language) {
-    string url = buildForecastUrl(lat, lon, days, timezone, language);
-    string json_str = performHttpRequest(url);
-    return parseForecastJson(json_str);
-}
-
-pair<double, double> APIClient::getCoordinates(const string& city, 
-                                             const string& country) {
-    string query = city;
-    if (!country.empty()) {
-        query += "," + country;
-    }
-    
-    string url = buildGeocodingUrl(query);
-    string json_str = performHttpRequest(url);
-    
-    try {
-        json j = json::parse(json_str);
-        
-        if (j.contains("results") && j["results"].size() > 0) {
-            auto result = j["results"][0];
-            double lat = result["latitude"];
-            double lon = result["longitude"];
-            return {lat, lon};
-        }
-    } catch (const exception& e) {
-        cerr << "解析地理编码JSON错误: " << e.what() << endl;
-    }
-    
-    return {0.0, 0.0};
-}
-
-vector<pair<string, string>> APIClient::searchCity(const string& query, int limit) {
-    vector<pair<string, string>> results;
-    
-    string url = buildGeocodingUrl(query);
-    string json_str = performHttpRequest(url);
-    
-    try {
-        json j = json::parse(json_str);
-        
-        if (j.contains("results")) {
-            int count = min(static_cast<int>(j["results"].size()), limit);
-            
-            for (int i = 0; i < count; i++) {
-                auto result = j["results"][i];
-                string name = result["name"];
-                string country = result["country"];
-                results.push_back({name, country});
-            }
-        }
-    } catch (const exception& e) {
-        cerr << "解析城市搜索JSON错误: " << e.what() << endl;
-    }
-    
-    return results;
-}
\ No newline at end of file
+#include "api_client.h"
+#include "weather_service.h"
+#include "trace.h"
+#include <curl/curl.h>
+#include <nlohmann/json.hpp>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <cctype>
+#include <ctime>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+using json = nlohmann::json;
+using namespace std;
+
+// HTTP客户端实现类
+// CURL easy句柄不能被多个线程同时使用，这里维护一个句柄池，
+// 每次请求独占一个句柄，用完归还以复用连接
+class APIClient::HttpClientImpl {
+public:
+    HttpClientImpl() {
+        curl_global_init(CURL_GLOBAL_DEFAULT);
+    }
+    
+    ~HttpClientImpl() {
+        for (CURL* curl : idle_handles_) {
+            curl_easy_cleanup(curl);
+        }
+        curl_global_cleanup();
+    }
+    
+    string performRequest(const string& url, UpstreamError& error) {
+        Trace::Span span("upstream.http");
+        CURL* curl = acquireHandle();
+        if (!curl) {
+            error.kind = UpstreamError::NETWORK;
+            error.message = "无法创建HTTP句柄";
+            return "";
+        }
+        
+        string response;
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, writeCallback);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
+        
+        CURLcode res = curl_easy_perform(curl);
+        long http_code = 0;
+        if (res == CURLE_OK) {
+            curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+        }
+        releaseHandle(curl);
+        
+        if (res != CURLE_OK) {
+            error.kind = UpstreamError::NETWORK;
+            error.message = curl_easy_strerror(res);
+            cerr << "HTTP请求失败: " << error.message << endl;
+            return "";
+        }
+        
+        if (http_code != 200) {
+            error.kind = UpstreamError::HTTP_STATUS;
+            error.http_status = http_code;
+            error.message = "HTTP " + to_string(http_code);
+            
+            // Open-Meteo 的错误响应为 {"error": true, "reason": "..."}
+            json body = json::parse(response, nullptr, false);
+            if (body.is_object() && body.contains("reason") && body["reason"].is_string()) {
+                error.message += ": " + body["reason"].get<string>();
+            }
+            cerr << "HTTP错误代码: " << http_code << endl;
+            return "";
+        }
+        
+        return response;
+    }
+    
+private:
+    static size_t writeCallback(void* contents, size_t size, size_t nmemb, void* userp) {
+        size_t total_size = size * nmemb;
+        ((string*)userp)->append((char*)contents, total_size);
+        return total_size;
+    }
+    
+    CURL* acquireHandle() {
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!idle_handles_.empty()) {
+                CURL* curl = idle_handles_.back();
+                idle_handles_.pop_back();
+                return curl;
+            }
+        }
+        
+        CURL* curl = curl_easy_init();
+        if (curl) {
+            curl_easy_setopt(curl, CURLOPT_USERAGENT, "WeatherApp/1.0");
+            curl_easy_setopt(curl, CURLOPT_TIMEOUT, 10L);
+            curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+            curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+            curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L); // 多线程下不能使用信号实现超时
+        }
+        return curl;
+    }
+    
+    void releaseHandle(CURL* curl) {
+        lock_guard<mutex> lock(mutex_);
+        idle_handles_.push_back(curl);
+    }
+    
+    mutex mutex_;
+    vector<CURL*> idle_handles_;
+};
+
+bool UpstreamError::transient() const {
+    switch (kind) {
+        case NETWORK:
+            return true;
+        case HTTP_STATUS:
+            return http_status == 408 || http_status == 429 || http_status >= 500;
+        default:
+            return false;
+    }
+}
+
+class APIClient::CallScope {
+public:
+    CallScope(APIClient& client, Endpoint endpoint, const UpstreamError& error)
+        : client_(client)
+        , endpoint_(endpoint)
+        , error_(error)
+        , start_(chrono::steady_clock::now()) {
+        client_.in_flight_.fetch_add(1, memory_order_relaxed);
+    }
+    
+    ~CallScope() {
+        client_.in_flight_.fetch_sub(1, memory_order_relaxed);
+        auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_);
+        client_.latency_[endpoint_].record(static_cast<uint64_t>(elapsed.count()));
+        if (!error_.ok()) {
+            client_.errors_[endpoint_][error_.kind].fetch_add(1, memory_order_relaxed);
+        }
+    }
+    
+    CallScope(const CallScope&) = delete;
+    CallScope& operator=(const CallScope&) = delete;
+
+private:
+    APIClient& client_;
+    Endpoint endpoint_;
+    const UpstreamError& error_;
+    chrono::steady_clock::time_point start_;
+};
+
+// APIClient实现
+APIClient::APIClient() 
+    : api_endpoint_("https://api.open-meteo.com/v1")
+    , user_agent_("WeatherApp/1.0")
+    , http_client_(make_unique<HttpClientImpl>()) {
+}
+
+APIClient::~APIClient() = default;
+
+void APIClient::setEndpoint(const string& endpoint) {
+    api_endpoint_ = endpoint;
+}
+
+string APIClient::buildCurrentWeatherUrl(double lat, double lon, 
+                                       const string& timezone,
+                                       const string& language) {
+    stringstream ss;
+    ss << api_endpoint_ << "/forecast?";
+    ss << "latitude=" << fixed << setprecision(6) << lat;
+    ss << "&longitude=" << fixed << setprecision(6) << lon;
+    ss << "&current=temperature_2m,relative_humidity_2m,apparent_temperature,";
+    ss << "wind_speed_10m,wind_direction_10m,pressure_msl,precipitation,";
+    ss << "cloud_cover,weather_code,is_day";
+    ss << "&timeformat=unixtime";
+    ss << "&timezone=" << timezone;
+    ss << "&language=" << language;
+    
+    return ss.str();
+}
+
+string APIClient::buildCurrentWeatherBatchUrl(const vector<pair<double, double>>& coords,
+                                            const string& timezone,
+                                            const string& language) {
+    // Open-Meteo 接受逗号分隔的多组坐标，返回按顺序排列的数组
+    stringstream ss;
+    ss << api_endpoint_ << "/forecast?" << fixed << setprecision(6);
+    ss << "latitude=";
+    for (size_t i = 0; i < coords.size(); i++) {
+        ss << (i ? "," : "") << coords[i].first;
+    }
+    ss << "&longitude=";
+    for (size_t i = 0; i < coords.size(); i++) {
+        ss << (i ? "," : "") << coords[i].second;
+    }
+    ss << "&current=temperature_2m,relative_humidity_2m,apparent_temperature,";
+    ss << "wind_speed_10m,wind_direction_10m,pressure_msl,precipitation,";
+    ss << "cloud_cover,weather_code,is_day";
+    ss << "&timeformat=unixtime";
+    ss << "&timezone=" << timezone;
+    ss << "&language=" << language;
+    
+    return ss.str();
+}
+
+string APIClient::buildForecastUrl(double lat, double lon, int days,
+                                 const string& timezone,
+                                 const string& language) {
+    stringstream ss;
+    ss << api_endpoint_ << "/forecast?";
+    ss << "latitude=" << fixed << setprecision(6) << lat;
+    ss << "&longitude=" << fixed << setprecision(6) << lon;
+    ss << "&current=temperature_2m,relative_humidity_2m,apparent_temperature,";
+    ss << "wind_speed_10m,wind_direction_10m,pressure_msl,precipitation,";
+    ss << "cloud_cover,weather_code,is_day";
+    ss << "&hourly=temperature_2m,precipitation_probability,weather_code";
+    ss << "&daily=weather_code,temperature_2m_max,temperature_2m_min,";
+    ss << "precipitation_sum,sunrise,sunset";
+    ss << "&forecast_days=" << days;
+    ss << "&timeformat=unixtime";
+    ss << "&timezone=" << timezone;
+    ss << "&language=" << language;
+    
+    return ss.str();
+}
+
+// 查询参数的百分号编码，城市名可能包含空格、中文和&等字符
+static string urlEncode(const string& text) {
+    static const char HEX[] = "0123456789ABCDEF";
+    string out;
+    out.reserve(text.size() * 3);
+    for (unsigned char c : text) {
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            out += static_cast<char>(c);
+        } else {
+            out += '%';
+            out += HEX[c >> 4];
+            out += HEX[c & 0xF];
+        }
+    }
+    return out;
+}
+
+string APIClient::buildGeocodingUrl(const string& query) {
+    stringstream ss;
+    ss << "https://geocoding-api.open-meteo.com/v1/search?";
+    ss << "name=" << urlEncode(query);
+    ss << "&count=10";
+    ss << "&language=zh";
+    ss << "&format=json";
+    
+    return ss.str();
+}
+
+string APIClient::performHttpRequest(const string& url, UpstreamError& error) {
+    return http_client_->performRequest(url, error);
+}
+
+// 解析失败时返回discarded值
+static json parseJson(const string& text) {
+    Trace::Span span("json.parse");
+    return json::parse(text, nullptr, false);
+}
+
+static bool fail(UpstreamError& error, UpstreamError::Kind kind, const string& message) {
+    error.kind = kind;
+    error.message = message;
+    return false;
+}
+
+// 读取数值字段。缺失时使用默认值，存在但不是数值（如null）时失败
+static bool readNumber(const json& object, const char* name, double fallback, double& out) {
+    auto it = object.find(name);
+    if (it == object.end()) {
+        out = fallback;
+        return true;
+    }
+    if (!it->is_number()) {
+        return false;
+    }
+    out = it->get<double>();
+    return true;
+}
+
+// 必需的数值字段
+static bool readRequired(const json& object, const char* name, double& out) {
+    return object.contains(name) && readNumber(object, name, 0.0, out);
+}
+
+// NaN不在任何范围内
+static bool inRange(double value, double low, double high) {
+    return value >= low && value <= high;
+}
+
+// 2000年以前的时间戳只可能来自缺失或错误的字段
+static constexpr int64_t MIN_VALID_TIMESTAMP = 946684800;
+
+// 检查数值是否在物理上合理的范围内，异常数据不能被当作成功结果缓存
+static bool validateCurrent(const WeatherData& data, UpstreamError& error) {
+    const char* field = nullptr;
+    if (!inRange(data.temperature, -100.0, 70.0)) field = "temperature";
+    else if (!inRange(data.feels_like, -120.0, 90.0)) field = "feels_like";
+    else if (!inRange(data.humidity, 0, 100)) field = "humidity";
+    else if (!inRange(data.wind_speed, 0.0, 500.0)) field = "wind_speed";
+    else if (!inRange(data.wind_direction, 0, 360)) field = "wind_direction";
+    else if (!inRange(data.pressure, 800.0, 1100.0)) field = "pressure";
+    else if (!inRange(data.precipitation, 0.0, 1000.0)) field = "precipitation";
+    else if (!inRange(data.cloud_cover, 0, 100)) field = "cloud_cover";
+    else if (!inRange(data.weather_code, 0, 99)) field = "weather_code";
+    else if (data.timestamp < MIN_VALID_TIMESTAMP) field = "time";
+    else if (!inRange(data.latitude, -90.0, 90.0) || !inRange(data.longitude, -180.0, 180.0)) field = "location";
+    
+    if (field) {
+        return fail(error, UpstreamError::INVALID, string("字段取值不合理: ") + field);
+    }
+    return true;
+}
+
+// 解析单个位置的当前天气对象
+static bool parseCurrentObject(const json& j, WeatherData& data, UpstreamError& error) {
+    if (!j.is_object() || !j.contains("current") || !j["current"].is_object()) {
+        return fail(error, UpstreamError::INVALID, "缺少current字段");
+    }
+    
+    const auto& current = j["current"];
+    double humidity, wind_direction, cloud_cover, weather_code, time, is_day;
+    if (!readRequired(current, "temperature_2m", data.temperature) ||
+        !readRequired(current, "weather_code", weather_code) ||
+        !readRequired(current, "time", time) ||
+        !readNumber(current, "apparent_temperature", data.temperature, data.feels_like) ||
+        !readNumber(current, "relative_humidity_2m", 0.0, humidity) ||
+        !readNumber(current, "wind_speed_10m", 0.0, data.wind_speed) ||
+        !readNumber(current, "wind_direction_10m", 0.0, wind_direction) ||
+        !readNumber(current, "pressure_msl", 1013.0, data.pressure) ||
+        !readNumber(current, "precipitation", 0.0, data.precipitation) ||
+        !readNumber(current, "cloud_cover", 0.0, cloud_cover) ||
+        !readNumber(current, "is_day", 1.0, is_day)) {
+        return fail(error, UpstreamError::INVALID, "current字段缺失或类型错误");
+    }
+    
+    data.humidity = static_cast<int>(humidity);
+    data.wind_direction = static_cast<int>(wind_direction);
+    data.cloud_cover = static_cast<int>(cloud_cover);
+    data.weather_code = static_cast<int>(weather_code);
+    data.timestamp = static_cast<int64_t>(time);
+    
+    data.is_day = is_day == 1.0;
+    data.icon_name = WeatherService::getIconNameFromCode(data.weather_code, data.is_day);
+    data.condition = WeatherService::getConditionFromCode(data.weather_code);
+    
+    if (!readNumber(j, "latitude", 0.0, data.latitude) ||
+        !readNumber(j, "longitude", 0.0, data.longitude)) {
+        return fail(error, UpstreamError::INVALID, "经纬度类型错误");
+    }
+    
+    if (j.contains("timezone") && j["timezone"].is_string()) {
+        data.timezone = j["timezone"];
+    }
+    
+    return validateCurrent(data, error);
+}
+
+// 解析失败时返回默认值，原因写入error
+WeatherData APIClient::parseCurrentWeatherJson(const string& json_str, UpstreamError& error) {
+    json j = parseJson(json_str);
+    if (j.is_discarded()) {
+        fail(error, UpstreamError::PARSE, "响应不是合法的JSON");
+        return WeatherData();
+    }
+    
+    WeatherData data;
+    if (!parseCurrentObject(j, data, error)) {
+        cerr << "当前天气数据无效: " << error.message << endl;
+        return WeatherData();
+    }
+    return data;
+}
+
+static bool parseHourly(const json& hourly, WeatherData& data, size_t max_count) {
+    if (!hourly.is_object() || !hourly.contains("time") || !hourly.contains("temperature_2m") ||
+        !hourly.contains("precipitation_probability") || !hourly.contains("weather_code")) {
+        return false;
+    }
+    
+    const auto& times = hourly["time"];
+    const auto& temps = hourly["temperature_2m"];
+    const auto& precip_probs = hourly["precipitation_probability"];
+    const auto& weather_codes = hourly["weather_code"];
+    if (!times.is_array() || !temps.is_array() || !precip_probs.is_array() || !weather_codes.is_array()) {
+        return false;
+    }
+    
+    size_t count = min({times.size(), temps.size(), 
+                       precip_probs.size(), weather_codes.size()});
+    count = min(count, max_count);
+    
+    data.hourly_forecast.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!times[i].is_number()) {
+            return false;
+        }
+        
+        // 远期的个别数值可能为null，按0处理
+        WeatherData::HourlyData hourly_data;
+        hourly_data.timestamp = times[i];
+        hourly_data.temperature = temps[i].is_number() ? temps[i].get<double>() : 0.0;
+        hourly_data.precipitation_probability = 
+            precip_probs[i].is_number() ? precip_probs[i].get<double>() : 0.0;
+        hourly_data.weather_code = weather_codes[i].is_number() ? weather_codes[i].get<int>() : 0;
+        data.hourly_forecast.push_back(hourly_data);
+    }
+    return !data.hourly_forecast.empty();
+}
+
+static bool parseDaily(const json& daily, WeatherData& data) {
+    if (!daily.is_object() || !daily.contains("time") || !daily.contains("temperature_2m_max") ||
+        !daily.contains("temperature_2m_min") || !daily.contains("precipitation_sum") ||
+        !daily.contains("weather_code") || !daily.contains("sunrise") ||
+        !daily.contains("sunset")) {
+        return false;
+    }
+    
+    const auto& dates = daily["time"];
+    const auto& temp_maxs = daily["temperature_2m_max"];
+    const auto& temp_mins = daily["temperature_2m_min"];
+    const auto& precip_sums = daily["precipitation_sum"];
+    const auto& weather_codes = daily["weather_code"];
+    const auto& sunrises = daily["sunrise"];
+    const auto& sunsets = daily["sunset"];
+    for (const json* column : {&dates, &temp_maxs, &temp_mins, &precip_sums,
+                               &weather_codes, &sunrises, &sunsets}) {
+        if (!column->is_array()) {
+            return false;
+        }
+    }
+    
+    size_t count = min({dates.size(), temp_maxs.size(), temp_mins.size(),
+                       precip_sums.size(), weather_codes.size(),
+                       sunrises.size(), sunsets.size()});
+    
+    data.daily_forecast.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!dates[i].is_number() || !temp_maxs[i].is_number() || !temp_mins[i].is_number()) {
+            return false;
+        }
+        
+        WeatherData::DailyData daily_data;
+        daily_data.date = dates[i];
+        daily_data.temp_max = temp_maxs[i];
+        daily_data.temp_min = temp_mins[i];
+        daily_data.precipitation_sum = precip_sums[i].is_number() ? precip_sums[i].get<double>() : 0.0;
+        daily_data.weather_code = weather_codes[i].is_number() ? weather_codes[i].get<int>() : 0;
+        // unixtime 格式下日出日落为整数时间戳
+        daily_data.sunrise = sunrises[i].is_string() ? sunrises[i].get<string>() : sunrises[i].dump();
+        daily_data.sunset = sunsets[i].is_string() ? sunsets[i].get<string>() : sunsets[i].dump();
+        
+        if (daily_data.date < MIN_VALID_TIMESTAMP || daily_data.temp_max < daily_data.temp_min) {
+            return false;
+        }
+        data.daily_forecast.push_back(daily_data);
+    }
+    return !data.daily_forecast.empty();
+}
+
+WeatherData APIClient::parseForecastJson(const string& json_str, UpstreamError& error) {
+    json j = parseJson(json_str);
+    if (j.is_discarded()) {
+        fail(error, UpstreamError::PARSE, "响应不是合法的JSON");
+        return WeatherData();
+    }
+    
+    WeatherData data;
+    if (!parseCurrentObject(j, data, error)) {
+        cerr << "预报数据无效: " << error.message << endl;
+        return WeatherData();
+    }
+    
+    // 逐小时预报保留完整预报时域，最多16天×24小时
+    if (!j.contains("hourly") || !parseHourly(j["hourly"], data, MAX_FORECAST_DAYS * 24)) {
+        fail(error, UpstreamError::INVALID, "逐小时预报缺失或无效");
+    } else if (!j.contains("daily") || !parseDaily(j["daily"], data)) {
+        fail(error, UpstreamError::INVALID, "每日预报缺失或无效");
+    }
+    
+    if (!error.ok()) {
+        cerr << "预报数据无效: " << error.message << endl;
+        return WeatherData();
+    }
+    return data;
+}
+
+WeatherData APIClient::getCurrentWeather(double lat, double lon, 
+                                       const string& timezone,
+                                       const string& language,
+                                       UpstreamError* error) {
+    UpstreamError local;
+    UpstreamError& e = error ? *error : local;
+    e = UpstreamError();
+    CallScope call(*this, ENDPOINT_CURRENT, e);
+    
+    string url = buildCurrentWeatherUrl(lat, lon, timezone, language);
+    string json_str = performHttpRequest(url, e);
+    if (!e.ok()) {
+        return WeatherData();
+    }
+    return parseCurrentWeatherJson(json_str, e);
+}
+
+vector<WeatherData> APIClient::getCurrentWeatherBatch(const vector<pair<double, double>>& coords,
+                                                   const string& timezone,
+                                                   const string& language,
+                                                   UpstreamError* error,
+                                                   vector<UpstreamError>* item_errors) {
+    UpstreamError local;
+    UpstreamError& e = error ? *error : local;
+    e = UpstreamError();
+    
+    vector<WeatherData> results;
+    if (coords.empty()) {
+        return results;
+    }
+    CallScope call(*this, ENDPOINT_CURRENT_BATCH, e);
+    
+    string url = buildCurrentWeatherBatchUrl(coords, timezone, language);
+    string json_str = performHttpRequest(url, e);
+    if (!e.ok()) {
+        return results;
+    }
+    
+    json j = parseJson(json_str);
+    if (j.is_discarded()) {
+        fail(e, UpstreamError::PARSE, "响应不是合法的JSON");
+        return results;
+    }
+    
+    // 只有一组坐标时返回的是对象而不是数组
+    if (j.is_object()) {
+        j = json::array({move(j)});
+    }
+    
+    if (!j.is_array() || j.size() != coords.size()) {
+        fail(e, UpstreamError::INVALID, "批量天气结果数量不匹配");
+        cerr << e.message << endl;
+        return results;
+    }
+    
+    results.resize(coords.size());
+    if (item_errors) {
+        item_errors->assign(coords.size(), UpstreamError());
+    }
+    for (size_t i = 0; i < coords.size(); i++) {
+        UpstreamError item_error;
+        if (!parseCurrentObject(j[i], results[i], item_error)) {
+            results[i] = WeatherData();
+            if (item_errors) {
+                (*item_errors)[i] = move(item_error);
+            }
+        }
+    }
+    
+    return results;
+}
+
+WeatherData APIClient::getForecast(double lat, double lon, 
+                                 int days,
+                                 const string& timezone,
+                                 const string& language,
+                                 UpstreamError* error) {
+    UpstreamError local;
+    UpstreamError& e = error ? *error : local;
+    e = UpstreamError();
+    CallScope call(*this, ENDPOINT_FORECAST, e);
+    
+    string url = buildForecastUrl(lat, lon, days, timezone, language);
+    string json_str = performHttpRequest(url, e);
+    if (!e.ok()) {
+        return WeatherData();
+    }
+    return parseForecastJson(json_str, e);
+}
+
+pair<double, double> APIClient::getCoordinates(const string& city, 
+                                             const string& country,
+                                             UpstreamError* error) {
+    UpstreamError local;
+    UpstreamError& e = error ? *error : local;
+    e = UpstreamError();
+    CallScope call(*this, ENDPOINT_GEOCODING, e);
+    
+    string query = city;
+    if (!country.empty()) {
+        query += "," + country;
+    }
+    
+    string url = buildGeocodingUrl(query);
+    string json_str = performHttpRequest(url, e);
+    if (!e.ok()) {
+        return {0.0, 0.0};
+    }
+    
+    json j = parseJson(json_str);
+    if (j.is_discarded() || !j.is_object()) {
+        fail(e, UpstreamError::PARSE, "地理编码响应不是合法的JSON");
+        return {0.0, 0.0};
+    }
+    
+    // 没有匹配时Open-Meteo省略results字段
+    if (!j.contains("results") || !j["results"].is_array() || j["results"].empty()) {
+        fail(e, UpstreamError::NOT_FOUND, "未找到城市: " + query);
+        return {0.0, 0.0};
+    }
+    
+    const auto& result = j["results"][0];
+    double lat, lon;
+    if (!result.is_object() || !readRequired(result, "latitude", lat) ||
+        !readRequired(result, "longitude", lon) ||
+        !inRange(lat, -90.0, 90.0) || !inRange(lon, -180.0, 180.0)) {
+        fail(e, UpstreamError::INVALID, "地理编码结果缺少经纬度");
+        return {0.0, 0.0};
+    }
+    
+    return {lat, lon};
+}
+
+vector<pair<string, string>> APIClient::searchCity(const string& query, int limit,
+                                                   UpstreamError* error) {
+    UpstreamError local;
+    UpstreamError& e = error ? *error : local;
+    e = UpstreamError();
+    CallScope call(*this, ENDPOINT_SEARCH, e);
+    
+    vector<pair<string, string>> results;
+    
+    string url = buildGeocodingUrl(query);
+    string json_str = performHttpRequest(url, e);
+    if (!e.ok()) {
+        return results;
+    }
+    
+    json j = parseJson(json_str);
+    if (j.is_discarded() || !j.is_object()) {
+        fail(e, UpstreamError::PARSE, "城市搜索响应不是合法的JSON");
+        return results;
+    }
+    
+    if (j.contains("results") && j["results"].is_array()) {
+        int count = min(static_cast<int>(j["results"].size()), limit);
+        
+        for (int i = 0; i < count; i++) {
+            const auto& result = j["results"][i];
+            // 个别结果（如海域、无主权地区）没有国家字段
+            if (!result.is_object() || !result.contains("name") || !result["name"].is_string()) {
+                continue;
+            }
+            string name = result["name"];
+            string country = result.contains("country") && result["country"].is_string() ?
+                result["country"].get<string>() : "";
+            results.push_back({name, country});
+        }
+    }
+    
+    return results;
+}
+
+APIClient::Statistics APIClient::getStatistics() const {
+    Statistics stats;
+    for (int endpoint = 0; endpoint < ENDPOINT_COUNT; endpoint++) {
+        latency_[endpoint].addTo(stats.latency[endpoint]);
+        for (int kind = 0; kind < UpstreamError::KIND_COUNT; kind++) {
+            stats.errors[endpoint][kind] = errors_[endpoint][kind].load(memory_order_relaxed);
+        }
+    }
+    stats.in_flight = in_flight_.load(memory_order_relaxed);
+    return stats;
+}
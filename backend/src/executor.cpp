@@ -0,0 +1,214 @@
+#include "executor.h"
+#include <iostream>
+
+using namespace std;
+
+// 当前线程所属的线程池及工作线程编号
+static thread_local const WorkStealingExecutor* current_executor = nullptr;
+static thread_local size_t current_worker = 0;
+
+// 单个工作线程的状态，按缓存行对齐以避免伪共享
+struct alignas(64) WorkStealingExecutor::Worker {
+    mutable mutex queue_mutex;
+    deque<Task> queues[PRIORITY_COUNT];
+    atomic<size_t> depth{0};
+    atomic<uint64_t> executed{0};
+    atomic<uint64_t> stolen{0};
+    atomic<uint64_t> busy_ns{0};
+    thread worker_thread;
+    
+    bool popFront(int priority, Task& task) {
+        lock_guard<mutex> lock(queue_mutex);
+        if (queues[priority].empty()) {
+            return false;
+        }
+        task = move(queues[priority].front());
+        queues[priority].pop_front();
+        depth--;
+        return true;
+    }
+    
+    bool popBack(int priority, Task& task) {
+        lock_guard<mutex> lock(queue_mutex);
+        if (queues[priority].empty()) {
+            return false;
+        }
+        task = move(queues[priority].back());
+        queues[priority].pop_back();
+        depth--;
+        return true;
+    }
+};
+
+WorkStealingExecutor::WorkStealingExecutor(size_t thread_count)
+    : start_time_(chrono::steady_clock::now()) {
+    if (thread_count == 0) {
+        thread_count = max(1u, thread::hardware_concurrency());
+    }
+    
+    for (size_t i = 0; i < thread_count; i++) {
+        workers_.push_back(make_unique<Worker>());
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        workers_[i]->worker_thread = thread([this, i]() { workerLoop(i); });
+    }
+}
+
+WorkStealingExecutor::~WorkStealingExecutor() {
+    shutdown();
+}
+
+void WorkStealingExecutor::submit(Task task, Priority priority) {
+    size_t index;
+    if (current_executor == this) {
+        index = current_worker;
+    } else {
+        index = next_worker_.fetch_add(1, memory_order_relaxed) % workers_.size();
+    }
+    
+    Worker& worker = *workers_[index];
+    {
+        lock_guard<mutex> lock(worker.queue_mutex);
+        worker.queues[priority].push_back(move(task));
+        worker.depth++;
+    }
+    
+    submitted_++;
+    pending_++;
+    
+    // 只有存在休眠线程时才需要加锁唤醒
+    if (sleeping_ > 0) {
+        lock_guard<mutex> lock(sleep_mutex_);
+        sleep_cv_.notify_one();
+    }
+}
+
+bool WorkStealingExecutor::runPendingTask() {
+    size_t index = current_executor == this ? current_worker : workers_.size();
+    
+    Task task;
+    if (!findTask(index, task)) {
+        return false;
+    }
+    
+    execute(index, task);
+    return true;
+}
+
+bool WorkStealingExecutor::isWorkerThread() const {
+    return current_executor == this;
+}
+
+// 按优先级查找任务：先取本线程队列，再从其他线程窃取同优先级任务
+bool WorkStealingExecutor::findTask(size_t index, Task& task) {
+    size_t count = workers_.size();
+    
+    for (int priority = 0; priority < PRIORITY_COUNT; priority++) {
+        if (index < count && workers_[index]->popFront(priority, task)) {
+            pending_--;
+            return true;
+        }
+        
+        size_t start = index < count ? index + 1 : next_worker_.load(memory_order_relaxed);
+        for (size_t i = 0; i < count; i++) {
+            size_t victim = (start + i) % count;
+            if (victim == index) {
+                continue;
+            }
+            if (workers_[victim]->popBack(priority, task)) {
+                pending_--;
+                if (index < count) {
+                    workers_[index]->stolen++;
+                }
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+void WorkStealingExecutor::execute(size_t index, Task& task) {
+    auto begin = chrono::steady_clock::now();
+    
+    try {
+        task();
+    } catch (const exception& e) {
+        cerr << "线程池任务异常: " << e.what() << endl;
+    } catch (...) {
+        cerr << "线程池任务异常" << endl;
+    }
+    
+    if (index < workers_.size()) {
+        auto elapsed = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - begin);
+        workers_[index]->busy_ns += elapsed.count();
+        workers_[index]->executed++;
+    }
+}
+
+void WorkStealingExecutor::workerLoop(size_t index) {
+    current_executor = this;
+    current_worker = index;
+    
+    while (true) {
+        Task task;
+        if (findTask(index, task)) {
+            execute(index, task);
+            continue;
+        }
+        
+        unique_lock<mutex> lock(sleep_mutex_);
+        sleeping_++;
+        sleep_cv_.wait(lock, [this]() { return stopping_ || pending_ > 0; });
+        sleeping_--;
+        
+        if (stopping_ && pending_ == 0) {
+            break;
+        }
+    }
+    
+    current_executor = nullptr;
+}
+
+WorkStealingExecutor::Statistics WorkStealingExecutor::getStatistics() const {
+    Statistics stats;
+    stats.queue_depth = 0;
+    stats.submitted = submitted_;
+    stats.executed = 0;
+    stats.steals = 0;
+    
+    double elapsed_ns = static_cast<double>(chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - start_time_).count());
+    
+    for (const auto& worker : workers_) {
+        WorkerStatistics ws;
+        ws.queue_depth = worker->depth;
+        ws.executed = worker->executed;
+        ws.stolen = worker->stolen;
+        ws.utilization = elapsed_ns > 0 ? min(1.0, worker->busy_ns / elapsed_ns) : 0.0;
+        
+        stats.queue_depth += ws.queue_depth;
+        stats.executed += ws.executed;
+        stats.steals += ws.stolen;
+        stats.workers.push_back(ws);
+    }
+    
+    return stats;
+}
+
+void WorkStealingExecutor::shutdown() {
+    {
+        lock_guard<mutex> lock(sleep_mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    sleep_cv_.notify_all();
+    
+    for (auto& worker : workers_) {
+        if (worker->worker_thread.joinable()) {
+            worker->worker_thread.join();
+        }
+    }
+}
@@ -0,0 +1,256 @@
+#include "forecast_delta.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+namespace {
+
+struct ColumnSpec {
+    const char* name;
+    int scale;
+};
+
+// 列的顺序与Snapshot中的数组一致
+const ColumnSpec HOURLY_COLUMNS[] = {
+    {"time", 1},
+    {"temperature", 10},
+    {"precipitation_probability", 1},
+    {"weather_code", 1}
+};
+
+const ColumnSpec DAILY_COLUMNS[] = {
+    {"date", 1},
+    {"temp_max", 10},
+    {"temp_min", 10},
+    {"precipitation_sum", 10},
+    {"weather_code", 1},
+    {"sunrise", 1},
+    {"sunset", 1}
+};
+
+const size_t HOURLY_COLUMN_COUNT = sizeof(HOURLY_COLUMNS) / sizeof(HOURLY_COLUMNS[0]);
+const size_t DAILY_COLUMN_COUNT = sizeof(DAILY_COLUMNS) / sizeof(DAILY_COLUMNS[0]);
+
+int64_t quantize(double value, int scale) {
+    return static_cast<int64_t>(llround(value * scale));
+}
+
+// FNV-1a
+void hashValue(uint64_t& hash, uint64_t value) {
+    for (int i = 0; i < 8; i++) {
+        hash ^= (value >> (i * 8)) & 0xff;
+        hash *= 1099511628211ULL;
+    }
+}
+
+void hashColumns(uint64_t& hash, const vector<vector<int64_t>>& columns) {
+    hashValue(hash, columns.empty() ? 0 : columns[0].size());
+    for (const auto& column : columns) {
+        for (int64_t value : column) {
+            hashValue(hash, static_cast<uint64_t>(value));
+        }
+    }
+}
+
+void fullSection(const vector<vector<int64_t>>& columns, const ColumnSpec* specs,
+                 ForecastSectionDelta& out) {
+    out.shift = 0;
+    out.length = static_cast<uint32_t>(columns[0].size());
+    out.columns.resize(columns.size());
+    for (size_t c = 0; c < columns.size(); c++) {
+        out.columns[c].name = specs[c].name;
+        out.columns[c].scale = specs[c].scale;
+        out.columns[c].values = columns[c];
+    }
+}
+
+// 第0列是时间。按新数组的起始时间对齐基准，窗口前移时只有末尾新增的部分需要完整发送
+size_t diffSection(const vector<vector<int64_t>>& base, const vector<vector<int64_t>>& current,
+                   const ColumnSpec* specs, ForecastSectionDelta& out) {
+    size_t base_length = base[0].size();
+    size_t length = current[0].size();
+    
+    size_t shift = 0;
+    if (length > 0) {
+        shift = lower_bound(base[0].begin(), base[0].end(), current[0][0]) - base[0].begin();
+    }
+    
+    out.shift = static_cast<uint32_t>(shift);
+    out.length = static_cast<uint32_t>(length);
+    
+    size_t entries = 0;
+    for (size_t c = 0; c < current.size(); c++) {
+        ForecastColumnDelta column;
+        for (size_t i = 0; i < length; i++) {
+            int64_t previous = i + shift < base_length ? base[c][i + shift] : 0;
+            int64_t diff = current[c][i] - previous;
+            if (diff != 0) {
+                column.indices.push_back(static_cast<uint32_t>(i));
+                column.values.push_back(diff);
+            }
+        }
+        
+        if (!column.indices.empty()) {
+            entries += column.indices.size();
+            column.name = specs[c].name;
+            column.scale = specs[c].scale;
+            out.columns.push_back(move(column));
+        }
+    }
+    return entries;
+}
+
+} // namespace
+
+ForecastDeltaEncoder::ForecastDeltaEncoder(size_t versions_per_location, size_t max_locations)
+    : versions_per_location_(max<size_t>(1, versions_per_location))
+    , max_locations_(max<size_t>(1, max_locations)) {
+}
+
+shared_ptr<const ForecastDeltaEncoder::Snapshot> ForecastDeltaEncoder::makeSnapshot(
+    const shared_ptr<const WeatherData>& forecast, size_t day_count) {
+    auto snapshot = make_shared<Snapshot>();
+    snapshot->source = forecast;
+    snapshot->day_count = min(day_count, forecast->daily_forecast.size());
+    
+    const auto& hours = forecast->hourly_forecast;
+    snapshot->hourly.assign(HOURLY_COLUMN_COUNT, vector<int64_t>());
+    for (auto& column : snapshot->hourly) {
+        column.reserve(hours.size());
+    }
+    for (const auto& h : hours) {
+        snapshot->hourly[0].push_back(h.timestamp);
+        snapshot->hourly[1].push_back(quantize(h.temperature, HOURLY_COLUMNS[1].scale));
+        snapshot->hourly[2].push_back(quantize(h.precipitation_probability, HOURLY_COLUMNS[2].scale));
+        snapshot->hourly[3].push_back(h.weather_code);
+    }
+    
+    snapshot->daily.assign(DAILY_COLUMN_COUNT, vector<int64_t>());
+    for (auto& column : snapshot->daily) {
+        column.reserve(snapshot->day_count);
+    }
+    for (size_t i = 0; i < snapshot->day_count; i++) {
+        const auto& d = forecast->daily_forecast[i];
+        snapshot->daily[0].push_back(d.date);
+        snapshot->daily[1].push_back(quantize(d.temp_max, DAILY_COLUMNS[1].scale));
+        snapshot->daily[2].push_back(quantize(d.temp_min, DAILY_COLUMNS[2].scale));
+        snapshot->daily[3].push_back(quantize(d.precipitation_sum, DAILY_COLUMNS[3].scale));
+        snapshot->daily[4].push_back(d.weather_code);
+        // unixtime 格式下日出日落是整数时间戳
+        snapshot->daily[5].push_back(strtoll(d.sunrise.c_str(), nullptr, 10));
+        snapshot->daily[6].push_back(strtoll(d.sunset.c_str(), nullptr, 10));
+    }
+    
+    uint64_t hash = 14695981039346656037ULL;
+    hashColumns(hash, snapshot->hourly);
+    hashColumns(hash, snapshot->daily);
+    snapshot->version = hash != 0 ? hash : 1; // 0 保留给“没有基准”
+    
+    return snapshot;
+}
+
+shared_ptr<ForecastDelta> ForecastDeltaEncoder::makeFull(const Snapshot& snapshot) {
+    auto delta = make_shared<ForecastDelta>();
+    delta->version = snapshot.version;
+    delta->full = true;
+    fullSection(snapshot.hourly, HOURLY_COLUMNS, delta->hourly);
+    fullSection(snapshot.daily, DAILY_COLUMNS, delta->daily);
+    return delta;
+}
+
+shared_ptr<ForecastDelta> ForecastDeltaEncoder::makeDelta(const Snapshot& base, const Snapshot& snapshot) {
+    auto delta = make_shared<ForecastDelta>();
+    delta->version = snapshot.version;
+    delta->base_version = base.version;
+    delta->full = false;
+    
+    size_t entries = diffSection(base.hourly, snapshot.hourly, HOURLY_COLUMNS, delta->hourly);
+    entries += diffSection(base.daily, snapshot.daily, DAILY_COLUMNS, delta->daily);
+    
+    // 每个变化要发送下标和差值，超过一半的值变化时完整快照更小
+    size_t total = snapshot.hourly[0].size() * HOURLY_COLUMN_COUNT +
+                   snapshot.daily[0].size() * DAILY_COLUMN_COUNT;
+    if (entries * 2 >= total && total > 0) {
+        return makeFull(snapshot);
+    }
+    return delta;
+}
+
+shared_ptr<const ForecastDelta> ForecastDeltaEncoder::encode(const string& cache_key,
+                                                             const shared_ptr<const WeatherData>& forecast,
+                                                             size_t day_count,
+                                                             uint64_t base_version) {
+    day_count = min(day_count, forecast->daily_forecast.size());
+    
+    shared_ptr<const Snapshot> snapshot;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = history_.find(cache_key);
+        if (it != history_.end()) {
+            const auto& latest = it->second.back();
+            if (latest->day_count == day_count && latest->source.lock() == forecast) {
+                snapshot = latest;
+            }
+        }
+    }
+    
+    // 量化在锁外进行
+    if (!snapshot) {
+        snapshot = makeSnapshot(forecast, day_count);
+    }
+    
+    shared_ptr<const Snapshot> base;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = history_.find(cache_key);
+        if (it == history_.end()) {
+            if (history_.size() >= max_locations_) {
+                history_.erase(history_.begin()); // 超过上限时随便淘汰一个位置
+            }
+            it = history_.emplace(cache_key, deque<shared_ptr<const Snapshot>>()).first;
+        }
+        
+        auto& versions = it->second;
+        if (versions.empty() || versions.back()->version != snapshot->version) {
+            versions.erase(remove_if(versions.begin(), versions.end(),
+                                     [&](const shared_ptr<const Snapshot>& v) {
+                                         return v->version == snapshot->version;
+                                     }),
+                           versions.end());
+            versions.push_back(snapshot);
+            if (versions.size() > versions_per_location_) {
+                versions.pop_front();
+            }
+        }
+        
+        if (base_version != 0) {
+            for (const auto& v : versions) {
+                if (v->version == base_version) {
+                    base = v;
+                    break;
+                }
+            }
+        }
+    }
+    
+    shared_ptr<ForecastDelta> delta = base ? makeDelta(*base, *snapshot) : makeFull(*snapshot);
+    if (delta->full) {
+        full_snapshots_.fetch_add(1, memory_order_relaxed);
+    } else {
+        deltas_.fetch_add(1, memory_order_relaxed);
+    }
+    return delta;
+}
+
+ForecastDeltaEncoder::Statistics ForecastDeltaEncoder::getStatistics() const {
+    Statistics stats;
+    stats.full_snapshots = full_snapshots_.load(memory_order_relaxed);
+    stats.deltas = deltas_.load(memory_order_relaxed);
+    {
+        lock_guard<mutex> lock(mutex_);
+        stats.locations = history_.size();
+    }
+    return stats;
+}
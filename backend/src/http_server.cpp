@@ -0,0 +1,1816 @@
+#include "http_server.h"
+#include "weather_service.h"
+#include "icon_renderer.h"
+#include "subscription_manager.h"
+#include "weather_json.h"
+#include "metrics_writer.h"
+#include "trace.h"
+#include <nlohmann/json.hpp>
+#include <zlib.h>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cmath>
+#include <ctime>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+using json = nlohmann::json;
+using namespace std;
+
+// 请求辅助方法
+const string* HttpServer::Request::getQuery(const string& name) const {
+    for (const auto& kv : query) {
+        if (kv.first == name) {
+            return &kv.second;
+        }
+    }
+    return nullptr;
+}
+
+const string* HttpServer::Request::getHeader(const string& name) const {
+    for (const auto& kv : headers) {
+        if (kv.first.size() == name.size() &&
+            equal(kv.first.begin(), kv.first.end(), name.begin(),
+                  [](char a, char b) { return tolower(a) == tolower(b); })) {
+            return &kv.second;
+        }
+    }
+    return nullptr;
+}
+
+// 流式响应推送端
+bool HttpServer::Stream::send(string data) {
+    lock_guard<mutex> lock(mutex_);
+    if (closed_) {
+        return false;
+    }
+    
+    if (!sink_) {
+        if (buffered_.size() >= MAX_BUFFERED) {
+            return false;
+        }
+        buffered_.push_back(move(data));
+        return true;
+    }
+    
+    sink_(move(data), false);
+    return true;
+}
+
+void HttpServer::Stream::close() {
+    lock_guard<mutex> lock(mutex_);
+    if (closed_) {
+        return;
+    }
+    
+    closed_ = true;
+    if (sink_) {
+        sink_(string(), true);
+    }
+}
+
+bool HttpServer::Stream::isOpen() const {
+    lock_guard<mutex> lock(mutex_);
+    return !closed_;
+}
+
+void HttpServer::Stream::attach(Sink sink) {
+    lock_guard<mutex> lock(mutex_);
+    if (detached_) {
+        return;
+    }
+    
+    sink_ = move(sink);
+    for (auto& data : buffered_) {
+        sink_(move(data), false);
+    }
+    buffered_.clear();
+    
+    if (closed_) {
+        sink_(string(), true);
+    }
+}
+
+void HttpServer::Stream::detach() {
+    lock_guard<mutex> lock(mutex_);
+    closed_ = true;
+    detached_ = true;
+    sink_ = nullptr;
+    buffered_.clear();
+}
+
+// URL解码（%XX 和 '+'）
+static string urlDecode(const char* begin, const char* end) {
+    string result;
+    result.reserve(end - begin);
+    
+    for (const char* p = begin; p < end; p++) {
+        if (*p == '%' && end - p >= 3 && isxdigit(p[1]) && isxdigit(p[2])) {
+            char hex[3] = {p[1], p[2], 0};
+            result.push_back(static_cast<char>(strtol(hex, nullptr, 16)));
+            p += 2;
+        } else if (*p == '+') {
+            result.push_back(' ');
+        } else {
+            result.push_back(*p);
+        }
+    }
+    
+    return result;
+}
+
+static void parseQueryString(const char* begin, const char* end,
+                             vector<pair<string, string>>& out) {
+    while (begin < end) {
+        const char* amp = find(begin, end, '&');
+        const char* eq = find(begin, amp, '=');
+        if (eq != begin) {
+            out.emplace_back(urlDecode(begin, eq),
+                             eq < amp ? urlDecode(eq + 1, amp) : string());
+        }
+        begin = amp < end ? amp + 1 : end;
+    }
+}
+
+// 解析 "北京,上海,London:GB" 形式的位置列表
+static void parseLocationList(const string& value, vector<WeatherLocation>& out) {
+    size_t pos = 0;
+    while (pos <= value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == string::npos) comma = value.size();
+        string name = value.substr(pos, comma - pos);
+        pos = comma + 1;
+        
+        if (name.empty()) continue;
+        WeatherLocation location;
+        size_t colon = name.find(':');
+        location.city_name = name.substr(0, colon);
+        if (colon != string::npos) location.country_code = name.substr(colon + 1);
+        out.push_back(move(location));
+    }
+}
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 413: return "Payload Too Large";
+        case 415: return "Unsupported Media Type";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        default: return "Unknown";
+    }
+}
+
+static string responseToJson(const WeatherResponse& response) {
+    string out;
+    out.reserve(estimateResponseSize(response));
+    writeWeatherResponse(out, response);
+    return out;
+}
+
+// gzip压缩，失败或没有收益时返回空
+static string gzipCompress(const string& input) {
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    if (deflateInit2(&zs, Z_BEST_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return string();
+    }
+    
+    string out(deflateBound(&zs, static_cast<uLong>(input.size())), '\0');
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    zs.avail_in = static_cast<uInt>(input.size());
+    zs.next_out = reinterpret_cast<Bytef*>(&out[0]);
+    zs.avail_out = static_cast<uInt>(out.size());
+    
+    int rc = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if (rc != Z_STREAM_END || zs.total_out >= input.size()) {
+        return string();
+    }
+    
+    out.resize(zs.total_out);
+    return out;
+}
+
+// 当前天气的响应体在写入缓存时编码一次（与responseToJson的输出相同）
+static shared_ptr<const EncodedBody> encodeCurrentBody(const WeatherData& data) {
+    string body;
+    body.reserve(512);
+    writeCurrentResponse(body, data);
+    
+    auto encoded = make_shared<EncodedBody>();
+    encoded->json = make_shared<const string>(move(body));
+    string compressed = gzipCompress(*encoded->json);
+    if (!compressed.empty()) {
+        encoded->gzip = make_shared<const string>(move(compressed));
+    }
+    return encoded;
+}
+
+static bool acceptsGzip(const HttpServer::Request& request) {
+    const string* value = request.getHeader("Accept-Encoding");
+    if (!value) {
+        return false;
+    }
+    
+    size_t pos = value->find("gzip");
+    if (pos == string::npos) {
+        return false;
+    }
+    
+    // 只识别显式禁用的 gzip;q=0
+    size_t end = value->find(',', pos);
+    string params = value->substr(pos + 4, end == string::npos ? string::npos : end - pos - 4);
+    params.erase(remove(params.begin(), params.end(), ' '), params.end());
+    return params != ";q=0" && params != ";q=0.0";
+}
+
+static uint32_t parseHourlyVariables(const string& value) {
+    uint32_t mask = 0;
+    size_t pos = 0;
+    while (pos <= value.size()) {
+        size_t comma = value.find(',', pos);
+        if (comma == string::npos) comma = value.size();
+        string name = value.substr(pos, comma - pos);
+        
+        if (name == "temperature") mask |= WeatherRequest::HOURLY_TEMPERATURE;
+        else if (name == "precipitation_probability") mask |= WeatherRequest::HOURLY_PRECIPITATION_PROBABILITY;
+        else if (name == "weather_code") mask |= WeatherRequest::HOURLY_WEATHER_CODE;
+        
+        pos = comma + 1;
+    }
+    return mask != 0 ? mask : static_cast<uint32_t>(WeatherRequest::HOURLY_ALL);
+}
+
+static IconRenderer::ColorTheme themeFromName(const string& name) {
+    if (name == "day") return IconRenderer::getDayTheme();
+    if (name == "night") return IconRenderer::getNightTheme();
+    if (name == "rain") return IconRenderer::getRainTheme();
+    if (name == "snow") return IconRenderer::getSnowTheme();
+    return IconRenderer::getDefaultTheme();
+}
+
+// size为逻辑像素，scale为设备像素比（HiDPI的1.5/2/3），实际像素为两者之积。
+// 无效的scale返回0，由调用方按尺寸无效处理
+static int scaledIconSize(int size, double scale) {
+    if (!(scale > 0.0 && scale <= 8.0)) {
+        return 0;
+    }
+    return static_cast<int>(lround(size * scale));
+}
+
+static bool isValidIconSize(int size) {
+    return size >= IconRenderer::MIN_ICON_SIZE && size <= IconRenderer::MAX_ICON_SIZE;
+}
+
+static string iconSizeError() {
+    return "图标尺寸必须在" + to_string(IconRenderer::MIN_ICON_SIZE) + "到" +
+           to_string(IconRenderer::MAX_ICON_SIZE) + "像素之间";
+}
+
+// 处理结果回调，可以在任意线程调用
+using Responder = function<void(HttpServer::Response)>;
+
+// 路由实现。I/O线程只解析请求并分发，实际处理在WeatherService的线程池中完成
+class HttpServer::Impl {
+public:
+    Impl(const Options& options, WeatherService* weather_service, IconRenderer* icon_renderer)
+        : options_(options)
+        , weather_service_(weather_service)
+        , icon_renderer_(icon_renderer) {
+        weather_service_->setBodyEncoder(encodeCurrentBody);
+    }
+    
+    void route(const Request& request, Responder respond) {
+        if (request.path == "/api/batch") {
+            handleBatch(request, move(respond));
+            return;
+        }
+        
+        if (request.method != "GET" && request.method != "HEAD") {
+            respond(makeError(405, "只支持GET请求"));
+            return;
+        }
+        
+        if (request.path == "/metrics") {
+            handleMetrics(move(respond));
+        } else if (request.path == "/api/weather") {
+            handleWeather(request, move(respond), WeatherRequest::CURRENT_WEATHER);
+        } else if (request.path == "/api/forecast") {
+            handleWeather(request, move(respond), WeatherRequest::FORECAST);
+        } else if (request.path == "/api/search") {
+            handleWeather(request, move(respond), WeatherRequest::SEARCH_CITY);
+        } else if (request.path == "/api/subscribe") {
+            handleSubscribe(request, move(respond));
+        } else if (request.path.compare(0, 10, "/api/icon/") == 0) {
+            handleIcon(request, move(respond));
+        } else if (request.path.compare(0, 17, "/api/icons/atlas.") == 0) {
+            handleIconAtlas(request, move(respond));
+        } else if (request.path == "/api/stats") {
+            handleStats(move(respond));
+        } else if (request.path == "/api/trace") {
+            handleTrace(request, move(respond));
+        } else {
+            respond(makeError(404, "未知的API端点"));
+        }
+    }
+    
+    void run();
+    void stop();
+    
+    Options options_;
+    WeatherService* weather_service_;
+    IconRenderer* icon_renderer_;
+    
+    // 统计（所有事件循环共享）
+    atomic<uint64_t> connections_accepted_{0};
+    atomic<uint64_t> connections_rejected_{0};
+    atomic<uint64_t> requests_{0};
+    atomic<uint64_t> bad_requests_{0};
+    atomic<uint64_t> active_connections_{0};
+    atomic<uint64_t> buffers_in_use_{0};
+    atomic<uint64_t> buffers_exhausted_{0};
+    
+    atomic<bool> stopped_{false};
+    mutex loops_mutex_;
+    vector<function<void()>> wakeups_;
+
+private:
+    static Response makeError(int status, const string& message) {
+        WeatherResponse error;
+        error.success = false;
+        error.error_message = message;
+        
+        Response response;
+        response.status = status;
+        response.body = responseToJson(error);
+        return response;
+    }
+    
+    // 被准入控制拒绝的请求返回429/503，并提示客户端稍后重试
+    static Response makeResult(const WeatherResponse& wres, int error_status, bool accept_gzip = false) {
+        Response response;
+        
+        // 预编码的响应体直接引用缓存中的字节
+        if (wres.success && wres.encoded_body) {
+            const EncodedBody& encoded = *wres.encoded_body;
+            if (encoded.gzip) {
+                response.headers.emplace_back("Vary", "Accept-Encoding");
+            }
+            if (accept_gzip && encoded.gzip) {
+                response.headers.emplace_back("Content-Encoding", "gzip");
+                response.shared_body = encoded.gzip;
+            } else {
+                response.shared_body = encoded.json;
+            }
+            return response;
+        }
+        
+        response.status = wres.success ? 200 : error_status;
+        if (wres.error_code == ERR_RATE_LIMITED) {
+            response.status = 429;
+            response.headers.emplace_back("Retry-After", "1");
+        } else if (wres.error_code == ERR_OVERLOADED) {
+            response.status = 503;
+            response.headers.emplace_back("Retry-After", "1");
+        } else if (wres.error_code == ERR_NOT_FOUND) {
+            response.status = 404;
+        } else if (wres.error_code == ERR_UPSTREAM) {
+            response.status = 502;
+        }
+        response.body = responseToJson(wres);
+        return response;
+    }
+    
+    // 按对端IP限速。X-Client-Id由客户端任意填写，只在请求来自配置的可信代理时采用，
+    // 否则每次换一个ID就能绕过限速
+    string clientId(const Request& request) const {
+        const auto& proxies = options_.trusted_proxies;
+        if (find(proxies.begin(), proxies.end(), request.remote_address) != proxies.end()) {
+            const string* id = request.getHeader("X-Client-Id");
+            if (id && !id->empty()) {
+                return *id;
+            }
+        }
+        return request.remote_address;
+    }
+    
+    void handleWeather(const Request& request, Responder respond,
+                       WeatherRequest::RequestType type) {
+        WeatherRequest wr;
+        wr.type = type;
+        wr.days = 0;
+        wr.latitude = 0.0;
+        wr.longitude = 0.0;
+        
+        const string* city = request.getQuery(type == WeatherRequest::SEARCH_CITY ? "q" : "city");
+        if (!city || city->empty()) {
+            respond(makeError(400, "缺少城市参数"));
+            return;
+        }
+        wr.city_name = *city;
+        
+        if (auto v = request.getQuery("country")) wr.country_code = *v;
+        if (auto v = request.getQuery("lang")) wr.language = *v;
+        if (auto v = request.getQuery("units")) wr.units = *v;
+        if (auto v = request.getQuery("days")) wr.days = atoi(v->c_str());
+        if (auto v = request.getQuery("start")) wr.hourly_start = atoi(v->c_str());
+        if (auto v = request.getQuery("count")) wr.hourly_count = atoi(v->c_str());
+        if (auto v = request.getQuery("vars")) wr.hourly_variables = parseHourlyVariables(*v);
+        if (auto v = request.getQuery("delta")) wr.delta_encoding = *v == "1" || *v == "true";
+        if (auto v = request.getQuery("base")) {
+            wr.delta_encoding = true;
+            wr.base_version = strtoull(v->c_str(), nullptr, 16);
+        }
+        wr.client_id = clientId(request);
+        wr.want_encoded = true;
+        bool accept_gzip = acceptsGzip(request);
+        
+        // 序列化也在工作线程中完成
+        weather_service_->submitRequest(wr, [respond = move(respond), accept_gzip](WeatherResponse wres) {
+            respond(makeResult(wres, 404, accept_gzip));
+        });
+    }
+    
+    // GET /api/batch?cities=北京,London:GB  或  POST JSON：
+    // {"locations": [{"city": "北京", "country": "CN"}, {"lat": 39.9, "lon": 116.4}], "lang": "zh"}
+    void handleBatch(const Request& request, Responder respond) {
+        WeatherRequest wr;
+        wr.type = WeatherRequest::BATCH;
+        wr.days = 0;
+        wr.latitude = 0.0;
+        wr.longitude = 0.0;
+        
+        if (request.method == "POST") {
+            try {
+                json body = json::parse(request.body);
+                for (const auto& item : body.at("locations")) {
+                    WeatherLocation location;
+                    location.city_name = item.value("city", "");
+                    location.country_code = item.value("country", "");
+                    location.latitude = item.value("lat", 0.0);
+                    location.longitude = item.value("lon", 0.0);
+                    wr.locations.push_back(move(location));
+                }
+                wr.language = body.value("lang", "");
+            } catch (const exception& e) {
+                respond(makeError(400, string("无效的批量请求: ") + e.what()));
+                return;
+            }
+        } else if (request.method == "GET" || request.method == "HEAD") {
+            const string* cities = request.getQuery("cities");
+            if (!cities || cities->empty()) {
+                respond(makeError(400, "缺少cities参数"));
+                return;
+            }
+            
+            parseLocationList(*cities, wr.locations);
+            if (auto v = request.getQuery("lang")) wr.language = *v;
+        } else {
+            respond(makeError(405, "只支持GET和POST请求"));
+            return;
+        }
+        
+        if (wr.locations.size() > WeatherService::MAX_BATCH_SIZE) {
+            respond(makeError(413, "批量请求最多包含" + to_string(WeatherService::MAX_BATCH_SIZE) + "个位置"));
+            return;
+        }
+        
+        wr.client_id = clientId(request);
+        weather_service_->submitRequest(wr, [respond = move(respond)](WeatherResponse wres) {
+            respond(makeResult(wres, 400));
+        });
+    }
+    
+    // GET /api/subscribe?cities=北京,London:GB
+    // Server-Sent Events：先推送缓存中的数据，之后只在数据变化时推送
+    void handleSubscribe(const Request& request, Responder respond) {
+        vector<WeatherLocation> locations;
+        if (auto v = request.getQuery("cities")) parseLocationList(*v, locations);
+        
+        if (locations.empty()) {
+            respond(makeError(400, "缺少cities参数"));
+            return;
+        }
+        if (locations.size() > WeatherService::MAX_BATCH_SIZE) {
+            respond(makeError(413, "订阅最多包含" + to_string(WeatherService::MAX_BATCH_SIZE) + "个位置"));
+            return;
+        }
+        
+        if (request.method == "HEAD") {
+            Response response;
+            response.content_type = "text/event-stream; charset=utf-8";
+            respond(move(response));
+            return;
+        }
+        
+        auto stream = make_shared<Stream>();
+        Response response;
+        response.content_type = "text/event-stream; charset=utf-8";
+        response.headers.emplace_back("Cache-Control", "no-cache");
+        response.body = "retry: 5000\n\n";
+        response.stream = stream;
+        respond(move(response));
+        
+        WeatherService* service = weather_service_;
+        service->getExecutor().submit([service, stream, locations = move(locations)]() {
+            for (const auto& location : locations) {
+                service->getSubscriptions().subscribe(location,
+                    [stream](const shared_ptr<const WeatherData>& data) {
+                        string event = "event: weather\ndata: ";
+                        JsonWriter writer(event);
+                        writeWeatherData(writer, *data);
+                        event += "\n\n";
+                        return stream->send(move(event));
+                    },
+                    [stream]() { return stream->isOpen(); });
+            }
+        }, WorkStealingExecutor::HIGH);
+    }
+    
+    void handleIcon(const Request& request, Responder respond) {
+        if (!icon_renderer_) {
+            respond(makeError(503, "图标渲染器未初始化"));
+            return;
+        }
+        
+        string name = request.path.substr(10);
+        string ext;
+        size_t dot = name.rfind('.');
+        if (dot != string::npos) {
+            ext = name.substr(dot + 1);
+            name.resize(dot);
+        }
+        
+        if (!ext.empty() && ext != "svg" && ext != "rgba" && ext != "png" && ext != "qoi") {
+            respond(makeError(415, "不支持的图标格式: " + ext));
+            return;
+        }
+        
+        IconRenderer::ColorTheme theme = IconRenderer::getDefaultTheme();
+        if (auto v = request.getQuery("theme")) theme = themeFromName(*v);
+        
+        int size = IconRenderer::LARGE;
+        double scale = 1.0;
+        if (auto v = request.getQuery("size")) size = atoi(v->c_str());
+        if (auto v = request.getQuery("scale")) scale = atof(v->c_str());
+        size = scaledIconSize(size, scale);
+        if (!isValidIconSize(size)) {
+            respond(makeError(400, iconSizeError()));
+            return;
+        }
+        
+        auto makeResponse = [ext, size](shared_ptr<const string> body) {
+            Response response;
+            if (ext == "svg") {
+                response.content_type = "image/svg+xml";
+            } else if (ext == "png" || ext == "qoi") {
+                response.content_type = ext == "png" ? "image/png" : "image/qoi";
+            } else {
+                response.content_type = "application/octet-stream";
+                response.headers.emplace_back("X-Icon-Width", to_string(IconRenderer::getIconWidth(size)));
+                response.headers.emplace_back("X-Icon-Height", to_string(IconRenderer::getIconHeight(size)));
+            }
+            response.shared_body = move(body);
+            return response;
+        };
+        
+        // SVG只是拼接路径字符串，直接在IO线程上生成
+        if (ext == "svg") {
+            Trace::Request trace("request.icon");
+            respond(makeResponse(icon_renderer_->getIconSVG(name, theme)));
+            return;
+        }
+        
+        // 已缓存的（包括启动时预热的常用尺寸）直接在IO线程上返回；
+        // 其他尺寸首次请求需要光栅化或缩放再编码，交给线程池，不阻塞同一事件循环上的连接
+        IconRenderer::ImageFormat format = ext == "png" ? IconRenderer::FORMAT_PNG :
+                                           ext == "qoi" ? IconRenderer::FORMAT_QOI : IconRenderer::FORMAT_RGBA;
+        if (auto cached = icon_renderer_->findCachedIcon(name, size, format, theme)) {
+            respond(makeResponse(move(cached)));
+            return;
+        }
+        IconRenderer* renderer = icon_renderer_;
+        weather_service_->getExecutor().submit(
+            [renderer, name = move(name), size, format, theme, makeResponse, respond = move(respond)]() {
+                Trace::Request trace("request.icon");
+                try {
+                    respond(makeResponse(renderer->getIconImage(name, size, format, theme)));
+                } catch (const exception& e) {
+                    respond(makeError(500, string("图标渲染失败: ") + e.what()));
+                }
+            }, WorkStealingExecutor::LOW);
+    }
+    
+    // GET /metrics：Prometheus文本格式。读取的统计都是原子变量或各线程的分片，
+    // 不获取请求路径上的任何锁，直接在IO线程上生成（约几十微秒），过载时也能抓取
+    void handleMetrics(Responder respond) {
+        static const char* const type_names[] = {"current", "forecast", "search", "geo", "batch"};
+        static const char* const outcome_names[] = {"hit", "miss", "error"};
+        static const char* const endpoint_names[] = {"current", "current_batch", "forecast",
+                                                     "geocoding", "search"};
+        static const char* const error_kinds[] = {"none", "network", "http_status", "parse",
+                                                  "invalid", "not_found"};
+        static const char* const stage_names[] = {"bitmap", "encode", "atlas"};
+        
+        Response response;
+        response.content_type = MetricsWriter::CONTENT_TYPE;
+        MetricsWriter metrics(response.body);
+        
+        RequestStatistics::Snapshot requests = weather_service_->getRequestStatistics();
+        uint64_t completed = 0;
+        metrics.family("weather_requests_total", "counter", "已完成的请求，按类型和结果（hit未访问上游，miss访问了上游）");
+        for (size_t type = 0; type < RequestStatistics::TYPE_COUNT; type++) {
+            for (size_t outcome = 0; outcome < RequestStatistics::OUTCOME_COUNT; outcome++) {
+                uint64_t count = requests.latency[type][outcome].count();
+                completed += count;
+                metrics.sample("weather_requests_total",
+                               {{"type", type_names[type]}, {"outcome", outcome_names[outcome]}}, count);
+            }
+        }
+        // 开始计数和完成计数分别读取，相减可能短暂为负
+        uint64_t started = requests.counters[RequestStatistics::REQUESTS];
+        metrics.family("weather_requests_in_flight", "gauge", "正在处理的请求");
+        metrics.sample("weather_requests_in_flight", {}, started > completed ? started - completed : 0);
+        
+        metrics.family("weather_request_duration_seconds", "histogram", "请求处理耗时");
+        for (size_t type = 0; type < RequestStatistics::TYPE_COUNT; type++) {
+            for (size_t outcome = 0; outcome < RequestStatistics::OUTCOME_COUNT; outcome++) {
+                metrics.histogram("weather_request_duration_seconds",
+                                  {{"type", type_names[type]}, {"outcome", outcome_names[outcome]}},
+                                  requests.latency[type][outcome]);
+            }
+        }
+        
+        metrics.family("weather_negative_cache_hits_total", "counter", "命中负缓存直接返回错误的次数");
+        metrics.sample("weather_negative_cache_hits_total", {},
+                       requests.counters[RequestStatistics::NEGATIVE_HITS]);
+        
+        WeatherCache::Statistics cache = weather_service_->getCacheStatistics();
+        NegativeCache::Statistics negative = weather_service_->getNegativeCacheStatistics();
+        metrics.family("weather_cache_lookups_total", "counter", "天气缓存查找，按结果（shared为从共享缓存取回）");
+        metrics.sample("weather_cache_lookups_total", {{"result", "hit"}}, cache.hits);
+        metrics.sample("weather_cache_lookups_total", {{"result", "shared"}}, cache.shared_hits);
+        metrics.sample("weather_cache_lookups_total", {{"result", "miss"}}, cache.misses);
+        metrics.family("weather_cache_evictions_total", "counter", "移出缓存的项");
+        metrics.sample("weather_cache_evictions_total", {{"cache", "weather"}, {"reason", "expired"}},
+                       cache.expired);
+        metrics.sample("weather_cache_evictions_total", {{"cache", "negative"}, {"reason", "full"}},
+                       negative.evicted);
+        metrics.family("weather_cache_entries", "gauge", "缓存项数");
+        metrics.sample("weather_cache_entries", {{"cache", "weather"}}, static_cast<uint64_t>(cache.entries));
+        metrics.sample("weather_cache_entries", {{"cache", "negative"}}, static_cast<uint64_t>(negative.entries));
+        
+        APIClient::Statistics upstream = weather_service_->getUpstreamStatistics();
+        metrics.family("weather_upstream_duration_seconds", "histogram", "上游调用耗时（含响应解析）");
+        for (int endpoint = 0; endpoint < APIClient::ENDPOINT_COUNT; endpoint++) {
+            metrics.histogram("weather_upstream_duration_seconds", {{"endpoint", endpoint_names[endpoint]}},
+                              upstream.latency[endpoint]);
+        }
+        metrics.family("weather_upstream_errors_total", "counter", "上游调用失败，按接口和原因");
+        for (int endpoint = 0; endpoint < APIClient::ENDPOINT_COUNT; endpoint++) {
+            for (int kind = UpstreamError::NETWORK; kind < UpstreamError::KIND_COUNT; kind++) {
+                metrics.sample("weather_upstream_errors_total",
+                               {{"endpoint", endpoint_names[endpoint]}, {"kind", error_kinds[kind]}},
+                               upstream.errors[endpoint][kind]);
+            }
+        }
+        metrics.family("weather_upstream_in_flight", "gauge", "进行中的上游调用");
+        metrics.sample("weather_upstream_in_flight", {}, upstream.in_flight);
+        
+        AdmissionController::Statistics admission = weather_service_->getAdmissionStatistics();
+        metrics.family("weather_admission_total", "counter", "准入控制的决定");
+        metrics.sample("weather_admission_total", {{"decision", "admitted"}}, admission.admitted);
+        metrics.sample("weather_admission_total", {{"decision", "rate_limited"}}, admission.rate_limited);
+        metrics.sample("weather_admission_total", {{"decision", "overloaded"}}, admission.overloaded);
+        metrics.family("weather_upstream_permits", "gauge", "上游并发许可");
+        metrics.sample("weather_upstream_permits", {{"state", "in_use"}},
+                       static_cast<uint64_t>(admission.upstream_in_flight));
+        metrics.sample("weather_upstream_permits", {{"state", "limit"}},
+                       static_cast<uint64_t>(admission.upstream_limit));
+        metrics.family("weather_admission_tracked_clients", "gauge", "限速跟踪的客户端数");
+        metrics.sample("weather_admission_tracked_clients", {}, static_cast<uint64_t>(admission.tracked_clients));
+        
+        WorkStealingExecutor::Statistics executor = weather_service_->getExecutorStatistics();
+        metrics.family("weather_executor_queue_depth", "gauge", "线程池中排队的任务");
+        metrics.sample("weather_executor_queue_depth", {}, static_cast<uint64_t>(executor.queue_depth));
+        metrics.family("weather_executor_tasks_total", "counter", "线程池任务");
+        metrics.sample("weather_executor_tasks_total", {{"state", "submitted"}}, executor.submitted);
+        metrics.sample("weather_executor_tasks_total", {{"state", "executed"}}, executor.executed);
+        metrics.sample("weather_executor_tasks_total", {{"state", "stolen"}}, executor.steals);
+        
+        metrics.family("weather_http_connections", "gauge", "当前的HTTP连接");
+        metrics.sample("weather_http_connections", {}, active_connections_.load(memory_order_relaxed));
+        metrics.family("weather_http_connections_total", "counter", "HTTP连接，按结果");
+        metrics.sample("weather_http_connections_total", {{"result", "accepted"}},
+                       connections_accepted_.load(memory_order_relaxed));
+        metrics.sample("weather_http_connections_total", {{"result", "rejected"}},
+                       connections_rejected_.load(memory_order_relaxed));
+        metrics.family("weather_http_requests_total", "counter", "收到的HTTP请求（bad为无法解析的请求）");
+        metrics.sample("weather_http_requests_total", {{"result", "parsed"}}, requests_.load(memory_order_relaxed));
+        metrics.sample("weather_http_requests_total", {{"result", "bad"}}, bad_requests_.load(memory_order_relaxed));
+        metrics.family("weather_http_read_buffers", "gauge", "使用中的HTTP读缓冲块");
+        metrics.sample("weather_http_read_buffers", {}, buffers_in_use_.load(memory_order_relaxed));
+        metrics.family("weather_http_read_buffer_exhausted_total", "counter", "读缓冲池耗尽而关闭的连接");
+        metrics.sample("weather_http_read_buffer_exhausted_total", {}, buffers_exhausted_.load(memory_order_relaxed));
+        
+        if (icon_renderer_) {
+            IconRenderer::CacheStatistics icons = icon_renderer_->getCacheStatistics();
+            metrics.family("weather_icon_cache_lookups_total", "counter", "图标缓存查找");
+            metrics.sample("weather_icon_cache_lookups_total", {{"result", "hit"}}, icons.hits);
+            metrics.sample("weather_icon_cache_lookups_total", {{"result", "miss"}}, icons.misses);
+            metrics.family("weather_icon_cache_evictions_total", "counter", "超出上限被淘汰的图标渲染结果和图集");
+            metrics.sample("weather_icon_cache_evictions_total", {}, icons.evictions);
+            metrics.family("weather_icon_cache_entries", "gauge", "缓存的图标、图集和主光栅");
+            metrics.sample("weather_icon_cache_entries", {{"kind", "render"}}, static_cast<uint64_t>(icons.entries));
+            metrics.sample("weather_icon_cache_entries", {{"kind", "atlas"}}, static_cast<uint64_t>(icons.atlases));
+            metrics.sample("weather_icon_cache_entries", {{"kind", "master"}}, static_cast<uint64_t>(icons.masters));
+            metrics.family("weather_icon_cache_bytes", "gauge", "缓存的图标渲染结果和图集大小");
+            metrics.sample("weather_icon_cache_bytes", {{"kind", "render"}}, static_cast<uint64_t>(icons.bytes));
+            metrics.sample("weather_icon_cache_bytes", {{"kind", "atlas"}}, static_cast<uint64_t>(icons.atlas_bytes));
+            
+            IconRenderer::RenderStatistics render = icon_renderer_->getRenderStatistics();
+            metrics.family("weather_icon_render_duration_seconds", "histogram", "未命中缓存时的图标渲染耗时，按阶段");
+            for (int stage = 0; stage < IconRenderer::RENDER_STAGE_COUNT; stage++) {
+                metrics.histogram("weather_icon_render_duration_seconds", {{"stage", stage_names[stage]}},
+                                  render.latency[stage]);
+            }
+        }
+        
+        respond(move(response));
+    }
+    
+    // GET /api/stats：请求计数和延迟分位数（微秒），按请求类型和结果细分，省略没有请求的组合
+    void handleStats(Responder respond) {
+        static const char* const type_names[] = {"current", "forecast", "search", "geo", "batch"};
+        static const char* const outcome_names[] = {"hit", "miss", "error"};
+        
+        auto writeLatency = [](JsonWriter& writer, const WeatherService::LatencySummary& latency) {
+            writer.beginObject();
+            writer.field("count", latency.count);
+            writer.field("mean_us", latency.mean_us);
+            writer.field("p50_us", latency.p50_us);
+            writer.field("p90_us", latency.p90_us);
+            writer.field("p99_us", latency.p99_us);
+            writer.field("p999_us", latency.p999_us);
+            writer.field("max_us", latency.max_us);
+            writer.endObject();
+        };
+        
+        WeatherService::Statistics stats = weather_service_->getStatistics();
+        Response response;
+        JsonWriter writer(response.body);
+        writer.beginObject();
+        writer.field("requests", stats.total_requests);
+        writer.field("cache_hits", stats.cache_hits);
+        writer.field("api_calls", stats.api_calls);
+        writer.field("negative_hits", stats.negative_hits);
+        writer.field("upstream_errors", stats.upstream_errors);
+        writer.key("latency");
+        writeLatency(writer, stats.latency);
+        writer.key("latency_by_type");
+        writer.beginObject();
+        for (size_t type = 0; type < RequestStatistics::TYPE_COUNT; type++) {
+            bool any = false;
+            for (size_t outcome = 0; outcome < RequestStatistics::OUTCOME_COUNT; outcome++) {
+                const auto& latency = stats.latency_by_type[type][outcome];
+                if (latency.count == 0) {
+                    continue;
+                }
+                if (!any) {
+                    writer.key(type_names[type]);
+                    writer.beginObject();
+                    any = true;
+                }
+                writer.key(outcome_names[outcome]);
+                writeLatency(writer, latency);
+            }
+            if (any) {
+                writer.endObject();
+            }
+        }
+        writer.endObject();
+        writer.endObject();
+        respond(move(response));
+    }
+    
+    // GET /api/trace：导出各线程缓冲区中采样到的请求阶段（Chrome trace JSON，可在ui.perfetto.dev打开）。
+    // 带rate参数时先设置采样率。缓冲区全满时输出有数MB，交给线程池低优先级生成
+    void handleTrace(const Request& request, Responder respond) {
+        if (auto v = request.getQuery("rate")) {
+            char* end = nullptr;
+            double rate = strtod(v->c_str(), &end);
+            if (v->empty() || *end != '\0' || !(rate >= 0.0 && rate <= 1.0)) {
+                respond(makeError(400, "rate应为0~1之间的数"));
+                return;
+            }
+            Trace::setSampleRate(rate);
+        }
+        weather_service_->getExecutor().submit([respond = move(respond)]() {
+            Response response;
+            Trace::exportChromeTrace(response.body);
+            response.headers.emplace_back("Content-Disposition", "attachment; filename=\"trace.json\"");
+            respond(move(response));
+        }, WorkStealingExecutor::LOW);
+    }
+    
+    // GET /api/icons/atlas.png?icons=rain,sunny@128,partly-cloudy-night&size=64&theme=day
+    // 扩展名为png/qoi/rgba时返回图集图片，json/bin返回索引（与PNG图集对应，各格式的布局相同）。
+    // 未指定尺寸的图标使用size参数，scale对所有图标生效
+    void handleIconAtlas(const Request& request, Responder respond) {
+        if (!icon_renderer_) {
+            respond(makeError(503, "图标渲染器未初始化"));
+            return;
+        }
+        
+        string ext = request.path.substr(17);
+        IconRenderer::ImageFormat format = IconRenderer::FORMAT_PNG;
+        if (ext == "qoi") format = IconRenderer::FORMAT_QOI;
+        else if (ext == "rgba") format = IconRenderer::FORMAT_RGBA;
+        else if (ext != "png" && ext != "json" && ext != "bin") {
+            respond(makeError(415, "不支持的图集格式: " + ext));
+            return;
+        }
+        
+        IconRenderer::ColorTheme theme = IconRenderer::getDefaultTheme();
+        if (auto v = request.getQuery("theme")) theme = themeFromName(*v);
+        int default_size = IconRenderer::LARGE;
+        double scale = 1.0;
+        if (auto v = request.getQuery("size")) default_size = atoi(v->c_str());
+        if (auto v = request.getQuery("scale")) scale = atof(v->c_str());
+        
+        const string* icons = request.getQuery("icons");
+        if (!icons || icons->empty()) {
+            respond(makeError(400, "缺少icons参数"));
+            return;
+        }
+        
+        vector<IconRenderer::IconRequest> requests;
+        size_t pos = 0;
+        while (pos <= icons->size()) {
+            size_t comma = icons->find(',', pos);
+            if (comma == string::npos) comma = icons->size();
+            string item = icons->substr(pos, comma - pos);
+            pos = comma + 1;
+            if (item.empty()) continue;
+            
+            int size = default_size;
+            size_t at = item.find('@');
+            if (at != string::npos) {
+                size = atoi(item.c_str() + at + 1);
+                item.resize(at);
+            }
+            size = scaledIconSize(size, scale);
+            if (!isValidIconSize(size)) {
+                respond(makeError(400, iconSizeError()));
+                return;
+            }
+            IconId id;
+            if (!findIconId(item, id)) {
+                respond(makeError(400, "未知的图标: " + item));
+                return;
+            }
+            requests.push_back({id, size, theme});
+        }
+        if (requests.empty() || requests.size() > IconRenderer::MAX_ATLAS_ICONS) {
+            respond(makeError(413, "图集最多包含" + to_string(IconRenderer::MAX_ATLAS_ICONS) + "个图标"));
+            return;
+        }
+        
+        auto makeResponse = [ext](const IconRenderer::IconAtlas& atlas) {
+            Response response;
+            if (ext == "json") {
+                response.shared_body = atlas.json_index;
+            } else if (ext == "bin") {
+                response.content_type = "application/octet-stream";
+                response.shared_body = atlas.binary_index;
+            } else {
+                response.content_type = ext == "png" ? "image/png" :
+                                        ext == "qoi" ? "image/qoi" : "application/octet-stream";
+                response.headers.emplace_back("X-Atlas-Width", to_string(atlas.width));
+                response.headers.emplace_back("X-Atlas-Height", to_string(atlas.height));
+                response.shared_body = atlas.image;
+            }
+            return response;
+        };
+        
+        // 已缓存的图集直接在IO线程上返回，首次生成需要光栅化和编码，交给线程池
+        if (auto atlas = icon_renderer_->findCachedAtlas(requests, format)) {
+            respond(makeResponse(*atlas));
+            return;
+        }
+        IconRenderer* renderer = icon_renderer_;
+        weather_service_->getExecutor().submit(
+            [renderer, requests = move(requests), format, makeResponse, respond = move(respond)]() {
+                Trace::Request trace("request.icon_atlas");
+                try {
+                    respond(makeResponse(*renderer->getIconAtlas(requests, format)));
+                } catch (const invalid_argument& e) {
+                    respond(makeError(413, e.what()));
+                } catch (const exception& e) {
+                    respond(makeError(500, string("图集生成失败: ") + e.what()));
+                }
+            }, WorkStealingExecutor::LOW);
+    }
+};
+
+// 生成完整的HTTP响应报文
+// shared_body不拷贝进报文，由调用方单独排入发送队列
+static string formatResponse(const HttpServer::Response& response, bool keep_alive, bool head) {
+    size_t body_size = response.shared_body ? response.shared_body->size() : response.body.size();
+    
+    string out;
+    out.reserve(160 + (response.shared_body ? 0 : body_size));
+    out += "HTTP/1.1 ";
+    out += to_string(response.status);
+    out += ' ';
+    out += statusText(response.status);
+    out += "\r\nServer: YourWeather\r\nContent-Type: ";
+    out += response.content_type;
+    if (response.stream) {
+        // 流式响应以关闭连接结束
+        out += "\r\nConnection: close\r\n";
+    } else {
+        out += "\r\nContent-Length: ";
+        out += to_string(body_size);
+        out += keep_alive ? "\r\nConnection: keep-alive\r\n" : "\r\nConnection: close\r\n";
+    }
+    for (const auto& h : response.headers) {
+        out += h.first;
+        out += ": ";
+        out += h.second;
+        out += "\r\n";
+    }
+    out += "\r\n";
+    if (!head && !response.shared_body) {
+        out += response.body;
+    }
+    return out;
+}
+
+#ifdef __linux__
+
+// 固定大小的缓冲块池，每个事件循环独占一个，无需加锁
+class BufferPool {
+public:
+    BufferPool(size_t block_size, size_t max_blocks, atomic<uint64_t>& in_use)
+        : block_size_(block_size), max_blocks_(max_blocks), in_use_(in_use) {
+    }
+    
+    ~BufferPool() {
+        for (char* block : free_) {
+            delete[] block;
+        }
+    }
+    
+    char* acquire() {
+        char* block = nullptr;
+        if (!free_.empty()) {
+            block = free_.back();
+            free_.pop_back();
+        } else if (allocated_ < max_blocks_) {
+            block = new char[block_size_];
+            allocated_++;
+        } else {
+            return nullptr;
+        }
+        in_use_++;
+        return block;
+    }
+    
+    void release(char* block) {
+        free_.push_back(block);
+        in_use_--;
+    }
+    
+    size_t blockSize() const { return block_size_; }
+
+private:
+    size_t block_size_;
+    size_t max_blocks_;
+    size_t allocated_ = 0;
+    vector<char*> free_;
+    atomic<uint64_t>& in_use_;
+};
+
+// 工作线程把处理结果投递回所属的事件循环
+struct LoopMailbox {
+    struct Completion {
+        enum Kind {
+            RESPONSE,       // 请求seq的完整响应（或流式响应的响应头）
+            STREAM_DATA,    // 流式响应的后续数据
+            STREAM_END
+        };
+        
+        uint64_t connection_id;
+        uint64_t seq;
+        string data;
+        Kind kind = RESPONSE;
+        shared_ptr<HttpServer::Stream> stream;
+        shared_ptr<const string> body;   // 紧随data发送的共享响应体
+    };
+    
+    mutex mutex_;
+    vector<Completion> items;
+    int wake_fd = -1;
+    bool closed = false;
+    
+    void post(Completion completion) {
+        {
+            lock_guard<mutex> lock(mutex_);
+            if (!closed) {
+                bool need_wake = items.empty();
+                items.push_back(move(completion));
+                if (need_wake) {
+                    uint64_t one = 1;
+                    ssize_t ignored = write(wake_fd, &one, sizeof(one));
+                    (void)ignored;
+                }
+                return;
+            }
+        }
+        
+        // 事件循环已退出，丢弃结果
+        if (completion.stream) {
+            completion.stream->detach();
+        }
+    }
+};
+
+// 按请求顺序等待处理结果的响应槽（保证pipelining的响应顺序）
+struct PendingResponse {
+    bool ready = false;
+    string data;
+    shared_ptr<const string> body;
+    shared_ptr<HttpServer::Stream> stream;
+};
+
+// 发送队列中的一段：自有数据（响应头、动态生成的响应），或与缓存共享的响应体
+struct OutputChunk {
+    string owned;
+    shared_ptr<const string> shared;
+    
+    OutputChunk(string data) : owned(move(data)) {}
+    OutputChunk(shared_ptr<const string> data) : shared(move(data)) {}
+    
+    const char* data() const { return shared ? shared->data() : owned.data(); }
+    size_t size() const { return shared ? shared->size() : owned.size(); }
+};
+
+struct HttpConnection {
+    uint64_t id = 0;
+    int fd = -1;
+    char* rbuf = nullptr;          // 读缓冲（来自缓冲池，空闲时归还）
+    size_t rlen = 0;
+    deque<OutputChunk> out;        // 待发送的响应
+    size_t out_offset = 0;         // out.front() 已发送的字节数
+    size_t out_bytes = 0;
+    deque<PendingResponse> pending; // 已分发、等待结果的请求
+    uint64_t first_seq = 0;        // pending.front() 的序号
+    uint64_t next_seq = 0;
+    bool want_read = true;         // 边缘触发：内核中可能还有未读数据
+    bool peer_closed = false;
+    bool close_after_write = false;
+    int64_t last_active = 0;
+    string remote_address;
+    shared_ptr<HttpServer::Stream> stream; // 正在推送的流式响应，此后不再处理新请求
+};
+
+static string formatAddress(const sockaddr_storage& addr) {
+    char text[INET6_ADDRSTRLEN] = {0};
+    if (addr.ss_family == AF_INET) {
+        inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(addr).sin_addr, text, sizeof(text));
+    } else if (addr.ss_family == AF_INET6) {
+        inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr, text, sizeof(text));
+    }
+    return text;
+}
+
+// 解析一个HTTP请求。返回值：>0 完整请求的字节数，0 数据不完整，-1 格式错误，-2 请求头过大，-3 请求体过大
+static long parseHttpRequest(const char* data, size_t len, size_t limit, HttpServer::Request& request) {
+    const char* end = data + len;
+    const char* header_end = static_cast<const char*>(memmem(data, len, "\r\n\r\n", 4));
+    if (!header_end) {
+        return len >= limit ? -2 : 0;
+    }
+    
+    // 请求行
+    const char* line_end = static_cast<const char*>(memmem(data, header_end + 2 - data, "\r\n", 2));
+    const char* sp1 = find(data, line_end, ' ');
+    const char* sp2 = sp1 < line_end ? find(sp1 + 1, line_end, ' ') : line_end;
+    if (sp1 == line_end || sp2 == line_end || line_end - sp2 != 9 ||
+        memcmp(sp2 + 1, "HTTP/1.", 7) != 0) {
+        return -1;
+    }
+    
+    request.method.assign(data, sp1);
+    const char* target = sp1 + 1;
+    const char* qmark = find(target, sp2, '?');
+    request.path = urlDecode(target, qmark);
+    if (qmark < sp2) {
+        parseQueryString(qmark + 1, sp2, request.query);
+    }
+    
+    bool http11 = sp2[8] == '1';
+    request.keep_alive = http11;
+    
+    // 请求头
+    size_t content_length = 0;
+    const char* p = line_end + 2;
+    while (p < header_end + 2) {
+        const char* eol = static_cast<const char*>(memmem(p, header_end + 2 - p, "\r\n", 2));
+        const char* colon = find(p, eol, ':');
+        if (colon == eol) {
+            return -1;
+        }
+        
+        const char* value = colon + 1;
+        while (value < eol && (*value == ' ' || *value == '\t')) value++;
+        const char* value_end = eol;
+        while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+        
+        request.headers.emplace_back(string(p, colon), string(value, value_end));
+        p = eol + 2;
+    }
+    
+    if (const string* conn = request.getHeader("Connection")) {
+        if (strcasecmp(conn->c_str(), "close") == 0) request.keep_alive = false;
+        else if (strcasecmp(conn->c_str(), "keep-alive") == 0) request.keep_alive = true;
+    }
+    if (request.getHeader("Transfer-Encoding")) {
+        return -1; // 不支持分块请求体
+    }
+    // 只接受十进制数字（strtoul会接受负号并回绕），超过上限时不再累加，避免计算total时溢出
+    if (const string* cl = request.getHeader("Content-Length")) {
+        if (cl->empty()) {
+            return -1;
+        }
+        for (char c : *cl) {
+            if (c < '0' || c > '9') {
+                return -1;
+            }
+            content_length = content_length * 10 + (c - '0');
+            if (content_length > limit) {
+                return -3;
+            }
+        }
+    }
+    
+    size_t total = (header_end + 4 - data) + content_length;
+    if (total > limit) {
+        return -3;
+    }
+    if (total > static_cast<size_t>(end - data)) {
+        return 0;
+    }
+    
+    request.body.assign(header_end + 4, content_length);
+    return static_cast<long>(total);
+}
+
+// 单个epoll事件循环
+class EventLoop {
+public:
+    using Handler = function<void(const HttpServer::Request&, Responder)>;
+    
+    struct Shared {
+        atomic<bool>& stopped;
+        atomic<uint64_t>& accepted;
+        atomic<uint64_t>& rejected;
+        atomic<uint64_t>& requests;
+        atomic<uint64_t>& bad_requests;
+        atomic<uint64_t>& active;
+        atomic<uint64_t>& buffers_exhausted;
+    };
+    
+    EventLoop(int listen_fd, const HttpServer::Options& options, size_t max_buffers,
+              atomic<uint64_t>& buffers_in_use, Shared shared, Handler handler)
+        : listen_fd_(listen_fd)
+        , options_(options)
+        , pool_(options.buffer_size, max_buffers, buffers_in_use)
+        , shared_(shared)
+        , handler_(move(handler))
+        , mailbox_(make_shared<LoopMailbox>()) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        mailbox_->wake_fd = wake_fd_;
+        
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLEXCLUSIVE;
+        ev.data.ptr = &listen_tag_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+        
+        ev.events = EPOLLIN;
+        ev.data.ptr = &wake_tag_;
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wake_fd_, &ev);
+    }
+    
+    ~EventLoop() {
+        vector<LoopMailbox::Completion> items;
+        {
+            lock_guard<mutex> lock(mailbox_->mutex_);
+            mailbox_->closed = true;
+            items.swap(mailbox_->items);
+        }
+        for (auto& item : items) {
+            if (item.stream) {
+                item.stream->detach();
+            }
+        }
+        while (!connections_.empty()) {
+            closeConnection(connections_.begin()->second.get());
+        }
+        close(wake_fd_);
+        close(epoll_fd_);
+    }
+    
+    void wakeup() {
+        uint64_t one = 1;
+        ssize_t ignored = write(wake_fd_, &one, sizeof(one));
+        (void)ignored;
+    }
+    
+    void run() {
+        epoll_event events[256];
+        int64_t last_sweep = time(nullptr);
+        
+        while (!shared_.stopped) {
+            int n = epoll_wait(epoll_fd_, events, 256, 1000);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                cerr << "epoll_wait失败: " << strerror(errno) << endl;
+                break;
+            }
+            
+            now_ = time(nullptr);
+            for (int i = 0; i < n; i++) {
+                void* tag = events[i].data.ptr;
+                if (tag == &listen_tag_) {
+                    acceptConnections();
+                } else if (tag == &wake_tag_) {
+                    uint64_t value;
+                    ssize_t ignored = read(wake_fd_, &value, sizeof(value));
+                    (void)ignored;
+                    drainMailbox();
+                } else {
+                    onConnectionEvent(static_cast<HttpConnection*>(tag), events[i].events);
+                }
+            }
+            
+            if (now_ - last_sweep >= 1) {
+                closeIdleConnections();
+                last_sweep = now_;
+            }
+        }
+    }
+
+private:
+    void acceptConnections() {
+        while (true) {
+            sockaddr_storage addr{};
+            socklen_t addr_len = sizeof(addr);
+            int fd = accept4(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &addr_len,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR) continue;
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    cerr << "accept失败: " << strerror(errno) << endl;
+                }
+                return;
+            }
+            
+            if (shared_.active >= options_.max_connections) {
+                close(fd);
+                shared_.rejected++;
+                continue;
+            }
+            
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            
+            auto conn = make_unique<HttpConnection>();
+            conn->id = next_connection_id_++;
+            conn->fd = fd;
+            conn->last_active = now_;
+            conn->remote_address = formatAddress(addr);
+            
+            epoll_event ev{};
+            ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.ptr = conn.get();
+            if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) < 0) {
+                close(fd);
+                continue;
+            }
+            
+            connections_.emplace(conn->id, move(conn));
+            shared_.accepted++;
+            shared_.active++;
+        }
+    }
+    
+    // 把工作线程完成的响应放回各自的连接
+    void drainMailbox() {
+        vector<LoopMailbox::Completion> items;
+        {
+            lock_guard<mutex> lock(mailbox_->mutex_);
+            items.swap(mailbox_->items);
+        }
+        
+        vector<uint64_t> touched;
+        for (auto& item : items) {
+            auto it = connections_.find(item.connection_id);
+            if (it == connections_.end()) {
+                if (item.stream) {
+                    item.stream->detach();
+                }
+                continue; // 连接已关闭
+            }
+            
+            HttpConnection* conn = it->second.get();
+            if (item.kind == LoopMailbox::Completion::RESPONSE) {
+                completeResponse(conn, item.seq, move(item.data), move(item.body), move(item.stream));
+            } else if (conn->stream) {
+                if (item.kind == LoopMailbox::Completion::STREAM_END) {
+                    conn->stream.reset();
+                    conn->close_after_write = true;
+                } else if (!item.data.empty()) {
+                    conn->out_bytes += item.data.size();
+                    conn->out.push_back(move(item.data));
+                    conn->last_active = now_;
+                }
+            }
+            touched.push_back(item.connection_id);
+        }
+        
+        for (uint64_t id : touched) {
+            auto it = connections_.find(id);
+            if (it != connections_.end()) {
+                service(it->second.get());
+            }
+        }
+    }
+    
+    // 填充响应槽，并把队首已就绪的响应移入发送队列
+    void completeResponse(HttpConnection* conn, uint64_t seq, string data,
+                          shared_ptr<const string> body = nullptr,
+                          shared_ptr<HttpServer::Stream> stream = nullptr) {
+        if (seq < conn->first_seq || seq - conn->first_seq >= conn->pending.size() ||
+            conn->pending[seq - conn->first_seq].ready) {
+            if (stream) {
+                stream->detach();
+            }
+            return; // 重复的结果，或流式响应之后被丢弃的请求
+        }
+        
+        PendingResponse& slot = conn->pending[seq - conn->first_seq];
+        slot.ready = true;
+        slot.data = move(data);
+        slot.body = move(body);
+        slot.stream = move(stream);
+        
+        while (!conn->pending.empty() && conn->pending.front().ready) {
+            PendingResponse& front = conn->pending.front();
+            conn->out_bytes += front.data.size();
+            conn->out.push_back(move(front.data));
+            if (front.body) {
+                conn->out_bytes += front.body->size();
+                conn->out.push_back(move(front.body));
+            }
+            
+            if (front.stream) {
+                // 连接转为推送模式，丢弃其后pipelining的请求
+                conn->stream = move(front.stream);
+                for (auto& later : conn->pending) {
+                    if (later.stream) {
+                        later.stream->detach();
+                    }
+                }
+                conn->pending.clear();
+                conn->first_seq = conn->next_seq;
+                
+                shared_ptr<LoopMailbox> mailbox = mailbox_;
+                uint64_t id = conn->id;
+                conn->stream->attach([mailbox, id](string chunk, bool end) {
+                    mailbox->post({id, 0, move(chunk),
+                                   end ? LoopMailbox::Completion::STREAM_END : LoopMailbox::Completion::STREAM_DATA,
+                                   nullptr, nullptr});
+                });
+                break;
+            }
+            
+            conn->pending.pop_front();
+            conn->first_seq++;
+        }
+        conn->last_active = now_;
+    }
+    
+    void onConnectionEvent(HttpConnection* conn, uint32_t events) {
+        if (events & EPOLLERR) {
+            closeConnection(conn);
+            return;
+        }
+        if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+            conn->want_read = true;
+        }
+        conn->last_active = now_;
+        service(conn);
+    }
+    
+    // 读取、分发、发送，直到没有进展或需要等待可写/处理结果
+    void service(HttpConnection* conn) {
+        while (true) {
+            if (conn->want_read && !conn->peer_closed && !readAvailable(conn)) {
+                closeConnection(conn);
+                return;
+            }
+            
+            bool progress = processBuffered(conn);
+            
+            if (!flushOutput(conn)) {
+                closeConnection(conn);
+                return;
+            }
+            
+            if (conn->stream && conn->peer_closed) {
+                closeConnection(conn);
+                return;
+            }
+            if (!conn->out.empty()) {
+                return; // 等待EPOLLOUT
+            }
+            if (conn->pending.empty() && !conn->stream &&
+                (conn->close_after_write || (conn->peer_closed && !progress))) {
+                closeConnection(conn);
+                return;
+            }
+            if (!progress && (!conn->want_read || conn->rlen == options_.buffer_size)) {
+                break;
+            }
+        }
+        
+        // 空闲的keep-alive连接不占用缓冲块
+        if (conn->rlen == 0 && conn->rbuf) {
+            pool_.release(conn->rbuf);
+            conn->rbuf = nullptr;
+        }
+    }
+    
+    // 读到EAGAIN、EOF或缓冲区满为止。返回false表示连接出错
+    bool readAvailable(HttpConnection* conn) {
+        if (!conn->rbuf) {
+            conn->rbuf = pool_.acquire();
+            if (!conn->rbuf) {
+                // 过载时每个事件都会走到这里，只计数，不在IO线程上同步写日志
+                shared_.buffers_exhausted.fetch_add(1, memory_order_relaxed);
+                return false;
+            }
+        }
+        
+        while (conn->rlen < options_.buffer_size) {
+            ssize_t n = recv(conn->fd, conn->rbuf + conn->rlen, options_.buffer_size - conn->rlen, 0);
+            if (n > 0) {
+                conn->rlen += n;
+            } else if (n == 0) {
+                conn->peer_closed = true;
+                conn->want_read = false;
+                return true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                conn->want_read = false;
+                return true;
+            } else {
+                return false;
+            }
+        }
+        
+        return true; // 缓冲区已满，内核中可能还有数据
+    }
+    
+    // 分发缓冲区中所有完整的请求（pipelining），返回是否处理了至少一个
+    bool processBuffered(HttpConnection* conn) {
+        size_t consumed = 0;
+        bool progress = false;
+        
+        while (!conn->close_after_write && !conn->stream && conn->out_bytes < options_.max_pending_output &&
+               conn->pending.size() < options_.max_pipelined && consumed < conn->rlen) {
+            HttpServer::Request request;
+            long used = parseHttpRequest(conn->rbuf + consumed, conn->rlen - consumed,
+                                         options_.buffer_size, request);
+            if (used == 0) {
+                break;
+            }
+            
+            progress = true;
+            request.remote_address = conn->remote_address;
+            uint64_t seq = conn->next_seq++;
+            conn->pending.emplace_back();
+            
+            if (used < 0) {
+                shared_.bad_requests++;
+                HttpServer::Response response;
+                response.status = used == -2 ? 431 : used == -3 ? 413 : 400;
+                response.body = "{\"success\":false}";
+                completeResponse(conn, seq, formatResponse(response, false, false));
+                conn->close_after_write = true;
+                consumed = conn->rlen;
+                break;
+            }
+            
+            consumed += used;
+            shared_.requests++;
+            if (!request.keep_alive) {
+                conn->close_after_write = true;
+            }
+            
+            shared_ptr<LoopMailbox> mailbox = mailbox_;
+            uint64_t id = conn->id;
+            bool keep_alive = request.keep_alive;
+            bool head = request.method == "HEAD";
+            Responder respond = [mailbox, id, seq, keep_alive, head](HttpServer::Response response) {
+                shared_ptr<HttpServer::Stream> stream = response.stream;
+                shared_ptr<const string> body = head ? nullptr : response.shared_body;
+                mailbox->post({id, seq, formatResponse(response, keep_alive, head),
+                               LoopMailbox::Completion::RESPONSE, move(stream), move(body)});
+            };
+            
+            try {
+                handler_(request, move(respond));
+            } catch (const exception& e) {
+                HttpServer::Response response;
+                response.status = 500;
+                response.body = "{\"success\":false}";
+                mailbox->post({id, seq, formatResponse(response, keep_alive, head),
+                               LoopMailbox::Completion::RESPONSE, nullptr, nullptr});
+                cerr << "分发HTTP请求时出错: " << e.what() << endl;
+            }
+        }
+        
+        if (consumed > 0) {
+            memmove(conn->rbuf, conn->rbuf + consumed, conn->rlen - consumed);
+            conn->rlen -= consumed;
+        }
+        
+        return progress;
+    }
+    
+    // 发送待发送数据，返回false表示连接出错
+    bool flushOutput(HttpConnection* conn) {
+        while (!conn->out.empty()) {
+            iovec iov[64];
+            int count = 0;
+            for (auto it = conn->out.begin(); it != conn->out.end() && count < 64; ++it, ++count) {
+                size_t offset = count == 0 ? conn->out_offset : 0;
+                iov[count].iov_base = const_cast<char*>(it->data() + offset);
+                iov[count].iov_len = it->size() - offset;
+            }
+            
+            msghdr msg{};
+            msg.msg_iov = iov;
+            msg.msg_iovlen = count;
+            ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            
+            size_t sent = static_cast<size_t>(n);
+            conn->out_bytes -= sent;
+            while (sent > 0) {
+                size_t remaining = conn->out.front().size() - conn->out_offset;
+                if (sent >= remaining) {
+                    sent -= remaining;
+                    conn->out.pop_front();
+                    conn->out_offset = 0;
+                } else {
+                    conn->out_offset += sent;
+                    sent = 0;
+                }
+            }
+        }
+        
+        return true;
+    }
+    
+    void closeIdleConnections() {
+        vector<HttpConnection*> idle;
+        vector<HttpConnection*> streaming;
+        for (auto& kv : connections_) {
+            HttpConnection* conn = kv.second.get();
+            if (conn->stream) {
+                // 推送连接不超时，但定期发送注释行以发现已断开的对端
+                if (now_ - conn->last_active >= STREAM_HEARTBEAT_SECONDS) {
+                    streaming.push_back(conn);
+                }
+            } else if (conn->pending.empty() && now_ - conn->last_active > options_.idle_timeout) {
+                idle.push_back(conn);
+            }
+        }
+        for (HttpConnection* conn : idle) {
+            closeConnection(conn);
+        }
+        for (HttpConnection* conn : streaming) {
+            conn->out_bytes += 3;
+            conn->out.emplace_back(":\n\n");
+            conn->last_active = now_;
+            service(conn);
+        }
+    }
+    
+    void closeConnection(HttpConnection* conn) {
+        if (conn->stream) {
+            conn->stream->detach();
+        }
+        for (auto& slot : conn->pending) {
+            if (slot.stream) {
+                slot.stream->detach();
+            }
+        }
+        
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, conn->fd, nullptr);
+        close(conn->fd);
+        if (conn->rbuf) {
+            pool_.release(conn->rbuf);
+        }
+        shared_.active--;
+        connections_.erase(conn->id);
+    }
+    
+    static constexpr int64_t STREAM_HEARTBEAT_SECONDS = 15;
+    
+    int listen_fd_;
+    int epoll_fd_ = -1;
+    int wake_fd_ = -1;
+    char listen_tag_ = 0;
+    char wake_tag_ = 0;
+    int64_t now_ = 0;
+    
+    HttpServer::Options options_;
+    BufferPool pool_;
+    Shared shared_;
+    Handler handler_;
+    shared_ptr<LoopMailbox> mailbox_;
+    uint64_t next_connection_id_ = 1;
+    unordered_map<uint64_t, unique_ptr<HttpConnection>> connections_;
+};
+
+void HttpServer::Impl::run() {
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0) {
+        cerr << "创建HTTP监听套接字失败: " << strerror(errno) << endl;
+        return;
+    }
+    
+    int one = 1;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    // 由内核在各进程的监听socket之间分配新连接
+    if (options_.reuse_port &&
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        cerr << "设置SO_REUSEPORT失败: " << strerror(errno) << endl;
+    }
+    
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(options_.port));
+    
+    if (bind(listen_fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        listen(listen_fd, SOMAXCONN) < 0) {
+        cerr << "HTTP服务器绑定端口 " << options_.port << " 失败: " << strerror(errno) << endl;
+        close(listen_fd);
+        return;
+    }
+    
+    int thread_count = max(1, options_.io_threads);
+    size_t buffers_per_loop = max<size_t>(1, options_.max_buffers / thread_count);
+    EventLoop::Shared shared{stopped_, connections_accepted_, connections_rejected_,
+                             requests_, bad_requests_, active_connections_, buffers_exhausted_};
+    
+    vector<unique_ptr<EventLoop>> loops;
+    {
+        lock_guard<mutex> lock(loops_mutex_);
+        if (stopped_) {
+            close(listen_fd);
+            return;
+        }
+        
+        for (int i = 0; i < thread_count; i++) {
+            loops.push_back(make_unique<EventLoop>(
+                listen_fd, options_, buffers_per_loop, buffers_in_use_, shared,
+                [this](const Request& request, Responder respond) { route(request, move(respond)); }));
+            EventLoop* loop = loops.back().get();
+            wakeups_.push_back([loop]() { loop->wakeup(); });
+        }
+    }
+    
+    cout << "HTTP服务器监听在端口 " << options_.port
+         << "（" << thread_count << " 个I/O线程）" << endl;
+    cout << "API端点:" << endl;
+    cout << "  GET /api/weather?city=北京" << endl;
+    cout << "  GET /api/forecast?city=北京&days=7&start=0&count=48" << endl;
+    cout << "  GET /api/forecast?city=北京&days=7&delta=1&base=<version>（增量编码）" << endl;
+    cout << "  GET /api/search?q=Bei" << endl;
+    cout << "  GET /api/batch?cities=北京,上海,London:GB（也支持POST JSON）" << endl;
+    cout << "  GET /api/subscribe?cities=北京,上海（Server-Sent Events）" << endl;
+    cout << "  GET /api/icon/sunny.svg" << endl;
+    cout << "  GET /api/icon/sunny.png?size=64&theme=night" << endl;
+    cout << "  GET /api/icon/rain.png?size=24&scale=2  (任意尺寸，scale为HiDPI倍率)" << endl;
+    cout << "  GET /api/icons/atlas.png?icons=sunny,rain@128,fog&size=32  (atlas.json/.bin为索引)" << endl;
+    cout << "  GET /api/stats  (请求计数和延迟分位数)" << endl;
+    cout << "  GET /metrics  (Prometheus格式的指标)" << endl;
+    cout << "  GET /api/trace?rate=0.01  (采样的请求追踪，Chrome trace JSON；rate可选，设置采样率)" << endl;
+    
+    vector<thread> threads;
+    for (int i = 1; i < thread_count; i++) {
+        threads.emplace_back([&loops, i]() { loops[i]->run(); });
+    }
+    loops[0]->run();
+    
+    for (auto& t : threads) {
+        t.join();
+    }
+    
+    {
+        lock_guard<mutex> lock(loops_mutex_);
+        wakeups_.clear();
+        loops.clear();
+    }
+    close(listen_fd);
+}
+
+void HttpServer::Impl::stop() {
+    lock_guard<mutex> lock(loops_mutex_);
+    stopped_ = true;
+    for (auto& wake : wakeups_) {
+        wake();
+    }
+}
+
+#else
+
+void HttpServer::Impl::run() {
+    cerr << "HTTP服务器目前只支持Linux (epoll)" << endl;
+}
+
+void HttpServer::Impl::stop() {
+    stopped_ = true;
+}
+
+#endif
+
+// HttpServer实现
+HttpServer::HttpServer(const Options& options,
+                       WeatherService* weather_service,
+                       IconRenderer* icon_renderer)
+    : impl_(make_unique<Impl>(options, weather_service, icon_renderer)) {
+}
+
+HttpServer::~HttpServer() {
+    Stop();
+}
+
+void HttpServer::Start() {
+    impl_->run();
+}
+
+void HttpServer::Stop() {
+    impl_->stop();
+}
+
+HttpServer::Statistics HttpServer::GetStatistics() const {
+    Statistics stats;
+    stats.connections_accepted = impl_->connections_accepted_;
+    stats.connections_rejected = impl_->connections_rejected_;
+    stats.requests = impl_->requests_;
+    stats.bad_requests = impl_->bad_requests_;
+    stats.active_connections = impl_->active_connections_;
+    stats.buffers_in_use = impl_->buffers_in_use_;
+    stats.buffers_exhausted = impl_->buffers_exhausted_;
+    return stats;
+}
@@ -1,419 +1,1016 @@
-#include "icon_renderer.h"
-#include <vector>
-#include <string>
-#include <cstring>
-#include <algorithm>
-#include <cmath>
-#include <memory>
-#include <stdexcept>
-
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <unistd.h>
-#endif
-
-using namespace std;
-
-// 简单的SVG解析和渲染实现
-class IconRenderer::IconRendererImpl {
-public:
-    IconRendererImpl() = default;
-    ~IconRendererImpl() = default;
-    
-    vector<uint8_t> renderToBitmap(const vector<string>& paths, 
-                                   int width, int height,
-                                   const ColorTheme& theme) {
-        vector<uint8_t> buffer(width * height * 4, 255); // RGBA格式，初始白色
-        
-        // 简化的渲染逻辑 - 实际项目中应该使用真正的SVG渲染库
-        // 这里我们绘制简单的几何形状
-        for (const auto& path : paths) {
-            if (path.find("circle") != string::npos) {
-                drawCircle(buffer, width, height, theme);
-            } else if (path.find("rect") != string::npos) {
-                drawRectangle(buffer, width, height, theme);
-            } else if (path.find("polygon") != string::npos) {
-                drawPolygon(buffer, width, height, theme);
-            }
-        }
-        
-        return buffer;
-    }
-    
-private:
-    void drawCircle(vector<uint8_t>& buffer, int width, int height, const ColorTheme& theme) {
-        int centerX = width / 2;
-        int centerY = height / 2;
-        int radius = min(width, height) / 3;
-        
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                int dx = x - centerX;
-                int dy = y - centerY;
-                if (dx * dx + dy * dy <= radius * radius) {
-                    int index = (y * width + x) * 4;
-                    buffer[index] = (theme.primary_color >> 16) & 0xFF;     // R
-                    buffer[index + 1] = (theme.primary_color >> 8) & 0xFF;  // G
-                    buffer[index + 2] = theme.primary_color & 0xFF;         // B
-                    buffer[index + 3] = 255;                                // A
-                }
-            }
-        }
-    }
-    
-    void drawRectangle(vector<uint8_t>& buffer, int width, int height, const ColorTheme& theme) {
-        int left = width / 4;
-        int top = height / 4;
-        int right = width * 3 / 4;
-        int bottom = height * 3 / 4;
-        
-        for (int y = top; y < bottom; y++) {
-            for (int x = left; x < right; x++) {
-                int index = (y * width + x) * 4;
-                buffer[index] = (theme.secondary_color >> 16) & 0xFF;
-                buffer[index + 1] = (theme.secondary_color >> 8) & 0xFF;
-                buffer[index + 2] = theme.secondary_color & 0xFF;
-                buffer[index + 3] = 255;
-            }
-        }
-    }
-    
-    void drawPolygon(vector<uint8_t>& buffer, int width, int height, const ColorTheme& theme) {
-        // 绘制三角形
-        vector<pair<int, int>> points = {
-            {width / 2, height / 4},
-            {width * 3 / 4, height * 3 / 4},
-            {width / 4, height * 3 / 4}
-        };
-        
-        for (int y = 0; y < height; y++) {
-            for (int x = 0; x < width; x++) {
-                if (isPointInTriangle(x, y, points[0], points[1], points[2])) {
-                    int index = (y * width + x) * 4;
-                    buffer[index] = (theme.accent_color >> 16) & 0xFF;
-                    buffer[index + 1] = (theme.accent_color >> 8) & 0xFF;
-                    buffer[index + 2] = theme.accent_color & 0xFF;
-                    buffer[index + 3] = 255;
-                }
-            }
-        }
-    }
-    
-    bool isPointInTriangle(int x, int y, 
-                          const pair<int, int>& p1,
-                          const pair<int, int>& p2,
-                          const pair<int, int>& p3) {
-        auto sign = [](const pair<int, int>& p1, const pair<int, int>& p2, const pair<int, int>& p3) {
-            return (p1.first - p3.first) * (p2.second - p3.second) - 
-                   (p2.first - p3.first) * (p1.second - p3.second);
-        };
-        
-        int d1 = sign({x, y}, p1, p2);
-        int d2 = sign({x, y}, p2, p3);
-        int d3 = sign({x, y}, p3, p1);
-        
-        bool has_neg = (d1 < 0) || (d2 < 0) || (d3 < 0);
-        bool has_pos = (d1 > 0) || (d2 > 0) || (d3 > 0);
-        
-        return !(has_neg && has_pos);
-    }
-};
-
-// 图标定义
-const vector<IconRenderer::IconDefinition> IconRenderer::icon_definitions_ = {
-    {
-        "sunny",
-        {"M50,20 A30,30 0 1,1 50,80 A30,30 0 1,1 50,20 Z"},
-        {{50, 20}, {80, 50}, {50, 80}, {20, 50}},
-        true,
-        true
-    },
-    {
-        "cloudy",
-        {
-            "M20,50 Q35,30 50,30 Q65,30 80,50",
-            "M20,50 C20,70 80,70 80,50"
-        },
-        {{20, 50}, {35, 30}, {65, 30}, {80, 50}},
-        true,
-        true
-    },
-    {
-        "rain",
-        {
-            "M20,50 C20,70 80,70 80,50",
-            "M35,70 L35,85",
-            "M50,70 L50,85",
-            "M65,70 L65,85"
-        },
-        {{20, 50}, {50, 30}, {80, 50}},
-        true,
-        true
-    },
-    {
-        "snow",
-        {
-            "M20,50 C20,70 80,70 80,50",
-            "M35,75 L45,85 M40,80 L40,90",
-            "M50,75 L60,85 M55,80 L55,90",
-            "M65,75 L75,85 M70,80 L70,90"
-        },
-        {{20, 50}, {50, 30}, {80, 50}},
-        true,
-        true
-    },
-    {
-        "thunderstorm",
-        {
-            "M20,50 C20,70 80,70 80,50",
-            "M40,65 L50,85 L45,80 L55,90"
-        },
-        {{20, 50}, {50, 30}, {80, 50}},
-        true,
-        true
-    },
-    {
-        "fog",
-        {
-            "M20,45 L80,45",
-            "M20,55 L80,55",
-            "M20,65 L80,65"
-        },
-        {{20, 45}, {80, 45}},
-        true,
-        false
-    },
-    {
-        "partly-cloudy-day",
-        {
-            "M30,30 A20,20 0 1,1 30,70 A20,20 0 1,1 30,30 Z",
-            "M50,40 C50,60 90,60 90,40"
-        },
-        {{30, 30}, {30, 70}, {50, 40}, {90, 40}},
-        true,
-        true
-    },
-    {
-        "partly-cloudy-night",
-        {
-            "M30,50 C30,35 45,25 60,30",
-            "M50,40 C50,60 90,60 90,40"
-        },
-        {{30, 50}, {45, 25}, {60, 30}, {50, 40}},
-        true,
-        true
-    },
-    {
-        "clear-night",
-        {
-            "M50,30 C30,40 40,70 50,70 C60,70 70,40 50,30 Z"
-        },
-        {{50, 30}, {30, 40}, {40, 70}, {60, 70}, {70, 40}},
-        true,
-        true
-    },
-    {
-        "unknown",
-        {
-            "M50,20 A30,30 0 1,1 50,80 A30,30 0 1,1 50,20 Z",
-            "M50,40 L50,55",
-            "M50,60 L50,65"
-        },
-        {{50, 20}, {80, 50}, {50, 80}, {20, 50}},
-        true,
-        true
-    }
-};
-
-// IconRenderer 公共方法实现
-IconRenderer::IconRenderer() 
-    : impl_(make_unique<IconRendererImpl>()) {
-}
-
-IconRenderer::~IconRenderer() = default;
-
-vector<uint8_t> IconRenderer::renderIcon(const string& icon_name, 
-                                        IconSize size,
-                                        const ColorTheme& theme) {
-    const IconDefinition* icon = findIconDefinition(icon_name);
-    if (!icon) {
-        icon = findIconDefinition("unknown");
-        if (!icon) {
-            throw runtime_error("找不到图标定义");
-        }
-    }
-    
-    int width = getIconWidth(size);
-    int height = getIconHeight(size);
-    
-    return impl_->renderToBitmap(icon->svg_paths, width, height, theme);
-}
-
-bool IconRenderer::renderIconToFile(const string& icon_name, 
-                                   const string& filename,
-                                   IconSize size,
-                                   const ColorTheme& theme) {
-    try {
-        auto buffer = renderIcon(icon_name, size, theme);
-        
-        // 简化的BMP文件写入
-        return writeBMPFile(filename, buffer, getIconWidth(size), getIconHeight(size));
-    } catch (const exception& e) {
-        cerr << "渲染图标到文件失败: " << e.what() << endl;
-        return false;
-    }
-}
-
-string IconRenderer::getSVGPathData(const string& icon_name) {
-    const IconDefinition* icon = findIconDefinition(icon_name);
-    if (!icon || icon->svg_paths.empty()) {
-        return "";
-    }
-    
-    // 合并所有路径
-    string result;
-    for (const auto& path : icon->svg_paths) {
-        if (!result.empty()) result += " ";
-        result += path;
-    }
-    
-    return result;
-}
-
-int IconRenderer::getIconWidth(IconSize size) {
-    return static_cast<int>(size);
-}
-
-int IconRenderer::getIconHeight(IconSize size) {
-    return static_cast<int>(size);
-}
-
-IconRenderer::ColorTheme IconRenderer::getDefaultTheme() {
-    return {0x2196F3, 0x03A9F4, 0xFFFFFF, 0x00BCD4}; // Material Design 颜色
-}
-
-IconRenderer::ColorTheme IconRenderer::getDayTheme() {
-    return {0xFF9800, 0xFFB74D, 0xFFFFFF, 0xFF9800}; // 橙色主题
-}
-
-IconRenderer::ColorTheme IconRenderer::getNightTheme() {
-    return {0x3F51B5, 0x5C6BC0, 0x212121, 0x7986CB}; // 深蓝色主题
-}
-
-IconRenderer::ColorTheme IconRenderer::getRainTheme() {
-    return {0x2196F3, 0x64B5F6, 0xFFFFFF, 0x1976D2}; // 蓝色主题
-}
-
-IconRenderer::ColorTheme IconRenderer::getSnowTheme() {
-    return {0xE0E0E0, 0xF5F5F5, 0xFFFFFF, 0x9E9E9E}; // 灰色主题
-}
-
-const IconRenderer::IconDefinition* IconRenderer::findIconDefinition(const string& name) const {
-    for (const auto& icon : icon_definitions_) {
-        if (icon.name == name) {
-            return &icon;
-        }
-    }
-    return nullptr;
-}
-
-vector<uint8_t> IconRenderer::renderToBitmap(const IconDefinition& icon, 
-                                            IconSize size,
-                                            const ColorTheme& theme) {
-    // 委托给实现类
-    return impl_->renderToBitmap(icon.svg_paths, 
-                                getIconWidth(size), 
-                                getIconHeight(size), 
-                                theme);
-}
-
-string IconRenderer::renderToSVG(const IconDefinition& icon,
-                                const ColorTheme& theme) {
-    stringstream svg;
-    svg << "<svg xmlns=\"http://www.w3.org/2000/svg\" "
-        << "width=\"100\" height=\"100\" viewBox=\"0 0 100 100\">\n";
-    
-    for (const auto& path : icon.svg_paths) {
-        svg << "  <path d=\"" << path << "\" ";
-        if (icon.has_fill) {
-            svg << "fill=\"#" << hex << setw(6) << setfill('0') 
-                << (theme.primary_color & 0xFFFFFF) << dec << "\" ";
-        } else {
-            svg << "fill=\"none\" ";
-        }
-        if (icon.has_stroke) {
-            svg << "stroke=\"#" << hex << setw(6) << setfill('0')
-                << (theme.secondary_color & 0xFFFFFF) << dec << "\" "
-                << "stroke-width=\"2\" ";
-        }
-        svg << "/>\n";
-    }
-    
-    svg << "</svg>";
-    return svg.str();
-}
-
-bool IconRenderer::writeBMPFile(const string& filename, 
-                               const vector<uint8_t>& buffer, 
-                               int width, int height) {
-#ifdef _WIN32
-    HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, NULL,
-                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
-    if (file == INVALID_HANDLE_VALUE) {
-        return false;
-    }
-    
-    // BMP文件头
-    BITMAPFILEHEADER fileHeader = {0};
-    BITMAPINFOHEADER infoHeader = {0};
-    
-    int rowSize = (width * 3 + 3) & ~3; // 每行字节数，4字节对齐
-    int imageSize = rowSize * height;
-    
-    fileHeader.bfType = 0x4D42; // "BM"
-    fileHeader.bfSize = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER) + imageSize;
-    fileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
-    
-    infoHeader.biSize = sizeof(BITMAPINFOHEADER);
-    infoHeader.biWidth = width;
-    infoHeader.biHeight = height;
-    infoHeader.biPlanes = 1;
-    infoHeader.biBitCount = 24; // RGB
-    infoHeader.biCompression = BI_RGB;
-    
-    DWORD bytesWritten;
-    WriteFile(file, &fileHeader, sizeof(fileHeader), &bytesWritten, NULL);
-    WriteFile(file, &infoHeader, sizeof(infoHeader), &bytesWritten, NULL);
-    
-    // 写入像素数据（BGR格式）
-    vector<uint8_t> bmpBuffer(imageSize, 0);
-    for (int y = 0; y < height; y++) {
-        for (int x = 0; x < width; x++) {
-            int srcIndex = ((height - 1 - y) * width + x) * 4; // BMP是倒着存储的
-            int dstIndex = y * rowSize + x * 3;
-            
-            bmpBuffer[dstIndex] = buffer[srcIndex + 2];     // B
-            bmpBuffer[dstIndex + 1] = buffer[srcIndex + 1]; // G
-            bmpBuffer[dstIndex + 2] = buffer[srcIndex];     // R
-        }
-    }
-    
-    WriteFile(file, bmpBuffer.data(), imageSize, &bytesWritten, NULL);
-    CloseHandle(file);
-    
-    return true;
-#else
-    // Linux/macOS 版本
-    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (fd < 0) {
-        return false;
-    }
- 
-    close(fd);
-    return true;
-#endif
-}
\ No newline at end of file
+#include "icon_renderer.h"
+#include "path_rasterizer.h"
+#include "image_encoder.h"
+#include "image_resampler.h"
+#include "json_writer.h"
+#include "executor.h"
+#include "trace.h"
+#include <vector>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <list>
+#include <unordered_map>
+#include <stdexcept>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// 图标路径坐标所在的viewBox边长，以及描边宽度（与renderToSVG一致）
+static constexpr float ICON_VIEWBOX_SIZE = 100.0f;
+static constexpr float ICON_STROKE_WIDTH = 2.0f;
+// 曲线展平容差（viewBox单位），XLARGE下约0.06像素
+static constexpr float ICON_FLATTEN_TOLERANCE = 0.05f;
+
+// 按SVG语义光栅化：每条路径先填充primary_color，再描边secondary_color。
+// 图标定义是静态数据，构造时一次性解析并展平所有路径，渲染时只做扫描线填充。
+// 渲染结果按(图标, 尺寸, 格式, 主题)缓存，SVG的尺寸记为0
+class IconRenderer::IconRendererImpl {
+public:
+    IconRendererImpl(const IconDefinition* icons, size_t count) {
+        geometry_.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            const IconDefinition& icon = icons[i];
+            vector<PathGeometry> paths;
+            for (size_t p = 0; p < icon.pathCount(); p++) {
+                vector<PathContour> contours = parseSvgPath(string(icon.svg_paths[p]), ICON_FLATTEN_TOLERANCE);
+                PathGeometry path;
+                if (icon.has_fill) {
+                    appendFillEdges(contours, path.fill);
+                }
+                if (icon.has_stroke) {
+                    appendStrokeEdges(contours, ICON_STROKE_WIDTH, path.stroke);
+                }
+                paths.push_back(move(path));
+            }
+            geometry_.push_back(move(paths));
+        }
+    }
+    
+    ~IconRendererImpl() = default;
+    
+    // icon_index即IconId的值。结果为预乘alpha的RGBA
+    vector<uint8_t> rasterize(size_t icon_index, int width, int height, const ColorTheme& theme) {
+        vector<uint8_t> buffer(static_cast<size_t>(width) * height * 4, 0); // 初始透明
+        
+        PathRasterizer rasterizer(buffer.data(), width, height);
+        float scale = width / ICON_VIEWBOX_SIZE;
+        for (const auto& path : geometry_[icon_index]) {
+            rasterizer.fill(path.fill, scale, theme.primary_color);
+            rasterizer.fill(path.stroke, scale, theme.secondary_color);
+        }
+        return buffer;
+    }
+    
+    // 常用尺寸和大于主光栅的尺寸直接光栅化，其他尺寸从主光栅缩小：
+    // 取不小于目标尺寸的最小一级，缩小比例在1~2倍之间，每个方向最多4个抽头
+    vector<uint8_t> renderToBitmap(size_t icon_index, 
+                                   int width, int height,
+                                   const ColorTheme& theme) {
+        StageTimer timer(*this, STAGE_BITMAP);
+        vector<uint8_t> buffer;
+        if (isStandardSize(width) || width >= MASTER_RASTER_SIZE) {
+            buffer = rasterize(icon_index, width, height, theme);
+        } else {
+            auto master = masterRaster(icon_index, theme);
+            size_t level = 0;
+            while (level + 1 < master->size() && (MASTER_RASTER_SIZE >> (level + 1)) >= width) {
+                level++;
+            }
+            int edge = MASTER_RASTER_SIZE >> level;
+            buffer.resize(static_cast<size_t>(width) * height * 4);
+            resampleRGBA((*master)[level].data(), edge, edge, buffer.data(), width, height, RESAMPLE_BOX);
+        }
+        
+        unpremultiplyRGBA(buffer.data(), static_cast<size_t>(width) * height, theme.background_color);
+        return buffer;
+    }
+    
+    // 主光栅及其逐级减半的各级（面积平均，预乘alpha），最小一级不小于MIN_ICON_SIZE。
+    // 各级总共只比主光栅多1/3的内存，生成时只做一次矢量光栅化。
+    // 光栅化在锁外进行，并发生成同一张主光栅时保留先插入的结果
+    using MasterLevels = vector<vector<uint8_t>>;
+    
+    shared_ptr<const MasterLevels> masterRaster(size_t icon_index, const ColorTheme& theme) {
+        CacheKey key{icon_index, MASTER_RASTER_SIZE, FORMAT_RGBA, theme};
+        {
+            lock_guard<mutex> lock(cache_mutex_);
+            auto it = masters_.find(key);
+            if (it != masters_.end()) {
+                return it->second;
+            }
+        }
+        
+        Trace::Span span("icon.master");
+        auto levels = make_shared<MasterLevels>();
+        levels->push_back(rasterize(icon_index, MASTER_RASTER_SIZE, MASTER_RASTER_SIZE, theme));
+        for (int edge = MASTER_RASTER_SIZE / 2; edge >= MIN_ICON_SIZE; edge /= 2) {
+            vector<uint8_t> half(static_cast<size_t>(edge) * edge * 4);
+            resampleRGBA(levels->back().data(), edge * 2, edge * 2, half.data(), edge, edge, RESAMPLE_BOX);
+            levels->push_back(move(half));
+        }
+        shared_ptr<const MasterLevels> master = move(levels);
+        
+        lock_guard<mutex> lock(cache_mutex_);
+        if (masters_.size() >= MAX_CACHED_MASTERS) {
+            return master;
+        }
+        auto result = masters_.emplace(key, master).first->second;
+        master_count_.store(masters_.size(), memory_order_relaxed);
+        return result;
+    }
+    
+    // count_miss为false时未命中不计数：调用方随后会走getIcon*渲染，由那里计一次
+    shared_ptr<const string> findCached(size_t icon_index, int size, ImageFormat format,
+                                        const ColorTheme& theme, bool count_miss = true) {
+        lock_guard<mutex> lock(cache_mutex_);
+        auto it = cache_.find(CacheKey{icon_index, size, format, theme});
+        if (it == cache_.end()) {
+            if (count_miss) {
+                cache_misses_.fetch_add(1, memory_order_relaxed);
+            }
+            return nullptr;
+        }
+        cache_hits_.fetch_add(1, memory_order_relaxed);
+        lru_.splice(lru_.begin(), lru_, it->second.lru);
+        return it->second.content;
+    }
+    
+    // 渲染在锁外进行，并发渲染同一项时保留先插入的结果。
+    // 总大小超过MAX_CACHED_BYTES时从最久未使用的一端淘汰，已取走的结果由调用方的shared_ptr保持有效
+    shared_ptr<const string> storeCached(size_t icon_index, int size, ImageFormat format,
+                                         const ColorTheme& theme, string content) {
+        auto rendered = make_shared<const string>(move(content));
+        CacheKey key{icon_index, size, format, theme};
+        
+        lock_guard<mutex> lock(cache_mutex_);
+        auto result = cache_.emplace(key, CacheEntry{rendered, lru_.end()});
+        if (!result.second) {
+            return result.first->second.content;
+        }
+        lru_.push_front(key);
+        result.first->second.lru = lru_.begin();
+        
+        size_t bytes = cache_bytes_.load(memory_order_relaxed) + rendered->size();
+        while (bytes > MAX_CACHED_BYTES && lru_.size() > 1) {
+            auto victim = cache_.find(lru_.back());
+            bytes -= victim->second.content->size();
+            cache_.erase(victim);
+            lru_.pop_back();
+            cache_evictions_.fetch_add(1, memory_order_relaxed);
+        }
+        cache_bytes_.store(bytes, memory_order_relaxed);
+        entry_count_.store(cache_.size(), memory_order_relaxed);
+        return rendered;
+    }
+    
+    shared_ptr<const IconAtlas> findAtlas(const string& key) {
+        lock_guard<mutex> lock(cache_mutex_);
+        auto it = atlases_.find(key);
+        if (it == atlases_.end()) {
+            return nullptr;
+        }
+        atlas_lru_.splice(atlas_lru_.begin(), atlas_lru_, it->second.lru);
+        return it->second.atlas;
+    }
+    
+    // 与storeCached相同，超出MAX_CACHED_ATLAS_BYTES或MAX_CACHED_ATLASES时从最久未使用的一端淘汰
+    shared_ptr<const IconAtlas> storeAtlas(const string& key, shared_ptr<const IconAtlas> atlas) {
+        size_t size = atlas->image->size() + atlas->json_index->size() + atlas->binary_index->size();
+        if (size > MAX_CACHED_ATLAS_BYTES) {
+            return atlas;
+        }
+        
+        lock_guard<mutex> lock(cache_mutex_);
+        auto result = atlases_.emplace(key, AtlasEntry{atlas, size, atlas_lru_.end()});
+        if (!result.second) {
+            return result.first->second.atlas;
+        }
+        atlas_lru_.push_front(key);
+        result.first->second.lru = atlas_lru_.begin();
+        
+        size_t bytes = atlas_bytes_.load(memory_order_relaxed) + size;
+        while ((bytes > MAX_CACHED_ATLAS_BYTES || atlases_.size() > MAX_CACHED_ATLASES) &&
+               atlas_lru_.size() > 1) {
+            auto victim = atlases_.find(atlas_lru_.back());
+            bytes -= victim->second.bytes;
+            atlases_.erase(victim);
+            atlas_lru_.pop_back();
+            cache_evictions_.fetch_add(1, memory_order_relaxed);
+        }
+        atlas_bytes_.store(bytes, memory_order_relaxed);
+        atlas_count_.store(atlases_.size(), memory_order_relaxed);
+        return atlas;
+    }
+    
+    // 缓存的大小在持有锁时更新到原子变量，统计不需要加锁
+    CacheStatistics getCacheStatistics() const {
+        return {cache_hits_.load(memory_order_relaxed), cache_misses_.load(memory_order_relaxed),
+                cache_evictions_.load(memory_order_relaxed), entry_count_.load(memory_order_relaxed),
+                cache_bytes_.load(memory_order_relaxed), atlas_count_.load(memory_order_relaxed),
+                atlas_bytes_.load(memory_order_relaxed), master_count_.load(memory_order_relaxed)};
+    }
+    
+    // 析构时把所在作用域的耗时计入对应阶段
+    class StageTimer {
+    public:
+        StageTimer(IconRendererImpl& impl, RenderStage stage)
+            : impl_(impl)
+            , stage_(stage)
+            , start_(chrono::steady_clock::now())
+            , span_(STAGE_TRACE_NAMES[stage]) {
+        }
+        
+        ~StageTimer() {
+            auto elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start_);
+            impl_.render_latency_[stage_].record(static_cast<uint64_t>(elapsed.count()));
+        }
+        
+        StageTimer(const StageTimer&) = delete;
+        StageTimer& operator=(const StageTimer&) = delete;
+    
+    private:
+        static constexpr const char* STAGE_TRACE_NAMES[RENDER_STAGE_COUNT] = {
+            "icon.bitmap", "icon.encode", "icon.atlas"
+        };
+        
+        IconRendererImpl& impl_;
+        RenderStage stage_;
+        chrono::steady_clock::time_point start_;
+        Trace::Span span_;
+    };
+    
+    RenderStatistics getRenderStatistics() const {
+        RenderStatistics stats;
+        for (int stage = 0; stage < RENDER_STAGE_COUNT; stage++) {
+            render_latency_[stage].addTo(stats.latency[stage]);
+        }
+        return stats;
+    }
+
+private:
+    struct PathGeometry {
+        vector<PathEdge> fill;
+        vector<PathEdge> stroke;
+    };
+    
+    struct CacheKey {
+        size_t icon_index;
+        int size;
+        ImageFormat format;
+        ColorTheme theme;
+        
+        bool operator==(const CacheKey& other) const {
+            return icon_index == other.icon_index && size == other.size &&
+                   format == other.format && theme == other.theme;
+        }
+    };
+    
+    struct CacheKeyHash {
+        size_t operator()(const CacheKey& key) const {
+            uint64_t h = key.icon_index * 0x9E3779B97F4A7C15ULL ^
+                         static_cast<uint64_t>(key.size) ^ static_cast<uint64_t>(key.format) << 16;
+            for (uint32_t color : {key.theme.primary_color, key.theme.secondary_color,
+                                   key.theme.background_color, key.theme.accent_color}) {
+                h = (h ^ color) * 0x100000001B3ULL;
+            }
+            return static_cast<size_t>(h ^ (h >> 32));
+        }
+    };
+    
+    vector<vector<PathGeometry>> geometry_;
+    
+    struct CacheEntry {
+        shared_ptr<const string> content;
+        list<CacheKey>::iterator lru;
+    };
+    
+    mutex cache_mutex_;
+    unordered_map<CacheKey, CacheEntry, CacheKeyHash> cache_;
+    list<CacheKey> lru_;    // 最近使用的在前
+    struct AtlasEntry {
+        shared_ptr<const IconAtlas> atlas;
+        size_t bytes;
+        list<string>::iterator lru;
+    };
+    
+    unordered_map<string, AtlasEntry> atlases_;
+    list<string> atlas_lru_;
+    unordered_map<CacheKey, shared_ptr<const MasterLevels>, CacheKeyHash> masters_;
+    atomic<uint64_t> cache_hits_{0};
+    atomic<uint64_t> cache_misses_{0};
+    atomic<uint64_t> cache_evictions_{0};
+    atomic<size_t> cache_bytes_{0};
+    atomic<size_t> entry_count_{0};
+    atomic<size_t> atlas_count_{0};
+    atomic<size_t> atlas_bytes_{0};
+    atomic<size_t> master_count_{0};
+    AtomicLatencyHistogram render_latency_[RENDER_STAGE_COUNT];
+};
+
+// 图标定义
+constexpr IconRenderer::IconDefinition IconRenderer::icon_definitions_[ICON_COUNT] = {
+    {
+        IconId::SUNNY,
+        {"M50,20 A30,30 0 1,1 50,80 A30,30 0 1,1 50,20 Z"},
+        {{50, 20}, {80, 50}, {50, 80}, {20, 50}},
+        true,
+        true
+    },
+    {
+        IconId::CLOUDY,
+        {
+            "M20,50 Q35,30 50,30 Q65,30 80,50",
+            "M20,50 C20,70 80,70 80,50"
+        },
+        {{20, 50}, {35, 30}, {65, 30}, {80, 50}},
+        true,
+        true
+    },
+    {
+        IconId::RAIN,
+        {
+            "M20,50 C20,70 80,70 80,50",
+            "M35,70 L35,85",
+            "M50,70 L50,85",
+            "M65,70 L65,85"
+        },
+        {{20, 50}, {50, 30}, {80, 50}},
+        true,
+        true
+    },
+    {
+        IconId::SNOW,
+        {
+            "M20,50 C20,70 80,70 80,50",
+            "M35,75 L45,85 M40,80 L40,90",
+            "M50,75 L60,85 M55,80 L55,90",
+            "M65,75 L75,85 M70,80 L70,90"
+        },
+        {{20, 50}, {50, 30}, {80, 50}},
+        true,
+        true
+    },
+    {
+        IconId::THUNDERSTORM,
+        {
+            "M20,50 C20,70 80,70 80,50",
+            "M40,65 L50,85 L45,80 L55,90"
+        },
+        {{20, 50}, {50, 30}, {80, 50}},
+        true,
+        true
+    },
+    {
+        IconId::FOG,
+        {
+            "M20,45 L80,45",
+            "M20,55 L80,55",
+            "M20,65 L80,65"
+        },
+        {{20, 45}, {80, 45}},
+        false,
+        true
+    },
+    {
+        IconId::PARTLY_CLOUDY_DAY,
+        {
+            "M30,30 A20,20 0 1,1 30,70 A20,20 0 1,1 30,30 Z",
+            "M50,40 C50,60 90,60 90,40"
+        },
+        {{30, 30}, {30, 70}, {50, 40}, {90, 40}},
+        true,
+        true
+    },
+    {
+        IconId::PARTLY_CLOUDY_NIGHT,
+        {
+            "M30,50 C30,35 45,25 60,30",
+            "M50,40 C50,60 90,60 90,40"
+        },
+        {{30, 50}, {45, 25}, {60, 30}, {50, 40}},
+        true,
+        true
+    },
+    {
+        IconId::CLEAR_NIGHT,
+        {
+            "M50,30 C30,40 40,70 50,70 C60,70 70,40 50,30 Z"
+        },
+        {{50, 30}, {30, 40}, {40, 70}, {60, 70}, {70, 40}},
+        true,
+        true
+    },
+    {
+        IconId::UNKNOWN,
+        {
+            "M50,20 A30,30 0 1,1 50,80 A30,30 0 1,1 50,20 Z",
+            "M50,40 L50,55",
+            "M50,60 L50,65"
+        },
+        {{50, 20}, {80, 50}, {50, 80}, {20, 50}},
+        true,
+        true
+    }
+};
+
+// IconRenderer 公共方法实现
+IconRenderer::IconRenderer() 
+    : impl_(make_unique<IconRendererImpl>(icon_definitions_, ICON_COUNT)) {
+    static_assert([] {
+        for (size_t i = 0; i < ICON_COUNT; i++) {
+            if (static_cast<size_t>(icon_definitions_[i].id) != i) {
+                return false;
+            }
+        }
+        return true;
+    }(), "图标定义必须按IconId顺序排列");
+}
+
+IconRenderer::~IconRenderer() = default;
+
+vector<uint8_t> IconRenderer::renderIcon(const string& icon_name, 
+                                        int size,
+                                        const ColorTheme& theme) {
+    auto bitmap = getIconBitmap(icon_name, size, theme);
+    return vector<uint8_t>(bitmap->begin(), bitmap->end());
+}
+
+bool IconRenderer::renderIconToFile(const string& icon_name, 
+                                   const string& filename,
+                                   int size,
+                                   const ColorTheme& theme) {
+    try {
+        auto bitmap = getIconBitmap(icon_name, size, theme);
+        bool qoi = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".qoi") == 0;
+        return writeImageFile(filename, *bitmap, getIconWidth(size), getIconHeight(size),
+                              qoi ? FORMAT_QOI : FORMAT_PNG);
+    } catch (const exception& e) {
+        cerr << "渲染图标到文件失败: " << e.what() << endl;
+        return false;
+    }
+}
+
+string IconRenderer::renderIconSVG(const string& icon_name, const ColorTheme& theme) {
+    return *getIconSVG(icon_name, theme);
+}
+
+shared_ptr<const string> IconRenderer::getIconBitmap(const string& icon_name,
+                                                     int size,
+                                                     const ColorTheme& theme) {
+    return getIconBitmap(resolveIcon(icon_name).id, size, theme);
+}
+
+shared_ptr<const string> IconRenderer::getIconSVG(const string& icon_name, const ColorTheme& theme) {
+    return getIconSVG(resolveIcon(icon_name).id, theme);
+}
+
+static void checkIconSize(int size) {
+    if (size < IconRenderer::MIN_ICON_SIZE || size > IconRenderer::MAX_ICON_SIZE) {
+        throw invalid_argument("图标尺寸必须在" + to_string(IconRenderer::MIN_ICON_SIZE) + "到" +
+                               to_string(IconRenderer::MAX_ICON_SIZE) + "像素之间");
+    }
+}
+
+shared_ptr<const string> IconRenderer::getIconBitmap(IconId id, int size, const ColorTheme& theme) {
+    checkIconSize(size);
+    const IconDefinition& icon = resolveIcon(id);
+    size_t index = static_cast<size_t>(icon.id);
+    if (auto cached = impl_->findCached(index, size, FORMAT_RGBA, theme)) {
+        return cached;
+    }
+    
+    vector<uint8_t> pixels = renderToBitmap(icon, size, theme);
+    return impl_->storeCached(index, size, FORMAT_RGBA, theme, string(pixels.begin(), pixels.end()));
+}
+
+shared_ptr<const string> IconRenderer::getIconImage(const string& icon_name,
+                                                    int size,
+                                                    ImageFormat format,
+                                                    const ColorTheme& theme) {
+    return getIconImage(resolveIcon(icon_name).id, size, format, theme);
+}
+
+shared_ptr<const string> IconRenderer::getIconImage(IconId id,
+                                                    int size,
+                                                    ImageFormat format,
+                                                    const ColorTheme& theme) {
+    if (format == FORMAT_RGBA) {
+        return getIconBitmap(id, size, theme);
+    }
+    
+    checkIconSize(size);
+    const IconDefinition& icon = resolveIcon(id);
+    size_t index = static_cast<size_t>(icon.id);
+    if (auto cached = impl_->findCached(index, size, format, theme)) {
+        return cached;
+    }
+    
+    // 非常用尺寸的中间位图用完即弃，不和编码结果一起占用缓存
+    shared_ptr<const string> bitmap;
+    if (isStandardSize(size)) {
+        bitmap = getIconBitmap(id, size, theme);
+    } else if (!(bitmap = impl_->findCached(index, size, FORMAT_RGBA, theme, false))) {
+        vector<uint8_t> pixels = renderToBitmap(icon, size, theme);
+        bitmap = make_shared<const string>(pixels.begin(), pixels.end());
+    }
+    const uint8_t* rgba = reinterpret_cast<const uint8_t*>(bitmap->data());
+    string encoded;
+    bool ok;
+    {
+        IconRendererImpl::StageTimer timer(*impl_, STAGE_ENCODE);
+        ImageOutput out(encoded);
+        ok = format == FORMAT_PNG ?
+            encodePNG(rgba, getIconWidth(size), getIconHeight(size), out) :
+            encodeQOI(rgba, getIconWidth(size), getIconHeight(size), out);
+    }
+    if (!ok) {
+        throw runtime_error("图标编码失败");
+    }
+    return impl_->storeCached(index, size, format, theme, move(encoded));
+}
+
+shared_ptr<const string> IconRenderer::findCachedIcon(const string& icon_name,
+                                                      int size,
+                                                      ImageFormat format,
+                                                      const ColorTheme& theme) const {
+    size_t index = static_cast<size_t>(resolveIcon(icon_name).id);
+    return impl_->findCached(index, size, format, theme, false);
+}
+
+shared_ptr<const string> IconRenderer::getIconSVG(IconId id, const ColorTheme& theme) {
+    const IconDefinition& icon = resolveIcon(id);
+    size_t index = static_cast<size_t>(icon.id);
+    if (auto cached = impl_->findCached(index, 0, FORMAT_RGBA, theme)) {
+        return cached;
+    }
+    
+    return impl_->storeCached(index, 0, FORMAT_RGBA, theme, renderToSVG(icon, theme));
+}
+
+// 位图先经renderBatch并行光栅化，编码时只查缓存
+void IconRenderer::prewarmCache() {
+    static const IconSize sizes[] = {SMALL, MEDIUM, LARGE, XLARGE};
+    vector<IconRequest> requests;
+    for (const auto& theme : getBuiltinThemes()) {
+        for (const auto& icon : icon_definitions_) {
+            for (IconSize size : sizes) {
+                requests.push_back({icon.id, size, theme});
+            }
+        }
+    }
+    renderBatch(requests);
+    
+    for (const auto& theme : getBuiltinThemes()) {
+        for (const auto& icon : icon_definitions_) {
+            for (IconSize size : sizes) {
+                getIconImage(icon.id, size, FORMAT_PNG, theme);
+                getIconImage(icon.id, size, FORMAT_QOI, theme);
+            }
+            getIconSVG(icon.id, theme);
+        }
+    }
+}
+
+void IconRenderer::setExecutor(WorkStealingExecutor* executor) {
+    executor_ = executor;
+}
+
+vector<shared_ptr<const string>> IconRenderer::renderBatch(const vector<IconRequest>& requests) {
+    vector<shared_ptr<const string>> results(requests.size());
+    
+    // 未缓存的请求去重后再渲染，同一批里重复的图标只光栅化一次
+    vector<size_t> misses;
+    vector<size_t> owner(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        const IconRequest& request = requests[i];
+        size_t index = static_cast<size_t>(resolveIcon(request.icon).id);
+        results[i] = impl_->findCached(index, request.size, FORMAT_RGBA, request.theme);
+        if (results[i]) {
+            continue;
+        }
+        
+        auto same = find_if(misses.begin(), misses.end(),
+                            [&](size_t m) { return requests[m] == request; });
+        owner[i] = same != misses.end() ? *same : i;
+        if (same == misses.end()) {
+            misses.push_back(i);
+        }
+    }
+    
+    if (executor_ && misses.size() > 1) {
+        // 调用方可能本身就在工作线程中，等待时帮忙执行排队的任务
+        vector<future<shared_ptr<const string>>> pending;
+        pending.reserve(misses.size());
+        for (size_t m : misses) {
+            const IconRequest& request = requests[m];
+            pending.push_back(executor_->async([this, request]() {
+                return getIconBitmap(request.icon, request.size, request.theme);
+            }));
+        }
+        for (size_t k = 0; k < misses.size(); k++) {
+            results[misses[k]] = executor_->awaitHelping(pending[k]);
+        }
+    } else {
+        for (size_t m : misses) {
+            results[m] = getIconBitmap(requests[m].icon, requests[m].size, requests[m].theme);
+        }
+    }
+    
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (!results[i]) {
+            results[i] = results[owner[i]];
+        }
+    }
+    return results;
+}
+
+shared_ptr<const IconRenderer::IconAtlas> IconRenderer::getIconAtlas(const vector<IconRequest>& requests,
+                                                                     ImageFormat format) {
+    if (requests.empty() || requests.size() > MAX_ATLAS_ICONS) {
+        throw invalid_argument("图集的图标数量必须在1到" + to_string(MAX_ATLAS_ICONS) + "之间");
+    }
+    
+    // 装箱后的边长不会超过面积的平方根太多，这里按面积粗略限制
+    size_t area = 0;
+    for (const auto& request : requests) {
+        if (request.size < MIN_ICON_SIZE || request.size > MAX_ICON_SIZE) {
+            throw invalid_argument("图标尺寸必须在" + to_string(MIN_ICON_SIZE) + "到" +
+                                   to_string(MAX_ICON_SIZE) + "像素之间");
+        }
+        size_t px = static_cast<size_t>(request.size + ATLAS_PADDING);
+        area += px * px;
+    }
+    if (area > static_cast<size_t>(MAX_ATLAS_SIZE) * MAX_ATLAS_SIZE) {
+        throw invalid_argument("图集超过" + to_string(MAX_ATLAS_SIZE) + "x" + to_string(MAX_ATLAS_SIZE));
+    }
+    
+    string key = atlasCacheKey(requests, format);
+    if (auto cached = impl_->findAtlas(key)) {
+        return cached;
+    }
+    return impl_->storeAtlas(key, buildAtlas(requests, format));
+}
+
+shared_ptr<const IconRenderer::IconAtlas> IconRenderer::findCachedAtlas(const vector<IconRequest>& requests,
+                                                                        ImageFormat format) const {
+    if (requests.empty() || requests.size() > MAX_ATLAS_ICONS) {
+        return nullptr;
+    }
+    return impl_->findAtlas(atlasCacheKey(requests, format));
+}
+
+IconRenderer::CacheStatistics IconRenderer::getCacheStatistics() const {
+    return impl_->getCacheStatistics();
+}
+
+IconRenderer::RenderStatistics IconRenderer::getRenderStatistics() const {
+    return impl_->getRenderStatistics();
+}
+
+string IconRenderer::getSVGPathData(const string& icon_name) {
+    const IconDefinition* icon = findIconDefinition(icon_name);
+    if (!icon || icon->pathCount() == 0) {
+        return "";
+    }
+    
+    // 合并所有路径
+    string result;
+    for (size_t i = 0; i < icon->pathCount(); i++) {
+        if (!result.empty()) result += " ";
+        result += icon->svg_paths[i];
+    }
+    
+    return result;
+}
+
+int IconRenderer::getIconWidth(int size) {
+    return static_cast<int>(size);
+}
+
+int IconRenderer::getIconHeight(int size) {
+    return static_cast<int>(size);
+}
+
+bool IconRenderer::isStandardSize(int size) {
+    return size == SMALL || size == MEDIUM || size == LARGE || size == XLARGE;
+}
+
+IconRenderer::ColorTheme IconRenderer::getDefaultTheme() {
+    return {0x2196F3, 0x03A9F4, 0xFFFFFF, 0x00BCD4}; // Material Design 颜色
+}
+
+IconRenderer::ColorTheme IconRenderer::getDayTheme() {
+    return {0xFF9800, 0xFFB74D, 0xFFFFFF, 0xFF9800}; // 橙色主题
+}
+
+IconRenderer::ColorTheme IconRenderer::getNightTheme() {
+    return {0x3F51B5, 0x5C6BC0, 0x212121, 0x7986CB}; // 深蓝色主题
+}
+
+IconRenderer::ColorTheme IconRenderer::getRainTheme() {
+    return {0x2196F3, 0x64B5F6, 0xFFFFFF, 0x1976D2}; // 蓝色主题
+}
+
+IconRenderer::ColorTheme IconRenderer::getSnowTheme() {
+    return {0xE0E0E0, 0xF5F5F5, 0xFFFFFF, 0x9E9E9E}; // 灰色主题
+}
+
+vector<IconRenderer::ColorTheme> IconRenderer::getBuiltinThemes() {
+    return {getDefaultTheme(), getDayTheme(), getNightTheme(), getRainTheme(), getSnowTheme()};
+}
+
+const IconRenderer::IconDefinition* IconRenderer::findIconDefinition(const string& name) const {
+    IconId id;
+    if (!findIconId(name, id)) {
+        return nullptr;
+    }
+    return &icon_definitions_[static_cast<size_t>(id)];
+}
+
+// 未知图标名使用"unknown"图标
+const IconRenderer::IconDefinition& IconRenderer::resolveIcon(const string& name) const {
+    const IconDefinition* icon = findIconDefinition(name);
+    return icon ? *icon : resolveIcon(IconId::UNKNOWN);
+}
+
+const IconRenderer::IconDefinition& IconRenderer::resolveIcon(IconId id) const {
+    size_t index = static_cast<size_t>(id);
+    return icon_definitions_[index < ICON_COUNT ? index : static_cast<size_t>(IconId::UNKNOWN)];
+}
+
+vector<uint8_t> IconRenderer::renderToBitmap(const IconDefinition& icon, 
+                                            int size,
+                                            const ColorTheme& theme) {
+    // 委托给实现类
+    return impl_->renderToBitmap(static_cast<size_t>(icon.id),
+                                getIconWidth(size), 
+                                getIconHeight(size), 
+                                theme);
+}
+
+string IconRenderer::renderToSVG(const IconDefinition& icon,
+                                const ColorTheme& theme) {
+    stringstream svg;
+    svg << "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+        << "width=\"100\" height=\"100\" viewBox=\"0 0 100 100\">\n";
+    
+    for (size_t i = 0; i < icon.pathCount(); i++) {
+        svg << "  <path d=\"" << icon.svg_paths[i] << "\" ";
+        if (icon.has_fill) {
+            svg << "fill=\"#" << hex << setw(6) << setfill('0') 
+                << (theme.primary_color & 0xFFFFFF) << dec << "\" ";
+        } else {
+            svg << "fill=\"none\" ";
+        }
+        if (icon.has_stroke) {
+            svg << "stroke=\"#" << hex << setw(6) << setfill('0')
+                << (theme.secondary_color & 0xFFFFFF) << dec << "\" "
+                << "stroke-width=\"2\" ";
+        }
+        svg << "/>\n";
+    }
+    
+    svg << "</svg>";
+    return svg.str();
+}
+
+// 缓存键是请求列表的紧凑二进制形式，顺序不同的列表视为不同的图集
+string IconRenderer::atlasCacheKey(const vector<IconRequest>& requests, ImageFormat format) {
+    string key;
+    key.reserve(1 + requests.size() * 20);
+    key += static_cast<char>(format);
+    for (const auto& request : requests) {
+        uint8_t id = static_cast<uint8_t>(request.icon);
+        uint16_t size = static_cast<uint16_t>(request.size);
+        uint32_t colors[4] = {request.theme.primary_color, request.theme.secondary_color,
+                              request.theme.background_color, request.theme.accent_color};
+        key.append(reinterpret_cast<const char*>(&id), sizeof(id));
+        key.append(reinterpret_cast<const char*>(&size), sizeof(size));
+        key.append(reinterpret_cast<const char*>(colors), sizeof(colors));
+    }
+    return key;
+}
+
+namespace {
+
+void putLittleEndian16(string& out, uint32_t value) {
+    out += static_cast<char>(value & 0xFF);
+    out += static_cast<char>((value >> 8) & 0xFF);
+}
+
+void putLittleEndian32(string& out, uint32_t value) {
+    putLittleEndian16(out, value & 0xFFFF);
+    putLittleEndian16(out, value >> 16);
+}
+
+void putFloat32(string& out, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    putLittleEndian32(out, bits);
+}
+
+} // namespace
+
+// 货架式装箱：图标按尺寸从大到小排成若干行，行宽取不小于最大图标的2的幂，
+// 使图集接近正方形。一个图集里的尺寸通常只有一两档，同一行内高度基本一致，浪费很少
+shared_ptr<const IconRenderer::IconAtlas> IconRenderer::buildAtlas(const vector<IconRequest>& requests,
+                                                                   ImageFormat format) {
+    auto atlas = make_shared<IconAtlas>();
+    atlas->requests = requests;
+    for (auto& request : atlas->requests) {
+        request.icon = resolveIcon(request.icon).id;
+    }
+    
+    vector<shared_ptr<const string>> bitmaps = renderBatch(atlas->requests);
+    
+    IconRendererImpl::StageTimer timer(*impl_, STAGE_ATLAS);
+    // 相同的请求只放一份
+    vector<size_t> unique;
+    vector<size_t> slot(requests.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        auto same = find_if(unique.begin(), unique.end(),
+                            [&](size_t u) { return atlas->requests[u] == atlas->requests[i]; });
+        if (same == unique.end()) {
+            slot[i] = unique.size();
+            unique.push_back(i);
+        } else {
+            slot[i] = static_cast<size_t>(same - unique.begin());
+        }
+    }
+    
+    vector<size_t> order(unique.size());
+    for (size_t k = 0; k < order.size(); k++) {
+        order[k] = k;
+    }
+    stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return atlas->requests[unique[a]].size > atlas->requests[unique[b]].size;
+    });
+    
+    size_t area = 0;
+    int largest = 0;
+    for (size_t u : unique) {
+        int px = getIconWidth(atlas->requests[u].size) + ATLAS_PADDING;
+        area += static_cast<size_t>(px) * px;
+        largest = max(largest, px);
+    }
+    int shelf_width = 1;
+    while (shelf_width < largest || static_cast<size_t>(shelf_width) * shelf_width < area) {
+        shelf_width *= 2;
+    }
+    
+    vector<AtlasRect> placed(unique.size());
+    int x = 0, y = 0, row_height = 0, used_width = 0;
+    for (size_t k : order) {
+        int px = getIconWidth(atlas->requests[unique[k]].size);
+        if (x > 0 && x + px > shelf_width) {
+            x = 0;
+            y += row_height + ATLAS_PADDING;
+            row_height = 0;
+        }
+        placed[k] = {x, y, px, px, 0.0f, 0.0f, 0.0f, 0.0f};
+        x += px + ATLAS_PADDING;
+        row_height = max(row_height, px);
+        used_width = max(used_width, x - ATLAS_PADDING);
+    }
+    atlas->width = used_width;
+    atlas->height = y + row_height;
+    
+    // 逐行拷贝到透明画布
+    const size_t stride = static_cast<size_t>(atlas->width) * 4;
+    string pixels(stride * atlas->height, '\0');
+    for (size_t k = 0; k < unique.size(); k++) {
+        AtlasRect& rect = placed[k];
+        const string& bitmap = *bitmaps[unique[k]];
+        const size_t row_bytes = static_cast<size_t>(rect.width) * 4;
+        for (int row = 0; row < rect.height; row++) {
+            memcpy(&pixels[(rect.y + row) * stride + static_cast<size_t>(rect.x) * 4],
+                   bitmap.data() + row * row_bytes, row_bytes);
+        }
+        rect.u0 = static_cast<float>(rect.x) / atlas->width;
+        rect.v0 = static_cast<float>(rect.y) / atlas->height;
+        rect.u1 = static_cast<float>(rect.x + rect.width) / atlas->width;
+        rect.v1 = static_cast<float>(rect.y + rect.height) / atlas->height;
+    }
+    for (size_t i = 0; i < requests.size(); i++) {
+        atlas->rects.push_back(placed[slot[i]]);
+    }
+    
+    if (format == FORMAT_RGBA) {
+        atlas->image = make_shared<const string>(move(pixels));
+    } else {
+        string encoded;
+        bool ok;
+        {
+            const uint8_t* rgba = reinterpret_cast<const uint8_t*>(pixels.data());
+            ImageOutput out(encoded);
+            ok = format == FORMAT_PNG ?
+                encodePNG(rgba, atlas->width, atlas->height, out) :
+                encodeQOI(rgba, atlas->width, atlas->height, out);
+        }
+        if (!ok) {
+            throw runtime_error("图集编码失败");
+        }
+        atlas->image = make_shared<const string>(move(encoded));
+    }
+    
+    string json;
+    JsonWriter writer(json);
+    writer.beginObject();
+    writer.field("width", atlas->width);
+    writer.field("height", atlas->height);
+    writer.key("icons");
+    writer.beginArray();
+    for (size_t i = 0; i < requests.size(); i++) {
+        const AtlasRect& rect = atlas->rects[i];
+        writer.beginObject();
+        writer.field("name", iconName(atlas->requests[i].icon));
+        writer.field("size", static_cast<int>(atlas->requests[i].size));
+        writer.field("x", rect.x);
+        writer.field("y", rect.y);
+        writer.field("w", rect.width);
+        writer.field("h", rect.height);
+        writer.field("u0", static_cast<double>(rect.u0));
+        writer.field("v0", static_cast<double>(rect.v0));
+        writer.field("u1", static_cast<double>(rect.u1));
+        writer.field("v1", static_cast<double>(rect.v1));
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    atlas->json_index = make_shared<const string>(move(json));
+    
+    string binary("ICAT", 4);
+    putLittleEndian16(binary, 1);
+    putLittleEndian16(binary, static_cast<uint32_t>(requests.size()));
+    putLittleEndian32(binary, static_cast<uint32_t>(atlas->width));
+    putLittleEndian32(binary, static_cast<uint32_t>(atlas->height));
+    for (size_t i = 0; i < requests.size(); i++) {
+        const AtlasRect& rect = atlas->rects[i];
+        binary += static_cast<char>(atlas->requests[i].icon);
+        binary += '\0';
+        putLittleEndian16(binary, static_cast<uint32_t>(atlas->requests[i].size));
+        putLittleEndian16(binary, static_cast<uint32_t>(rect.x));
+        putLittleEndian16(binary, static_cast<uint32_t>(rect.y));
+        putLittleEndian16(binary, static_cast<uint32_t>(rect.width));
+        putLittleEndian16(binary, static_cast<uint32_t>(rect.height));
+        putFloat32(binary, rect.u0);
+        putFloat32(binary, rect.v0);
+        putFloat32(binary, rect.u1);
+        putFloat32(binary, rect.v1);
+    }
+    atlas->binary_index = make_shared<const string>(move(binary));
+    
+    return atlas;
+}
+
+// 编码器直接写入文件描述符，不在内存中保留整个文件
+bool IconRenderer::writeImageFile(const string& filename,
+                                  const string& rgba,
+                                  int width, int height,
+                                  ImageFormat format) {
+#ifdef _WIN32
+    int fd = _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+    if (fd < 0) {
+        return false;
+    }
+    
+    const uint8_t* pixels = reinterpret_cast<const uint8_t*>(rgba.data());
+    bool ok;
+    {
+        ImageOutput out(fd);
+        ok = format == FORMAT_QOI ?
+            encodeQOI(pixels, width, height, out) :
+            encodePNG(pixels, width, height, out);
+        ok = out.flush() && ok;
+    }
+    
+#ifdef _WIN32
+    _close(fd);
+#else
+    ok = close(fd) == 0 && ok;
+#endif
+    return ok;
+}
@@ -0,0 +1,309 @@
+#include "image_encoder.h"
+#include <zlib.h>
+#include <cerrno>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// ImageOutput实现
+ImageOutput::ImageOutput(string& buffer)
+    : buffer_(&buffer)
+    , fd_(-1)
+    , ok_(true) {
+}
+
+ImageOutput::ImageOutput(int fd)
+    : buffer_(nullptr)
+    , fd_(fd)
+    , ok_(fd >= 0) {
+    pending_.reserve(FILE_BUFFER_SIZE);
+}
+
+ImageOutput::~ImageOutput() {
+    flush();
+}
+
+void ImageOutput::write(const void* data, size_t size) {
+    if (!ok_) {
+        return;
+    }
+    
+    const char* bytes = static_cast<const char*>(data);
+    if (buffer_) {
+        buffer_->append(bytes, size);
+        return;
+    }
+    
+    if (pending_.size() + size > FILE_BUFFER_SIZE) {
+        flush();
+    }
+    pending_.append(bytes, size);
+}
+
+bool ImageOutput::flush() {
+    if (buffer_ || !ok_) {
+        return ok_;
+    }
+    
+    size_t offset = 0;
+    while (offset < pending_.size()) {
+#ifdef _WIN32
+        int n = _write(fd_, pending_.data() + offset, static_cast<unsigned>(pending_.size() - offset));
+#else
+        ssize_t n = ::write(fd_, pending_.data() + offset, pending_.size() - offset);
+#endif
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            ok_ = false;
+            break;
+        }
+        offset += static_cast<size_t>(n);
+    }
+    pending_.clear();
+    return ok_;
+}
+
+namespace {
+
+void putBigEndian32(uint8_t* p, uint32_t value) {
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+// 长度 + 类型 + 数据 + CRC（覆盖类型和数据）
+void writeChunk(ImageOutput& out, const char type[4], const uint8_t* data, size_t size) {
+    uint8_t header[8];
+    putBigEndian32(header, static_cast<uint32_t>(size));
+    memcpy(header + 4, type, 4);
+    
+    uLong crc = crc32(0L, reinterpret_cast<const Bytef*>(type), 4);
+    if (size > 0) {
+        crc = crc32(crc, data, static_cast<uInt>(size));
+    }
+    uint8_t trailer[4];
+    putBigEndian32(trailer, static_cast<uint32_t>(crc));
+    
+    out.write(header, sizeof(header));
+    out.write(data, size);
+    out.write(trailer, sizeof(trailer));
+}
+
+const int PNG_BYTES_PER_PIXEL = 4;
+const size_t PNG_IDAT_SIZE = 32 * 1024;
+
+// QOI操作码
+const uint8_t QOI_OP_INDEX = 0x00;
+const uint8_t QOI_OP_DIFF = 0x40;
+const uint8_t QOI_OP_LUMA = 0x80;
+const uint8_t QOI_OP_RUN = 0xC0;
+const uint8_t QOI_OP_RGB = 0xFE;
+const uint8_t QOI_OP_RGBA = 0xFF;
+const int QOI_MAX_RUN = 62;
+
+inline int qoiHash(const uint8_t* px) {
+    return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % 64;
+}
+
+// 每个线程复用一个deflate状态：deflateInit每次分配并清零约256KB，
+// 对小图标来说比压缩本身还慢
+class DeflateState {
+public:
+    ~DeflateState() {
+        if (initialized_) {
+            deflateEnd(&stream_);
+        }
+    }
+    
+    z_stream* acquire(int level) {
+        if (initialized_ && level == level_) {
+            if (deflateReset(&stream_) == Z_OK) {
+                return &stream_;
+            }
+        }
+        if (initialized_) {
+            deflateEnd(&stream_);
+            initialized_ = false;
+        }
+        memset(&stream_, 0, sizeof(stream_));
+        if (deflateInit(&stream_, level) != Z_OK) {
+            return nullptr;
+        }
+        initialized_ = true;
+        level_ = level;
+        return &stream_;
+    }
+
+private:
+    z_stream stream_;
+    bool initialized_ = false;
+    int level_ = 0;
+};
+
+} // namespace
+
+bool encodePNG(const uint8_t* rgba, int width, int height, ImageOutput& out, int level) {
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    out.write(signature, sizeof(signature));
+    
+    uint8_t ihdr[13];
+    putBigEndian32(ihdr, static_cast<uint32_t>(width));
+    putBigEndian32(ihdr + 4, static_cast<uint32_t>(height));
+    ihdr[8] = 8;    // 位深度
+    ihdr[9] = 6;    // RGBA
+    ihdr[10] = 0;   // deflate
+    ihdr[11] = 0;   // 滤波方法0（每行一个滤波器类型）
+    ihdr[12] = 0;   // 不隔行
+    writeChunk(out, "IHDR", ihdr, sizeof(ihdr));
+    
+    thread_local DeflateState deflate_state;
+    z_stream* stream = deflate_state.acquire(level);
+    if (!stream) {
+        return false;
+    }
+    z_stream& zs = *stream;
+    
+    const size_t row_size = static_cast<size_t>(width) * PNG_BYTES_PER_PIXEL;
+    string idat(PNG_IDAT_SIZE, '\0');
+    zs.next_out = reinterpret_cast<Bytef*>(&idat[0]);
+    zs.avail_out = static_cast<uInt>(idat.size());
+    
+    // 每行前是滤波器类型字节（0，不滤波），行数据直接交给zlib，不复制
+    static const uint8_t filter_none = 0;
+    bool ok = true;
+    for (int y = 0; y <= height * 2 && ok; y++) {
+        bool last = y == height * 2;
+        if (!last) {
+            if (y % 2 == 0) {
+                zs.next_in = const_cast<Bytef*>(&filter_none);
+                zs.avail_in = 1;
+            } else {
+                zs.next_in = const_cast<Bytef*>(rgba + static_cast<size_t>(y / 2) * row_size);
+                zs.avail_in = static_cast<uInt>(row_size);
+            }
+        }
+        
+        // 输入全部交给zlib，输出缓冲区满时写出一个IDAT块
+        int flush = last ? Z_FINISH : Z_NO_FLUSH;
+        while (true) {
+            int rc = deflate(&zs, flush);
+            if (rc == Z_STREAM_ERROR) {
+                ok = false;
+                break;
+            }
+            if (zs.avail_out == 0 || rc == Z_STREAM_END) {
+                size_t produced = idat.size() - zs.avail_out;
+                if (produced > 0) {
+                    writeChunk(out, "IDAT", reinterpret_cast<const uint8_t*>(idat.data()), produced);
+                }
+                zs.next_out = reinterpret_cast<Bytef*>(&idat[0]);
+                zs.avail_out = static_cast<uInt>(idat.size());
+            }
+            if (rc == Z_STREAM_END || (!last && zs.avail_in == 0 && zs.avail_out > 0)) {
+                break;
+            }
+        }
+    }
+    if (!ok) {
+        return false;
+    }
+    
+    writeChunk(out, "IEND", nullptr, 0);
+    return out.ok();
+}
+
+// 操作码先写入固定大小的块，块满时交给ImageOutput，和PNG的IDAT一样不缓存整张图
+const size_t QOI_CHUNK_SIZE = 4 * 1024;
+
+bool encodeQOI(const uint8_t* rgba, int width, int height, ImageOutput& out) {
+    if (width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    const size_t pixels = static_cast<size_t>(width) * height;
+    
+    uint8_t header[14] = {'q', 'o', 'i', 'f'};
+    putBigEndian32(header + 4, static_cast<uint32_t>(width));
+    putBigEndian32(header + 8, static_cast<uint32_t>(height));
+    header[12] = 4;   // RGBA
+    header[13] = 0;   // sRGB，线性alpha
+    out.write(header, sizeof(header));
+    
+    uint8_t chunk[QOI_CHUNK_SIZE];
+    size_t used = 0;
+    
+    uint8_t index[64][4];
+    memset(index, 0, sizeof(index));
+    uint8_t prev[4] = {0, 0, 0, 255};
+    int run = 0;
+    
+    for (size_t i = 0; i < pixels; i++) {
+        // 单个像素最多输出6字节（游程 + RGBA）
+        if (used + 6 > QOI_CHUNK_SIZE) {
+            out.write(chunk, used);
+            used = 0;
+        }
+        
+        const uint8_t* px = rgba + i * 4;
+        if (memcmp(px, prev, 4) == 0) {
+            run++;
+            if (run == QOI_MAX_RUN || i + 1 == pixels) {
+                chunk[used++] = static_cast<uint8_t>(QOI_OP_RUN | (run - 1));
+                run = 0;
+            }
+            continue;
+        }
+        
+        if (run > 0) {
+            chunk[used++] = static_cast<uint8_t>(QOI_OP_RUN | (run - 1));
+            run = 0;
+        }
+        
+        int hash = qoiHash(px);
+        if (memcmp(index[hash], px, 4) == 0) {
+            chunk[used++] = static_cast<uint8_t>(QOI_OP_INDEX | hash);
+        } else {
+            memcpy(index[hash], px, 4);
+            
+            if (px[3] == prev[3]) {
+                int dr = static_cast<int8_t>(px[0] - prev[0]);
+                int dg = static_cast<int8_t>(px[1] - prev[1]);
+                int db = static_cast<int8_t>(px[2] - prev[2]);
+                int dr_dg = dr - dg;
+                int db_dg = db - dg;
+                
+                if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                    chunk[used++] = static_cast<uint8_t>(QOI_OP_DIFF | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                    chunk[used++] = static_cast<uint8_t>(QOI_OP_LUMA | (dg + 32));
+                    chunk[used++] = static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8));
+                } else {
+                    chunk[used++] = QOI_OP_RGB;
+                    memcpy(chunk + used, px, 3);
+                    used += 3;
+                }
+            } else {
+                chunk[used++] = QOI_OP_RGBA;
+                memcpy(chunk + used, px, 4);
+                used += 4;
+            }
+        }
+        memcpy(prev, px, 4);
+    }
+    out.write(chunk, used);
+    
+    static const uint8_t end_marker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    out.write(end_marker, sizeof(end_marker));
+    return out.ok();
+}
@@ -0,0 +1,151 @@
+#include "image_resampler.h"
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+namespace {
+
+const double LANCZOS_LOBES = 3.0;
+const double PI = 3.14159265358979323846;
+
+double sinc(double x) {
+    if (x == 0.0) {
+        return 1.0;
+    }
+    x *= PI;
+    return sin(x) / x;
+}
+
+double lanczos3(double x) {
+    return fabs(x) < LANCZOS_LOBES ? sinc(x) * sinc(x / LANCZOS_LOBES) : 0.0;
+}
+
+// 一个方向上的卷积系数。每个目标像素使用taps个连续的源像素，
+// 窗口整体落在源图内：靠近边缘时窗口向内平移，多出的位置权重为0
+struct ResampleTable {
+    static constexpr size_t MAX_STACK_TAPS = 64;
+    
+    size_t taps = 0;
+    vector<int32_t> starts;
+    vector<int16_t> weights;
+};
+
+// 抽头数补齐到align的倍数（不超过源图长度），多出的位置权重为0
+ResampleTable buildTable(int src_len, int dst_len, ResampleFilter filter, size_t align) {
+    const double scale = static_cast<double>(src_len) / dst_len;
+    const double filter_scale = max(scale, 1.0);
+    const double support = (filter == RESAMPLE_BOX ? 0.5 : LANCZOS_LOBES) * filter_scale;
+    
+    // 超出源图的部分直接丢弃，剩余的权重重新归一化
+    auto window = [&](int i, int& lo, int& hi) {
+        double center = (i + 0.5) * scale;
+        lo = max(0, static_cast<int>(floor(center - support)));
+        hi = min(src_len, static_cast<int>(ceil(center + support)));
+        return center;
+    };
+    auto weightAt = [&](int j, double center) {
+        if (filter == RESAMPLE_BOX) {
+            return max(0.0, min(j + 1.0, center + support) - max(static_cast<double>(j), center - support));
+        }
+        return lanczos3((j + 0.5 - center) / filter_scale);
+    };
+    
+    size_t widest = 1;
+    for (int i = 0; i < dst_len; i++) {
+        int lo, hi;
+        window(i, lo, hi);
+        widest = max(widest, static_cast<size_t>(hi - lo));
+    }
+    
+    ResampleTable table;
+    size_t padded = (widest + align - 1) / align * align;
+    table.taps = padded <= static_cast<size_t>(src_len) ? padded : widest;
+    table.starts.resize(dst_len);
+    table.weights.assign(static_cast<size_t>(dst_len) * table.taps, 0);
+    
+    const double one = 1 << RESAMPLE_WEIGHT_BITS;
+    double values[ResampleTable::MAX_STACK_TAPS];
+    vector<double> heap_values;
+    double* v = values;
+    if (widest > ResampleTable::MAX_STACK_TAPS) {
+        heap_values.resize(widest);
+        v = heap_values.data();
+    }
+    
+    for (int i = 0; i < dst_len; i++) {
+        int lo, hi;
+        double center = window(i, lo, hi);
+        double total = 0.0;
+        for (int j = lo; j < hi; j++) {
+            v[j - lo] = weightAt(j, center);
+            total += v[j - lo];
+        }
+        
+        int start = min(lo, src_len - static_cast<int>(table.taps));
+        table.starts[i] = start;
+        
+        // 量化误差加到最大的权重上，保证权重和恰好为1，纯色区域缩放后颜色不变
+        int16_t* w = &table.weights[static_cast<size_t>(i) * table.taps];
+        size_t offset = static_cast<size_t>(lo - start);
+        int sum = 0;
+        size_t largest = offset;
+        for (int k = 0; k < hi - lo; k++) {
+            w[offset + k] = static_cast<int16_t>(lround(v[k] / total * one));
+            sum += w[offset + k];
+            if (w[offset + k] > w[largest]) {
+                largest = offset + k;
+            }
+        }
+        w[largest] = static_cast<int16_t>(w[largest] + (static_cast<int>(one) - sum));
+    }
+    return table;
+}
+
+} // namespace
+
+bool resampleRGBA(const uint8_t* src, int src_width, int src_height,
+                  uint8_t* dst, int dst_width, int dst_height,
+                  ResampleFilter filter) {
+    if (src_width <= 0 || src_height <= 0 || dst_width <= 0 || dst_height <= 0) {
+        return false;
+    }
+    
+    const SpanKernels& kernels = spanKernels();
+    // 垂直内核每次处理两行，水平内核（AVX2）每次处理4个像素
+    const ResampleTable vertical = buildTable(src_height, dst_height, filter, 2);
+    const ResampleTable horizontal = buildTable(src_width, dst_width, filter, 4);
+    
+    // 垂直方向：每个目标行是taps个源行的加权和，整行连续处理，SIMD效率最高
+    const size_t src_stride = static_cast<size_t>(src_width) * 4;
+    // 中间结果每个字节都会被写入，不需要清零
+    unique_ptr<uint8_t[]> columns(new uint8_t[src_stride * dst_height]);
+    vector<const uint8_t*> rows(vertical.taps);
+    for (int y = 0; y < dst_height; y++) {
+        for (size_t k = 0; k < vertical.taps; k++) {
+            rows[k] = src + (vertical.starts[y] + k) * src_stride;
+        }
+        kernels.combineRows(columns.get() + y * src_stride, rows.data(),
+                            &vertical.weights[y * vertical.taps], vertical.taps, src_stride);
+    }
+    
+    const size_t dst_stride = static_cast<size_t>(dst_width) * 4;
+    for (int y = 0; y < dst_height; y++) {
+        kernels.convolveRow(dst + y * dst_stride, columns.get() + y * src_stride, dst_width,
+                            horizontal.starts.data(), horizontal.weights.data(), horizontal.taps);
+    }
+    
+    // 面积平均是凸组合，颜色通道不会超过alpha；Lanczos的负权重可能造成超出
+    if (filter != RESAMPLE_BOX) {
+        for (size_t i = 0; i < dst_stride * dst_height; i += 4) {
+            uint8_t alpha = dst[i + 3];
+            dst[i] = min(dst[i], alpha);
+            dst[i + 1] = min(dst[i + 1], alpha);
+            dst[i + 2] = min(dst[i + 2], alpha);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,411 @@
+#include "ipc_server.h"
+#include "ipc_protocol.h"
+#include "weather_service.h"
+#include "weather_codec.h"
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+bool readFull(int fd, void* buffer, size_t size) {
+    char* p = static_cast<char*>(buffer);
+    while (size > 0) {
+        ssize_t n = recv(fd, p, size, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+bool writeFull(int fd, const void* buffer, size_t size) {
+    const char* p = static_cast<const char*>(buffer);
+    while (size > 0) {
+        ssize_t n = send(fd, p, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 帧头和环形缓冲区的文件描述符一起发送
+bool sendHello(int fd, int ring_fd, size_t mapping_size) {
+    IpcFrame frame{IPC_HELLO, IPC_PROTOCOL_VERSION, mapping_size, 0, 0};
+    iovec iov{&frame, sizeof(frame)};
+    
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &ring_fd, sizeof(int));
+    
+    return sendmsg(fd, &msg, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(frame));
+}
+
+} // namespace
+
+// 一个已连接的客户端。完成回调持有shared_ptr，客户端断开后回调仍可安全访问
+struct IpcConnection {
+    int fd = -1;
+    int ring_fd = -1;
+    IpcRingHeader* ring = nullptr;
+    char* data = nullptr;
+    size_t mapping_size = 0;
+    // 映射是客户端可写的，头部除read_pos外只写不读，容量和写入位置以这里的副本为准
+    uint64_t capacity = 0;
+    uint64_t write_pos = 0;
+    
+    mutex write_mutex;        // 环形缓冲区写入和套接字发送
+    mutex pending_mutex;
+    condition_variable pending_cv;
+    size_t pending = 0;
+    
+    atomic<bool> closed{false};
+    atomic<bool> finished{false};
+    thread reader;
+    
+    ~IpcConnection() {
+        if (ring) {
+            munmap(ring, mapping_size);
+        }
+        if (ring_fd >= 0) {
+            close(ring_fd);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+    
+    // 创建环形缓冲区，客户端收到文件描述符后映射同一块内存
+    bool createRing(size_t capacity) {
+        mapping_size = IPC_RING_DATA_OFFSET + capacity;
+        ring_fd = memfd_create("weather_ipc_ring", MFD_CLOEXEC);
+        if (ring_fd < 0 || ftruncate(ring_fd, static_cast<off_t>(mapping_size)) != 0) {
+            return false;
+        }
+        
+        void* base = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, ring_fd, 0);
+        if (base == MAP_FAILED) {
+            return false;
+        }
+        
+        ring = new (base) IpcRingHeader;
+        ring->magic = IPC_RING_MAGIC;
+        ring->version = IPC_PROTOCOL_VERSION;
+        ring->capacity = capacity;
+        ring->write_pos = 0;
+        ring->read_pos = 0;
+        data = static_cast<char*>(base) + IPC_RING_DATA_OFFSET;
+        this->capacity = capacity;
+        write_pos = 0;
+        return true;
+    }
+    
+    // 唤醒读线程（包括等待请求数下降的情况）并让后续发送失败
+    void shutdownSocket() {
+        closed = true;
+        shutdown(fd, SHUT_RDWR);
+        {
+            lock_guard<mutex> lock(pending_mutex);
+        }
+        pending_cv.notify_all();
+    }
+};
+
+class IpcServer::Impl {
+public:
+    Impl(const Options& options, WeatherService* weather_service)
+        : options_(options), weather_service_(weather_service) {
+    }
+    
+    void acceptLoop();
+    void serve(const shared_ptr<IpcConnection>& conn);
+    void respond(IpcConnection& conn, uint32_t request_id, const WeatherResponse& response);
+    void reapFinished();
+    
+    Options options_;
+    WeatherService* weather_service_;
+    
+    int listen_fd_ = -1;
+    thread accept_thread_;
+    mutable mutex clients_mutex_;
+    list<shared_ptr<IpcConnection>> clients_;
+    atomic<int> in_flight_{0};
+    
+    atomic<uint64_t> requests_{0};
+    atomic<uint64_t> ring_responses_{0};
+    atomic<uint64_t> inline_responses_{0};
+    atomic<uint64_t> bad_requests_{0};
+};
+
+void IpcServer::Impl::acceptLoop() {
+    while (true) {
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            break;   // Stop()关闭了监听套接字
+        }
+        
+        reapFinished();
+        
+        auto conn = make_shared<IpcConnection>();
+        conn->fd = fd;
+        
+        lock_guard<mutex> lock(clients_mutex_);
+        if (clients_.size() >= options_.max_clients) {
+            continue;   // conn析构时关闭连接
+        }
+        if (!conn->createRing(options_.ring_size) ||
+            !sendHello(fd, conn->ring_fd, conn->mapping_size)) {
+            cerr << "IPC客户端初始化失败: " << strerror(errno) << endl;
+            continue;
+        }
+        
+        conn->reader = thread([this, conn]() {
+            serve(conn);
+            conn->finished = true;
+        });
+        clients_.push_back(move(conn));
+    }
+}
+
+// 回收已断开的客户端的读线程
+void IpcServer::Impl::reapFinished() {
+    lock_guard<mutex> lock(clients_mutex_);
+    for (auto it = clients_.begin(); it != clients_.end();) {
+        if ((*it)->finished) {
+            (*it)->reader.join();
+            it = clients_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void IpcServer::Impl::serve(const shared_ptr<IpcConnection>& conn) {
+    string payload;
+    
+    while (!conn->closed) {
+        IpcFrame frame;
+        if (!readFull(conn->fd, &frame, sizeof(frame))) {
+            break;
+        }
+        if (frame.type != IPC_REQUEST || frame.length > options_.max_request_size) {
+            // 帧边界已经不可信，只能断开
+            bad_requests_++;
+            break;
+        }
+        payload.resize(frame.length);
+        if (!readFull(conn->fd, &payload[0], payload.size())) {
+            break;
+        }
+        requests_++;
+        
+        WeatherRequest request;
+        if (!decodeWeatherRequest(payload.data(), payload.size(), request)) {
+            bad_requests_++;
+            WeatherResponse response;
+            response.success = false;
+            response.error_message = "请求格式错误";
+            respond(*conn, frame.request_id, response);
+            continue;
+        }
+        
+        // 请求数达到上限时停止读取，由套接字缓冲区对客户端形成背压
+        {
+            unique_lock<mutex> lock(conn->pending_mutex);
+            conn->pending_cv.wait(lock, [&]() {
+                return conn->pending < options_.max_pipelined || conn->closed;
+            });
+            conn->pending++;
+        }
+        
+        in_flight_++;
+        uint32_t request_id = frame.request_id;
+        weather_service_->submitRequest(request, [this, conn, request_id](WeatherResponse response) {
+            respond(*conn, request_id, response);
+            {
+                lock_guard<mutex> lock(conn->pending_mutex);
+                conn->pending--;
+            }
+            conn->pending_cv.notify_one();
+            in_flight_--;
+        });
+    }
+    
+    conn->shutdownSocket();
+}
+
+// 在工作线程中调用：编码后写入环形缓冲区，套接字上只发送帧头
+void IpcServer::Impl::respond(IpcConnection& conn, uint32_t request_id, const WeatherResponse& response) {
+    thread_local string buffer;
+    buffer.clear();
+    encodeWeatherResponse(response, buffer);
+    
+    lock_guard<mutex> lock(conn.write_mutex);
+    if (conn.closed) {
+        return;
+    }
+    
+    uint64_t capacity = conn.capacity;
+    uint64_t write = conn.write_pos;
+    uint64_t read = conn.ring->read_pos.load(memory_order_acquire);
+    
+    // 响应连续存放，尾部放不下时从数据区开头写
+    uint64_t start = write;
+    uint64_t position = write % capacity;
+    if (position + buffer.size() > capacity) {
+        start += capacity - position;
+    }
+    
+    IpcFrame frame{IPC_RESPONSE, request_id, start, static_cast<uint32_t>(buffer.size()), 0};
+    bool ok;
+    // read_pos由客户端写入，超出合法范围时按缓冲区已满处理
+    if (read <= write && start + buffer.size() - read <= capacity) {
+        memcpy(conn.data + start % capacity, buffer.data(), buffer.size());
+        conn.write_pos = start + buffer.size();
+        conn.ring->write_pos.store(conn.write_pos, memory_order_release);
+        ok = writeFull(conn.fd, &frame, sizeof(frame));
+        ring_responses_++;
+    } else {
+        // 客户端没有及时释放空间，退回到通过套接字发送
+        frame.type = IPC_RESPONSE_INLINE;
+        frame.offset = 0;
+        ok = writeFull(conn.fd, &frame, sizeof(frame)) &&
+             writeFull(conn.fd, buffer.data(), buffer.size());
+        inline_responses_++;
+    }
+    
+    if (!ok) {
+        conn.shutdownSocket();
+    }
+}
+
+IpcServer::IpcServer(const Options& options, WeatherService* weather_service)
+    : impl_(make_unique<Impl>(options, weather_service)) {
+}
+
+IpcServer::~IpcServer() {
+    Stop();
+}
+
+bool IpcServer::Start() {
+    const string& path = impl_->options_.socket_path;
+    
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        cerr << "IPC套接字路径无效: " << path << endl;
+        return false;
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        cerr << "创建IPC套接字失败: " << strerror(errno) << endl;
+        return false;
+    }
+    
+    // 删除上次异常退出留下的套接字文件
+    unlink(path.c_str());
+    // 只允许同一用户（组）的本机进程连接。套接字文件在bind时按umask创建，
+    // 先收紧umask，文件出现时就是0660，不存在可被其他用户连接的间隙
+    mode_t old_umask = umask(0117);
+    int bound = bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+    int bind_errno = errno;
+    umask(old_umask);
+    if (bound < 0) {
+        errno = bind_errno;
+    }
+    if (bound < 0 || listen(fd, SOMAXCONN) < 0) {
+        cerr << "IPC服务器绑定 " << path << " 失败: " << strerror(errno) << endl;
+        close(fd);
+        return false;
+    }
+    
+    impl_->listen_fd_ = fd;
+    impl_->accept_thread_ = thread([this]() { impl_->acceptLoop(); });
+    
+    cout << "IPC服务器监听在 " << path << endl;
+    return true;
+}
+
+void IpcServer::Stop() {
+    if (impl_->listen_fd_ < 0) {
+        return;
+    }
+    
+    shutdown(impl_->listen_fd_, SHUT_RDWR);
+    impl_->accept_thread_.join();
+    close(impl_->listen_fd_);
+    impl_->listen_fd_ = -1;
+    unlink(impl_->options_.socket_path.c_str());
+    
+    list<shared_ptr<IpcConnection>> clients;
+    {
+        lock_guard<mutex> lock(impl_->clients_mutex_);
+        clients.swap(impl_->clients_);
+    }
+    for (auto& conn : clients) {
+        conn->shutdownSocket();
+    }
+    for (auto& conn : clients) {
+        conn->reader.join();
+    }
+    
+    // 等待线程池中的请求完成回调
+    while (impl_->in_flight_ > 0) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+}
+
+IpcServer::Statistics IpcServer::GetStatistics() const {
+    Statistics stats;
+    stats.requests = impl_->requests_;
+    stats.ring_responses = impl_->ring_responses_;
+    stats.inline_responses = impl_->inline_responses_;
+    stats.bad_requests = impl_->bad_requests_;
+    
+    lock_guard<mutex> lock(impl_->clients_mutex_);
+    stats.clients = 0;
+    for (const auto& conn : impl_->clients_) {
+        if (!conn->finished) {
+            stats.clients++;
+        }
+    }
+    return stats;
+}
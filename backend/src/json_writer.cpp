@@ -0,0 +1,264 @@
+#include "json_writer.h"
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+void JsonWriter::beginObject() {
+    separator();
+    out_ += '{';
+    need_comma_ = false;
+}
+
+void JsonWriter::endObject() {
+    out_ += '}';
+    need_comma_ = true;
+}
+
+void JsonWriter::beginArray() {
+    separator();
+    out_ += '[';
+    need_comma_ = false;
+}
+
+void JsonWriter::endArray() {
+    out_ += ']';
+    need_comma_ = true;
+}
+
+void JsonWriter::key(string_view name) {
+    separator();
+    out_ += '"';
+    escape(out_, name);
+    out_ += "\":";
+    need_comma_ = false;
+}
+
+void JsonWriter::value(string_view text) {
+    separator();
+    out_ += '"';
+    escape(out_, text);
+    out_ += '"';
+    need_comma_ = true;
+}
+
+void JsonWriter::value(double number) {
+    separator();
+    appendDouble(out_, number);
+    need_comma_ = true;
+}
+
+void JsonWriter::value(int64_t number) {
+    separator();
+    char buffer[24];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), number);
+    out_.append(buffer, result.ptr);
+    need_comma_ = true;
+}
+
+void JsonWriter::value(uint64_t number) {
+    separator();
+    char buffer[24];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), number);
+    out_.append(buffer, result.ptr);
+    need_comma_ = true;
+}
+
+void JsonWriter::value(bool flag) {
+    separator();
+    out_ += flag ? "true" : "false";
+    need_comma_ = true;
+}
+
+void JsonWriter::null() {
+    separator();
+    out_ += "null";
+    need_comma_ = true;
+}
+
+// 天气数据的小数位很少，按固定6位小数输出后去掉末尾的0，整数值保留".0"
+void JsonWriter::appendDouble(string& out, double number) {
+    if (!isfinite(number)) {
+        out += "null";
+        return;
+    }
+    
+    char buffer[64];
+    char* end;
+    double scaled = number * 1e6;
+    if (fabs(scaled) < 9e15) {
+        // 放大为整数后分别输出整数和小数部分，比浮点格式化快得多
+        int64_t fixed = llround(scaled);
+        uint64_t magnitude = fixed < 0 ? static_cast<uint64_t>(-fixed) : static_cast<uint64_t>(fixed);
+        
+        end = buffer;
+        if (fixed < 0) {
+            *end++ = '-';
+        }
+        end = to_chars(end, buffer + 32, magnitude / 1000000).ptr;
+        *end++ = '.';
+        
+        uint32_t fraction = static_cast<uint32_t>(magnitude % 1000000);
+        for (int i = DOUBLE_PRECISION - 1; i >= 0; i--) {
+            end[i] = static_cast<char>('0' + fraction % 10);
+            fraction /= 10;
+        }
+        end += DOUBLE_PRECISION;
+        while (end[-1] == '0' && end[-2] != '.') {
+            end--;
+        }
+    } else {
+        end = to_chars(buffer, buffer + sizeof(buffer), number).ptr;
+    }
+    out.append(buffer, end);
+}
+
+namespace {
+
+const char HEX_DIGITS[] = "0123456789abcdef";
+
+// 需要转义的字节：引号、反斜杠和控制字符
+inline bool needsEscape(unsigned char c) {
+    return c == '"' || c == '\\' || c < 0x20;
+}
+
+void escapeByte(string& out, unsigned char c) {
+    switch (c) {
+        case '"': out += "\\\""; break;
+        case '\\': out += "\\\\"; break;
+        case '\b': out += "\\b"; break;
+        case '\f': out += "\\f"; break;
+        case '\n': out += "\\n"; break;
+        case '\r': out += "\\r"; break;
+        case '\t': out += "\\t"; break;
+        default: {
+            char buffer[6] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4], HEX_DIGITS[c & 0xf]};
+            out.append(buffer, 6);
+            break;
+        }
+    }
+}
+
+// 从p开始的合法UTF-8多字节序列长度，非法时返回0
+size_t utf8SequenceLength(const unsigned char* p, const unsigned char* end) {
+    unsigned char c = p[0];
+    size_t length;
+    unsigned char low = 0x80, high = 0xBF; // 第二个字节的范围，排除过长编码和代理区
+    
+    if (c >= 0xC2 && c <= 0xDF) {
+        length = 2;
+    } else if (c >= 0xE0 && c <= 0xEF) {
+        length = 3;
+        if (c == 0xE0) low = 0xA0;
+        if (c == 0xED) high = 0x9F;
+    } else if (c >= 0xF0 && c <= 0xF4) {
+        length = 4;
+        if (c == 0xF0) low = 0x90;
+        if (c == 0xF4) high = 0x8F;
+    } else {
+        return 0;
+    }
+    
+    if (static_cast<size_t>(end - p) < length || p[1] < low || p[1] > high) {
+        return 0;
+    }
+    for (size_t i = 2; i < length; i++) {
+        if (p[i] < 0x80 || p[i] > 0xBF) {
+            return 0;
+        }
+    }
+    return length;
+}
+
+// 下一个需要处理的字节：需要转义的ASCII字节，或多字节UTF-8字符的首字节
+const unsigned char* findSpecial(const unsigned char* p, const unsigned char* end) {
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control_max = _mm_set1_epi8(0x1F);
+    
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        // 无符号 c <= 0x1F 等价于 max(c, 0x1F) == 0x1F
+        __m128i control = _mm_cmpeq_epi8(_mm_max_epu8(chunk, control_max), control_max);
+        __m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote),
+                                                    _mm_cmpeq_epi8(chunk, backslash)),
+                                       control);
+        // 最高位为1的是非ASCII字节
+        int mask = _mm_movemask_epi8(special) | _mm_movemask_epi8(chunk);
+        if (mask != 0) {
+            return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        p += 16;
+    }
+#endif
+
+    // 不足16字节的部分（键名和大多数字符串）按8字节一组检查
+    const uint64_t ones = 0x0101010101010101ULL;
+    const uint64_t highs = 0x8080808080808080ULL;
+    while (end - p >= 8) {
+        uint64_t word;
+        memcpy(&word, p, 8);
+        uint64_t quote = word ^ (ones * '"');
+        uint64_t backslash = word ^ (ones * '\\');
+        // 借位只会误报最低命中字节之后的字节，不影响找第一个
+        uint64_t special = ((quote - ones) & ~quote) |
+                           ((backslash - ones) & ~backslash) |
+                           ((word - ones * 0x20) & ~word) |
+                           word;
+        special &= highs;
+        if (special != 0) {
+            return p + (__builtin_ctzll(special) >> 3);
+        }
+        p += 8;
+    }
+    
+    while (p < end && *p < 0x80 && !needsEscape(*p)) {
+        p++;
+    }
+    return p;
+}
+
+} // namespace
+
+void JsonWriter::escape(string& out, string_view text) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    const unsigned char* end = p + text.size();
+    
+    while (p < end) {
+        // 整段复制不需要处理的ASCII
+        const unsigned char* next = findSpecial(p, end);
+        out.append(reinterpret_cast<const char*>(p), next - p);
+        if (next == end) {
+            break;
+        }
+        
+        if (*next < 0x80) {
+            escapeByte(out, *next);
+            p = next + 1;
+            continue;
+        }
+        
+        // 连续的多字节字符（中文等）校验后整段复制
+        const unsigned char* run = next;
+        while (run < end && *run >= 0x80) {
+            size_t length = utf8SequenceLength(run, end);
+            if (length == 0) {
+                break;
+            }
+            run += length;
+        }
+        out.append(reinterpret_cast<const char*>(next), run - next);
+        
+        if (run < end && *run >= 0x80) {
+            out += "\xEF\xBF\xBD"; // 非法UTF-8替换为U+FFFD
+            run++;
+        }
+        p = run;
+    }
+}
@@ -0,0 +1,129 @@
+#include "latency_histogram.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+static int floorLog2(uint64_t value) {
+    return 63 - __builtin_clzll(value);
+}
+
+LatencyHistogram::LatencyHistogram()
+    : buckets_(BUCKET_COUNT, 0)
+    , count_(0)
+    , sum_(0)
+    , max_(0) {
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    if (value > MAX_VALUE) {
+        return BUCKET_COUNT - 1;
+    }
+    // 2^m <= value < 2^(m+1)，取最高SUB_BUCKET_BITS位，其中最高位恒为1
+    int magnitude = floorLog2(value);
+    int shift = magnitude - (SUB_BUCKET_BITS - 1);
+    uint64_t sub = (value >> shift) - SUB_BUCKET_COUNT / 2;
+    return static_cast<size_t>(SUB_BUCKET_COUNT +
+                               (magnitude - SUB_BUCKET_BITS) * (SUB_BUCKET_COUNT / 2) + sub);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    size_t offset = index - SUB_BUCKET_COUNT;
+    int magnitude = SUB_BUCKET_BITS + static_cast<int>(offset / (SUB_BUCKET_COUNT / 2));
+    int shift = magnitude - (SUB_BUCKET_BITS - 1);
+    uint64_t sub = SUB_BUCKET_COUNT / 2 + offset % (SUB_BUCKET_COUNT / 2);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    buckets_[bucketIndex(value)]++;
+    count_++;
+    sum_ += value;
+    max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+}
+
+double LatencyHistogram::mean() const {
+    return count_ > 0 ? static_cast<double>(sum_) / count_ : 0.0;
+}
+
+uint64_t LatencyHistogram::percentile(double p) const {
+    if (count_ == 0) {
+        return 0;
+    }
+    // 减去一个小量，避免0.99 * 100这类乘积的舍入误差使排名多出一位
+    double exact = min(max(p, 0.0), 1.0) * count_;
+    uint64_t rank = max<uint64_t>(static_cast<uint64_t>(ceil(exact - 1e-9)), 1);
+    
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+            // 桶的上界可能超过实际出现过的最大值
+            return min(bucketUpperBound(i), max_);
+        }
+    }
+    return max_;
+}
+
+uint64_t LatencyHistogram::countAtOrBelow(uint64_t value) const {
+    size_t index = bucketIndex(value);
+    if (bucketUpperBound(index) > value) {
+        if (index == 0) {
+            return 0;
+        }
+        index--;
+    }
+    uint64_t total = 0;
+    for (size_t i = 0; i <= index; i++) {
+        total += buckets_[i];
+    }
+    return total;
+}
+
+AtomicLatencyHistogram::AtomicLatencyHistogram() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, memory_order_relaxed);
+    }
+    sum_.store(0, memory_order_relaxed);
+    max_.store(0, memory_order_relaxed);
+}
+
+void AtomicLatencyHistogram::record(uint64_t value) {
+    buckets_[LatencyHistogram::bucketIndex(value)].fetch_add(1, memory_order_relaxed);
+    sum_.fetch_add(value, memory_order_relaxed);
+    
+    uint64_t current = max_.load(memory_order_relaxed);
+    while (value > current && !max_.compare_exchange_weak(current, value, memory_order_relaxed)) {
+    }
+}
+
+void AtomicLatencyHistogram::addTo(LatencyHistogram& out) const {
+    for (size_t i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+        uint64_t n = buckets_[i].load(memory_order_relaxed);
+        out.buckets_[i] += n;
+        out.count_ += n;
+    }
+    out.sum_ += sum_.load(memory_order_relaxed);
+    out.max_ = max(out.max_, max_.load(memory_order_relaxed));
+}
+
+LatencyHistogram AtomicLatencyHistogram::snapshot() const {
+    LatencyHistogram result;
+    addTo(result);
+    return result;
+}
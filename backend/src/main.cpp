@@ -1,453 +1,792 @@
-#include "weather_service.h"
-#include "icon_renderer.h"
-#include <iostream>
-#include <string>
-#include <thread>
-#include <chrono>
-#include <memory>
-#include <csignal>
-#include <cstdlib>
-#include <atomic>
-
-#ifdef _WIN32
-#include <windows.h>
-#else
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
-#endif
-
-using namespace std;
-using namespace chrono;
-
-atomic<bool> running{true};
-
-// 信号处理
-#ifdef _WIN32
-BOOL WINAPI ConsoleHandler(DWORD signal) {
-    if (signal == CTRL_C_EVENT || signal == CTRL_CLOSE_EVENT) {
-        running = false;
-        return TRUE;
-    }
-    return FALSE;
-}
-#else
-void SignalHandler(int signal) {
-    if (signal == SIGINT || signal == SIGTERM) {
-        running = false;
-    }
-}
-#endif
-
-// 创建守护进程（Linux/macOS）
-#ifdef __linux__
-void Daemonize() {
-    pid_t pid = fork();
-    
-    if (pid < 0) {
-        exit(EXIT_FAILURE);
-    }
-    
-    if (pid > 0) {
-        exit(EXIT_SUCCESS);
-    }
-    
-    if (setsid() < 0) {
-        exit(EXIT_FAILURE);
-    }
-    
-    signal(SIGCHLD, SIG_IGN);
-    signal(SIGHUP, SIG_IGN);
-    
-    pid = fork();
-    if (pid < 0) {
-        exit(EXIT_FAILURE);
-    }
-    
-    if (pid > 0) {
-        exit(EXIT_SUCCESS);
-    }
-    
-    umask(0);
-    
-    chdir("/");
-    
-    // 关闭所有打开的文件描述符
-    for (int x = sysconf(_SC_OPEN_MAX); x >= 0; x--) {
-        close(x);
-    }
-}
-#endif
-
-// 简单的HTTP服务器（用于演示，实际项目应该使用cpp-httplib或类似库）
-class SimpleHttpServer {
-public:
-    SimpleHttpServer(int port) : port_(port) {}
-    
-    void Start() {
-        // 这里应该启动一个真正的HTTP服务器
-        // 为了简化，我们只打印信息
-        cout << "HTTP服务器监听在端口 " << port_ << endl;
-        cout << "API端点:" << endl;
-        cout << "  GET /api/weather?city=北京" << endl;
-        cout << "  GET /api/forecast?city=北京&days=7" << endl;
-        cout << "  GET /api/search?q=Bei" << endl;
-        cout << "  GET /api/icon/sunny.png" << endl;
-    }
-    
-    void Stop() {
-        cout << "HTTP服务器已停止" << endl;
-    }
-    
-private:
-    int port_;
-};
-
-// 配置文件管理
-class ConfigManager {
-public:
-    struct Config {
-        string api_endpoint = "https://api.open-meteo.com/v1";
-        string language = "zh";
-        string units = "metric";
-        int cache_ttl = 300; // 5分钟
-        int http_port = 8080;
-        bool daemon_mode = false;
-        bool enable_cache = true;
-        string log_file = "weather_service.log";
-    };
-    
-    Config LoadConfig(const string& filename) {
-        Config config;
-        
-        // 简化的配置加载
-        // 实际项目中应该使用JSON或YAML解析库
-        ifstream file(filename);
-        if (file.is_open()) {
-            string line;
-            while (getline(file, line)) {
-                size_t pos = line.find('=');
-                if (pos != string::npos) {
-                    string key = line.substr(0, pos);
-                    string value = line.substr(pos + 1);
-                    
-                    if (key == "api_endpoint") config.api_endpoint = value;
-                    else if (key == "language") config.language = value;
-                    else if (key == "units") config.units = value;
-                    else if (key == "cache_ttl") config.cache_ttl = stoi(value);
-                    else if (key == "http_port") config.http_port = stoi(value);
-                    else if (key == "daemon_mode") config.daemon_mode = (value == "true");
-                    else if (key == "enable_cache") config.enable_cache = (value == "true");
-                    else if (key == "log_file") config.log_file = value;
-                }
-            }
-        }
-        
-        return config;
-    }
-    
-    void SaveConfig(const Config& config, const string& filename) {
-        ofstream file(filename);
-        if (file.is_open()) {
-            file << "api_endpoint=" << config.api_endpoint << endl;
-            file << "language=" << config.language << endl;
-            file << "units=" << config.units << endl;
-            file << "cache_ttl=" << config.cache_ttl << endl;
-            file << "http_port=" << config.http_port << endl;
-            file << "daemon_mode=" << (config.daemon_mode ? "true" : "false") << endl;
-            file << "enable_cache=" << (config.enable_cache ? "true" : "false") << endl;
-            file << "log_file=" << config.log_file << endl;
-        }
-    }
-};
-
-// 日志系统
-class Logger {
-public:
-    enum LogLevel {
-        DEBUG,
-        INFO,
-        WARNING,
-        ERROR
-    };
-    
-    Logger(const string& filename = "") {
-        if (!filename.empty()) {
-            log_file_.open(filename, ios::app);
-        }
-    }
-    
-    ~Logger() {
-        if (log_file_.is_open()) {
-            log_file_.close();
-        }
-    }
-    
-    void Log(LogLevel level, const string& message) {
-        string timestamp = GetCurrentTime();
-        string levelStr = GetLevelString(level);
-        
-        string logEntry = timestamp + " [" + levelStr + "] " + message;
-        
-        // 输出到控制台
-        cout << logEntry << endl;
-        
-        // 输出到文件
-        if (log_file_.is_open()) {
-            log_file_ << logEntry << endl;
-        }
-    }
-    
-private:
-    ofstream log_file_;
-    
-    string GetCurrentTime() {
-        auto now = system_clock::now();
-        auto time = system_clock::to_time_t(now);
-        auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
-        
-        stringstream ss;
-        ss << put_time(localtime(&time), "%Y-%m-%d %H:%M:%S");
-        ss << '.' << setfill('0') << setw(3) << ms.count();
-        
-        return ss.str();
-    }
-    
-    string GetLevelString(LogLevel level) {
-        switch (level) {
-            case DEBUG: return "DEBUG";
-            case INFO: return "INFO";
-            case WARNING: return "WARN";
-            case ERROR: return "ERROR";
-            default: return "UNKNOWN";
-        }
-    }
-};
-
-// 主程序
-int main(int argc, char* argv[]) {
-    cout << "==========================================" << endl;
-    cout << "       天气服务后端 v1.0.0" << endl;
-    cout << "==========================================" << endl;
-    cout << endl;
-    
-    // 设置信号处理
-#ifdef _WIN32
-    SetConsoleCtrlHandler(ConsoleHandler, TRUE);
-#else
-    signal(SIGINT, SignalHandler);
-    signal(SIGTERM, SignalHandler);
-#endif
-    
-    // 加载配置
-    ConfigManager configManager;
-    string configFile = "weather_service.conf";
-    
-    if (argc > 1) {
-        configFile = argv[1];
-    }
-    
-    auto config = configManager.LoadConfig(configFile);
-    
-    // 设置日志
-    Logger logger(config.log_file);
-    logger.Log(Logger::INFO, "启动天气服务...");
-    
-    // 守护进程模式
-    if (config.daemon_mode) {
-#ifdef __linux__
-        logger.Log(Logger::INFO, "进入守护进程模式...");
-        Daemonize();
-#else
-        logger.Log(Logger::WARNING, "守护进程模式只在Linux系统支持");
-#endif
-    }
-    
-    // 创建天气服务
-    unique_ptr<WeatherService> weatherService;
-    
-    try {
-        weatherService = make_unique<WeatherService>();
-        if (!weatherService->initialize()) {
-            logger.Log(Logger::ERROR, "初始化天气服务失败");
-            return 1;
-        }
-        
-        weatherService->setCacheEnabled(config.enable_cache);
-        weatherService->setCacheTTL(config.cache_ttl);
-        weatherService->setLanguage(config.language);
-        weatherService->setUnits(config.units);
-        
-        logger.Log(Logger::INFO, "天气服务初始化成功");
-    } catch (const exception& e) {
-        logger.Log(Logger::ERROR, string("初始化失败: ") + e.what());
-        return 1;
-    }
-    
-    // 创建图标渲染器
-    unique_ptr<IconRenderer> iconRenderer;
-    try {
-        iconRenderer = make_unique<IconRenderer>();
-        logger.Log(Logger::INFO, "图标渲染器初始化成功");
-    } catch (const exception& e) {
-        logger.Log(Logger::WARNING, string("图标渲染器初始化失败: ") + e.what());
-    }
-    
-    // 启动HTTP服务器
-    SimpleHttpServer httpServer(config.http_port);
-    thread httpThread([&httpServer]() {
-        httpServer.Start();
-    });
-    
-    // 显示帮助信息
-    cout << endl;
-    cout << "服务已启动，输入命令控制服务：" << endl;
-    cout << "  stats        - 显示统计信息" << endl;
-    cout << "  test <城市>  - 测试天气查询" << endl;
-    cout << "  icon <名称>  - 测试图标渲染" << endl;
-    cout << "  config       - 显示当前配置" << endl;
-    cout << "  clear        - 清空缓存" << endl;
-    cout << "  save         - 保存配置" << endl;
-    cout << "  help         - 显示帮助" << endl;
-    cout << "  quit/exit    - 退出程序" << endl;
-    cout << endl;
-    
-    // 主命令循环
-    while (running) {
-        cout << "> ";
-        
-        string command;
-        if (!getline(cin, command)) {
-            // 输入结束
-            break;
-        }
-        
-        // 处理命令
-        if (command == "quit" || command == "exit") {
-            break;
-        } else if (command == "stats") {
-            if (weatherService) {
-                auto stats = weatherService->getStatistics();
-                cout << "统计信息:" << endl;
-                cout << "  总请求数: " << stats.total_requests << endl;
-                cout << "  缓存命中: " << stats.cache_hits << endl;
-                cout << "  API调用: " << stats.api_calls << endl;
-                cout << "  缓存命中率: " 
-                     << (stats.total_requests > 0 ? 
-                         (stats.cache_hits * 100.0 / stats.total_requests) : 0)
-                     << "%" << endl;
-                cout << "  平均响应时间: " 
-                     << (stats.total_requests > 0 ? 
-                         stats.total_response_time / stats.total_requests : 0)
-                     << "ms" << endl;
-            }
-        } else if (command.find("test ") == 0) {
-            string city = command.substr(5);
-            if (!city.empty()) {
-                cout << "测试查询城市: " << city << endl;
-                
-                try {
-                    WeatherRequest request;
-                    request.type = WeatherRequest::CURRENT_WEATHER;
-                    request.city_name = city;
-                    request.language = config.language;
-                    
-                    auto response = weatherService->processRequest(request);
-                    
-                    if (response.success) {
-                        cout << "查询成功:" << endl;
-                        cout << "  城市: " << response.current_weather.city << endl;
-                        cout << "  温度: " << response.current_weather.temperature << "°C" << endl;
-                        cout << "  体感温度: " << response.current_weather.feels_like << "°C" << endl;
-                        cout << "  湿度: " << response.current_weather.humidity << "%" << endl;
-                        cout << "  风速: " << response.current_weather.wind_speed << " km/h" << endl;
-                        cout << "  天气状况: " << response.current_weather.condition << endl;
-                        cout << "  图标: " << response.current_weather.icon_name << endl;
-                    } else {
-                        cout << "查询失败: " << response.error_message << endl;
-                    }
-                } catch (const exception& e) {
-                    cout << "查询异常: " << e.what() << endl;
-                }
-            }
-        } else if (command.find("icon ") == 0) {
-            if (iconRenderer) {
-                string iconName = command.substr(5);
-                cout << "测试渲染图标: " << iconName << endl;
-                
-                try {
-                    auto iconData = iconRenderer->renderIcon(iconName, IconRenderer::LARGE);
-                    cout << "图标渲染成功，大小: " << iconData.size() << " 字节" << endl;
-                    
-                    // 保存到文件
-                    string filename = iconName + ".bmp";
-                    if (iconRenderer->renderIconToFile(iconName, filename)) {
-                        cout << "图标已保存到: " << filename << endl;
-                    }
-                    
-                    // 获取SVG路径数据
-                    string svgPath = iconRenderer->getSVGPathData(iconName);
-                    if (!svgPath.empty()) {
-                        cout << "SVG路径数据: " << svgPath << endl;
-                    }
-                } catch (const exception& e) {
-                    cout << "图标渲染失败: " << e.what() << endl;
-                }
-            } else {
-                cout << "图标渲染器未初始化" << endl;
-            }
-        } else if (command == "config") {
-            cout << "当前配置:" << endl;
-            cout << "  API端点: " << config.api_endpoint << endl;
-            cout << "  语言: " << config.language << endl;
-            cout << "  单位制: " << config.units << endl;
-            cout << "  缓存TTL: " << config.cache_ttl << "秒" << endl;
-            cout << "  HTTP端口: " << config.http_port << endl;
-            cout << "  守护进程模式: " << (config.daemon_mode ? "是" : "否") << endl;
-            cout << "  启用缓存: " << (config.enable_cache ? "是" : "否") << endl;
-            cout << "  日志文件: " << config.log_file << endl;
-        } else if (command == "clear") {
-            if (weatherService) {
-                weatherService->setCacheEnabled(false);
-                weatherService->setCacheEnabled(true);
-                cout << "缓存已清空" << endl;
-            }
-        } else if (command == "save") {
-            configManager.SaveConfig(config, configFile);
-            cout << "配置已保存到: " << configFile << endl;
-        } else if (command == "help") {
-            cout << "可用命令:" << endl;
-            cout << "  stats                 - 显示统计信息" << endl;
-            cout << "  test <城市>           - 测试天气查询" << endl;
-            cout << "  icon <名称>           - 测试图标渲染" << endl;
-            cout << "  config                - 显示当前配置" << endl;
-            cout << "  clear                 - 清空缓存" << endl;
-            cout << "  save                  - 保存配置" << endl;
-            cout << "  help                  - 显示帮助" << endl;
-            cout << "  quit/exit             - 退出程序" << endl;
-        } else if (!command.empty()) {
-            cout << "未知命令: " << command << endl;
-            cout << "输入 'help' 查看可用命令" << endl;
-        }
-        
-        // 防止CPU占用过高
-        this_thread::sleep_for(milliseconds(10));
-    }
-    
-    // 停止服务
-    logger.Log(Logger::INFO, "正在停止服务...");
-    
-    running = false;
-    
-    // 停止HTTP服务器
-    httpServer.Stop();
-    if (httpThread.joinable()) {
-        httpThread.join();
-    }
-    
-    logger.Log(Logger::INFO, "服务已停止");
-    cout << "再见！" << endl;
-    
-    return 0;
-}
\ No newline at end of file
+#include "weather_service.h"
+#include "icon_renderer.h"
+#include "http_server.h"
+#include "subscription_manager.h"
+#include "shared_cache.h"
+#include "trace.h"
+#ifdef __linux__
+#include "ipc_server.h"
+#endif
+#ifdef WEATHER_WITH_GRPC
+#include "rpc_server.h"
+#endif
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <atomic>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#endif
+
+#ifdef __linux__
+#include <sys/prctl.h>
+#endif
+
+using namespace std;
+using namespace chrono;
+
+atomic<bool> running{true};
+
+// 信号处理
+#ifdef _WIN32
+BOOL WINAPI ConsoleHandler(DWORD signal) {
+    if (signal == CTRL_C_EVENT || signal == CTRL_CLOSE_EVENT) {
+        running = false;
+        return TRUE;
+    }
+    return FALSE;
+}
+#else
+void SignalHandler(int signal) {
+    if (signal == SIGINT || signal == SIGTERM) {
+        running = false;
+    }
+}
+#endif
+
+// 创建守护进程（Linux/macOS）
+#ifdef __linux__
+void Daemonize() {
+    pid_t pid = fork();
+    
+    if (pid < 0) {
+        exit(EXIT_FAILURE);
+    }
+    
+    if (pid > 0) {
+        exit(EXIT_SUCCESS);
+    }
+    
+    if (setsid() < 0) {
+        exit(EXIT_FAILURE);
+    }
+    
+    signal(SIGCHLD, SIG_IGN);
+    signal(SIGHUP, SIG_IGN);
+    
+    pid = fork();
+    if (pid < 0) {
+        exit(EXIT_FAILURE);
+    }
+    
+    if (pid > 0) {
+        exit(EXIT_SUCCESS);
+    }
+    
+    umask(0);
+    
+    chdir("/");
+    
+    // 关闭所有打开的文件描述符
+    for (int x = sysconf(_SC_OPEN_MAX); x >= 0; x--) {
+        close(x);
+    }
+}
+#endif
+
+// 拆分逗号分隔的列表，去掉空白和空项
+static vector<string> splitList(const string& text) {
+    vector<string> items;
+    stringstream stream(text);
+    string item;
+    while (getline(stream, item, ',')) {
+        size_t begin = item.find_first_not_of(" \t");
+        if (begin != string::npos) {
+            items.push_back(item.substr(begin, item.find_last_not_of(" \t") - begin + 1));
+        }
+    }
+    return items;
+}
+
+// 配置文件管理
+class ConfigManager {
+public:
+    struct Config {
+        string api_endpoint = "https://api.open-meteo.com/v1";
+        string language = "zh";
+        string units = "metric";
+        int cache_ttl = 300; // 5分钟
+        int http_port = 8080;
+        int http_threads = 1;    // HTTP事件循环线程数
+        int worker_threads = 0;  // 请求处理线程数，0表示CPU核数
+        string rpc_address = "0.0.0.0:50051";
+        int rpc_threads = 0;     // gRPC CompletionQueue线程数，0表示CPU核数
+        double client_rate = 10.0;       // 每客户端每秒可发起的上游请求数，0表示不限速
+        double client_burst = 20.0;      // 每客户端突发上限
+        string trusted_proxies;          // 逗号分隔的反向代理IP，只有来自这些地址的请求才按X-Client-Id限速
+        int max_upstream_requests = 0;   // 同时访问上游的请求上限，0表示自动
+        int workers = 1;         // 工作进程数，大于1时多个进程通过SO_REUSEPORT监听同一端口（仅Linux）
+        int shared_cache_mb = 64;        // 多进程模式下共享缓存的大小
+        string ipc_socket = "/tmp/weather_service.sock";   // 本机IPC套接字路径，为空时不启用（仅Linux）
+        double trace_sample_rate = 0.0;  // 请求追踪采样率（0~1），0表示关闭
+        bool daemon_mode = false;
+        bool enable_cache = true;
+        string log_file = "weather_service.log";
+    };
+    
+    Config LoadConfig(const string& filename) {
+        Config config;
+        
+        // 简化的配置加载
+        // 实际项目中应该使用JSON或YAML解析库
+        ifstream file(filename);
+        if (file.is_open()) {
+            string line;
+            while (getline(file, line)) {
+                size_t pos = line.find('=');
+                if (pos != string::npos) {
+                    string key = line.substr(0, pos);
+                    string value = line.substr(pos + 1);
+                    
+                    if (key == "api_endpoint") config.api_endpoint = value;
+                    else if (key == "language") config.language = value;
+                    else if (key == "units") config.units = value;
+                    else if (key == "cache_ttl") config.cache_ttl = stoi(value);
+                    else if (key == "http_port") config.http_port = stoi(value);
+                    else if (key == "http_threads") config.http_threads = stoi(value);
+                    else if (key == "worker_threads") config.worker_threads = stoi(value);
+                    else if (key == "rpc_address") config.rpc_address = value;
+                    else if (key == "rpc_threads") config.rpc_threads = stoi(value);
+                    else if (key == "client_rate") config.client_rate = stod(value);
+                    else if (key == "client_burst") config.client_burst = stod(value);
+                    else if (key == "trusted_proxies") config.trusted_proxies = value;
+                    else if (key == "max_upstream_requests") config.max_upstream_requests = stoi(value);
+                    else if (key == "workers") config.workers = stoi(value);
+                    else if (key == "shared_cache_mb") config.shared_cache_mb = stoi(value);
+                    else if (key == "ipc_socket") config.ipc_socket = value;
+                    else if (key == "trace_sample_rate") config.trace_sample_rate = stod(value);
+                    else if (key == "daemon_mode") config.daemon_mode = (value == "true");
+                    else if (key == "enable_cache") config.enable_cache = (value == "true");
+                    else if (key == "log_file") config.log_file = value;
+                }
+            }
+        }
+        
+        return config;
+    }
+    
+    void SaveConfig(const Config& config, const string& filename) {
+        ofstream file(filename);
+        if (file.is_open()) {
+            file << "api_endpoint=" << config.api_endpoint << endl;
+            file << "language=" << config.language << endl;
+            file << "units=" << config.units << endl;
+            file << "cache_ttl=" << config.cache_ttl << endl;
+            file << "http_port=" << config.http_port << endl;
+            file << "http_threads=" << config.http_threads << endl;
+            file << "worker_threads=" << config.worker_threads << endl;
+            file << "rpc_address=" << config.rpc_address << endl;
+            file << "rpc_threads=" << config.rpc_threads << endl;
+            file << "client_rate=" << config.client_rate << endl;
+            file << "client_burst=" << config.client_burst << endl;
+            file << "trusted_proxies=" << config.trusted_proxies << endl;
+            file << "max_upstream_requests=" << config.max_upstream_requests << endl;
+            file << "workers=" << config.workers << endl;
+            file << "shared_cache_mb=" << config.shared_cache_mb << endl;
+            file << "ipc_socket=" << config.ipc_socket << endl;
+            file << "trace_sample_rate=" << config.trace_sample_rate << endl;
+            file << "daemon_mode=" << (config.daemon_mode ? "true" : "false") << endl;
+            file << "enable_cache=" << (config.enable_cache ? "true" : "false") << endl;
+            file << "log_file=" << config.log_file << endl;
+        }
+    }
+};
+
+// 日志系统
+class Logger {
+public:
+    enum LogLevel {
+        DEBUG,
+        INFO,
+        WARNING,
+        ERROR
+    };
+    
+    Logger(const string& filename = "") {
+        if (!filename.empty()) {
+            log_file_.open(filename, ios::app);
+        }
+    }
+    
+    ~Logger() {
+        if (log_file_.is_open()) {
+            log_file_.close();
+        }
+    }
+    
+    void Log(LogLevel level, const string& message) {
+        string timestamp = GetCurrentTime();
+        string levelStr = GetLevelString(level);
+        
+        string logEntry = timestamp + " [" + levelStr + "] " + message;
+        
+        // 输出到控制台
+        cout << logEntry << endl;
+        
+        // 输出到文件
+        if (log_file_.is_open()) {
+            log_file_ << logEntry << endl;
+        }
+    }
+    
+private:
+    ofstream log_file_;
+    
+    string GetCurrentTime() {
+        auto now = system_clock::now();
+        auto time = system_clock::to_time_t(now);
+        auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
+        
+        stringstream ss;
+        ss << put_time(localtime(&time), "%Y-%m-%d %H:%M:%S");
+        ss << '.' << setfill('0') << setw(3) << ms.count();
+        
+        return ss.str();
+    }
+    
+    string GetLevelString(LogLevel level) {
+        switch (level) {
+            case DEBUG: return "DEBUG";
+            case INFO: return "INFO";
+            case WARNING: return "WARN";
+            case ERROR: return "ERROR";
+            default: return "UNKNOWN";
+        }
+    }
+};
+
+#ifdef __linux__
+// 多进程模式：主进程只创建工作进程并在其异常退出时重新启动，不处理请求。
+// 必须在创建任何线程之前调用。工作进程中返回其编号，主进程在收到退出信号、
+// 停止所有工作进程后返回-1
+int RunWorkerSupervisor(int workers, Logger& logger) {
+    pid_t master = getpid();
+    vector<pid_t> pids(workers, 0);
+    
+    // 守护进程模式忽略了SIGCHLD，需要恢复才能等待工作进程
+    signal(SIGCHLD, SIG_DFL);
+    
+    auto spawn = [&](int index) -> pid_t {
+        pid_t pid = fork();
+        if (pid == 0) {
+            // 主进程被强制结束时工作进程也随之退出
+            prctl(PR_SET_PDEATHSIG, SIGTERM);
+            if (getppid() != master) {
+                _exit(EXIT_SUCCESS);
+            }
+        } else if (pid > 0) {
+            pids[index] = pid;
+            logger.Log(Logger::INFO, "工作进程 " + to_string(index) + " 已启动, pid " + to_string(pid));
+        } else {
+            logger.Log(Logger::ERROR, "创建工作进程失败: " + string(strerror(errno)));
+        }
+        return pid;
+    };
+    
+    for (int i = 0; i < workers; i++) {
+        if (spawn(i) == 0) {
+            return i;
+        }
+    }
+    
+    while (running) {
+        int status;
+        pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0) {
+            this_thread::sleep_for(milliseconds(200));
+            continue;
+        }
+        
+        for (int i = 0; i < workers; i++) {
+            if (pids[i] != pid) {
+                continue;
+            }
+            pids[i] = 0;
+            logger.Log(Logger::WARNING, "工作进程 " + to_string(i) + " 退出（" +
+                       (WIFSIGNALED(status) ? "信号 " + to_string(WTERMSIG(status))
+                                            : "状态 " + to_string(WEXITSTATUS(status))) +
+                       "），重新启动");
+            // 避免启动即崩溃时占满CPU
+            this_thread::sleep_for(seconds(1));
+            if (running && spawn(i) == 0) {
+                return i;
+            }
+        }
+    }
+    
+    for (pid_t pid : pids) {
+        if (pid > 0) {
+            kill(pid, SIGTERM);
+        }
+    }
+    for (pid_t pid : pids) {
+        if (pid > 0) {
+            waitpid(pid, nullptr, 0);
+        }
+    }
+    return -1;
+}
+#endif
+
+// 主程序
+int main(int argc, char* argv[]) {
+    cout << "==========================================" << endl;
+    cout << "       天气服务后端 v1.0.0" << endl;
+    cout << "==========================================" << endl;
+    cout << endl;
+    
+    // 设置信号处理
+#ifdef _WIN32
+    SetConsoleCtrlHandler(ConsoleHandler, TRUE);
+#else
+    signal(SIGINT, SignalHandler);
+    signal(SIGTERM, SignalHandler);
+#endif
+    
+    // 加载配置
+    ConfigManager configManager;
+    string configFile = "weather_service.conf";
+    
+    if (argc > 1) {
+        configFile = argv[1];
+    }
+    
+    auto config = configManager.LoadConfig(configFile);
+    
+    // 设置日志
+    Logger logger(config.log_file);
+    logger.Log(Logger::INFO, "启动天气服务...");
+    
+    // 守护进程模式
+    if (config.daemon_mode) {
+#ifdef __linux__
+        logger.Log(Logger::INFO, "进入守护进程模式...");
+        Daemonize();
+#else
+        logger.Log(Logger::WARNING, "守护进程模式只在Linux系统支持");
+#endif
+    }
+    
+    // 多进程模式：共享缓存和工作进程都在创建任何线程之前准备好
+    bool workerProcess = false;
+    int workerIndex = 0;
+#ifdef __linux__
+    unique_ptr<SharedMemoryCache> sharedCache;
+    if (config.workers > 1) {
+        sharedCache = SharedMemoryCache::create(static_cast<size_t>(max(1, config.shared_cache_mb)) << 20);
+        if (!sharedCache) {
+            logger.Log(Logger::WARNING, "创建共享内存缓存失败，使用单进程模式");
+        } else {
+            logger.Log(Logger::INFO, "多进程模式: " + to_string(config.workers) + " 个工作进程，共享缓存 " +
+                       to_string(config.shared_cache_mb) + "MB");
+            int index = RunWorkerSupervisor(config.workers, logger);
+            if (index < 0) {
+                auto shmStats = sharedCache->getStatistics();
+                logger.Log(Logger::INFO, "共享缓存: 命中 " + to_string(shmStats.hits) +
+                           ", 未命中 " + to_string(shmStats.misses) +
+                           ", 写入 " + to_string(shmStats.stores) +
+                           ", 淘汰 " + to_string(shmStats.evictions) +
+                           ", 当前项数 " + to_string(shmStats.entries));
+                logger.Log(Logger::INFO, "服务已停止");
+                return 0;
+            }
+            workerProcess = true;
+            workerIndex = index;
+        }
+    }
+#else
+    if (config.workers > 1) {
+        logger.Log(Logger::WARNING, "多进程模式只在Linux系统支持");
+    }
+#endif
+
+    // 创建天气服务
+    unique_ptr<WeatherService> weatherService;
+    
+    try {
+        weatherService = make_unique<WeatherService>();
+        if (!weatherService->initialize()) {
+            logger.Log(Logger::ERROR, "初始化天气服务失败");
+            return 1;
+        }
+        
+        weatherService->setCacheEnabled(config.enable_cache);
+        weatherService->setCacheTTL(config.cache_ttl);
+        weatherService->setLanguage(config.language);
+        weatherService->setUnits(config.units);
+        weatherService->setWorkerThreads(config.worker_threads);
+        
+        AdmissionController::Options admission;
+        admission.client_rate = config.client_rate;
+        admission.client_burst = config.client_burst;
+        admission.max_upstream_in_flight = max(0, config.max_upstream_requests);
+        weatherService->setAdmissionOptions(admission);
+        Trace::setSampleRate(config.trace_sample_rate);
+        
+#ifdef __linux__
+        if (workerProcess) {
+            weatherService->setSharedCache(sharedCache.get());
+        }
+#endif
+
+        logger.Log(Logger::INFO, "天气服务初始化成功");
+    } catch (const exception& e) {
+        logger.Log(Logger::ERROR, string("初始化失败: ") + e.what());
+        return 1;
+    }
+    
+    // 创建图标渲染器
+    unique_ptr<IconRenderer> iconRenderer;
+    try {
+        iconRenderer = make_unique<IconRenderer>();
+        iconRenderer->setExecutor(&weatherService->getExecutor());
+        iconRenderer->prewarmCache();
+        logger.Log(Logger::INFO, "图标渲染器初始化成功，已缓存 " +
+                   to_string(iconRenderer->getCacheStatistics().entries) + " 项渲染结果");
+    } catch (const exception& e) {
+        logger.Log(Logger::WARNING, string("图标渲染器初始化失败: ") + e.what());
+    }
+    
+    // 启动HTTP服务器
+    HttpServer::Options httpOptions;
+    httpOptions.port = config.http_port;
+    httpOptions.io_threads = config.http_threads;
+    httpOptions.reuse_port = workerProcess;
+    httpOptions.trusted_proxies = splitList(config.trusted_proxies);
+    HttpServer httpServer(httpOptions, weatherService.get(), iconRenderer.get());
+    thread httpThread([&httpServer]() {
+        httpServer.Start();
+    });
+    
+#ifdef WEATHER_WITH_GRPC
+    // 启动RPC服务器
+    RPCServer::Options rpcOptions;
+    rpcOptions.address = config.rpc_address;
+    rpcOptions.cq_threads = config.rpc_threads;
+    rpcOptions.reuse_port = workerProcess;
+    rpcOptions.trusted_proxies = splitList(config.trusted_proxies);
+    RPCServer rpcServer(rpcOptions, weatherService.get());
+    if (!rpcServer.Start()) {
+        logger.Log(Logger::WARNING, "RPC服务器启动失败");
+    }
+#endif
+
+#ifdef __linux__
+    // 启动本机IPC服务器，多进程模式下只由第一个工作进程监听（缓存是共享的）
+    unique_ptr<IpcServer> ipcServer;
+    if (!config.ipc_socket.empty() && workerIndex == 0) {
+        IpcServer::Options ipcOptions;
+        ipcOptions.socket_path = config.ipc_socket;
+        ipcServer = make_unique<IpcServer>(ipcOptions, weatherService.get());
+        if (!ipcServer->Start()) {
+            logger.Log(Logger::WARNING, "IPC服务器启动失败");
+            ipcServer.reset();
+        }
+    }
+#endif
+
+    if (workerProcess) {
+        // 工作进程没有控制台，等待主进程转发的退出信号
+        while (running) {
+            this_thread::sleep_for(milliseconds(200));
+        }
+    } else {
+        // 显示帮助信息
+        cout << endl;
+        cout << "服务已启动，输入命令控制服务：" << endl;
+        cout << "  stats        - 显示统计信息" << endl;
+        cout << "  test <城市>  - 测试天气查询" << endl;
+        cout << "  icon <名称>  - 测试图标渲染" << endl;
+        cout << "  config       - 显示当前配置" << endl;
+        cout << "  clear        - 清空缓存" << endl;
+        cout << "  save         - 保存配置" << endl;
+        cout << "  trace <比例> - 设置请求追踪采样率（0~1）" << endl;
+        cout << "  trace dump [文件] - 导出追踪记录（Chrome trace JSON）" << endl;
+        cout << "  help         - 显示帮助" << endl;
+        cout << "  quit/exit    - 退出程序" << endl;
+        cout << endl;
+    
+        // 主命令循环
+        while (running) {
+            cout << "> ";
+        
+            string command;
+            if (!getline(cin, command)) {
+                // 输入结束
+                break;
+            }
+            
+            // 处理命令
+            if (command == "quit" || command == "exit") {
+                break;
+            } else if (command == "stats") {
+                if (weatherService) {
+                    auto stats = weatherService->getStatistics();
+                    cout << "统计信息:" << endl;
+                    cout << "  总请求数: " << stats.total_requests << endl;
+                    cout << "  缓存命中: " << stats.cache_hits << endl;
+                    cout << "  API调用: " << stats.api_calls << endl;
+                    cout << "  上游错误: " << stats.upstream_errors << endl;
+                    cout << "  负缓存命中: " << stats.negative_hits << endl;
+                    cout << "  缓存命中率: " 
+                         << (stats.total_requests > 0 ? 
+                             (stats.cache_hits * 100.0 / stats.total_requests) : 0)
+                         << "%" << endl;
+                    
+                    // 延迟按毫秒显示，精确到微秒
+                    auto printLatency = [](const string& label, const WeatherService::LatencySummary& l) {
+                        cout << "  " << label << ": " << l.count << " 次, 平均 " << fixed << setprecision(3)
+                             << l.mean_us / 1000.0 << "ms, p50 " << l.p50_us / 1000.0
+                             << "ms, p90 " << l.p90_us / 1000.0 << "ms, p99 " << l.p99_us / 1000.0
+                             << "ms, p999 " << l.p999_us / 1000.0 << "ms, 最大 " << l.max_us / 1000.0
+                             << "ms" << defaultfloat << endl;
+                    };
+                    static const char* const typeNames[] = {"当前天气", "预报", "城市搜索", "坐标查询", "批量"};
+                    static const char* const outcomeNames[] = {"命中", "未命中", "错误"};
+                    cout << "响应时间:" << endl;
+                    printLatency("全部", stats.latency);
+                    for (size_t type = 0; type < RequestStatistics::TYPE_COUNT; type++) {
+                        for (size_t outcome = 0; outcome < RequestStatistics::OUTCOME_COUNT; outcome++) {
+                            if (stats.latency_by_type[type][outcome].count > 0) {
+                                printLatency(string(typeNames[type]) + "/" + outcomeNames[outcome],
+                                             stats.latency_by_type[type][outcome]);
+                            }
+                        }
+                    }
+                }
+                if (weatherService) {
+                    auto execStats = weatherService->getExecutorStatistics();
+                    cout << "线程池:" << endl;
+                    cout << "  排队任务: " << execStats.queue_depth << endl;
+                    cout << "  已提交/已执行: " << execStats.submitted << "/" << execStats.executed << endl;
+                    cout << "  窃取次数: " << execStats.steals << endl;
+                    for (size_t i = 0; i < execStats.workers.size(); i++) {
+                        const auto& w = execStats.workers[i];
+                        cout << "  工作线程" << i << ": 队列 " << w.queue_depth
+                             << ", 执行 " << w.executed
+                             << ", 窃取 " << w.stolen
+                             << ", 利用率 " << fixed << setprecision(1) << w.utilization * 100 << "%"
+                             << defaultfloat << endl;
+                    }
+                    
+                    auto admStats = weatherService->getAdmissionStatistics();
+                    cout << "准入控制:" << endl;
+                    cout << "  上游并发: " << admStats.upstream_in_flight << "/" << admStats.upstream_limit << endl;
+                    cout << "  已放行: " << admStats.admitted << endl;
+                    cout << "  限速拒绝: " << admStats.rate_limited << endl;
+                    cout << "  过载拒绝: " << admStats.overloaded << endl;
+                    cout << "  跟踪客户端: " << admStats.tracked_clients << endl;
+                    
+                    auto subStats = weatherService->getSubscriptions().getStatistics();
+                    cout << "推送订阅:" << endl;
+                    cout << "  订阅位置: " << subStats.locations << endl;
+                    cout << "  订阅者: " << subStats.subscribers << endl;
+                    cout << "  刷新次数: " << subStats.refreshes << endl;
+                    cout << "  推送次数: " << subStats.notifications << endl;
+                    
+                    auto deltaStats = weatherService->getDeltaStatistics();
+                    cout << "预报增量编码:" << endl;
+                    cout << "  完整快照/增量: " << deltaStats.full_snapshots << "/" << deltaStats.deltas << endl;
+                    cout << "  跟踪位置: " << deltaStats.locations << endl;
+                }
+                auto httpStats = httpServer.GetStatistics();
+                cout << "HTTP服务器:" << endl;
+                cout << "  请求数: " << httpStats.requests << endl;
+                cout << "  错误请求: " << httpStats.bad_requests << endl;
+                cout << "  活动连接: " << httpStats.active_connections << endl;
+                cout << "  已接受/拒绝连接: " << httpStats.connections_accepted
+                     << "/" << httpStats.connections_rejected << endl;
+                cout << "  使用中的读缓冲: " << httpStats.buffers_in_use << "，耗尽次数: "
+                     << httpStats.buffers_exhausted << endl;
+                if (iconRenderer) {
+                    auto iconStats = iconRenderer->getCacheStatistics();
+                    cout << "图标缓存:" << endl;
+                    cout << "  命中/未命中: " << iconStats.hits << "/" << iconStats.misses << endl;
+                    cout << "  缓存项: " << iconStats.entries << "（" << iconStats.bytes / 1024 << " KB），已淘汰 "
+                         << iconStats.evictions << endl;
+                    cout << "  图集/主光栅: " << iconStats.atlases << "（" << iconStats.atlas_bytes / 1024 << " KB）/"
+                         << iconStats.masters << endl;
+                }
+#ifdef __linux__
+                if (ipcServer) {
+                    auto ipcStats = ipcServer->GetStatistics();
+                    cout << "IPC服务器:" << endl;
+                    cout << "  请求数: " << ipcStats.requests << endl;
+                    cout << "  环形缓冲区/套接字响应: " << ipcStats.ring_responses
+                         << "/" << ipcStats.inline_responses << endl;
+                    cout << "  错误请求: " << ipcStats.bad_requests << endl;
+                    cout << "  客户端: " << ipcStats.clients << endl;
+                }
+#endif
+            } else if (command.find("test ") == 0) {
+                string city = command.substr(5);
+                if (!city.empty()) {
+                    cout << "测试查询城市: " << city << endl;
+                    
+                    try {
+                        WeatherRequest request;
+                        request.type = WeatherRequest::CURRENT_WEATHER;
+                        request.city_name = city;
+                        request.language = config.language;
+                        
+                        auto response = weatherService->processRequestAsync(request).get();
+                        
+                        if (response.success) {
+                            cout << "查询成功:" << endl;
+                            cout << "  城市: " << response.current_weather.city << endl;
+                            cout << "  温度: " << response.current_weather.temperature << "°C" << endl;
+                            cout << "  体感温度: " << response.current_weather.feels_like << "°C" << endl;
+                            cout << "  湿度: " << response.current_weather.humidity << "%" << endl;
+                            cout << "  风速: " << response.current_weather.wind_speed << " km/h" << endl;
+                            cout << "  天气状况: " << response.current_weather.condition << endl;
+                            cout << "  图标: " << response.current_weather.icon_name << endl;
+                        } else {
+                            cout << "查询失败: " << response.error_message << endl;
+                        }
+                    } catch (const exception& e) {
+                        cout << "查询异常: " << e.what() << endl;
+                    }
+                }
+            } else if (command.find("icon ") == 0) {
+                if (iconRenderer) {
+                    string iconName = command.substr(5);
+                    cout << "测试渲染图标: " << iconName << endl;
+                    
+                    try {
+                        auto iconData = iconRenderer->renderIcon(iconName, IconRenderer::LARGE);
+                        cout << "图标渲染成功，大小: " << iconData.size() << " 字节" << endl;
+                        
+                        // 保存到文件
+                        string filename = iconName + ".png";
+                        if (iconRenderer->renderIconToFile(iconName, filename)) {
+                            cout << "图标已保存到: " << filename << endl;
+                        }
+                        
+                        // 获取SVG路径数据
+                        string svgPath = iconRenderer->getSVGPathData(iconName);
+                        if (!svgPath.empty()) {
+                            cout << "SVG路径数据: " << svgPath << endl;
+                        }
+                    } catch (const exception& e) {
+                        cout << "图标渲染失败: " << e.what() << endl;
+                    }
+                } else {
+                    cout << "图标渲染器未初始化" << endl;
+                }
+            } else if (command == "config") {
+                cout << "当前配置:" << endl;
+                cout << "  API端点: " << config.api_endpoint << endl;
+                cout << "  语言: " << config.language << endl;
+                cout << "  单位制: " << config.units << endl;
+                cout << "  缓存TTL: " << config.cache_ttl << "秒" << endl;
+                cout << "  HTTP端口: " << config.http_port << endl;
+                cout << "  HTTP线程数: " << config.http_threads << endl;
+                cout << "  工作线程数: " << config.worker_threads << endl;
+                cout << "  RPC地址: " << config.rpc_address << endl;
+                cout << "  RPC线程数: " << config.rpc_threads << endl;
+                cout << "  客户端限速: " << config.client_rate << "/秒，突发 " << config.client_burst << endl;
+                cout << "  可信代理: " << (config.trusted_proxies.empty() ? "无" : config.trusted_proxies) << endl;
+                cout << "  上游并发上限: " << config.max_upstream_requests << endl;
+                cout << "  工作进程数: " << config.workers << endl;
+                cout << "  共享缓存: " << config.shared_cache_mb << "MB" << endl;
+                cout << "  IPC套接字: " << (config.ipc_socket.empty() ? "未启用" : config.ipc_socket) << endl;
+                cout << "  追踪采样率: " << config.trace_sample_rate << endl;
+                cout << "  守护进程模式: " << (config.daemon_mode ? "是" : "否") << endl;
+                cout << "  启用缓存: " << (config.enable_cache ? "是" : "否") << endl;
+                cout << "  日志文件: " << config.log_file << endl;
+            } else if (command == "clear") {
+                if (weatherService) {
+                    weatherService->setCacheEnabled(false);
+                    weatherService->setCacheEnabled(true);
+                    cout << "缓存已清空" << endl;
+                }
+            } else if (command == "save") {
+                configManager.SaveConfig(config, configFile);
+                cout << "配置已保存到: " << configFile << endl;
+            } else if (command == "trace dump" || command.find("trace dump ") == 0) {
+                string filename = command.size() > 11 ? command.substr(11) : "trace.json";
+                string trace;
+                size_t events = Trace::exportChromeTrace(trace);
+                ofstream file(filename, ios::binary);
+                if (file.write(trace.data(), trace.size())) {
+                    cout << "已导出 " << events << " 条追踪记录到: " << filename << endl;
+                    cout << "可在 chrome://tracing 或 https://ui.perfetto.dev 中打开" << endl;
+                } else {
+                    cout << "写入失败: " << filename << endl;
+                }
+            } else if (command == "trace" || command.find("trace ") == 0) {
+                if (command.size() > 6) {
+                    try {
+                        config.trace_sample_rate = max(0.0, min(1.0, stod(command.substr(6))));
+                        Trace::setSampleRate(config.trace_sample_rate);
+                    } catch (const exception&) {
+                        cout << "无效的采样率: " << command.substr(6) << endl;
+                    }
+                }
+                cout << "追踪采样率: " << Trace::sampleRate() << endl;
+            } else if (command == "help") {
+                cout << "可用命令:" << endl;
+                cout << "  stats                 - 显示统计信息" << endl;
+                cout << "  test <城市>           - 测试天气查询" << endl;
+                cout << "  icon <名称>           - 测试图标渲染" << endl;
+                cout << "  config                - 显示当前配置" << endl;
+                cout << "  clear                 - 清空缓存" << endl;
+                cout << "  save                  - 保存配置" << endl;
+                cout << "  trace <比例>          - 设置请求追踪采样率（0~1）" << endl;
+                cout << "  trace dump [文件]     - 导出追踪记录（Chrome trace JSON，默认trace.json）" << endl;
+                cout << "  help                  - 显示帮助" << endl;
+                cout << "  quit/exit             - 退出程序" << endl;
+            } else if (!command.empty()) {
+                cout << "未知命令: " << command << endl;
+                cout << "输入 'help' 查看可用命令" << endl;
+            }
+            
+            // 防止CPU占用过高
+            this_thread::sleep_for(milliseconds(10));
+        }
+    }
+    
+    // 停止服务
+    logger.Log(Logger::INFO, "正在停止服务...");
+    
+    running = false;
+
+#ifdef __linux__
+    if (ipcServer) {
+        ipcServer->Stop();
+    }
+#endif
+    
+    // 停止RPC服务器
+#ifdef WEATHER_WITH_GRPC
+    rpcServer.Stop();
+#endif
+
+    // 停止HTTP服务器
+    httpServer.Stop();
+    if (httpThread.joinable()) {
+        httpThread.join();
+    }
+    
+    logger.Log(Logger::INFO, "服务已停止");
+    cout << "再见！" << endl;
+    
+    return 0;
+}
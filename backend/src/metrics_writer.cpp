@@ -0,0 +1,108 @@
+#include "metrics_writer.h"
+#include <charconv>
+#include <cstdio>
+
+using namespace std;
+
+static void appendEscaped(string& out, string_view text, bool quote_escape) {
+    for (char c : text) {
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '"' && quote_escape) {
+            out += "\\\"";
+        } else {
+            out += c;
+        }
+    }
+}
+
+static void appendUnsigned(string& out, uint64_t value) {
+    char buffer[24];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+static void appendDouble(string& out, double value) {
+    char buffer[32];
+    int length = snprintf(buffer, sizeof(buffer), "%.9g", value);
+    out.append(buffer, static_cast<size_t>(length));
+}
+
+void MetricsWriter::family(string_view name, string_view type, string_view help) {
+    out_ += "# HELP ";
+    out_ += name;
+    out_ += ' ';
+    appendEscaped(out_, help, false);
+    out_ += "\n# TYPE ";
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += '\n';
+}
+
+void MetricsWriter::beginSample(string_view name, string_view suffix,
+                                initializer_list<Label> labels, const Label* extra) {
+    out_ += name;
+    out_ += suffix;
+    if (labels.size() == 0 && !extra) {
+        out_ += ' ';
+        return;
+    }
+    
+    out_ += '{';
+    bool first = true;
+    auto append = [&](const Label& label) {
+        if (!first) {
+            out_ += ',';
+        }
+        first = false;
+        out_ += label.name;
+        out_ += "=\"";
+        appendEscaped(out_, label.value, true);
+        out_ += '"';
+    };
+    for (const Label& label : labels) {
+        append(label);
+    }
+    if (extra) {
+        append(*extra);
+    }
+    out_ += "} ";
+}
+
+void MetricsWriter::sample(string_view name, initializer_list<Label> labels, uint64_t value) {
+    beginSample(name, "", labels);
+    appendUnsigned(out_, value);
+    out_ += '\n';
+}
+
+void MetricsWriter::sample(string_view name, initializer_list<Label> labels, double value) {
+    beginSample(name, "", labels);
+    appendDouble(out_, value);
+    out_ += '\n';
+}
+
+void MetricsWriter::histogram(string_view name, initializer_list<Label> labels,
+                              const LatencyHistogram& histogram) {
+    char le[32];
+    for (uint64_t bound : LATENCY_BUCKETS_US) {
+        snprintf(le, sizeof(le), "%g", bound / 1e6);
+        Label label{"le", le};
+        beginSample(name, "_bucket", labels, &label);
+        appendUnsigned(out_, histogram.countAtOrBelow(bound));
+        out_ += '\n';
+    }
+    Label inf{"le", "+Inf"};
+    beginSample(name, "_bucket", labels, &inf);
+    appendUnsigned(out_, histogram.count());
+    out_ += '\n';
+    
+    beginSample(name, "_sum", labels);
+    appendDouble(out_, histogram.sum() / 1e6);
+    out_ += '\n';
+    beginSample(name, "_count", labels);
+    appendUnsigned(out_, histogram.count());
+    out_ += '\n';
+}
@@ -0,0 +1,616 @@
+#include "path_rasterizer.h"
+#include "pixel_kernels.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+namespace {
+
+const double PI = 3.14159265358979323846;
+
+// 路径数据的词法解析和展平
+class SvgPathParser {
+public:
+    SvgPathParser(const string& data, double tolerance)
+        : p_(data.c_str()), end_(data.c_str() + data.size()), tolerance_(tolerance) {}
+    
+    vector<PathContour> parse() {
+        char command = 0;
+        char previous = 0;
+        
+        while (true) {
+            skipSeparators();
+            if (p_ >= end_) {
+                break;
+            }
+            
+            if (isalpha(static_cast<unsigned char>(*p_))) {
+                command = *p_++;
+            } else if (command == 0) {
+                break; // 路径必须以命令开头
+            }
+            
+            bool relative = islower(static_cast<unsigned char>(command)) != 0;
+            double ox = relative ? x_ : 0.0;
+            double oy = relative ? y_ : 0.0;
+            char upper = static_cast<char>(toupper(static_cast<unsigned char>(command)));
+            
+            double a[7];
+            bool ok = true;
+            switch (upper) {
+                case 'M':
+                    if ((ok = numbers(a, 2))) {
+                        moveTo(ox + a[0], oy + a[1]);
+                        // 后续的隐式坐标对按直线处理
+                        command = relative ? 'l' : 'L';
+                    }
+                    break;
+                case 'L':
+                    if ((ok = numbers(a, 2))) {
+                        lineTo(ox + a[0], oy + a[1]);
+                    }
+                    break;
+                case 'H':
+                    if ((ok = numbers(a, 1))) {
+                        lineTo(ox + a[0], y_);
+                    }
+                    break;
+                case 'V':
+                    if ((ok = numbers(a, 1))) {
+                        lineTo(x_, oy + a[0]);
+                    }
+                    break;
+                case 'C':
+                    if ((ok = numbers(a, 6))) {
+                        cubicTo(ox + a[0], oy + a[1], ox + a[2], oy + a[3], ox + a[4], oy + a[5]);
+                    }
+                    break;
+                case 'S':
+                    if ((ok = numbers(a, 4))) {
+                        // 第一个控制点是上一段第二个控制点的镜像
+                        bool smooth = previous == 'C' || previous == 'S';
+                        double c1x = smooth ? 2 * x_ - control_x_ : x_;
+                        double c1y = smooth ? 2 * y_ - control_y_ : y_;
+                        cubicTo(c1x, c1y, ox + a[0], oy + a[1], ox + a[2], oy + a[3]);
+                    }
+                    break;
+                case 'Q':
+                    if ((ok = numbers(a, 4))) {
+                        quadTo(ox + a[0], oy + a[1], ox + a[2], oy + a[3]);
+                    }
+                    break;
+                case 'T':
+                    if ((ok = numbers(a, 2))) {
+                        bool smooth = previous == 'Q' || previous == 'T';
+                        double cx = smooth ? 2 * x_ - control_x_ : x_;
+                        double cy = smooth ? 2 * y_ - control_y_ : y_;
+                        quadTo(cx, cy, ox + a[0], oy + a[1]);
+                    }
+                    break;
+                case 'A':
+                    ok = numbers(a, 3) && flag(a[3]) && flag(a[4]) && numbers(a + 5, 2);
+                    if (ok) {
+                        arcTo(a[0], a[1], a[2], a[3] != 0.0, a[4] != 0.0, ox + a[5], oy + a[6]);
+                    }
+                    break;
+                case 'Z':
+                    closePath();
+                    break;
+                default:
+                    ok = false;
+                    break;
+            }
+            
+            if (!ok) {
+                break;
+            }
+            previous = upper;
+        }
+        
+        contours_.erase(remove_if(contours_.begin(), contours_.end(),
+                                  [](const PathContour& c) { return c.points.size() < 2; }),
+                        contours_.end());
+        return move(contours_);
+    }
+
+private:
+    void skipSeparators() {
+        while (p_ < end_ && (isspace(static_cast<unsigned char>(*p_)) || *p_ == ',')) {
+            p_++;
+        }
+    }
+    
+    bool number(double& out) {
+        skipSeparators();
+        if (p_ >= end_) {
+            return false;
+        }
+        char* next;
+        out = strtod(p_, &next);
+        if (next == p_) {
+            return false;
+        }
+        p_ = next;
+        return true;
+    }
+    
+    bool numbers(double* out, int count) {
+        for (int i = 0; i < count; i++) {
+            if (!number(out[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+    
+    // 圆弧的标志位只有一个字符，可以和后面的数字连写（如"0 11 50,80"）
+    bool flag(double& out) {
+        skipSeparators();
+        if (p_ >= end_ || (*p_ != '0' && *p_ != '1')) {
+            return false;
+        }
+        out = *p_++ == '1' ? 1.0 : 0.0;
+        return true;
+    }
+    
+    void moveTo(double x, double y) {
+        contours_.emplace_back();
+        contours_.back().points.push_back({static_cast<float>(x), static_cast<float>(y)});
+        x_ = start_x_ = control_x_ = x;
+        y_ = start_y_ = control_y_ = y;
+        open_ = true;
+    }
+    
+    void addPoint(double x, double y) {
+        // Z之后直接绘制时从子路径起点开始新的子路径
+        if (!open_) {
+            contours_.emplace_back();
+            contours_.back().points.push_back({static_cast<float>(x_), static_cast<float>(y_)});
+            open_ = true;
+        }
+        
+        PathPoint point{static_cast<float>(x), static_cast<float>(y)};
+        const PathPoint& last = contours_.back().points.back();
+        if (point.x != last.x || point.y != last.y) {
+            contours_.back().points.push_back(point);
+        }
+    }
+    
+    void lineTo(double x, double y) {
+        addPoint(x, y);
+        x_ = control_x_ = x;
+        y_ = control_y_ = y;
+    }
+    
+    void cubicTo(double c1x, double c1y, double c2x, double c2y, double x, double y) {
+        // 二阶差分的上界决定展平误差
+        double ddx = max(fabs(x_ - 2 * c1x + c2x), fabs(c1x - 2 * c2x + x));
+        double ddy = max(fabs(y_ - 2 * c1y + c2y), fabs(c1y - 2 * c2y + y));
+        int n = segmentCount(sqrt(0.75 * hypot(ddx, ddy) / tolerance_));
+        
+        for (int i = 1; i <= n; i++) {
+            double t = static_cast<double>(i) / n;
+            double u = 1.0 - t;
+            double px = u * u * u * x_ + 3 * u * u * t * c1x + 3 * u * t * t * c2x + t * t * t * x;
+            double py = u * u * u * y_ + 3 * u * u * t * c1y + 3 * u * t * t * c2y + t * t * t * y;
+            addPoint(i == n ? x : px, i == n ? y : py);
+        }
+        x_ = x;
+        y_ = y;
+        control_x_ = c2x;
+        control_y_ = c2y;
+    }
+    
+    void quadTo(double cx, double cy, double x, double y) {
+        double dd = hypot(x_ - 2 * cx + x, y_ - 2 * cy + y);
+        int n = segmentCount(sqrt(0.25 * dd / tolerance_));
+        
+        for (int i = 1; i <= n; i++) {
+            double t = static_cast<double>(i) / n;
+            double u = 1.0 - t;
+            double px = u * u * x_ + 2 * u * t * cx + t * t * x;
+            double py = u * u * y_ + 2 * u * t * cy + t * t * y;
+            addPoint(i == n ? x : px, i == n ? y : py);
+        }
+        x_ = x;
+        y_ = y;
+        control_x_ = cx;
+        control_y_ = cy;
+    }
+    
+    // 端点参数化转换为中心参数化，见SVG规范附录F.6.5
+    void arcTo(double rx, double ry, double rotation, bool large_arc, bool sweep, double x, double y) {
+        if (x == x_ && y == y_) {
+            return;
+        }
+        rx = fabs(rx);
+        ry = fabs(ry);
+        if (rx == 0.0 || ry == 0.0) {
+            lineTo(x, y);
+            return;
+        }
+        
+        double phi = rotation * PI / 180.0;
+        double cos_phi = cos(phi);
+        double sin_phi = sin(phi);
+        double dx = (x_ - x) / 2;
+        double dy = (y_ - y) / 2;
+        double x1p = cos_phi * dx + sin_phi * dy;
+        double y1p = -sin_phi * dx + cos_phi * dy;
+        
+        // 半径不足以连接两个端点时按比例放大
+        double lambda = (x1p * x1p) / (rx * rx) + (y1p * y1p) / (ry * ry);
+        if (lambda > 1.0) {
+            rx *= sqrt(lambda);
+            ry *= sqrt(lambda);
+        }
+        
+        double num = rx * rx * ry * ry - rx * rx * y1p * y1p - ry * ry * x1p * x1p;
+        double den = rx * rx * y1p * y1p + ry * ry * x1p * x1p;
+        double coef = sqrt(max(0.0, num / den)) * (large_arc == sweep ? -1.0 : 1.0);
+        double cxp = coef * rx * y1p / ry;
+        double cyp = -coef * ry * x1p / rx;
+        double cx = cos_phi * cxp - sin_phi * cyp + (x_ + x) / 2;
+        double cy = sin_phi * cxp + cos_phi * cyp + (y_ + y) / 2;
+        
+        double theta = atan2((y1p - cyp) / ry, (x1p - cxp) / rx);
+        double delta = atan2((-y1p - cyp) / ry, (-x1p - cxp) / rx) - theta;
+        if (sweep && delta < 0) {
+            delta += 2 * PI;
+        } else if (!sweep && delta > 0) {
+            delta -= 2 * PI;
+        }
+        
+        // 每段对应的圆心角保证弦高不超过容差
+        double radius = max(rx, ry);
+        double step = 2 * acos(max(-1.0, 1.0 - tolerance_ / radius));
+        int n = segmentCount(fabs(delta) / step);
+        
+        for (int i = 1; i <= n; i++) {
+            if (i == n) {
+                addPoint(x, y);
+                break;
+            }
+            double t = theta + delta * i / n;
+            double ex = rx * cos(t);
+            double ey = ry * sin(t);
+            addPoint(cx + ex * cos_phi - ey * sin_phi, cy + ex * sin_phi + ey * cos_phi);
+        }
+        x_ = control_x_ = x;
+        y_ = control_y_ = y;
+    }
+    
+    void closePath() {
+        if (open_ && !contours_.empty()) {
+            contours_.back().closed = true;
+        }
+        open_ = false;
+        x_ = control_x_ = start_x_;
+        y_ = control_y_ = start_y_;
+    }
+    
+    static int segmentCount(double estimate) {
+        if (!(estimate >= 1.0)) {
+            return 1;
+        }
+        return static_cast<int>(min(ceil(estimate), 256.0));
+    }
+    
+    const char* p_;
+    const char* end_;
+    double tolerance_;
+    
+    vector<PathContour> contours_;
+    bool open_ = false;
+    double x_ = 0.0, y_ = 0.0;
+    double start_x_ = 0.0, start_y_ = 0.0;
+    double control_x_ = 0.0, control_y_ = 0.0; // 上一段曲线的最后一个控制点
+};
+
+void appendEdge(const PathPoint& a, const PathPoint& b, int winding, vector<PathEdge>& edges) {
+    if (a.y == b.y) {
+        return; // 水平边不与扫描线相交
+    }
+    if (a.y < b.y) {
+        edges.push_back({a.x, a.y, b.x, b.y, winding});
+    } else {
+        edges.push_back({b.x, b.y, a.x, a.y, -winding});
+    }
+}
+
+// 凸多边形统一为同一方向，重叠部分在非零规则下不会互相抵消
+void appendPolygon(const PathPoint* points, size_t count, vector<PathEdge>& edges) {
+    double area = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        const PathPoint& a = points[i];
+        const PathPoint& b = points[(i + 1) % count];
+        area += static_cast<double>(a.x) * b.y - static_cast<double>(b.x) * a.y;
+    }
+    if (fabs(area) < 1e-9) {
+        return;
+    }
+    
+    int winding = area > 0 ? 1 : -1;
+    for (size_t i = 0; i < count; i++) {
+        appendEdge(points[i], points[(i + 1) % count], winding, edges);
+    }
+}
+
+// 闭合子路径的终点与起点重合（如以Z结束的整圆）
+bool closedDuplicate(const PathContour& contour) {
+    const auto& points = contour.points;
+    return contour.closed && points.size() > 2 &&
+           points.front().x == points.back().x && points.front().y == points.back().y;
+}
+
+} // namespace
+
+vector<PathContour> parseSvgPath(const string& data, float tolerance) {
+    return SvgPathParser(data, max(tolerance, 1e-4f)).parse();
+}
+
+void appendFillEdges(const vector<PathContour>& contours, vector<PathEdge>& edges) {
+    for (const auto& contour : contours) {
+        const auto& points = contour.points;
+        for (size_t i = 0; i < points.size(); i++) {
+            appendEdge(points[i], points[(i + 1) % points.size()], 1, edges);
+        }
+    }
+}
+
+void appendStrokeEdges(const vector<PathContour>& contours, float width,
+                       vector<PathEdge>& edges, float miter_limit) {
+    float half = width / 2;
+    
+    for (const auto& contour : contours) {
+        const auto& points = contour.points;
+        size_t count = points.size();
+        if (closedDuplicate(contour)) {
+            count--; // 闭合路径的终点与起点重合
+        }
+        size_t segments = contour.closed ? count : count - 1;
+        
+        // 每个线段的单位方向
+        vector<PathPoint> directions(segments);
+        for (size_t i = 0; i < segments; i++) {
+            const PathPoint& a = points[i];
+            const PathPoint& b = points[(i + 1) % count];
+            float length = hypot(b.x - a.x, b.y - a.y);
+            directions[i] = {(b.x - a.x) / length, (b.y - a.y) / length};
+        }
+        
+        for (size_t i = 0; i < segments; i++) {
+            const PathPoint& a = points[i];
+            const PathPoint& b = points[(i + 1) % count];
+            float nx = -directions[i].y * half;
+            float ny = directions[i].x * half;
+            PathPoint quad[4] = {
+                {a.x + nx, a.y + ny}, {b.x + nx, b.y + ny},
+                {b.x - nx, b.y - ny}, {a.x - nx, a.y - ny}
+            };
+            appendPolygon(quad, 4, edges);
+        }
+        
+        // 拐角：在外侧补上斜接或斜切的部分
+        size_t joins = contour.closed ? segments : segments - 1;
+        for (size_t i = 0; i < joins; i++) {
+            const PathPoint& d1 = directions[i];
+            const PathPoint& d2 = directions[(i + 1) % segments];
+            const PathPoint& vertex = points[(i + 1) % count];
+            
+            float cross = d1.x * d2.y - d1.y * d2.x;
+            float dot = d1.x * d2.x + d1.y * d2.y;
+            if (fabs(cross) < 1e-4f && dot > 0) {
+                continue; // 几乎共线
+            }
+            
+            float side = cross > 0 ? -1.0f : 1.0f;
+            PathPoint o1 = {vertex.x - d1.y * half * side, vertex.y + d1.x * half * side};
+            PathPoint o2 = {vertex.x - d2.y * half * side, vertex.y + d2.x * half * side};
+            
+            // 斜接长度与线宽之比为 1/cos(θ/2)，θ为转角
+            float cos_half = sqrt(max(0.0f, (1.0f + dot) / 2));
+            if (cos_half > 0 && 1.0f / cos_half <= miter_limit) {
+                float mx = (o1.x + o2.x) / 2 - vertex.x;
+                float my = (o1.y + o2.y) / 2 - vertex.y;
+                float scale = 1.0f / (cos_half * cos_half);
+                PathPoint miter[4] = {vertex, o1, {vertex.x + mx * scale, vertex.y + my * scale}, o2};
+                appendPolygon(miter, 4, edges);
+            } else {
+                PathPoint bevel[3] = {vertex, o1, o2};
+                appendPolygon(bevel, 3, edges);
+            }
+        }
+    }
+}
+
+PathRasterizer::PathRasterizer(uint8_t* rgba, int width, int height)
+    : rgba_(rgba)
+    , width_(width)
+    , height_(height)
+    , cover_(width + 2, 0.0f)
+    , runs_(width + 2, 0.0f)
+    , alpha_(width + 2, 0)
+    , dirty_min_(width)
+    , dirty_max_(-1) {
+}
+
+void PathRasterizer::fill(const vector<PathEdge>& edges, float scale, uint32_t color) {
+    edges_.clear();
+    float top = static_cast<float>(height_);
+    float bottom = 0.0f;
+    for (const auto& edge : edges) {
+        PathEdge e = {edge.x0 * scale, edge.y0 * scale, edge.x1 * scale, edge.y1 * scale, edge.winding};
+        if (e.y1 <= 0.0f || e.y0 >= height_) {
+            continue;
+        }
+        top = min(top, e.y0);
+        bottom = max(bottom, e.y1);
+        edges_.push_back(e);
+    }
+    if (edges_.empty()) {
+        return;
+    }
+    
+    sort(edges_.begin(), edges_.end(), [](const PathEdge& a, const PathEdge& b) { return a.y0 < b.y0; });
+    slopes_.resize(edges_.size());
+    for (size_t i = 0; i < edges_.size(); i++) {
+        slopes_[i] = (edges_[i].x1 - edges_[i].x0) / (edges_[i].y1 - edges_[i].y0);
+    }
+    
+    int y_begin = max(0, static_cast<int>(floor(top)));
+    int y_end = min(height_, static_cast<int>(ceil(bottom)));
+    size_t next = 0;
+    active_.clear();
+    
+    for (int y = y_begin; y < y_end; y++) {
+        for (int s = 0; s < SUBSAMPLES; s++) {
+            float sample_y = y + (s + 0.5f) / SUBSAMPLES;
+            
+            // 更新活动边表：加入从这条子扫描线开始的边，移除已经结束的边
+            while (next < edges_.size() && edges_[next].y0 <= sample_y) {
+                active_.push_back(next++);
+            }
+            active_.erase(remove_if(active_.begin(), active_.end(),
+                                    [&](size_t i) { return edges_[i].y1 <= sample_y; }),
+                          active_.end());
+            if (active_.empty()) {
+                continue;
+            }
+            
+            crossings_.clear();
+            for (size_t i : active_) {
+                const PathEdge& e = edges_[i];
+                crossings_.push_back({e.x0 + (sample_y - e.y0) * slopes_[i], e.winding});
+            }
+            // 交点很少，插入排序即可
+            for (size_t i = 1; i < crossings_.size(); i++) {
+                Crossing c = crossings_[i];
+                size_t j = i;
+                while (j > 0 && crossings_[j - 1].x > c.x) {
+                    crossings_[j] = crossings_[j - 1];
+                    j--;
+                }
+                crossings_[j] = c;
+            }
+            
+            int winding = 0;
+            float span_start = 0.0f;
+            for (const auto& c : crossings_) {
+                int before = winding;
+                winding += c.winding;
+                if (before == 0 && winding != 0) {
+                    span_start = c.x;
+                } else if (before != 0 && winding == 0) {
+                    addSpan(span_start, c.x);
+                }
+            }
+        }
+        
+        compositeRow(y, color);
+    }
+}
+
+// 累加子扫描线上[x0, x1)的覆盖：两端像素记部分覆盖，中间的整像素记在差分数组中
+void PathRasterizer::addSpan(float x0, float x1) {
+    x0 = max(x0, 0.0f);
+    x1 = min(x1, static_cast<float>(width_));
+    if (x1 <= x0) {
+        return;
+    }
+    
+    int i0 = static_cast<int>(x0);
+    int i1 = static_cast<int>(x1);
+    if (i0 == i1) {
+        cover_[i0] += x1 - x0;
+    } else {
+        cover_[i0] += (i0 + 1) - x0;
+        runs_[i0 + 1] += 1.0f;
+        runs_[i1] -= 1.0f;
+        cover_[i1] += x1 - i1;
+    }
+    
+    dirty_min_ = min(dirty_min_, i0);
+    dirty_max_ = max(dirty_max_, i1);
+}
+
+// 把一行的覆盖率合成到缓冲区（预乘alpha的source-over），并清空累加器
+void PathRasterizer::compositeRow(int y, uint32_t color) {
+    if (dirty_max_ < dirty_min_) {
+        return;
+    }
+    
+    const float to_alpha = 255.0f / SUBSAMPLES;
+    int last = min(dirty_max_, width_ - 1);
+    
+    float run = 0.0f;
+    for (int x = dirty_min_; x <= dirty_max_; x++) {
+        run += runs_[x];
+        float coverage = cover_[x] + run;
+        cover_[x] = 0.0f;
+        runs_[x] = 0.0f;
+        alpha_[x] = coverage <= 0.0f ? 0 : static_cast<uint8_t>(min(coverage * to_alpha, 255.0f) + 0.5f);
+    }
+    
+    // 完全覆盖的连续像素直接填充，其余（边缘和细线）按覆盖率混合
+    const SpanKernels& kernels = spanKernels();
+    const uint32_t opaque = packOpaquePixel(color);
+    uint8_t* row = rgba_ + static_cast<size_t>(y) * width_ * 4;
+    int x = dirty_min_;
+    while (x <= last) {
+        int start = x;
+        if (alpha_[x] == 255) {
+            while (x <= last && alpha_[x] == 255) {
+                x++;
+            }
+            kernels.fill(row + start * 4, x - start, opaque);
+        } else {
+            while (x <= last && alpha_[x] != 255) {
+                x++;
+            }
+            kernels.blend(row + start * 4, alpha_.data() + start, x - start, color);
+        }
+    }
+    
+    dirty_min_ = width_;
+    dirty_max_ = -1;
+}
+
+// (c*255 + a/2) / a 用乘以 ceil(2^24/a) 再右移24位代替除法，对全部0<=c<=255、1<=a<=255逐一验证过结果相同
+static const uint32_t* unpremultiplyReciprocals() {
+    static const auto table = [] {
+        array<uint32_t, 256> values{};
+        for (uint32_t a = 1; a < 256; a++) {
+            values[a] = ((1u << 24) + a - 1) / a;
+        }
+        return values;
+    }();
+    return table.data();
+}
+
+void unpremultiplyRGBA(uint8_t* rgba, size_t pixels, uint32_t background) {
+    const uint8_t r = (background >> 16) & 0xFF;
+    const uint8_t g = (background >> 8) & 0xFF;
+    const uint8_t b = background & 0xFF;
+    const uint32_t* reciprocals = unpremultiplyReciprocals();
+    
+    for (size_t i = 0; i < pixels; i++) {
+        uint8_t* pixel = rgba + i * 4;
+        uint32_t alpha = pixel[3];
+        if (alpha == 0) {
+            pixel[0] = r;
+            pixel[1] = g;
+            pixel[2] = b;
+        } else if (alpha < 255) {
+            const uint64_t reciprocal = reciprocals[alpha];
+            for (int c = 0; c < 3; c++) {
+                uint32_t value = static_cast<uint32_t>(((pixel[c] * 255u + alpha / 2) * reciprocal) >> 24);
+                pixel[c] = static_cast<uint8_t>(min(255u, value));
+            }
+        }
+    }
+}
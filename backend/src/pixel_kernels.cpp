@@ -0,0 +1,466 @@
+#include "pixel_kernels.h"
+#include <atomic>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIXEL_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// x * y / 255，四舍五入。SIMD实现使用相同的公式，结果逐字节一致
+inline uint32_t mulDiv255(uint32_t x, uint32_t y) {
+    uint32_t t = x * y + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+inline void blendPixel(uint8_t* dst, uint32_t alpha, const uint32_t rgb[3]) {
+    uint32_t inverse = 255 - alpha;
+    dst[0] = static_cast<uint8_t>(mulDiv255(rgb[0], alpha) + mulDiv255(dst[0], inverse));
+    dst[1] = static_cast<uint8_t>(mulDiv255(rgb[1], alpha) + mulDiv255(dst[1], inverse));
+    dst[2] = static_cast<uint8_t>(mulDiv255(rgb[2], alpha) + mulDiv255(dst[2], inverse));
+    dst[3] = static_cast<uint8_t>(alpha + mulDiv255(dst[3], inverse));
+}
+
+void fillScalar(uint8_t* dst, size_t count, uint32_t pixel) {
+    for (size_t i = 0; i < count; i++) {
+        memcpy(dst + i * 4, &pixel, 4);
+    }
+}
+
+// 标量实现也用于SIMD实现的尾部
+void blendScalar(uint8_t* dst, const uint8_t* alpha, size_t count, uint32_t color) {
+    const uint32_t rgb[3] = {(color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF};
+    const uint32_t opaque = packOpaquePixel(color);
+    
+    for (size_t i = 0; i < count; i++) {
+        uint32_t a = alpha[i];
+        if (a == 255) {
+            memcpy(dst + i * 4, &opaque, 4);
+        } else if (a != 0) {
+            blendPixel(dst + i * 4, a, rgb);
+        }
+    }
+}
+
+const int32_t RESAMPLE_ROUNDING = 1 << (RESAMPLE_WEIGHT_BITS - 1);
+
+// 算术右移，负数向下取整，与SIMD的srai一致
+inline uint8_t clampFixed(int32_t sum) {
+    int32_t value = (sum + RESAMPLE_ROUNDING) >> RESAMPLE_WEIGHT_BITS;
+    return static_cast<uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+void convolveRowScalar(uint8_t* dst, const uint8_t* src, size_t count,
+                       const int32_t* starts, const int16_t* weights, size_t taps) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = src + static_cast<size_t>(starts[i]) * 4;
+        const int16_t* w = weights + i * taps;
+        int32_t sum[4] = {0, 0, 0, 0};
+        for (size_t k = 0; k < taps; k++) {
+            for (int c = 0; c < 4; c++) {
+                sum[c] += w[k] * p[k * 4 + c];
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            dst[i * 4 + c] = clampFixed(sum[c]);
+        }
+    }
+}
+
+// SIMD实现也用这个函数处理不足一个向量的尾部，offset为起始字节
+void combineRowsScalar(uint8_t* dst, const uint8_t* const* rows, const int16_t* weights,
+                       size_t taps, size_t bytes, size_t offset) {
+    for (size_t j = offset; j < bytes; j++) {
+        int32_t sum = 0;
+        for (size_t k = 0; k < taps; k++) {
+            sum += weights[k] * rows[k][j];
+        }
+        dst[j] = clampFixed(sum);
+    }
+}
+
+void combineRowsScalar(uint8_t* dst, const uint8_t* const* rows, const int16_t* weights,
+                       size_t taps, size_t bytes) {
+    combineRowsScalar(dst, rows, weights, taps, bytes, 0);
+}
+
+const SpanKernels SCALAR_KERNELS = {
+    "scalar", fillScalar, blendScalar, convolveRowScalar, combineRowsScalar
+};
+
+#if defined(PIXEL_KERNELS_X86)
+
+// 16位通道上的 x / 255（x <= 255*255 + 128），与mulDiv255相同
+__attribute__((target("sse2")))
+inline __m128i div255Epu16(__m128i t) {
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("sse2")))
+void fillSSE2(uint8_t* dst, size_t count, uint32_t pixel) {
+    const __m128i value = _mm_set1_epi32(static_cast<int>(pixel));
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), value);
+    }
+    fillScalar(dst + i * 4, count - i, pixel);
+}
+
+// 混合4个像素：全透明跳过，全覆盖直接写入，其余按16位通道计算。
+// 强制内联，AVX2实现的尾部内联后使用VEX编码，避免SSE/AVX切换的开销
+__attribute__((target("sse2"), always_inline))
+inline void blend4SSE2(uint8_t* dst, uint32_t packed, __m128i opaque, __m128i color16) {
+    if (packed == 0) {
+        return;
+    }
+    __m128i* p = reinterpret_cast<__m128i*>(dst);
+    if (packed == 0xFFFFFFFFu) {
+        _mm_storeu_si128(p, opaque);
+        return;
+    }
+    
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rounding = _mm_set1_epi16(128);
+    const __m128i max255 = _mm_set1_epi16(255);
+    
+    // 每个像素的alpha复制到4个通道
+    __m128i a = _mm_cvtsi32_si128(static_cast<int>(packed));
+    a = _mm_unpacklo_epi8(a, a);
+    a = _mm_unpacklo_epi16(a, a);
+    
+    __m128i d = _mm_loadu_si128(p);
+    __m128i result[2];
+    for (int half = 0; half < 2; half++) {
+        __m128i a16 = half ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+        __m128i d16 = half ? _mm_unpackhi_epi8(d, zero) : _mm_unpacklo_epi8(d, zero);
+        __m128i src = div255Epu16(_mm_add_epi16(_mm_mullo_epi16(color16, a16), rounding));
+        __m128i inverse = _mm_sub_epi16(max255, a16);
+        __m128i keep = div255Epu16(_mm_add_epi16(_mm_mullo_epi16(d16, inverse), rounding));
+        result[half] = _mm_add_epi16(src, keep);
+    }
+    _mm_storeu_si128(p, _mm_packus_epi16(result[0], result[1]));
+}
+
+__attribute__((target("sse2")))
+void blendSSE2(uint8_t* dst, const uint8_t* alpha, size_t count, uint32_t color) {
+    const __m128i opaque = _mm_set1_epi32(static_cast<int>(packOpaquePixel(color)));
+    const __m128i color16 = _mm_unpacklo_epi8(opaque, _mm_setzero_si128());
+    
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        uint32_t packed;
+        memcpy(&packed, alpha + i, 4);
+        blend4SSE2(dst + i * 4, packed, opaque, color16);
+    }
+    blendScalar(dst + i * 4, alpha + i, count - i, color);
+}
+
+// 相邻两个权重按(低16位, 高16位)打包，配合madd使用
+inline int32_t weightPair(const int16_t* w) {
+    int32_t pair;
+    memcpy(&pair, w, 4);
+    return pair;
+}
+
+// 4个32位累加和（一个像素的R,G,B,A或4个字节）定点舍入后饱和为8位
+__attribute__((target("sse2"), always_inline))
+inline __m128i roundFixedSSE2(__m128i sum) {
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(RESAMPLE_ROUNDING)), RESAMPLE_WEIGHT_BITS);
+}
+
+// 从第k个抽头开始累加一个像素的剩余抽头。每次两个像素：
+// 交错为(r0,r1,g0,g1,b0,b1,a0,a1)后与(w0,w1)做madd，得到R,G,B,A的32位和
+__attribute__((target("sse2"), always_inline))
+inline __m128i convolveTapsSSE2(__m128i sum, const uint8_t* p, const int16_t* w, size_t k, size_t taps) {
+    const __m128i zero = _mm_setzero_si128();
+    for (; k + 2 <= taps; k += 2) {
+        __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + k * 4)), zero);
+        px = _mm_unpacklo_epi16(px, _mm_srli_si128(px, 8));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32(weightPair(w + k))));
+    }
+    if (k < taps) {
+        int32_t last;
+        memcpy(&last, p + k * 4, 4);
+        __m128i px = _mm_unpacklo_epi8(_mm_cvtsi32_si128(last), zero);
+        px = _mm_unpacklo_epi16(px, zero);
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(px, _mm_set1_epi32(static_cast<uint16_t>(w[k]))));
+    }
+    return sum;
+}
+
+__attribute__((target("sse2"), always_inline))
+inline void storePixelSSE2(uint8_t* dst, __m128i sum) {
+    __m128i rounded = roundFixedSSE2(sum);
+    __m128i packed = _mm_packs_epi32(rounded, rounded);
+    int32_t pixel = _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+    memcpy(dst, &pixel, 4);
+}
+
+__attribute__((target("sse2")))
+void convolveRowSSE2(uint8_t* dst, const uint8_t* src, size_t count,
+                     const int32_t* starts, const int16_t* weights, size_t taps) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = src + static_cast<size_t>(starts[i]) * 4;
+        __m128i sum = convolveTapsSSE2(_mm_setzero_si128(), p, weights + i * taps, 0, taps);
+        storePixelSSE2(dst + i * 4, sum);
+    }
+}
+
+// 16个字节：两行对应字节交错后与(w0,w1)做madd，4个累加器各管4个字节
+__attribute__((target("sse2"), always_inline))
+inline void combine16SSE2(uint8_t* dst, const uint8_t* const* rows, const int16_t* weights,
+                          size_t taps, size_t offset) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum[4] = {zero, zero, zero, zero};
+    for (size_t k = 0; k < taps; k += 2) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + offset));
+        __m128i b = zero;
+        __m128i w;
+        if (k + 1 < taps) {
+            b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + offset));
+            w = _mm_set1_epi32(weightPair(weights + k));
+        } else {
+            w = _mm_set1_epi32(static_cast<uint16_t>(weights[k]));
+        }
+        __m128i a_lo = _mm_unpacklo_epi8(a, zero), a_hi = _mm_unpackhi_epi8(a, zero);
+        __m128i b_lo = _mm_unpacklo_epi8(b, zero), b_hi = _mm_unpackhi_epi8(b, zero);
+        sum[0] = _mm_add_epi32(sum[0], _mm_madd_epi16(_mm_unpacklo_epi16(a_lo, b_lo), w));
+        sum[1] = _mm_add_epi32(sum[1], _mm_madd_epi16(_mm_unpackhi_epi16(a_lo, b_lo), w));
+        sum[2] = _mm_add_epi32(sum[2], _mm_madd_epi16(_mm_unpacklo_epi16(a_hi, b_hi), w));
+        sum[3] = _mm_add_epi32(sum[3], _mm_madd_epi16(_mm_unpackhi_epi16(a_hi, b_hi), w));
+    }
+    __m128i lo = _mm_packs_epi32(roundFixedSSE2(sum[0]), roundFixedSSE2(sum[1]));
+    __m128i hi = _mm_packs_epi32(roundFixedSSE2(sum[2]), roundFixedSSE2(sum[3]));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + offset), _mm_packus_epi16(lo, hi));
+}
+
+__attribute__((target("sse2")))
+void combineRowsSSE2(uint8_t* dst, const uint8_t* const* rows, const int16_t* weights,
+                     size_t taps, size_t bytes) {
+    size_t j = 0;
+    for (; j + 16 <= bytes; j += 16) {
+        combine16SSE2(dst, rows, weights, taps, j);
+    }
+    combineRowsScalar(dst, rows, weights, taps, bytes, j);
+}
+
+const SpanKernels SSE2_KERNELS = {"sse2", fillSSE2, blendSSE2, convolveRowSSE2, combineRowsSSE2};
+
+__attribute__((target("avx2")))
+inline __m256i div255Epu16AVX2(__m256i t) {
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+
+__attribute__((target("avx2")))
+void fillAVX2(uint8_t* dst, size_t count, uint32_t pixel) {
+    const __m256i value = _mm256_set1_epi32(static_cast<int>(pixel));
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 4), value);
+    }
+    if (i + 4 <= count) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), _mm256_castsi256_si128(value));
+        i += 4;
+    }
+    // 尾调用标量实现前清除YMM高位（编译器不一定会插入vzeroupper）
+    _mm256_zeroupper();
+    fillScalar(dst + i * 4, count - i, pixel);
+}
+
+// 每次处理8个像素。unpack/pack都在128位通道内进行，像素顺序保持不变
+__attribute__((target("avx2")))
+void blendAVX2(uint8_t* dst, const uint8_t* alpha, size_t count, uint32_t color) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i opaque = _mm256_set1_epi32(static_cast<int>(packOpaquePixel(color)));
+    const __m256i color16 = _mm256_unpacklo_epi8(opaque, zero);
+    const __m256i rounding = _mm256_set1_epi16(128);
+    const __m256i max255 = _mm256_set1_epi16(255);
+    // 低128位取像素0~3的alpha，高128位取像素4~7
+    const __m256i spread = _mm256_setr_epi8(
+        0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+        4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+    
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint64_t packed;
+        memcpy(&packed, alpha + i, 8);
+        if (packed == 0) {
+            continue;
+        }
+        __m256i* p = reinterpret_cast<__m256i*>(dst + i * 4);
+        if (packed == ~0ULL) {
+            _mm256_storeu_si256(p, opaque);
+            continue;
+        }
+        
+        __m128i a8 = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(alpha + i));
+        __m256i a = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(a8), spread);
+        
+        __m256i d = _mm256_loadu_si256(p);
+        __m256i a_lo = _mm256_unpacklo_epi8(a, zero);
+        __m256i a_hi = _mm256_unpackhi_epi8(a, zero);
+        __m256i d_lo = _mm256_unpacklo_epi8(d, zero);
+        __m256i d_hi = _mm256_unpackhi_epi8(d, zero);
+        
+        __m256i lo = _mm256_add_epi16(
+            div255Epu16AVX2(_mm256_add_epi16(_mm256_mullo_epi16(color16, a_lo), rounding)),
+            div255Epu16AVX2(_mm256_add_epi16(_mm256_mullo_epi16(d_lo, _mm256_sub_epi16(max255, a_lo)), rounding)));
+        __m256i hi = _mm256_add_epi16(
+            div255Epu16AVX2(_mm256_add_epi16(_mm256_mullo_epi16(color16, a_hi), rounding)),
+            div255Epu16AVX2(_mm256_add_epi16(_mm256_mullo_epi16(d_hi, _mm256_sub_epi16(max255, a_hi)), rounding)));
+        _mm256_storeu_si256(p, _mm256_packus_epi16(lo, hi));
+    }
+    if (i + 4 <= count) {
+        uint32_t packed;
+        memcpy(&packed, alpha + i, 4);
+        blend4SSE2(dst + i * 4, packed, _mm256_castsi256_si128(opaque), _mm256_castsi256_si128(color16));
+        i += 4;
+    }
+    _mm256_zeroupper();
+    blendScalar(dst + i * 4, alpha + i, count - i, color);
+}
+
+// 4个抽头（4个源像素）：两个128位通道各按SSE2的方式处理两个，结果为两个通道的部分和
+__attribute__((target("avx2"), always_inline))
+inline __m256i convolve4AVX2(const uint8_t* p, const int16_t* w, __m256i spread) {
+    __m256i px = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+    px = _mm256_unpacklo_epi16(px, _mm256_srli_si256(px, 8));
+    // 低通道取权重0,1，高通道取权重2,3
+    __m256i wv = _mm256_permutevar8x32_epi32(
+        _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(w))), spread);
+    return _mm256_madd_epi16(px, wv);
+}
+
+// 抽头数为4的倍数时（缩放表按此补齐）每次计算两个目标像素，
+// 两个像素的部分和交叉合并后一起舍入和打包
+__attribute__((target("avx2")))
+void convolveRowAVX2(uint8_t* dst, const uint8_t* src, size_t count,
+                     const int32_t* starts, const int16_t* weights, size_t taps) {
+    const __m256i spread = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    const __m256i rounding = _mm256_set1_epi32(RESAMPLE_ROUNDING);
+    size_t i = 0;
+    if (taps % 4 == 0) {
+        for (; i + 2 <= count; i += 2) {
+            const uint8_t* p0 = src + static_cast<size_t>(starts[i]) * 4;
+            const uint8_t* p1 = src + static_cast<size_t>(starts[i + 1]) * 4;
+            const int16_t* w0 = weights + i * taps;
+            const int16_t* w1 = w0 + taps;
+            __m256i s0 = _mm256_setzero_si256();
+            __m256i s1 = _mm256_setzero_si256();
+            for (size_t k = 0; k < taps; k += 4) {
+                s0 = _mm256_add_epi32(s0, convolve4AVX2(p0 + k * 4, w0 + k, spread));
+                s1 = _mm256_add_epi32(s1, convolve4AVX2(p1 + k * 4, w1 + k, spread));
+            }
+            // 低通道为像素i，高通道为像素i+1
+            __m256i sum = _mm256_add_epi32(_mm256_permute2x128_si256(s0, s1, 0x20),
+                                           _mm256_permute2x128_si256(s0, s1, 0x31));
+            sum = _mm256_srai_epi32(_mm256_add_epi32(sum, rounding), RESAMPLE_WEIGHT_BITS);
+            __m256i packed = _mm256_packs_epi32(sum, sum);
+            packed = _mm256_packus_epi16(packed, packed);
+            int32_t first = _mm_cvtsi128_si32(_mm256_castsi256_si128(packed));
+            int32_t second = _mm_cvtsi128_si32(_mm256_extracti128_si256(packed, 1));
+            memcpy(dst + i * 4, &first, 4);
+            memcpy(dst + i * 4 + 4, &second, 4);
+        }
+    }
+    
+    for (; i < count; i++) {
+        const uint8_t* p = src + static_cast<size_t>(starts[i]) * 4;
+        const int16_t* w = weights + i * taps;
+        __m256i wide = _mm256_setzero_si256();
+        size_t k = 0;
+        for (; k + 4 <= taps; k += 4) {
+            wide = _mm256_add_epi32(wide, convolve4AVX2(p + k * 4, w + k, spread));
+        }
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(wide), _mm256_extracti128_si256(wide, 1));
+        storePixelSSE2(dst + i * 4, convolveTapsSSE2(sum, p, w, k, taps));
+    }
+}
+
+// 每次32个字节。unpack在128位通道内进行，packs/packus也按通道合并，字节顺序恰好还原
+__attribute__((target("avx2")))
+void combineRowsAVX2(uint8_t* dst, const uint8_t* const* rows, const int16_t* weights,
+                     size_t taps, size_t bytes) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rounding = _mm256_set1_epi32(RESAMPLE_ROUNDING);
+    size_t j = 0;
+    for (; j + 32 <= bytes; j += 32) {
+        __m256i sum[4] = {zero, zero, zero, zero};
+        for (size_t k = 0; k < taps; k += 2) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + j));
+            __m256i b = zero;
+            __m256i w;
+            if (k + 1 < taps) {
+                b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + j));
+                w = _mm256_set1_epi32(weightPair(weights + k));
+            } else {
+                w = _mm256_set1_epi32(static_cast<uint16_t>(weights[k]));
+            }
+            __m256i a_lo = _mm256_unpacklo_epi8(a, zero), a_hi = _mm256_unpackhi_epi8(a, zero);
+            __m256i b_lo = _mm256_unpacklo_epi8(b, zero), b_hi = _mm256_unpackhi_epi8(b, zero);
+            sum[0] = _mm256_add_epi32(sum[0], _mm256_madd_epi16(_mm256_unpacklo_epi16(a_lo, b_lo), w));
+            sum[1] = _mm256_add_epi32(sum[1], _mm256_madd_epi16(_mm256_unpackhi_epi16(a_lo, b_lo), w));
+            sum[2] = _mm256_add_epi32(sum[2], _mm256_madd_epi16(_mm256_unpacklo_epi16(a_hi, b_hi), w));
+            sum[3] = _mm256_add_epi32(sum[3], _mm256_madd_epi16(_mm256_unpackhi_epi16(a_hi, b_hi), w));
+        }
+        for (auto& s : sum) {
+            s = _mm256_srai_epi32(_mm256_add_epi32(s, rounding), RESAMPLE_WEIGHT_BITS);
+        }
+        __m256i lo = _mm256_packs_epi32(sum[0], sum[1]);
+        __m256i hi = _mm256_packs_epi32(sum[2], sum[3]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + j), _mm256_packus_epi16(lo, hi));
+    }
+    if (j + 16 <= bytes) {
+        combine16SSE2(dst, rows, weights, taps, j);
+        j += 16;
+    }
+    _mm256_zeroupper();
+    combineRowsScalar(dst, rows, weights, taps, bytes, j);
+}
+
+const SpanKernels AVX2_KERNELS = {"avx2", fillAVX2, blendAVX2, convolveRowAVX2, combineRowsAVX2};
+
+#endif // PIXEL_KERNELS_X86
+
+vector<const SpanKernels*> detectKernels() {
+    vector<const SpanKernels*> kernels = {&SCALAR_KERNELS};
+#if defined(PIXEL_KERNELS_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sse2")) {
+        kernels.push_back(&SSE2_KERNELS);
+        if (__builtin_cpu_supports("avx2")) {
+            kernels.push_back(&AVX2_KERNELS);
+        }
+    }
+#endif
+    return kernels;
+}
+
+atomic<const SpanKernels*>& activeKernels() {
+    static atomic<const SpanKernels*> active(availableSpanKernels().back());
+    return active;
+}
+
+} // namespace
+
+const vector<const SpanKernels*>& availableSpanKernels() {
+    static const vector<const SpanKernels*> kernels = detectKernels();
+    return kernels;
+}
+
+const SpanKernels& spanKernels() {
+    return *activeKernels().load(memory_order_relaxed);
+}
+
+bool selectSpanKernels(const string& name) {
+    for (const SpanKernels* kernels : availableSpanKernels()) {
+        if (name == kernels->name) {
+            activeKernels().store(kernels, memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+#include "request_stats.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace std;
+
+static int64_t nowNanos() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyHistogram RequestStatistics::Snapshot::total() const {
+    LatencyHistogram all;
+    for (size_t type = 0; type < TYPE_COUNT; type++) {
+        for (size_t outcome = 0; outcome < OUTCOME_COUNT; outcome++) {
+            all.merge(latency[type][outcome]);
+        }
+    }
+    return all;
+}
+
+// 当前线程上最内层的请求
+static thread_local RequestStatistics::Scope* current_scope = nullptr;
+
+RequestStatistics::Scope::Scope(RequestStatistics& stats, WeatherRequest::RequestType type)
+    : stats_(stats)
+    , type_(type)
+    , start_ns_(nowNanos())
+    , outer_(current_scope) {
+    current_scope = this;
+    stats_.add(REQUESTS);
+}
+
+RequestStatistics::Scope::~Scope() {
+    current_scope = outer_;
+    int64_t elapsed_ns = nowNanos() - start_ns_;
+    Outcome outcome = error_ ? OUTCOME_ERROR : (upstream_ ? OUTCOME_MISS : OUTCOME_HIT);
+    stats_.recordLatency(type_, outcome, static_cast<uint64_t>(max<int64_t>(elapsed_ns, 0) / 1000));
+}
+
+void RequestStatistics::Scope::markUpstream() {
+    if (current_scope) {
+        current_scope->upstream_ = true;
+    }
+}
+
+RequestStatistics::Shard::Shard() {
+    for (auto& counter : counters) {
+        counter.store(0, memory_order_relaxed);
+    }
+}
+
+RequestStatistics::RequestStatistics() {
+    for (auto& shard : shards_) {
+        shard.store(nullptr, memory_order_relaxed);
+    }
+}
+
+RequestStatistics::~RequestStatistics() {
+    for (auto& shard : shards_) {
+        delete shard.load(memory_order_relaxed);
+    }
+}
+
+RequestStatistics::Shard& RequestStatistics::localShard() {
+    // 线程编号在所有实例间共用，同一线程总是写各实例中相同位置的分片
+    static atomic<size_t> next_slot{0};
+    static thread_local size_t slot = next_slot.fetch_add(1, memory_order_relaxed) % MAX_SHARDS;
+    
+    Shard* shard = shards_[slot].load(memory_order_acquire);
+    if (!shard) {
+        // 共用分片的线程可能同时分配，只保留先装入的
+        Shard* created = new Shard();
+        if (shards_[slot].compare_exchange_strong(shard, created, memory_order_acq_rel)) {
+            shard = created;
+        } else {
+            delete created;
+        }
+    }
+    return *shard;
+}
+
+void RequestStatistics::add(Counter counter, uint64_t n) {
+    localShard().counters[counter].fetch_add(n, memory_order_relaxed);
+}
+
+void RequestStatistics::recordLatency(WeatherRequest::RequestType type, Outcome outcome,
+                                      uint64_t micros) {
+    if (static_cast<size_t>(type) >= TYPE_COUNT) {
+        return;
+    }
+    localShard().latency[type][outcome].record(micros);
+}
+
+RequestStatistics::Snapshot RequestStatistics::snapshot() const {
+    Snapshot result;
+    for (const auto& slot : shards_) {
+        const Shard* shard = slot.load(memory_order_acquire);
+        if (!shard) {
+            continue;
+        }
+        for (size_t i = 0; i < COUNTER_COUNT; i++) {
+            result.counters[i] += shard->counters[i].load(memory_order_relaxed);
+        }
+        for (size_t type = 0; type < TYPE_COUNT; type++) {
+            for (size_t outcome = 0; outcome < OUTCOME_COUNT; outcome++) {
+                shard->latency[type][outcome].addTo(result.latency[type][outcome]);
+            }
+        }
+    }
+    return result;
+}
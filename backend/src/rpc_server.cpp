@@ -1,131 +1,496 @@
-#include "weather_service.h"
-#include <grpcpp/grpcpp.h>
-#include <thread>
-#include <memory>
-#include <mutex>
-
-using namespace grpc;
-using namespace std;
-
-// Protobuf定义（简化，实际应该用.proto文件）
-class WeatherRPC : public Service {
-public:
-    explicit WeatherRPC(shared_ptr<WeatherService> service) 
-        : weather_service_(service) {
-    }
-    
-    // RPC方法实现
-    Status GetCurrentWeather(ServerContext* context, 
-                           const WeatherRequest* request,
-                           WeatherResponse* response) override {
-        *response = weather_service_->processRequest(*request);
-        return Status::OK;
-    }
-    
-    Status GetForecast(ServerContext* context,
-                      const WeatherRequest* request,
-                      ServerWriter<WeatherResponse>* writer) override {
-        // 流式返回预报数据
-        WeatherResponse response = weather_service_->processRequest(*request);
-        writer->Write(response);
-        
-        // 可以添加更多预报数据...
-        return Status::OK;
-    }
-    
-private:
-    shared_ptr<WeatherService> weather_service_;
-};
-
-class RPCServer {
-public:
-    RPCServer(const string& address, shared_ptr<WeatherService> service)
-        : address_(address), weather_service_(service) {
-    }
-    
-    void Start() {
-        ServerBuilder builder;
-        builder.AddListeningPort(address_, InsecureServerCredentials());
-        
-        auto rpc_service = make_shared<WeatherRPC>(weather_service_);
-        builder.RegisterService(rpc_service.get());
-        
-        server_ = builder.BuildAndStart();
-        cout << "RPC服务器监听在 " << address_ << endl;
-        
-        server_->Wait();
-    }
-    
-    void Stop() {
-        if (server_) {
-            server_->Shutdown();
-        }
-    }
-    
-private:
-    string address_;
-    shared_ptr<WeatherService> weather_service_;
-    unique_ptr<Server> server_;
-};
-
-// 主程序入口
-int main(int argc, char* argv[]) {
-    cout << "启动天气服务后端..." << endl;
-    
-    auto weather_service = make_shared<WeatherService>();
-    if (!weather_service->initialize()) {
-        cerr << "初始化天气服务失败" << endl;
-        return 1;
-    }
-    
-    cout << "天气服务初始化成功" << endl;
-    
-    // 启动RPC服务器
-    RPCServer rpc_server("0.0.0.0:50051", weather_service);
-    
-    thread rpc_thread([&rpc_server]() {
-        rpc_server.Start();
-    });
-    
-    cout << "输入 'quit' 或 'exit' 停止服务" << endl;
-    
-    // 主循环
-    string command;
-    while (true) {
-        cout << "> ";
-        getline(cin, command);
-        
-        if (command == "quit" || command == "exit") {
-            break;
-        } else if (command == "stats") {
-            auto stats = weather_service->getStatistics();
-            cout << "统计信息:" << endl;
-            cout << "  总请求数: " << stats.total_requests << endl;
-            cout << "  缓存命中: " << stats.cache_hits << endl;
-            cout << "  API调用: " << stats.api_calls << endl;
-            cout << "  平均响应时间: " 
-                 << (stats.total_requests > 0 ? 
-                     stats.total_response_time / stats.total_requests : 0)
-                 << "ms" << endl;
-        } else if (command == "clear cache") {
-            // 清空缓存
-            weather_service->setCacheEnabled(false);
-            weather_service->setCacheEnabled(true);
-            cout << "缓存已清空" << endl;
-        } else if (command == "help") {
-            cout << "可用命令:" << endl;
-            cout << "  stats        - 显示统计信息" << endl;
-            cout << "  clear cache  - 清空缓存" << endl;
-            cout << "  quit/exit    - 退出程序" << endl;
-        } else {
-            cout << "未知命令，输入 'help' 查看帮助" << endl;
-        }
-    }
-    
-    cout << "正在停止服务..." << endl;
-    rpc_server.Stop();
-    rpc_thread.join();
-    
-    cout << "服务已停止" << endl;
-    return 0;
-}
\ No newline at end of file
+#include "rpc_server.h"
+#include "weather_service.h"
+#include "weather.grpc.pb.h"
+#include <grpcpp/grpcpp.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+namespace pb = yourweather;
+
+// 共享结构体与protobuf消息之间的转换
+static void toProto(const WeatherData::HourlyData& src, pb::HourlyData* dst) {
+    dst->set_timestamp(src.timestamp);
+    dst->set_temperature(src.temperature);
+    dst->set_precipitation_probability(src.precipitation_probability);
+    dst->set_weather_code(src.weather_code);
+}
+
+static void toProto(const WeatherData::DailyData& src, pb::DailyData* dst) {
+    dst->set_date(src.date);
+    dst->set_temp_max(src.temp_max);
+    dst->set_temp_min(src.temp_min);
+    dst->set_precipitation_sum(src.precipitation_sum);
+    dst->set_weather_code(src.weather_code);
+    dst->set_sunrise(src.sunrise);
+    dst->set_sunset(src.sunset);
+}
+
+// 只转换当前天气字段
+static void toProtoCurrent(const WeatherData& src, pb::WeatherData* dst) {
+    dst->set_temperature(src.temperature);
+    dst->set_feels_like(src.feels_like);
+    dst->set_humidity(src.humidity);
+    dst->set_wind_speed(src.wind_speed);
+    dst->set_wind_direction(src.wind_direction);
+    dst->set_pressure(src.pressure);
+    dst->set_precipitation(src.precipitation);
+    dst->set_cloud_cover(src.cloud_cover);
+    dst->set_uv_index(src.uv_index);
+    dst->set_condition(src.condition);
+    dst->set_description(src.description);
+    dst->set_weather_code(src.weather_code);
+    dst->set_icon_name(src.icon_name);
+    dst->set_timestamp(src.timestamp);
+    dst->set_city(src.city);
+    dst->set_country(src.country);
+    dst->set_latitude(src.latitude);
+    dst->set_longitude(src.longitude);
+    dst->set_timezone(src.timezone);
+}
+
+static void toProto(const WeatherData& src, pb::WeatherData* dst) {
+    toProtoCurrent(src, dst);
+    
+    dst->mutable_hourly_forecast()->Reserve(static_cast<int>(src.hourly_forecast.size()));
+    for (const auto& hourly : src.hourly_forecast) {
+        toProto(hourly, dst->add_hourly_forecast());
+    }
+    for (const auto& daily : src.daily_forecast) {
+        toProto(daily, dst->add_daily_forecast());
+    }
+}
+
+static void toProto(const HourlySlice& slice, pb::HourlyRange* range) {
+    range->set_start(static_cast<uint32_t>(slice.start));
+    range->set_count(static_cast<uint32_t>(slice.count));
+    range->set_variables(slice.variables);
+    range->mutable_hours()->Reserve(static_cast<int>(slice.count));
+    
+    for (const auto& h : slice) {
+        auto* hour = range->add_hours();
+        hour->set_timestamp(h.timestamp);
+        if (slice.variables & WeatherRequest::HOURLY_TEMPERATURE) hour->set_temperature(h.temperature);
+        if (slice.variables & WeatherRequest::HOURLY_PRECIPITATION_PROBABILITY) hour->set_precipitation_probability(h.precipitation_probability);
+        if (slice.variables & WeatherRequest::HOURLY_WEATHER_CODE) hour->set_weather_code(h.weather_code);
+    }
+}
+
+static void toProto(const WeatherResponse& src, pb::WeatherResponse* dst) {
+    dst->set_success(src.success);
+    dst->set_error_message(src.error_message);
+    dst->set_error_code(static_cast<pb::ErrorCode>(src.error_code));
+    toProto(src.current_weather, dst->mutable_current_weather());
+    
+    for (const auto& forecast : src.forecast) {
+        toProto(forecast, dst->add_forecast());
+    }
+    for (const auto& city : src.city_suggestions) {
+        auto* suggestion = dst->add_city_suggestions();
+        suggestion->set_name(city.first);
+        suggestion->set_country(city.second);
+    }
+    
+    if (!src.hourly_range.empty()) {
+        toProto(src.hourly_range, dst->mutable_hourly_range());
+    }
+    
+    dst->mutable_batch_results()->Reserve(static_cast<int>(src.batch_results.size()));
+    for (const auto& item : src.batch_results) {
+        auto* result = dst->add_batch_results();
+        result->set_success(item.success);
+        result->set_from_cache(item.from_cache);
+        result->set_error_message(item.error_message);
+        result->set_error_code(static_cast<pb::ErrorCode>(item.error_code));
+        if (item.weather) {
+            toProtoCurrent(*item.weather, result->mutable_weather());
+        }
+    }
+}
+
+static void toProto(const ForecastChunk& src, uint32_t sequence, pb::ForecastChunk* dst) {
+    dst->Clear();
+    dst->set_sequence(sequence);
+    
+    switch (src.kind) {
+        case ForecastChunk::CURRENT_CONDITIONS:
+            toProtoCurrent(*src.source, dst->mutable_current());
+            break;
+        case ForecastChunk::DAILY_FORECAST: {
+            auto* daily = dst->mutable_daily();
+            daily->set_start(static_cast<uint32_t>(src.start));
+            daily->mutable_days()->Reserve(static_cast<int>(src.count));
+            for (size_t i = src.start; i < src.start + src.count; i++) {
+                toProto(src.source->daily_forecast[i], daily->add_days());
+            }
+            break;
+        }
+        case ForecastChunk::HOURLY_FORECAST:
+            toProto(src.hourly, dst->mutable_hourly());
+            break;
+        default:
+            break;
+    }
+}
+
+static WeatherRequest fromProto(const pb::WeatherRequest& src) {
+    WeatherRequest request;
+    request.type = static_cast<WeatherRequest::RequestType>(src.type());
+    request.city_name = src.city_name();
+    request.country_code = src.country_code();
+    request.days = src.days();
+    request.latitude = src.latitude();
+    request.longitude = src.longitude();
+    request.language = src.language();
+    request.units = src.units();
+    request.hourly_start = src.hourly_start();
+    request.hourly_count = src.hourly_count();
+    request.hourly_variables = src.hourly_variables() != 0 ?
+        src.hourly_variables() : static_cast<uint32_t>(WeatherRequest::HOURLY_ALL);
+    
+    request.locations.reserve(src.locations_size());
+    for (const auto& loc : src.locations()) {
+        WeatherLocation location;
+        location.city_name = loc.city_name();
+        location.country_code = loc.country_code();
+        location.latitude = loc.latitude();
+        location.longitude = loc.longitude();
+        request.locations.push_back(move(location));
+    }
+    return request;
+}
+
+// 对端IP：去掉peer()中的协议前缀和端口，如 ipv4:127.0.0.1:50000、ipv6:[::1]:50000
+static string peerAddress(const grpc::ServerContext& context) {
+    string peer = context.peer();
+    size_t scheme = peer.find(':');
+    if (scheme == string::npos) {
+        return peer;
+    }
+    string address = peer.substr(scheme + 1);
+    if (!address.empty() && address[0] == '[') {
+        size_t bracket = address.find(']');
+        return bracket != string::npos ? address.substr(1, bracket - 1) : address;
+    }
+    size_t colon = address.rfind(':');
+    return peer.compare(0, scheme, "ipv4") == 0 && colon != string::npos ? address.substr(0, colon) : address;
+}
+
+// 限速用的客户端标识：对端IP。元数据 x-client-id 只在调用来自可信代理时采用
+static string clientId(const grpc::ServerContext& context, const vector<string>& trusted_proxies) {
+    string address = peerAddress(context);
+    if (find(trusted_proxies.begin(), trusted_proxies.end(), address) != trusted_proxies.end()) {
+        const auto& metadata = context.client_metadata();
+        auto it = metadata.find("x-client-id");
+        if (it != metadata.end() && !it->second.empty()) {
+            return string(it->second.data(), it->second.size());
+        }
+    }
+    return address;
+}
+
+// 每个CompletionQueue的调用上下文
+struct RPCCallContext {
+    pb::WeatherRPC::AsyncService* service;
+    grpc::ServerCompletionQueue* cq;
+    WeatherService* weather_service;
+    atomic<int>* in_flight;        // 已交给线程池、尚未提交结果的调用数
+    size_t forecast_chunk_hours;
+    vector<string> trusted_proxies;
+};
+
+// 异步调用的基类，CompletionQueue的tag就是调用对象本身
+class RPCCall {
+public:
+    virtual ~RPCCall() = default;
+    virtual void proceed(bool ok) = 0;
+};
+
+// 一元调用：GetCurrentWeather / SearchCity / GetBatch
+class UnaryCall : public RPCCall {
+public:
+    using RequestMethod = void (pb::WeatherRPC::AsyncService::*)(
+        grpc::ServerContext*, pb::WeatherRequest*,
+        grpc::ServerAsyncResponseWriter<pb::WeatherResponse>*,
+        grpc::CompletionQueue*, grpc::ServerCompletionQueue*, void*);
+    
+    // forced_type < 0 时使用客户端请求中的类型
+    UnaryCall(RPCCallContext* ctx, RequestMethod method, int forced_type)
+        : ctx_(ctx), method_(method), forced_type_(forced_type), responder_(&context_) {
+        (ctx_->service->*method_)(&context_, &request_, &responder_, ctx_->cq, ctx_->cq, this);
+    }
+    
+    void proceed(bool ok) override {
+        if (state_ == WAITING) {
+            if (!ok) {
+                delete this; // 服务器正在关闭
+                return;
+            }
+            
+            // 先挂起下一个同类调用，再处理当前调用
+            new UnaryCall(ctx_, method_, forced_type_);
+            state_ = FINISHING;
+            
+            WeatherRequest request = fromProto(request_);
+            if (forced_type_ >= 0) {
+                request.type = static_cast<WeatherRequest::RequestType>(forced_type_);
+            }
+            request.client_id = clientId(context_, ctx_->trusted_proxies);
+            
+            RPCCallContext* ctx = ctx_;
+            ctx->in_flight->fetch_add(1);
+            ctx->weather_service->submitRequest(request, [this, ctx](WeatherResponse response) {
+                toProto(response, &reply_);
+                responder_.Finish(reply_, grpc::Status::OK, this);
+                ctx->in_flight->fetch_sub(1); // Finish之后this可能已被释放
+            });
+        } else {
+            delete this;
+        }
+    }
+
+private:
+    enum State { WAITING, FINISHING };
+    
+    RPCCallContext* ctx_;
+    RequestMethod method_;
+    int forced_type_;
+    State state_ = WAITING;
+    grpc::ServerContext context_;
+    pb::WeatherRequest request_;
+    pb::WeatherResponse reply_;
+    grpc::ServerAsyncResponseWriter<pb::WeatherResponse> responder_;
+};
+
+// 服务端流式调用：GetForecast
+// 线程池中的任务边生成分块边入队，同一时刻只有一个Write在进行，
+// 上一个Write完成后由CompletionQueue线程写出下一个分块
+class ForecastStreamCall : public RPCCall {
+public:
+    explicit ForecastStreamCall(RPCCallContext* ctx)
+        : ctx_(ctx), writer_(&context_) {
+        ctx_->service->RequestGetForecast(&context_, &request_, &writer_, ctx_->cq, ctx_->cq, this);
+    }
+    
+    void proceed(bool ok) override {
+        switch (state_) {
+            case WAITING: {
+                if (!ok) {
+                    delete this;
+                    return;
+                }
+                
+                new ForecastStreamCall(ctx_);
+                state_ = STREAMING;
+                
+                WeatherRequest request = fromProto(request_);
+                request.type = WeatherRequest::FORECAST;
+                request.client_id = clientId(context_, ctx_->trusted_proxies);
+                
+                RPCCallContext* ctx = ctx_;
+                ctx->in_flight->fetch_add(1);
+                ctx->weather_service->getExecutor().submit([this, ctx, request]() {
+                    ctx->weather_service->streamForecast(request, [this](const ForecastChunk& chunk) {
+                        return enqueue(chunk);
+                    }, ctx->forecast_chunk_hours);
+                    producerDone();
+                    ctx->in_flight->fetch_sub(1); // producerDone之后this可能已被释放
+                }, WeatherService::getRequestPriority(request));
+                break;
+            }
+            case STREAMING:
+                writeCompleted(ok);
+                break;
+            case FINISHING:
+                delete this;
+                break;
+        }
+    }
+
+private:
+    enum State { WAITING, STREAMING, FINISHING };
+    
+    // 线程池线程调用，返回false表示客户端已断开
+    bool enqueue(const ForecastChunk& chunk) {
+        lock_guard<mutex> lock(mutex_);
+        if (failed_) {
+            return false;
+        }
+        
+        if (chunk.kind == ForecastChunk::STREAM_ERROR) {
+            grpc::StatusCode code = grpc::StatusCode::UNAVAILABLE;
+            if (chunk.error_code == ERR_RATE_LIMITED) {
+                code = grpc::StatusCode::RESOURCE_EXHAUSTED;
+            } else if (chunk.error_code == ERR_NOT_FOUND) {
+                code = grpc::StatusCode::NOT_FOUND;
+            }
+            status_ = grpc::Status(code, chunk.error_message);
+            return false;
+        }
+        
+        if (writing_) {
+            pending_.push_back(chunk);
+        } else {
+            writing_ = true;
+            write(chunk);
+        }
+        return true;
+    }
+    
+    void producerDone() {
+        lock_guard<mutex> lock(mutex_);
+        producer_done_ = true;
+        if (!writing_) {
+            finish();
+        }
+    }
+    
+    void writeCompleted(bool ok) {
+        lock_guard<mutex> lock(mutex_);
+        if (!ok) {
+            failed_ = true;
+            pending_.clear();
+        }
+        
+        if (!pending_.empty()) {
+            write(pending_.front());
+            pending_.pop_front();
+            return;
+        }
+        
+        writing_ = false;
+        if (producer_done_) {
+            finish();
+        }
+    }
+    
+    // 以下两个函数需持有mutex_
+    void write(const ForecastChunk& chunk) {
+        toProto(chunk, sequence_++, &reply_);
+        writer_.Write(reply_, this);
+    }
+    
+    void finish() {
+        state_ = FINISHING;
+        writer_.Finish(failed_ ? grpc::Status(grpc::StatusCode::CANCELLED, "写入失败") : status_, this);
+    }
+    
+    RPCCallContext* ctx_;
+    State state_ = WAITING;
+    grpc::ServerContext context_;
+    pb::WeatherRequest request_;
+    pb::ForecastChunk reply_;
+    grpc::ServerAsyncWriter<pb::ForecastChunk> writer_;
+    
+    mutex mutex_;
+    deque<ForecastChunk> pending_;   // 分块只引用缓存数据，排队时不复制数组
+    uint32_t sequence_ = 0;
+    bool writing_ = false;
+    bool producer_done_ = false;
+    bool failed_ = false;
+    grpc::Status status_;
+};
+
+class RPCServer::Impl {
+public:
+    Impl(const Options& options, WeatherService* weather_service)
+        : options_(options), weather_service_(weather_service) {
+    }
+    
+    Options options_;
+    WeatherService* weather_service_;
+    
+    pb::WeatherRPC::AsyncService service_;
+    unique_ptr<grpc::Server> server_;
+    vector<unique_ptr<grpc::ServerCompletionQueue>> cqs_;
+    vector<unique_ptr<RPCCallContext>> contexts_;
+    vector<thread> threads_;
+    atomic<int> in_flight_{0};
+};
+
+RPCServer::RPCServer(const Options& options, WeatherService* weather_service)
+    : impl_(make_unique<Impl>(options, weather_service)) {
+}
+
+RPCServer::~RPCServer() {
+    Stop();
+}
+
+bool RPCServer::Start() {
+    grpc::ServerBuilder builder;
+    builder.AddListeningPort(impl_->options_.address, grpc::InsecureServerCredentials());
+    builder.RegisterService(&impl_->service_);
+    builder.SetMaxReceiveMessageSize(impl_->options_.max_message_size);
+    builder.SetMaxSendMessageSize(impl_->options_.max_message_size);
+    builder.AddChannelArgument(GRPC_ARG_ALLOW_REUSEPORT, impl_->options_.reuse_port ? 1 : 0);
+    
+    int cq_count = impl_->options_.cq_threads > 0 ?
+        impl_->options_.cq_threads : max(1, static_cast<int>(thread::hardware_concurrency()));
+    for (int i = 0; i < cq_count; i++) {
+        impl_->cqs_.push_back(builder.AddCompletionQueue());
+    }
+    
+    impl_->server_ = builder.BuildAndStart();
+    if (!impl_->server_) {
+        cerr << "RPC服务器启动失败: " << impl_->options_.address << endl;
+        impl_->cqs_.clear();
+        return false;
+    }
+    
+    for (auto& cq : impl_->cqs_) {
+        impl_->contexts_.push_back(make_unique<RPCCallContext>(
+            RPCCallContext{&impl_->service_, cq.get(), impl_->weather_service_, &impl_->in_flight_,
+                           impl_->options_.forecast_chunk_hours, impl_->options_.trusted_proxies}));
+        RPCCallContext* ctx = impl_->contexts_.back().get();
+        
+        // 每个CompletionQueue上各挂起一个调用，收到调用后再补充
+        new UnaryCall(ctx, &pb::WeatherRPC::AsyncService::RequestGetCurrentWeather, -1);
+        new UnaryCall(ctx, &pb::WeatherRPC::AsyncService::RequestSearchCity, WeatherRequest::SEARCH_CITY);
+        new UnaryCall(ctx, &pb::WeatherRPC::AsyncService::RequestGetBatch, WeatherRequest::BATCH);
+        new ForecastStreamCall(ctx);
+        
+        grpc::ServerCompletionQueue* queue = cq.get();
+        impl_->threads_.emplace_back([queue]() {
+            void* tag = nullptr;
+            bool ok = false;
+            while (queue->Next(&tag, &ok)) {
+                static_cast<RPCCall*>(tag)->proceed(ok);
+            }
+        });
+    }
+    
+    cout << "RPC服务器监听在 " << impl_->options_.address
+         << "（" << cq_count << " 个CompletionQueue线程）" << endl;
+    return true;
+}
+
+void RPCServer::Stop() {
+    if (!impl_->server_) {
+        return;
+    }
+    
+    impl_->server_->Shutdown(chrono::system_clock::now() + chrono::seconds(1));
+    
+    // 等待线程池中的调用提交结果，之后才能关闭CompletionQueue
+    while (impl_->in_flight_ > 0) {
+        this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    
+    for (auto& cq : impl_->cqs_) {
+        cq->Shutdown();
+    }
+    for (auto& t : impl_->threads_) {
+        t.join();
+    }
+    
+    impl_->threads_.clear();
+    impl_->contexts_.clear();
+    impl_->cqs_.clear();
+    impl_->server_.reset();
+}
@@ -0,0 +1,308 @@
+#include "shared_cache.h"
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <new>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+const uint64_t SEGMENT_MAGIC = 0x57454154'48455231ULL;   // "WEATHER1"
+const uint32_t SHARD_COUNT = 16;
+const uint32_t PROBE_LIMIT = 8;          // 开放寻址的最大探测距离
+const size_t BYTES_PER_SLOT = 1024;      // 按平均每项1KB估算槽位数
+
+uint64_t hashKey(const string& key) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : key) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash == 0 ? 1 : hash;   // 0 表示空槽
+}
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+} // namespace
+
+// 段内只能保存偏移，各进程的映射地址不一定相同
+struct SharedMemoryCache::Header {
+    uint64_t magic;
+    uint32_t shard_count;
+    uint32_t slots_per_shard;
+    uint64_t arena_size;
+    uint64_t shard_stride;
+    uint64_t shard_offset;
+    atomic<uint64_t> hits;
+    atomic<uint64_t> misses;
+    atomic<uint64_t> stores;
+    atomic<uint64_t> evictions;
+    atomic<uint64_t> recoveries;
+};
+
+struct alignas(64) SharedMemoryCache::Shard {
+    pthread_mutex_t mutex;
+    uint64_t head;   // 数据区的逻辑写位置，只增不减
+};
+
+struct SharedMemoryCache::Slot {
+    uint64_t hash;       // 0 表示空
+    uint64_t offset;     // 记录在数据区的逻辑位置
+    int64_t expiry;
+    uint32_t key_length;
+    uint32_t value_length;
+};
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "共享内存中的计数器必须是无锁的");
+
+unique_ptr<SharedMemoryCache> SharedMemoryCache::create(size_t bytes) {
+    size_t shard_offset = alignUp(sizeof(Header), 64);
+    size_t stride = bytes > shard_offset ? (bytes - shard_offset) / SHARD_COUNT / 64 * 64 : 0;
+    size_t slot_count = stride / BYTES_PER_SLOT;
+    if (slot_count < PROBE_LIMIT * 8) {
+        return nullptr;
+    }
+    size_t arena_offset = alignUp(sizeof(Shard) + slot_count * sizeof(Slot), 64);
+    size_t size = shard_offset + stride * SHARD_COUNT;
+    
+    string name = "/weather_cache." + to_string(getpid());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+        return nullptr;
+    }
+    shm_unlink(name.c_str());
+    
+    void* base = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(size)) == 0) {
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED) {
+        return nullptr;
+    }
+    
+    Header* header = new (base) Header;
+    header->magic = SEGMENT_MAGIC;
+    header->shard_count = SHARD_COUNT;
+    header->slots_per_shard = static_cast<uint32_t>(slot_count);
+    header->arena_size = stride - arena_offset;
+    header->shard_stride = stride;
+    header->shard_offset = shard_offset;
+    header->hits = 0;
+    header->misses = 0;
+    header->stores = 0;
+    header->evictions = 0;
+    header->recoveries = 0;
+    
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    
+    unique_ptr<SharedMemoryCache> cache(new SharedMemoryCache(base, size));
+    for (uint32_t i = 0; i < SHARD_COUNT; i++) {
+        Shard* shard = new (static_cast<char*>(base) + shard_offset + i * stride) Shard;
+        pthread_mutex_init(&shard->mutex, &attr);
+        cache->resetShard(shard);
+    }
+    pthread_mutexattr_destroy(&attr);
+    
+    return cache;
+}
+
+SharedMemoryCache::SharedMemoryCache(void* base, size_t size)
+    : header_(static_cast<Header*>(base))
+    , size_(size) {
+}
+
+SharedMemoryCache::~SharedMemoryCache() {
+    munmap(header_, size_);
+}
+
+SharedMemoryCache::Shard* SharedMemoryCache::shardFor(uint64_t hash) const {
+    // 高位选分片，低位选槽位
+    char* base = reinterpret_cast<char*>(header_) + header_->shard_offset;
+    return reinterpret_cast<Shard*>(base + (hash >> 60) % header_->shard_count * header_->shard_stride);
+}
+
+SharedMemoryCache::Slot* SharedMemoryCache::slots(Shard* shard) const {
+    return reinterpret_cast<Slot*>(reinterpret_cast<char*>(shard) + sizeof(Shard));
+}
+
+char* SharedMemoryCache::arena(Shard* shard) const {
+    return reinterpret_cast<char*>(shard) + header_->shard_stride - header_->arena_size;
+}
+
+bool SharedMemoryCache::lock(Shard* shard) const {
+    int rc = pthread_mutex_lock(&shard->mutex);
+    if (rc == EOWNERDEAD) {
+        // 上一个持锁进程在修改途中退出，分片内容不可信
+        resetShard(shard);
+        header_->recoveries++;
+        pthread_mutex_consistent(&shard->mutex);
+        return true;
+    }
+    return rc == 0;
+}
+
+void SharedMemoryCache::unlock(Shard* shard) const {
+    pthread_mutex_unlock(&shard->mutex);
+}
+
+void SharedMemoryCache::resetShard(Shard* shard) const {
+    memset(slots(shard), 0, header_->slots_per_shard * sizeof(Slot));
+    shard->head = 0;
+}
+
+// 未过期，且记录之后写入的数据还没有绕回覆盖它
+bool SharedMemoryCache::isLive(Shard* shard, const Slot& slot, int64_t now) const {
+    return slot.hash != 0 && now < slot.expiry &&
+           shard->head - slot.offset <= header_->arena_size;
+}
+
+bool SharedMemoryCache::put(const string& key, const string& value, int64_t expiry) {
+    uint64_t length = key.size() + value.size();
+    if (length > header_->arena_size / 4) {
+        return false;
+    }
+    
+    uint64_t hash = hashKey(key);
+    Shard* shard = shardFor(hash);
+    if (!lock(shard)) {
+        return false;
+    }
+    
+    int64_t now = time(nullptr);
+    Slot* table = slots(shard);
+    char* data = arena(shard);
+    uint32_t count = header_->slots_per_shard;
+    uint32_t home = static_cast<uint32_t>(hash % count);
+    
+    // 优先覆盖同键的旧项，其次是空槽或失效项，都没有时挤掉最早过期的项
+    Slot* target = nullptr;
+    Slot* free_slot = nullptr;
+    Slot* oldest = nullptr;
+    for (uint32_t i = 0; i < PROBE_LIMIT; i++) {
+        Slot& slot = table[(home + i) % count];
+        if (slot.hash == hash && slot.key_length == key.size() &&
+            shard->head - slot.offset <= header_->arena_size &&
+            memcmp(data + slot.offset % header_->arena_size, key.data(), key.size()) == 0) {
+            target = &slot;
+            break;
+        }
+        if (!isLive(shard, slot, now)) {
+            if (!free_slot) free_slot = &slot;
+        } else if (!oldest || slot.expiry < oldest->expiry) {
+            oldest = &slot;
+        }
+    }
+    if (!target) {
+        target = free_slot;
+    }
+    if (!target) {
+        target = oldest;
+        header_->evictions++;
+    }
+    
+    // 记录必须连续存放，放不下时跳到数据区开头
+    uint64_t position = shard->head % header_->arena_size;
+    if (position + length > header_->arena_size) {
+        shard->head += header_->arena_size - position;
+        position = 0;
+    }
+    memcpy(data + position, key.data(), key.size());
+    memcpy(data + position + key.size(), value.data(), value.size());
+    
+    target->hash = hash;
+    target->offset = shard->head;
+    target->expiry = expiry;
+    target->key_length = static_cast<uint32_t>(key.size());
+    target->value_length = static_cast<uint32_t>(value.size());
+    shard->head += length;
+    
+    unlock(shard);
+    header_->stores++;
+    return true;
+}
+
+bool SharedMemoryCache::get(const string& key, string& value, int64_t& expiry) {
+    uint64_t hash = hashKey(key);
+    Shard* shard = shardFor(hash);
+    if (!lock(shard)) {
+        header_->misses++;
+        return false;
+    }
+    
+    int64_t now = time(nullptr);
+    Slot* table = slots(shard);
+    char* data = arena(shard);
+    uint32_t count = header_->slots_per_shard;
+    uint32_t home = static_cast<uint32_t>(hash % count);
+    bool found = false;
+    
+    for (uint32_t i = 0; i < PROBE_LIMIT; i++) {
+        Slot& slot = table[(home + i) % count];
+        if (slot.hash != hash || slot.key_length != key.size()) {
+            continue;
+        }
+        if (!isLive(shard, slot, now)) {
+            continue;
+        }
+        const char* record = data + slot.offset % header_->arena_size;
+        if (memcmp(record, key.data(), key.size()) == 0) {
+            value.assign(record + slot.key_length, slot.value_length);
+            expiry = slot.expiry;
+            found = true;
+            break;
+        }
+    }
+    
+    unlock(shard);
+    (found ? header_->hits : header_->misses)++;
+    return found;
+}
+
+void SharedMemoryCache::clear() {
+    for (uint32_t i = 0; i < header_->shard_count; i++) {
+        Shard* shard = shardFor(static_cast<uint64_t>(i) << 60);
+        if (lock(shard)) {
+            resetShard(shard);
+            unlock(shard);
+        }
+    }
+}
+
+SharedMemoryCache::Statistics SharedMemoryCache::getStatistics() const {
+    Statistics stats{};
+    stats.hits = header_->hits;
+    stats.misses = header_->misses;
+    stats.stores = header_->stores;
+    stats.evictions = header_->evictions;
+    stats.recoveries = header_->recoveries;
+    stats.slots = static_cast<size_t>(header_->slots_per_shard) * header_->shard_count;
+    stats.capacity_bytes = size_;
+    
+    int64_t now = time(nullptr);
+    for (uint32_t i = 0; i < header_->shard_count; i++) {
+        Shard* shard = shardFor(static_cast<uint64_t>(i) << 60);
+        if (!lock(shard)) {
+            continue;
+        }
+        Slot* table = slots(shard);
+        for (uint32_t j = 0; j < header_->slots_per_shard; j++) {
+            if (isLive(shard, table[j], now)) {
+                stats.entries++;
+            }
+        }
+        unlock(shard);
+    }
+    return stats;
+}
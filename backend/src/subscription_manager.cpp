@@ -0,0 +1,255 @@
+#include "subscription_manager.h"
+#include "weather_service.h"
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+
+using namespace std;
+
+SubscriptionManager::SubscriptionManager(WeatherService* weather_service, int refresh_interval)
+    : weather_service_(weather_service)
+    , refresh_interval_(refresh_interval > 0 ? refresh_interval : 30) {
+    refresh_thread_ = thread([this]() { refreshLoop(); });
+}
+
+SubscriptionManager::~SubscriptionManager() {
+    stop();
+}
+
+void SubscriptionManager::stop() {
+    {
+        lock_guard<mutex> lock(thread_mutex_);
+        if (stopping_) {
+            return;
+        }
+        stopping_ = true;
+    }
+    stop_cv_.notify_all();
+    if (refresh_thread_.joinable()) {
+        refresh_thread_.join();
+    }
+}
+
+uint64_t SubscriptionManager::subscribe(const WeatherLocation& location, Listener listener, AliveCheck alive) {
+    string key = WeatherService::currentCacheKey(location);
+    shared_ptr<const WeatherData> cached = weather_service_->getCachedCurrent(key);
+    
+    uint64_t id;
+    shared_ptr<const WeatherData> initial;
+    bool need_refresh = false;
+    {
+        lock_guard<mutex> lock(mutex_);
+        id = next_id_++;
+        
+        Topic& topic = topics_[key];
+        if (!topic.subscribers) {
+            topic.location = location;
+        }
+        
+        auto list = make_shared<SubscriberList>(topic.subscribers ? *topic.subscribers : SubscriberList());
+        list->push_back({id, listener, move(alive)});
+        topic.subscribers = move(list);
+        subscription_keys_[id] = key;
+        
+        if (!topic.last) {
+            topic.last = cached;
+        }
+        initial = topic.last;
+        
+        // 没有可推送的数据时立即刷新一次
+        if (!initial && !topic.refreshing) {
+            topic.refreshing = true;
+            topic.last_refresh = time(nullptr);
+            need_refresh = true;
+        }
+    }
+    
+    if (initial && !listener(initial)) {
+        unsubscribe(id);
+        return id;
+    }
+    
+    if (need_refresh) {
+        refresh(key, location);
+    }
+    return id;
+}
+
+void SubscriptionManager::unsubscribe(uint64_t id) {
+    string key;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = subscription_keys_.find(id);
+        if (it == subscription_keys_.end()) {
+            return;
+        }
+        key = it->second;
+    }
+    removeSubscribers(key, {id});
+}
+
+void SubscriptionManager::removeSubscribers(const string& cache_key, const vector<uint64_t>& ids) {
+    lock_guard<mutex> lock(mutex_);
+    
+    auto it = topics_.find(cache_key);
+    if (it == topics_.end()) {
+        return;
+    }
+    
+    auto list = make_shared<SubscriberList>();
+    for (const auto& subscriber : *it->second.subscribers) {
+        if (find(ids.begin(), ids.end(), subscriber.id) == ids.end()) {
+            list->push_back(subscriber);
+        }
+    }
+    for (uint64_t id : ids) {
+        subscription_keys_.erase(id);
+    }
+    
+    // 没有订阅者的位置不再刷新
+    if (list->empty()) {
+        topics_.erase(it);
+    } else {
+        it->second.subscribers = move(list);
+    }
+}
+
+void SubscriptionManager::onUpdate(const string& cache_key, const shared_ptr<const WeatherData>& data) {
+    shared_ptr<const SubscriberList> subscribers;
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto it = topics_.find(cache_key);
+        if (it == topics_.end()) {
+            return;
+        }
+        
+        Topic& topic = it->second;
+        bool is_changed = !topic.last || changed(*topic.last, *data);
+        topic.last = data;
+        if (!is_changed) {
+            return;
+        }
+        subscribers = topic.subscribers;
+    }
+    
+    vector<uint64_t> dead;
+    for (const auto& subscriber : *subscribers) {
+        if (subscriber.listener(data)) {
+            notifications_++;
+        } else {
+            dead.push_back(subscriber.id);
+        }
+    }
+    
+    if (!dead.empty()) {
+        removeSubscribers(cache_key, dead);
+    }
+}
+
+// 观测时间本身的变化不算数据变化
+bool SubscriptionManager::changed(const WeatherData& previous, const WeatherData& current) {
+    return previous.temperature != current.temperature ||
+           previous.feels_like != current.feels_like ||
+           previous.humidity != current.humidity ||
+           previous.wind_speed != current.wind_speed ||
+           previous.wind_direction != current.wind_direction ||
+           previous.pressure != current.pressure ||
+           previous.precipitation != current.precipitation ||
+           previous.cloud_cover != current.cloud_cover ||
+           previous.uv_index != current.uv_index ||
+           previous.weather_code != current.weather_code ||
+           previous.icon_name != current.icon_name;
+}
+
+// 通过批量接口刷新，城市名和经纬度订阅走同一路径，并写入与普通请求共享的缓存。
+// 缓存未过期时不会访问上游。多进程模式下缓存项可能是其他进程写入的，
+// 命中时同样交给onUpdate比较是否变化
+void SubscriptionManager::refresh(const string& cache_key, const WeatherLocation& location) {
+    WeatherRequest request;
+    request.type = WeatherRequest::BATCH;
+    request.days = 0;
+    request.latitude = 0.0;
+    request.longitude = 0.0;
+    request.locations.push_back(location);
+    
+    weather_service_->getExecutor().submit([this, cache_key, request]() {
+        WeatherResponse response = weather_service_->processRequest(request);
+        refreshes_++;
+        if (!response.batch_results.empty() && response.batch_results[0].success &&
+            response.batch_results[0].from_cache) {
+            onUpdate(cache_key, response.batch_results[0].weather);
+        }
+        
+        lock_guard<mutex> lock(mutex_);
+        auto it = topics_.find(cache_key);
+        if (it != topics_.end()) {
+            it->second.refreshing = false;
+            it->second.last_refresh = time(nullptr);
+        }
+    }, WorkStealingExecutor::LOW);
+}
+
+void SubscriptionManager::refreshLoop() {
+    unique_lock<mutex> thread_lock(thread_mutex_);
+    
+    while (!stopping_) {
+        stop_cv_.wait_for(thread_lock, chrono::seconds(1));
+        if (stopping_) {
+            break;
+        }
+        thread_lock.unlock();
+        
+        // 清理已断开的订阅者
+        vector<pair<string, shared_ptr<const SubscriberList>>> lists;
+        {
+            lock_guard<mutex> lock(mutex_);
+            lists.reserve(topics_.size());
+            for (const auto& kv : topics_) {
+                lists.emplace_back(kv.first, kv.second.subscribers);
+            }
+        }
+        for (const auto& entry : lists) {
+            vector<uint64_t> dead;
+            for (const auto& subscriber : *entry.second) {
+                if (subscriber.alive && !subscriber.alive()) {
+                    dead.push_back(subscriber.id);
+                }
+            }
+            if (!dead.empty()) {
+                removeSubscribers(entry.first, dead);
+            }
+        }
+        
+        // 刷新到期的位置
+        vector<pair<string, WeatherLocation>> due;
+        {
+            lock_guard<mutex> lock(mutex_);
+            int64_t now = time(nullptr);
+            for (auto& kv : topics_) {
+                Topic& topic = kv.second;
+                if (!topic.refreshing && now - topic.last_refresh >= refresh_interval_) {
+                    topic.refreshing = true;
+                    topic.last_refresh = now;
+                    due.emplace_back(kv.first, topic.location);
+                }
+            }
+        }
+        for (const auto& entry : due) {
+            refresh(entry.first, entry.second);
+        }
+        
+        thread_lock.lock();
+    }
+}
+
+SubscriptionManager::Statistics SubscriptionManager::getStatistics() const {
+    Statistics stats;
+    {
+        lock_guard<mutex> lock(mutex_);
+        stats.locations = topics_.size();
+        stats.subscribers = subscription_keys_.size();
+    }
+    stats.refreshes = refreshes_;
+    stats.notifications = notifications_;
+    return stats;
+}
@@ -0,0 +1,185 @@
+#include "trace.h"
+#include "json_writer.h"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+static_assert((Trace::RING_CAPACITY & (Trace::RING_CAPACITY - 1)) == 0, "RING_CAPACITY必须是2的幂");
+
+namespace {
+
+// 采样阈值：随机数的高32位小于它时采样，0为关闭
+atomic<uint64_t> sample_threshold{0};
+atomic<uint64_t> next_request_id{1};
+
+// 一条记录。用序号做顺序锁：写入前为奇数，写完为偶数，读取前后序号不变才有效。
+// 字段都是relaxed原子变量，并发读写没有数据竞争
+struct TraceEvent {
+    atomic<uint64_t> sequence{0};
+    atomic<const char*> name{nullptr};
+    atomic<int64_t> start_ns{0};
+    atomic<int64_t> end_ns{0};
+    atomic<uint64_t> request{0};
+};
+
+// 一个线程的环形缓冲区，只有所属线程写入
+struct TraceBuffer {
+    explicit TraceBuffer(uint32_t thread_index) : thread_index(thread_index) {}
+    
+    uint32_t thread_index;
+    atomic<uint64_t> head{0};
+    TraceEvent events[Trace::RING_CAPACITY];
+};
+
+// 缓冲区在线程首次记录时注册，线程退出后保留，导出时仍可读取
+mutex buffers_mutex;
+vector<shared_ptr<TraceBuffer>> buffers;
+
+TraceBuffer& localBuffer() {
+    static thread_local TraceBuffer* buffer = nullptr;
+    if (!buffer) {
+        lock_guard<mutex> lock(buffers_mutex);
+        buffers.push_back(make_shared<TraceBuffer>(static_cast<uint32_t>(buffers.size())));
+        buffer = buffers.back().get();
+    }
+    return *buffer;
+}
+
+// xorshift64*，每个线程独立，种子取自线程局部变量的地址和时钟
+uint64_t nextRandom() {
+    static thread_local uint64_t state = 0;
+    if (state == 0) {
+        state = reinterpret_cast<uintptr_t>(&state) ^
+                static_cast<uint64_t>(chrono::steady_clock::now().time_since_epoch().count()) ^
+                0x9E3779B97F4A7C15ULL;
+    }
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 0x2545F4914F6CDD1DULL;
+}
+
+} // namespace
+
+void Trace::setSampleRate(double rate) {
+    uint64_t threshold = 0;
+    if (rate >= 1.0) {
+        threshold = 1ull << 32;
+    } else if (rate > 0.0) {
+        threshold = static_cast<uint64_t>(rate * 4294967296.0);
+    }
+    sample_threshold.store(threshold, memory_order_relaxed);
+}
+
+double Trace::sampleRate() {
+    return sample_threshold.load(memory_order_relaxed) / 4294967296.0;
+}
+
+int64_t Trace::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Trace::record(const char* name, int64_t start_ns, uint64_t request) {
+    int64_t end_ns = now();
+    TraceBuffer& buffer = localBuffer();
+    uint64_t index = buffer.head.load(memory_order_relaxed);
+    TraceEvent& event = buffer.events[index & (RING_CAPACITY - 1)];
+    
+    event.sequence.store(index * 2 + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    event.name.store(name, memory_order_relaxed);
+    event.start_ns.store(start_ns, memory_order_relaxed);
+    event.end_ns.store(end_ns, memory_order_relaxed);
+    event.request.store(request, memory_order_relaxed);
+    event.sequence.store(index * 2 + 2, memory_order_release);
+    buffer.head.store(index + 1, memory_order_release);
+}
+
+Trace::Request::Request(const char* name)
+    : outer_(current_request_)
+    , name_(name) {
+    uint64_t threshold = sample_threshold.load(memory_order_relaxed);
+    if (threshold != 0 && (nextRandom() >> 32) < threshold) {
+        current_request_ = next_request_id.fetch_add(1, memory_order_relaxed);
+        start_ns_ = now();
+    } else {
+        current_request_ = 0;
+    }
+}
+
+Trace::Request::~Request() {
+    if (current_request_) {
+        record(name_, start_ns_, current_request_);
+    }
+    current_request_ = outer_;
+}
+
+size_t Trace::exportChromeTrace(string& out) {
+    vector<shared_ptr<TraceBuffer>> snapshot;
+    {
+        lock_guard<mutex> lock(buffers_mutex);
+        snapshot = buffers;
+    }
+    
+    JsonWriter writer(out);
+    writer.beginObject();
+    writer.field("displayTimeUnit", "ms");
+    writer.key("traceEvents");
+    writer.beginArray();
+    
+    size_t exported = 0;
+    for (const auto& buffer : snapshot) {
+        writer.beginObject();
+        writer.field("name", "thread_name");
+        writer.field("ph", "M");
+        writer.field("pid", 1);
+        writer.field("tid", buffer->thread_index);
+        writer.key("args");
+        writer.beginObject();
+        writer.field("name", "线程" + to_string(buffer->thread_index));
+        writer.endObject();
+        writer.endObject();
+        
+        uint64_t head = buffer->head.load(memory_order_acquire);
+        uint64_t begin = head > RING_CAPACITY ? head - RING_CAPACITY : 0;
+        for (uint64_t index = begin; index < head; index++) {
+            const TraceEvent& event = buffer->events[index & (RING_CAPACITY - 1)];
+            uint64_t sequence = event.sequence.load(memory_order_acquire);
+            if (sequence != index * 2 + 2) {
+                continue;   // 已被覆盖或正在写入
+            }
+            const char* name = event.name.load(memory_order_relaxed);
+            int64_t start_ns = event.start_ns.load(memory_order_relaxed);
+            int64_t end_ns = event.end_ns.load(memory_order_relaxed);
+            uint64_t request = event.request.load(memory_order_relaxed);
+            atomic_thread_fence(memory_order_acquire);
+            if (event.sequence.load(memory_order_relaxed) != sequence) {
+                continue;
+            }
+            
+            // 完整事件，时间单位为微秒
+            writer.beginObject();
+            writer.field("name", name);
+            writer.field("cat", "weather");
+            writer.field("ph", "X");
+            writer.field("ts", start_ns / 1000.0);
+            writer.field("dur", (end_ns - start_ns) / 1000.0);
+            writer.field("pid", 1);
+            writer.field("tid", buffer->thread_index);
+            writer.key("args");
+            writer.beginObject();
+            writer.field("request", request);
+            writer.endObject();
+            writer.endObject();
+            exported++;
+        }
+    }
+    
+    writer.endArray();
+    writer.endObject();
+    return exported;
+}
@@ -0,0 +1,342 @@
+#include "weather_codec.h"
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+const uint8_t CODEC_VERSION = 2;
+
+// 只在小端机器上运行，定长字段直接按内存布局复制
+class Encoder {
+public:
+    explicit Encoder(string& out) : out_(out) {}
+    
+    template<typename T>
+    void put(T value) {
+        out_.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+    
+    void put(const string& text) {
+        put(static_cast<uint32_t>(text.size()));
+        out_.append(text);
+    }
+
+private:
+    string& out_;
+};
+
+class Decoder {
+public:
+    Decoder(const char* data, size_t size) : p_(data), end_(data + size) {}
+    
+    template<typename T>
+    bool get(T& value) {
+        if (static_cast<size_t>(end_ - p_) < sizeof(value)) {
+            return false;
+        }
+        memcpy(&value, p_, sizeof(value));
+        p_ += sizeof(value);
+        return true;
+    }
+    
+    bool get(string& text) {
+        uint32_t length;
+        if (!get(length) || static_cast<size_t>(end_ - p_) < length) {
+            return false;
+        }
+        text.assign(p_, length);
+        p_ += length;
+        return true;
+    }
+    
+    // 按int32编码的枚举和int字段
+    template<typename T>
+    bool getInt(T& value) {
+        int32_t v;
+        if (!get(v)) {
+            return false;
+        }
+        value = static_cast<T>(v);
+        return true;
+    }
+    
+    // 数组长度不能超过剩余字节能容纳的元素数，防止损坏的数据导致巨大分配
+    bool getCount(uint32_t& count, size_t min_element_size) {
+        return get(count) && count <= static_cast<size_t>(end_ - p_) / min_element_size;
+    }
+    
+    bool done() const { return p_ == end_; }
+
+private:
+    const char* p_;
+    const char* end_;
+};
+
+// 每个元素编码后的最小字节数
+const size_t HOURLY_SIZE = 8 + 8 + 8 + 4;
+const size_t DAILY_SIZE = 8 + 8 + 8 + 8 + 4 + 4 + 4;
+const size_t WEATHER_DATA_MIN_SIZE = 8 * 8 + 4 * 5 + 4 * 6 + 4 * 2 + 1;
+
+void putHourly(Encoder& e, const WeatherData::HourlyData& h) {
+    e.put(h.timestamp);
+    e.put(h.temperature);
+    e.put(h.precipitation_probability);
+    e.put(static_cast<int32_t>(h.weather_code));
+}
+
+bool getHourly(Decoder& d, WeatherData::HourlyData& h) {
+    return d.get(h.timestamp) && d.get(h.temperature) &&
+           d.get(h.precipitation_probability) && d.getInt(h.weather_code);
+}
+
+void putWeatherData(Encoder& e, const WeatherData& data) {
+    e.put(data.temperature);
+    e.put(data.feels_like);
+    e.put(static_cast<int32_t>(data.humidity));
+    e.put(data.wind_speed);
+    e.put(static_cast<int32_t>(data.wind_direction));
+    e.put(data.pressure);
+    e.put(data.precipitation);
+    e.put(static_cast<int32_t>(data.cloud_cover));
+    e.put(static_cast<int32_t>(data.uv_index));
+    e.put(data.condition);
+    e.put(data.description);
+    e.put(static_cast<int32_t>(data.weather_code));
+    e.put(data.icon_name);
+    e.put(static_cast<uint8_t>(data.is_day));
+    e.put(data.timestamp);
+    
+    e.put(data.city);
+    e.put(data.country);
+    e.put(data.latitude);
+    e.put(data.longitude);
+    e.put(data.timezone);
+    
+    e.put(static_cast<uint32_t>(data.hourly_forecast.size()));
+    for (const auto& h : data.hourly_forecast) {
+        putHourly(e, h);
+    }
+    
+    e.put(static_cast<uint32_t>(data.daily_forecast.size()));
+    for (const auto& d : data.daily_forecast) {
+        e.put(d.date);
+        e.put(d.temp_max);
+        e.put(d.temp_min);
+        e.put(d.precipitation_sum);
+        e.put(static_cast<int32_t>(d.weather_code));
+        e.put(d.sunrise);
+        e.put(d.sunset);
+    }
+}
+
+bool getWeatherData(Decoder& d, WeatherData& out) {
+    uint8_t is_day;
+    bool ok = d.get(out.temperature) && d.get(out.feels_like) && d.getInt(out.humidity) &&
+              d.get(out.wind_speed) && d.getInt(out.wind_direction) && d.get(out.pressure) &&
+              d.get(out.precipitation) && d.getInt(out.cloud_cover) && d.getInt(out.uv_index) &&
+              d.get(out.condition) && d.get(out.description) && d.getInt(out.weather_code) &&
+              d.get(out.icon_name) && d.get(is_day) && d.get(out.timestamp) &&
+              d.get(out.city) && d.get(out.country) && d.get(out.latitude) &&
+              d.get(out.longitude) && d.get(out.timezone);
+    if (!ok) {
+        return false;
+    }
+    out.is_day = is_day != 0;
+    
+    uint32_t count;
+    if (!d.getCount(count, HOURLY_SIZE)) {
+        return false;
+    }
+    out.hourly_forecast.resize(count);
+    for (auto& h : out.hourly_forecast) {
+        if (!getHourly(d, h)) {
+            return false;
+        }
+    }
+    
+    if (!d.getCount(count, DAILY_SIZE)) {
+        return false;
+    }
+    out.daily_forecast.resize(count);
+    for (auto& day : out.daily_forecast) {
+        if (!d.get(day.date) || !d.get(day.temp_max) || !d.get(day.temp_min) ||
+            !d.get(day.precipitation_sum) || !d.getInt(day.weather_code) ||
+            !d.get(day.sunrise) || !d.get(day.sunset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void encodeWeatherData(const WeatherData& data, string& out) {
+    Encoder e(out);
+    e.put(CODEC_VERSION);
+    putWeatherData(e, data);
+}
+
+bool decodeWeatherData(const char* data, size_t size, WeatherData& out) {
+    Decoder d(data, size);
+    uint8_t version;
+    return d.get(version) && version == CODEC_VERSION && getWeatherData(d, out) && d.done();
+}
+
+void encodeWeatherRequest(const WeatherRequest& request, string& out) {
+    Encoder e(out);
+    e.put(CODEC_VERSION);
+    e.put(static_cast<int32_t>(request.type));
+    e.put(request.city_name);
+    e.put(request.country_code);
+    e.put(static_cast<int32_t>(request.days));
+    e.put(request.latitude);
+    e.put(request.longitude);
+    e.put(request.language);
+    e.put(request.units);
+    e.put(static_cast<int32_t>(request.hourly_start));
+    e.put(static_cast<int32_t>(request.hourly_count));
+    e.put(request.hourly_variables);
+    
+    e.put(static_cast<uint32_t>(request.locations.size()));
+    for (const auto& location : request.locations) {
+        e.put(location.city_name);
+        e.put(location.country_code);
+        e.put(location.latitude);
+        e.put(location.longitude);
+    }
+}
+
+bool decodeWeatherRequest(const char* data, size_t size, WeatherRequest& out) {
+    Decoder d(data, size);
+    uint8_t version;
+    bool ok = d.get(version) && version == CODEC_VERSION &&
+              d.getInt(out.type) && d.get(out.city_name) && d.get(out.country_code) &&
+              d.getInt(out.days) && d.get(out.latitude) && d.get(out.longitude) &&
+              d.get(out.language) && d.get(out.units) &&
+              d.getInt(out.hourly_start) && d.getInt(out.hourly_count) &&
+              d.get(out.hourly_variables);
+    
+    uint32_t count;
+    if (!ok || !d.getCount(count, 4 + 4 + 8 + 8)) {
+        return false;
+    }
+    out.locations.resize(count);
+    for (auto& location : out.locations) {
+        if (!d.get(location.city_name) || !d.get(location.country_code) ||
+            !d.get(location.latitude) || !d.get(location.longitude)) {
+            return false;
+        }
+    }
+    return d.done();
+}
+
+void encodeWeatherResponse(const WeatherResponse& response, string& out) {
+    Encoder e(out);
+    e.put(CODEC_VERSION);
+    e.put(static_cast<uint8_t>(response.success));
+    e.put(static_cast<int32_t>(response.error_code));
+    e.put(response.error_message);
+    putWeatherData(e, response.current_weather);
+    
+    e.put(static_cast<uint32_t>(response.forecast.size()));
+    for (const auto& f : response.forecast) {
+        putWeatherData(e, f);
+    }
+    
+    e.put(static_cast<uint32_t>(response.city_suggestions.size()));
+    for (const auto& c : response.city_suggestions) {
+        e.put(c.first);
+        e.put(c.second);
+    }
+    
+    e.put(static_cast<uint32_t>(response.hourly_range.size()));
+    e.put(response.hourly_range.variables);
+    for (const auto& h : response.hourly_range) {
+        putHourly(e, h);
+    }
+    
+    e.put(static_cast<uint32_t>(response.batch_results.size()));
+    for (const auto& item : response.batch_results) {
+        e.put(static_cast<uint8_t>(item.success));
+        e.put(static_cast<uint8_t>(item.from_cache));
+        e.put(static_cast<int32_t>(item.error_code));
+        e.put(item.error_message);
+        e.put(static_cast<uint8_t>(item.weather != nullptr));
+        if (item.weather) {
+            putWeatherData(e, *item.weather);
+        }
+    }
+}
+
+bool decodeWeatherResponse(const char* data, size_t size, WeatherResponse& out) {
+    Decoder d(data, size);
+    uint8_t version, success;
+    if (!d.get(version) || version != CODEC_VERSION || !d.get(success) ||
+        !d.getInt(out.error_code) || !d.get(out.error_message) ||
+        !getWeatherData(d, out.current_weather)) {
+        return false;
+    }
+    out.success = success != 0;
+    
+    uint32_t count;
+    if (!d.getCount(count, WEATHER_DATA_MIN_SIZE)) {
+        return false;
+    }
+    out.forecast.resize(count);
+    for (auto& f : out.forecast) {
+        if (!getWeatherData(d, f)) {
+            return false;
+        }
+    }
+    
+    if (!d.getCount(count, 8)) {
+        return false;
+    }
+    out.city_suggestions.resize(count);
+    for (auto& c : out.city_suggestions) {
+        if (!d.get(c.first) || !d.get(c.second)) {
+            return false;
+        }
+    }
+    
+    uint32_t variables;
+    if (!d.getCount(count, HOURLY_SIZE) || !d.get(variables)) {
+        return false;
+    }
+    out.hourly_range = HourlySlice();
+    if (count > 0) {
+        auto source = make_shared<WeatherData>();
+        source->hourly_forecast.resize(count);
+        for (auto& h : source->hourly_forecast) {
+            if (!getHourly(d, h)) {
+                return false;
+            }
+        }
+        out.hourly_range.source = move(source);
+        out.hourly_range.count = count;
+        out.hourly_range.variables = variables;
+    }
+    
+    if (!d.getCount(count, 1 + 1 + 4 + 4 + 1)) {
+        return false;
+    }
+    out.batch_results.resize(count);
+    for (auto& item : out.batch_results) {
+        uint8_t item_success, from_cache, has_weather;
+        if (!d.get(item_success) || !d.get(from_cache) || !d.getInt(item.error_code) ||
+            !d.get(item.error_message) || !d.get(has_weather)) {
+            return false;
+        }
+        item.success = item_success != 0;
+        item.from_cache = from_cache != 0;
+        if (has_weather) {
+            auto weather = make_shared<WeatherData>();
+            if (!getWeatherData(d, *weather)) {
+                return false;
+            }
+            item.weather = move(weather);
+        }
+    }
+    return d.done();
+}
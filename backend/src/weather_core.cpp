@@ -0,0 +1,391 @@
+#include "weather_core.h"
+#include "weather_service.h"
+#include "weather_json.h"
+#include "icon_renderer.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+using namespace std;
+
+// C接口实现：所有入口都捕获异常，C++对象只通过不透明指针暴露
+
+struct wc_service {
+    WeatherService service;
+    IconRenderer icons;
+    mutex icon_mutex;
+};
+
+struct wc_result {
+    WeatherResponse response;
+    // 当前天气：直接读缓存时引用缓存中的对象，否则指向response.current_weather
+    shared_ptr<const WeatherData> cached;
+    const WeatherData* current = nullptr;
+    string json;   // wc_result_json按需生成
+};
+
+// wc_hourly直接映射缓存中的数组，布局必须完全一致
+static_assert(sizeof(wc_hourly) == sizeof(WeatherData::HourlyData), "wc_hourly布局不匹配");
+static_assert(offsetof(wc_hourly, timestamp) == offsetof(WeatherData::HourlyData, timestamp), "wc_hourly布局不匹配");
+static_assert(offsetof(wc_hourly, temperature) == offsetof(WeatherData::HourlyData, temperature), "wc_hourly布局不匹配");
+static_assert(offsetof(wc_hourly, precipitation_probability) ==
+              offsetof(WeatherData::HourlyData, precipitation_probability), "wc_hourly布局不匹配");
+static_assert(offsetof(wc_hourly, weather_code) == offsetof(WeatherData::HourlyData, weather_code), "wc_hourly布局不匹配");
+
+namespace {
+
+// 输出结构体只写入调用方声明的大小，旧版本的调用方不会被越界写。
+// 声明的大小至少要容纳struct_size本身，它会被原样写回
+template<typename T>
+wc_status copyOut(const T& value, T* out) {
+    if (!out || out->struct_size < sizeof(out->struct_size)) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    size_t size = min<size_t>(out->struct_size, sizeof(T));
+    uint32_t struct_size = out->struct_size;
+    memcpy(out, &value, size);
+    out->struct_size = struct_size;
+    return WC_OK;
+}
+
+// 输入结构体按调用方声明的大小读取到零初始化的副本中：较旧的调用方缺少的末尾字段为零，
+// 较新的调用方多出的字段被忽略。struct_size不能小于第一个字段的偏移
+template<typename T>
+bool copyIn(const T* in, size_t first_field, T& value) {
+    if (in->struct_size < first_field) {
+        return false;
+    }
+    value = T{};
+    memcpy(&value, in, min<size_t>(in->struct_size, sizeof(T)));
+    return true;
+}
+
+// 调用方声明的大小是否包含某个字段
+template<typename T>
+bool hasField(const T& value, size_t offset, size_t size) {
+    return value.struct_size >= offset + size;
+}
+
+wc_status fillWeather(const WeatherData& data, wc_weather* out) {
+    wc_weather w{};
+    w.temperature = data.temperature;
+    w.feels_like = data.feels_like;
+    w.humidity = data.humidity;
+    w.wind_speed = data.wind_speed;
+    w.wind_direction = data.wind_direction;
+    w.pressure = data.pressure;
+    w.precipitation = data.precipitation;
+    w.cloud_cover = data.cloud_cover;
+    w.uv_index = data.uv_index;
+    w.weather_code = data.weather_code;
+    w.timestamp = data.timestamp;
+    w.latitude = data.latitude;
+    w.longitude = data.longitude;
+    w.condition = data.condition.c_str();
+    w.description = data.description.c_str();
+    w.icon_name = data.icon_name.c_str();
+    w.city = data.city.c_str();
+    w.country = data.country.c_str();
+    w.timezone = data.timezone.c_str();
+    return copyOut(w, out);
+}
+
+wc_status statusOf(const WeatherResponse& response) {
+    if (response.success) {
+        return WC_OK;
+    }
+    switch (response.error_code) {
+        case ERR_RATE_LIMITED: return WC_ERR_RATE_LIMITED;
+        case ERR_OVERLOADED: return WC_ERR_OVERLOADED;
+        case ERR_NOT_FOUND: return WC_ERR_NOT_FOUND;
+        case ERR_UPSTREAM: return WC_ERR_UPSTREAM;
+        default: return WC_ERR_FAILED;
+    }
+}
+
+const char* orEmpty(const char* text) {
+    return text ? text : "";
+}
+
+bool isIconSize(int32_t size) {
+    return size >= IconRenderer::MIN_ICON_SIZE && size <= IconRenderer::MAX_ICON_SIZE;
+}
+
+wc_status copyBuffer(const void* data, size_t size, wc_buffer* out) {
+    out->data = static_cast<uint8_t*>(malloc(size > 0 ? size : 1));
+    if (!out->data) {
+        return WC_ERR_INTERNAL;
+    }
+    memcpy(out->data, data, size);
+    out->size = size;
+    return WC_OK;
+}
+
+} // namespace
+
+extern "C" {
+
+uint32_t wc_abi_version(void) {
+    return WC_ABI_VERSION;
+}
+
+wc_service* wc_service_create(const wc_options* options_in) {
+    wc_options copied;
+    const wc_options* options = nullptr;
+    if (options_in) {
+        if (!copyIn(options_in, offsetof(wc_options, language), copied)) {
+            return nullptr;
+        }
+        if (!hasField(copied, offsetof(wc_options, enable_cache), sizeof(copied.enable_cache))) {
+            copied.enable_cache = 1;
+        }
+        options = &copied;
+    }
+    
+    try {
+        auto* handle = new wc_service();
+        WeatherService& service = handle->service;
+        if (!service.initialize()) {
+            delete handle;
+            return nullptr;
+        }
+        if (options) {
+            if (options->language) service.setLanguage(options->language);
+            if (options->units) service.setUnits(options->units);
+            if (options->cache_ttl > 0) service.setCacheTTL(options->cache_ttl);
+            service.setWorkerThreads(static_cast<size_t>(max(0, options->worker_threads)));
+            service.setCacheEnabled(options->enable_cache != 0);
+        }
+        return handle;
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void wc_service_destroy(wc_service* service) {
+    delete service;
+}
+
+wc_status wc_query(wc_service* service, const wc_request* request_in, wc_result** result) {
+    wc_request copied;
+    if (!service || !request_in || !result || !copyIn(request_in, offsetof(wc_request, type), copied)) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    const wc_request* request = &copied;
+    if (request->type < WC_CURRENT_WEATHER || request->type > WC_GEO_LOCATION) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    *result = nullptr;
+    
+    try {
+        WeatherRequest wr;
+        wr.type = static_cast<WeatherRequest::RequestType>(request->type);
+        wr.city_name = orEmpty(request->city);
+        wr.country_code = orEmpty(request->country);
+        wr.latitude = request->latitude;
+        wr.longitude = request->longitude;
+        wr.days = request->days;
+        wr.language = orEmpty(request->language);
+        wr.hourly_start = max(0, request->hourly_start);
+        wr.hourly_count = max(0, request->hourly_count);
+        if (request->hourly_variables != 0) {
+            wr.hourly_variables = request->hourly_variables & WeatherRequest::HOURLY_ALL;
+        }
+        
+        auto r = make_unique<wc_result>();
+        r->response = service->service.processRequest(wr);
+        r->current = &r->response.current_weather;
+        wc_status status = statusOf(r->response);
+        *result = r.release();
+        return status;
+    } catch (...) {
+        return WC_ERR_INTERNAL;
+    }
+}
+
+wc_status wc_get_cached_current(wc_service* service, const char* city, const char* country,
+                                wc_result** result) {
+    if (!service || !city || !result) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    *result = nullptr;
+    
+    try {
+        WeatherLocation location;
+        location.city_name = city;
+        location.country_code = orEmpty(country);
+        auto cached = service->service.getCachedCurrent(WeatherService::currentCacheKey(location));
+        if (!cached) {
+            return WC_ERR_NOT_FOUND;
+        }
+        
+        auto* r = new wc_result();
+        r->response.success = true;
+        r->cached = move(cached);
+        r->current = r->cached.get();
+        *result = r;
+        return WC_OK;
+    } catch (...) {
+        return WC_ERR_INTERNAL;
+    }
+}
+
+void wc_result_release(wc_result* result) {
+    delete result;
+}
+
+const char* wc_result_error(const wc_result* result) {
+    return result ? result->response.error_message.c_str() : "";
+}
+
+wc_status wc_result_current(const wc_result* result, wc_weather* out) {
+    if (!result) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    return fillWeather(*result->current, out);
+}
+
+size_t wc_result_hourly(const wc_result* result, const wc_hourly** data) {
+    if (!result || !data) {
+        return 0;
+    }
+    
+    const HourlySlice& range = result->response.hourly_range;
+    if (!range.empty()) {
+        *data = reinterpret_cast<const wc_hourly*>(range.begin());
+        return range.size();
+    }
+    
+    const auto& hourly = result->current->hourly_forecast;
+    *data = reinterpret_cast<const wc_hourly*>(hourly.data());
+    return hourly.size();
+}
+
+size_t wc_result_daily_count(const wc_result* result) {
+    return result ? result->current->daily_forecast.size() : 0;
+}
+
+wc_status wc_result_daily(const wc_result* result, size_t index, wc_daily* out) {
+    if (!result) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    const auto& daily = result->current->daily_forecast;
+    if (index >= daily.size()) {
+        return WC_ERR_NOT_FOUND;
+    }
+    
+    const auto& d = daily[index];
+    wc_daily value{};
+    value.date = d.date;
+    value.temp_max = d.temp_max;
+    value.temp_min = d.temp_min;
+    value.precipitation_sum = d.precipitation_sum;
+    value.weather_code = d.weather_code;
+    value.sunrise = d.sunrise.c_str();
+    value.sunset = d.sunset.c_str();
+    return copyOut(value, out);
+}
+
+size_t wc_result_forecast_count(const wc_result* result) {
+    return result ? result->response.forecast.size() : 0;
+}
+
+wc_status wc_result_forecast(const wc_result* result, size_t index, wc_weather* out) {
+    if (!result) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    if (index >= result->response.forecast.size()) {
+        return WC_ERR_NOT_FOUND;
+    }
+    return fillWeather(result->response.forecast[index], out);
+}
+
+size_t wc_result_city_count(const wc_result* result) {
+    return result ? result->response.city_suggestions.size() : 0;
+}
+
+wc_status wc_result_city(const wc_result* result, size_t index, const char** name, const char** country) {
+    if (!result || !name || !country) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    const auto& cities = result->response.city_suggestions;
+    if (index >= cities.size()) {
+        return WC_ERR_NOT_FOUND;
+    }
+    *name = cities[index].first.c_str();
+    *country = cities[index].second.c_str();
+    return WC_OK;
+}
+
+wc_status wc_result_json(wc_result* result, const char** data, size_t* size) {
+    if (!result || !data || !size) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    
+    try {
+        if (result->json.empty()) {
+            if (result->cached) {
+                writeCurrentResponse(result->json, *result->cached);
+            } else {
+                result->json.reserve(estimateResponseSize(result->response));
+                writeWeatherResponse(result->json, result->response);
+            }
+        }
+        *data = result->json.c_str();
+        *size = result->json.size();
+        return WC_OK;
+    } catch (...) {
+        return WC_ERR_INTERNAL;
+    }
+}
+
+wc_status wc_icon_render(wc_service* service, const char* name, int32_t size, wc_buffer* out) {
+    if (!service || !name || !out || !isIconSize(size)) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    *out = wc_buffer{};
+    
+    try {
+        vector<uint8_t> pixels;
+        {
+            lock_guard<mutex> lock(service->icon_mutex);
+            pixels = service->icons.renderIcon(name, size);
+        }
+        wc_status status = copyBuffer(pixels.data(), pixels.size(), out);
+        out->width = IconRenderer::getIconWidth(size);
+        out->height = IconRenderer::getIconHeight(size);
+        return status;
+    } catch (...) {
+        return WC_ERR_INTERNAL;
+    }
+}
+
+wc_status wc_icon_svg(wc_service* service, const char* name, wc_buffer* out) {
+    if (!service || !name || !out) {
+        return WC_ERR_INVALID_ARGUMENT;
+    }
+    *out = wc_buffer{};
+    
+    try {
+        string svg;
+        {
+            lock_guard<mutex> lock(service->icon_mutex);
+            svg = service->icons.renderIconSVG(name);
+        }
+        return copyBuffer(svg.data(), svg.size(), out);
+    } catch (...) {
+        return WC_ERR_INTERNAL;
+    }
+}
+
+void wc_buffer_free(wc_buffer* buffer) {
+    if (buffer) {
+        free(buffer->data);
+        *buffer = wc_buffer{};
+    }
+}
+
+} // extern "C"
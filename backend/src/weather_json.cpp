@@ -0,0 +1,272 @@
+#include "weather_json.h"
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+using namespace std;
+
+// 字段按名称顺序写出（与nlohmann对象的键顺序相同）
+
+static void writeHourly(JsonWriter& writer, const WeatherData::HourlyData& h) {
+    writer.beginObject();
+    writer.field("precipitation_probability", h.precipitation_probability);
+    writer.field("temperature", h.temperature);
+    writer.field("time", h.timestamp);
+    writer.field("weather_code", h.weather_code);
+    writer.endObject();
+}
+
+static void writeDaily(JsonWriter& writer, const WeatherData::DailyData& d) {
+    writer.beginObject();
+    writer.field("date", d.date);
+    writer.field("precipitation_sum", d.precipitation_sum);
+    writer.field("sunrise", d.sunrise);
+    writer.field("sunset", d.sunset);
+    writer.field("temp_max", d.temp_max);
+    writer.field("temp_min", d.temp_min);
+    writer.field("weather_code", d.weather_code);
+    writer.endObject();
+}
+
+void writeWeatherData(JsonWriter& writer, const WeatherData& data) {
+    writer.beginObject();
+    writer.field("city", data.city);
+    writer.field("cloud_cover", data.cloud_cover);
+    writer.field("condition", data.condition);
+    writer.field("country", data.country);
+    
+    if (!data.daily_forecast.empty()) {
+        writer.key("daily");
+        writer.beginArray();
+        for (const auto& d : data.daily_forecast) {
+            writeDaily(writer, d);
+        }
+        writer.endArray();
+    }
+    
+    writer.field("description", data.description);
+    writer.field("feels_like", data.feels_like);
+    
+    if (!data.hourly_forecast.empty()) {
+        writer.key("hourly");
+        writer.beginArray();
+        for (const auto& h : data.hourly_forecast) {
+            writeHourly(writer, h);
+        }
+        writer.endArray();
+    }
+    
+    writer.field("humidity", data.humidity);
+    writer.field("icon_name", data.icon_name);
+    writer.field("latitude", data.latitude);
+    writer.field("longitude", data.longitude);
+    writer.field("precipitation", data.precipitation);
+    writer.field("pressure", data.pressure);
+    writer.field("temperature", data.temperature);
+    writer.field("timestamp", data.timestamp);
+    writer.field("timezone", data.timezone);
+    writer.field("uv_index", data.uv_index);
+    writer.field("weather_code", data.weather_code);
+    writer.field("wind_direction", data.wind_direction);
+    writer.field("wind_speed", data.wind_speed);
+    writer.endObject();
+}
+
+// 范围查询结果按列输出，只包含请求的变量
+static void writeHourlySlice(JsonWriter& writer, const HourlySlice& slice) {
+    writer.beginObject();
+    writer.field("count", static_cast<uint64_t>(slice.count));
+    
+    if (slice.variables & WeatherRequest::HOURLY_PRECIPITATION_PROBABILITY) {
+        writer.key("precipitation_probability");
+        writer.beginArray();
+        for (const auto& h : slice) writer.value(h.precipitation_probability);
+        writer.endArray();
+    }
+    
+    writer.field("start", static_cast<uint64_t>(slice.start));
+    
+    if (slice.variables & WeatherRequest::HOURLY_TEMPERATURE) {
+        writer.key("temperature");
+        writer.beginArray();
+        for (const auto& h : slice) writer.value(h.temperature);
+        writer.endArray();
+    }
+    
+    writer.key("time");
+    writer.beginArray();
+    for (const auto& h : slice) writer.value(h.timestamp);
+    writer.endArray();
+    
+    if (slice.variables & WeatherRequest::HOURLY_WEATHER_CODE) {
+        writer.key("weather_code");
+        writer.beginArray();
+        for (const auto& h : slice) writer.value(h.weather_code);
+        writer.endArray();
+    }
+    
+    writer.endObject();
+}
+
+// 64位版本号以十六进制字符串传输，避免JavaScript丢失精度
+static void writeVersion(JsonWriter& writer, const char* name, uint64_t version) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016llx", static_cast<unsigned long long>(version));
+    writer.field(name, buffer);
+}
+
+template<typename T>
+static void writeArray(JsonWriter& writer, const char* name, const vector<T>& values) {
+    writer.key(name);
+    writer.beginArray();
+    for (const auto& v : values) writer.value(v);
+    writer.endArray();
+}
+
+static void writeForecastSection(JsonWriter& writer, const ForecastSectionDelta& section, bool full) {
+    vector<const ForecastColumnDelta*> columns;
+    for (const auto& column : section.columns) {
+        columns.push_back(&column);
+    }
+    sort(columns.begin(), columns.end(), [](const ForecastColumnDelta* a, const ForecastColumnDelta* b) {
+        return a->name < b->name;
+    });
+    
+    writer.beginObject();
+    writer.key("columns");
+    writer.beginObject();
+    for (const ForecastColumnDelta* column : columns) {
+        writer.key(column->name);
+        writer.beginObject();
+        if (full) {
+            writer.field("scale", column->scale);
+            writeArray(writer, "values", column->values);
+        } else {
+            writeArray(writer, "diff", column->values);
+            writeArray(writer, "index", column->indices);
+            writer.field("scale", column->scale);
+        }
+        writer.endObject();
+    }
+    writer.endObject();
+    
+    writer.field("length", section.length);
+    if (!full) {
+        writer.field("shift", section.shift);
+    }
+    writer.endObject();
+}
+
+static const char* errorCodeName(WeatherErrorCode code) {
+    switch (code) {
+        case ERR_RATE_LIMITED: return "rate_limited";
+        case ERR_OVERLOADED: return "overloaded";
+        case ERR_NOT_FOUND: return "not_found";
+        case ERR_UPSTREAM: return "upstream_error";
+        default: return "";
+    }
+}
+
+static void writeBatchItem(JsonWriter& writer, const BatchItemResult& item) {
+    writer.beginObject();
+    if (item.success) {
+        writer.field("cached", item.from_cache);
+        writer.key("current");
+        writeWeatherData(writer, *item.weather);
+    } else {
+        if (item.error_code != ERR_NONE) {
+            writer.field("code", errorCodeName(item.error_code));
+        }
+        writer.field("error", item.error_message);
+    }
+    writer.field("success", item.success);
+    writer.endObject();
+}
+
+void writeWeatherResponse(string& out, const WeatherResponse& response) {
+    JsonWriter writer(out);
+    writer.beginObject();
+    
+    if (!response.success) {
+        if (response.error_code != ERR_NONE) {
+            writer.field("code", errorCodeName(response.error_code));
+        }
+        writer.field("error", response.error_message);
+    } else if (!response.batch_results.empty()) {
+        writer.key("results");
+        writer.beginArray();
+        for (const auto& item : response.batch_results) {
+            writeBatchItem(writer, item);
+        }
+        writer.endArray();
+    } else if (response.forecast_delta) {
+        // 完整快照直接给出量化后的列；增量给出变化的下标和量化差值
+        const ForecastDelta& delta = *response.forecast_delta;
+        if (!delta.full) {
+            writeVersion(writer, "base", delta.base_version);
+        }
+        writer.key("current");
+        writeWeatherData(writer, response.current_weather);
+        writer.key("daily");
+        writeForecastSection(writer, delta.daily, delta.full);
+        writer.field("encoding", delta.full ? "full" : "delta");
+        writer.key("hourly");
+        writeForecastSection(writer, delta.hourly, delta.full);
+    } else {
+        if (!response.city_suggestions.empty()) {
+            writer.key("cities");
+            writer.beginArray();
+            for (const auto& c : response.city_suggestions) {
+                writer.beginObject();
+                writer.field("country", c.second);
+                writer.field("name", c.first);
+                writer.endObject();
+            }
+            writer.endArray();
+        }
+        
+        writer.key("current");
+        writeWeatherData(writer, response.current_weather);
+        
+        if (!response.forecast.empty()) {
+            writer.key("forecast");
+            writer.beginArray();
+            for (const auto& f : response.forecast) {
+                writeWeatherData(writer, f);
+            }
+            writer.endArray();
+        }
+        
+        if (!response.hourly_range.empty()) {
+            writer.key("hourly_range");
+            writeHourlySlice(writer, response.hourly_range);
+        }
+    }
+    
+    writer.field("success", response.success);
+    if (response.success && response.batch_results.empty() && response.forecast_delta) {
+        writeVersion(writer, "version", response.forecast_delta->version);
+    }
+    writer.endObject();
+}
+
+void writeCurrentResponse(string& out, const WeatherData& data) {
+    JsonWriter writer(out);
+    writer.beginObject();
+    writer.key("current");
+    writeWeatherData(writer, data);
+    writer.field("success", true);
+    writer.endObject();
+}
+
+size_t estimateResponseSize(const WeatherResponse& response) {
+    // 实测当前天气约400字节，每个逐小时元素约90字节，每日元素约150字节
+    size_t size = 512 + response.current_weather.hourly_forecast.size() * 96 +
+                  response.current_weather.daily_forecast.size() * 160 +
+                  response.forecast.size() * 420 + response.hourly_range.size() * 40 +
+                  response.batch_results.size() * 440;
+    if (response.forecast_delta) {
+        size += (response.forecast_delta->hourly.length + response.forecast_delta->daily.length) * 40;
+    }
+    return size;
+}
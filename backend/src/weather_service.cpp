@@ -1,414 +1,1297 @@
-#include "weather_service.h"
-#include "api_client.h"
-#include <algorithm>
-#include <sstream>
-#include <iomanip>
-#include <ctime>
-
-using namespace std;
-
-// WeatherCache实现
-WeatherCache::WeatherCache(int64_t default_ttl) 
-    : default_ttl_(default_ttl) {
-}
-
-void WeatherCache::put(const string& key, const WeatherData& data, int64_t ttl) {
-    lock_guard<mutex> lock(mutex_);
-    
-    int64_t now = time(nullptr);
-    CacheEntry entry;
-    entry.data = data;
-    entry.timestamp = now;
-    entry.expiry = now + (ttl > 0 ? ttl : default_ttl_);
-    
-    cache_[key] = entry;
-}
-
-bool WeatherCache::get(const string& key, WeatherData& data) {
-    lock_guard<mutex> lock(mutex_);
-    
-    auto it = cache_.find(key);
-    if (it != cache_.end()) {
-        int64_t now = time(nullptr);
-        if (now < it->second.expiry) {
-            data = it->second.data;
-            return true;
-        } else {
-            cache_.erase(it);
-        }
-    }
-    
-    return false;
-}
-
-void WeatherCache::clear() {
-    lock_guard<mutex> lock(mutex_);
-    cache_.clear();
-}
-
-void WeatherCache::cleanup() {
-    lock_guard<mutex> lock(mutex_);
-    int64_t now = time(nullptr);
-    
-    for (auto it = cache_.begin(); it != cache_.end();) {
-        if (now >= it->second.expiry) {
-            it = cache_.erase(it);
-        } else {
-            ++it;
-        }
-    }
-}
-
-// WeatherService实现
-WeatherService::WeatherService() 
-    : cache_enabled_(true)
-    , language_("zh")
-    , units_("metric") {
-    
-    api_client_ = make_unique<APIClient>();
-    cache_ = make_unique<WeatherCache>(300); // 5分钟缓存
-    
-    stats_.total_requests = 0;
-    stats_.cache_hits = 0;
-    stats_.api_calls = 0;
-    stats_.total_response_time = 0;
-}
-
-WeatherService::~WeatherService() = default;
-
-bool WeatherService::initialize() {
-    // 初始化API客户端
-    api_client_->setEndpoint("https://api.open-meteo.com/v1");
-    
-    // 清理过期缓存
-    cache_->cleanup();
-    
-    return true;
-}
-
-string WeatherService::getConditionFromCode(int code, const string& language) {
-    // WMO天气代码翻译
-    static const unordered_map<int, string> zh_cn = {
-        {0, "晴天"},
-        {1, "大部晴朗"},
-        {2, "部分多云"},
-        {3, "阴天"},
-        {45, "有雾"},
-        {48, "有雾"},
-        {51, "小雨"},
-        {53, "中雨"},
-        {55, "大雨"},
-        {56, "冻毛毛雨"},
-        {57, "强冻毛毛雨"},
-        {61, "小雨"},
-        {63, "中雨"},
-        {65, "大雨"},
-        {66, "冻雨"},
-        {67, "强冻雨"},
-        {71, "小雪"},
-        {73, "中雪"},
-        {75, "大雪"},
-        {77, "雪粒"},
-        {80, "小阵雨"},
-        {81, "中阵雨"},
-        {82, "强阵雨"},
-        {85, "小阵雪"},
-        {86, "大阵雪"},
-        {95, "雷暴"},
-        {96, "小雹雷暴"},
-        {99, "大雹雷暴"}
-    };
-    
-    static const unordered_map<int, string> en = {
-        {0, "Clear sky"},
-        {1, "Mainly clear"},
-        {2, "Partly cloudy"},
-        {3, "Overcast"},
-        {45, "Fog"},
-        {48, "Fog"},
-        {51, "Light drizzle"},
-        {53, "Moderate drizzle"},
-        {55, "Dense drizzle"},
-        {56, "Light freezing drizzle"},
-        {57, "Dense freezing drizzle"},
-        {61, "Slight rain"},
-        {63, "Moderate rain"},
-        {65, "Heavy rain"},
-        {66, "Light freezing rain"},
-        {67, "Heavy freezing rain"},
-        {71, "Slight snow fall"},
-        {73, "Moderate snow fall"},
-        {75, "Heavy snow fall"},
-        {77, "Snow grains"},
-        {80, "Slight rain showers"},
-        {81, "Moderate rain showers"},
-        {82, "Violent rain showers"},
-        {85, "Slight snow showers"},
-        {86, "Heavy snow showers"},
-        {95, "Thunderstorm"},
-        {96, "Thunderstorm with slight hail"},
-        {99, "Thunderstorm with heavy hail"}
-    };
-    
-    if (language == "zh" || language == "zh-CN") {
-        auto it = zh_cn.find(code);
-        return it != zh_cn.end() ? it->second : "未知";
-    } else {
-        auto it = en.find(code);
-        return it != en.end() ? it->second : "Unknown";
-    }
-}
-
-string WeatherService::getIconNameFromCode(int code, bool is_day) {
-    // 根据WMO天气代码和白天/夜晚返回图标名称
-    if (code == 0) return is_day ? "sunny" : "clear-night";
-    if (code >= 1 && code <= 3) return is_day ? "partly-cloudy-day" : "partly-cloudy-night";
-    if (code == 45 || code == 48) return "fog";
-    if (code >= 51 && code <= 57) return "drizzle";
-    if (code >= 61 && code <= 67) return "rain";
-    if (code >= 71 && code <= 77) return "snow";
-    if (code >= 80 && code <= 82) return "rain";
-    if (code >= 85 && code <= 86) return "snow";
-    if (code >= 95 && code <= 99) return "thunderstorm";
-    
-    return "unknown";
-}
-
-string WeatherService::formatTemperature(double temp, const string& units) {
-    stringstream ss;
-    ss << fixed << setprecision(1) << temp;
-    
-    if (units == "metric") {
-        ss << "°C";
-    } else if (units == "imperial") {
-        ss << "°F";
-    }
-    
-    return ss.str();
-}
-
-string WeatherService::formatWindSpeed(double speed, const string& units) {
-    stringstream ss;
-    ss << fixed << setprecision(1) << speed;
-    
-    if (units == "metric") {
-        ss << " km/h";
-    } else if (units == "imperial") {
-        ss << " mph";
-    }
-    
-    return ss.str();
-}
-
-string WeatherService::formatPressure(double pressure) {
-    stringstream ss;
-    ss << fixed << setprecision(0) << pressure << " hPa";
-    return ss.str();
-}
-
-WeatherResponse WeatherService::processRequest(const WeatherRequest& request) {
-    auto start_time = chrono::high_resolution_clock::now();
-    
-    {
-        lock_guard<mutex> lock(stats_mutex_);
-        stats_.total_requests++;
-    }
-    
-    WeatherResponse response;
-    response.success = false;
-    
-    try {
-        switch (request.type) {
-            case WeatherRequest::CURRENT_WEATHER:
-                response = handleCurrentWeather(request);
-                break;
-            case WeatherRequest::FORECAST:
-                response = handleForecast(request);
-                break;
-            case WeatherRequest::SEARCH_CITY:
-                response = handleCitySearch(request);
-                break;
-            case WeatherRequest::GEO_LOCATION:
-                response = handleGeoLocation(request);
-                break;
-            default:
-                response.error_message = "未知请求类型";
-                break;
-        }
-    } catch (const exception& e) {
-        response.error_message = string("处理请求时出错: ") + e.what();
-    }
-    
-    auto end_time = chrono::high_resolution_clock::now();
-    auto duration = chrono::duration_cast<chrono::milliseconds>(end_time - start_time);
-    
-    {
-        lock_guard<mutex> lock(stats_mutex_);
-        stats_.total_response_time += duration.count();
-    }
-    
-    return response;
-}
-
-WeatherResponse WeatherService::handleCurrentWeather(const WeatherRequest& request) {
-    WeatherResponse response;
-    
-    // 生成缓存键
-    string cache_key = "current_" + request.city_name + "_" + request.country_code;
-    
-    // 尝试从缓存获取
-    if (cache_enabled_) {
-        WeatherData cached_data;
-        if (cache_->get(cache_key, cached_data)) {
-            {
-                lock_guard<mutex> lock(stats_mutex_);
-                stats_.cache_hits++;
-            }
-            response.current_weather = cached_data;
-            response.success = true;
-            return response;
-        }
-    }
-    
-    // 从API获取
-    auto coords = getCityCoordinates(request.city_name, request.country_code);
-    if (coords.first == 0.0 && coords.second == 0.0) {
-        response.error_message = "无法找到城市坐标";
-        return response;
-    }
-    
-    WeatherData weather = api_client_->getCurrentWeather(
-        coords.first, coords.second, "auto", request.language.empty() ? language_ : request.language);
-    
-    weather.city = request.city_name;
-    weather.country = request.country_code;
-    weather.latitude = coords.first;
-    weather.longitude = coords.second;
-    
-    // 缓存结果
-    if (cache_enabled_) {
-        cache_->put(cache_key, weather);
-    }
-    
-    {
-        lock_guard<mutex> lock(stats_mutex_);
-        stats_.api_calls++;
-    }
-    
-    response.current_weather = weather;
-    response.success = true;
-    
-    return response;
-}
-
-WeatherResponse WeatherService::handleForecast(const WeatherRequest& request) {
-    WeatherResponse response;
-    
-    string cache_key = "forecast_" + request.city_name + "_" + 
-                      request.country_code + "_" + to_string(request.days);
-    
-    if (cache_enabled_) {
-        // 这里简化处理，实际应该缓存整个预报
-    }
-    
-    auto coords = getCityCoordinates(request.city_name, request.country_code);
-    if (coords.first == 0.0 && coords.second == 0.0) {
-        response.error_message = "无法找到城市坐标";
-        return response;
-    }
-    
-    int days = request.days > 0 ? request.days : 3;
-    WeatherData weather = api_client_->getForecast(
-        coords.first, coords.second, days, "auto", 
-        request.language.empty() ? language_ : request.language);
-    
-    weather.city = request.city_name;
-    weather.country = request.country_code;
-    
-    // 提取每日预报到响应中
-    for (size_t i = 0; i < weather.daily_forecast.size(); i++) {
-        WeatherData daily;
-        daily.temperature = weather.daily_forecast[i].temp_max;
-        daily.weather_code = weather.daily_forecast[i].weather_code;
-        daily.icon_name = getIconNameFromCode(daily.weather_code, true);
-        daily.condition = getConditionFromCode(daily.weather_code, language_);
-        response.forecast.push_back(daily);
-    }
-    
-    response.current_weather = weather;
-    response.success = true;
-    
-    {
-        lock_guard<mutex> lock(stats_mutex_);
-        stats_.api_calls++;
-    }
-    
-    return response;
-}
-
-WeatherResponse WeatherService::handleCitySearch(const WeatherRequest& request) {
-    WeatherResponse response;
-    
-    if (request.city_name.empty()) {
-        response.error_message = "搜索查询不能为空";
-        return response;
-    }
-    
-    auto results = api_client_->searchCity(request.city_name, 10);
-    response.city_suggestions = results;
-    response.success = !results.empty();
-    
-    if (!response.success) {
-        response.error_message = "未找到匹配的城市";
-    }
-    
-    return response;
-}
-
-WeatherResponse WeatherService::handleGeoLocation(const WeatherRequest& request) {
-    WeatherResponse response;
-    
-    if (request.latitude == 0.0 && request.longitude == 0.0) {
-        response.error_message = "无效的经纬度";
-        return response;
-    }
-    
-    WeatherData weather = api_client_->getCurrentWeather(
-        request.latitude, request.longitude, "auto", language_);
-    
-    response.current_weather = weather;
-    response.success = true;
-    
-    {
-        lock_guard<mutex> lock(stats_mutex_);
-        stats_.api_calls++;
-    }
-    
-    return response;
-}
-
-pair<double, double> WeatherService::getCityCoordinates(const string& city, 
-                                                      const string& country) {
-    return api_client_->getCoordinates(city, country);
-}
-
-void WeatherService::setCacheEnabled(bool enabled) {
-    cache_enabled_ = enabled;
-}
-
-void WeatherService::setCacheTTL(int64_t ttl_seconds) {
-    cache_ = make_unique<WeatherCache>(ttl_seconds);
-}
-
-void WeatherService::setLanguage(const string& language) {
-    language_ = language;
-}
-
-void WeatherService::setUnits(const string& units) {
-    units_ = units;
-}
-
-WeatherService::Statistics WeatherService::getStatistics() const {
-    lock_guard<mutex> lock(stats_mutex_);
-    return stats_;
-}
\ No newline at end of file
+#include "weather_service.h"
+#include "api_client.h"
+#include "trace.h"
+#include "subscription_manager.h"
+#include "shared_cache.h"
+#include "weather_codec.h"
+#include "weather_icons.h"
+#include <algorithm>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+// WeatherData实现
+WeatherData::WeatherData()
+    : temperature(0.0)
+    , feels_like(0.0)
+    , humidity(0)
+    , wind_speed(0.0)
+    , wind_direction(0)
+    , pressure(0.0)
+    , precipitation(0.0)
+    , cloud_cover(0)
+    , uv_index(0)
+    , weather_code(0)
+    , is_day(true)
+    , timestamp(0)
+    , latitude(0.0)
+    , longitude(0.0) {
+}
+
+// WeatherCache实现
+WeatherCache::WeatherCache(int64_t default_ttl) 
+    : default_ttl_(default_ttl) {
+}
+
+void WeatherCache::put(const string& key, const WeatherData& data, int64_t ttl) {
+    put(key, make_shared<const WeatherData>(data), ttl);
+}
+
+void WeatherCache::put(const string& key, shared_ptr<const WeatherData> data, int64_t ttl) {
+    put(key, move(data), nullptr, ttl);
+}
+
+void WeatherCache::put(const string& key, shared_ptr<const WeatherData> data,
+                       shared_ptr<const EncodedBody> encoded, int64_t ttl) {
+    Trace::Span span("cache.put");
+    int64_t now = time(nullptr);
+    int64_t expiry = now + (ttl > 0 ? ttl : default_ttl_);
+    
+    // 共享缓存在本地锁之外写入，其他进程随后即可命中
+    if (shared_) {
+        string bytes;
+        encodeWeatherData(*data, bytes);
+        shared_->put(key, bytes, expiry);
+    }
+    
+    lock_guard<mutex> lock(mutex_);
+    
+    CacheEntry entry;
+    entry.data = move(data);
+    entry.encoded = move(encoded);
+    entry.timestamp = now;
+    entry.expiry = expiry;
+    
+    cache_[key] = move(entry);
+    entries_.store(cache_.size(), memory_order_relaxed);
+}
+
+bool WeatherCache::get(const string& key, WeatherData& data) {
+    auto shared = getShared(key);
+    if (!shared) {
+        return false;
+    }
+    
+    data = *shared;
+    return true;
+}
+
+shared_ptr<const WeatherData> WeatherCache::getShared(const string& key) {
+    return getEntry(key).data;
+}
+
+WeatherCache::Lookup WeatherCache::getEntry(const string& key) {
+    Trace::Span span("cache.get");
+    {
+        lock_guard<mutex> lock(mutex_);
+        
+        auto it = cache_.find(key);
+        if (it != cache_.end()) {
+            int64_t now = time(nullptr);
+            if (now < it->second.expiry) {
+                hits_.fetch_add(1, memory_order_relaxed);
+                return {it->second.data, it->second.encoded};
+            } else {
+                cache_.erase(it);
+                expired_.fetch_add(1, memory_order_relaxed);
+                entries_.store(cache_.size(), memory_order_relaxed);
+            }
+        }
+    }
+    
+    CacheEntry entry;
+    if (loadShared(key, entry)) {
+        return {entry.data, entry.encoded};
+    }
+    misses_.fetch_add(1, memory_order_relaxed);
+    return {};
+}
+
+// 从共享缓存取回并放入本地缓存，保留原来的过期时间
+bool WeatherCache::loadShared(const string& key, CacheEntry& entry) {
+    string bytes;
+    int64_t expiry;
+    if (!shared_ || !shared_->get(key, bytes, expiry)) {
+        return false;
+    }
+    
+    auto data = make_shared<WeatherData>();
+    if (!decodeWeatherData(bytes.data(), bytes.size(), *data)) {
+        return false;
+    }
+    
+    entry.data = data;
+    entry.encoded = promote_encoder_ ? promote_encoder_(key, *data) : nullptr;
+    entry.timestamp = time(nullptr);
+    entry.expiry = expiry;
+    
+    lock_guard<mutex> lock(mutex_);
+    cache_[key] = entry;
+    entries_.store(cache_.size(), memory_order_relaxed);
+    shared_hits_.fetch_add(1, memory_order_relaxed);
+    return true;
+}
+
+void WeatherCache::clear() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        cache_.clear();
+        entries_.store(0, memory_order_relaxed);
+    }
+    if (shared_) {
+        shared_->clear();
+    }
+}
+
+void WeatherCache::cleanup() {
+    lock_guard<mutex> lock(mutex_);
+    int64_t now = time(nullptr);
+    
+    for (auto it = cache_.begin(); it != cache_.end();) {
+        if (now >= it->second.expiry) {
+            it = cache_.erase(it);
+            expired_.fetch_add(1, memory_order_relaxed);
+        } else {
+            ++it;
+        }
+    }
+    entries_.store(cache_.size(), memory_order_relaxed);
+}
+
+void WeatherCache::setSharedCache(SharedMemoryCache* shared) {
+    shared_ = shared;
+}
+
+void WeatherCache::setPromoteEncoder(PromoteEncoder encoder) {
+    promote_encoder_ = move(encoder);
+}
+
+WeatherCache::Statistics WeatherCache::getStatistics() const {
+    Statistics stats;
+    stats.hits = hits_.load(memory_order_relaxed);
+    stats.misses = misses_.load(memory_order_relaxed);
+    stats.shared_hits = shared_hits_.load(memory_order_relaxed);
+    stats.expired = expired_.load(memory_order_relaxed);
+    stats.entries = entries_.load(memory_order_relaxed);
+    return stats;
+}
+
+// NegativeCache实现
+NegativeCache::NegativeCache(size_t max_entries)
+    : max_entries_(max_entries) {
+}
+
+string NegativeCache::sharedKey(const string& key) {
+    return "negative_" + key;
+}
+
+void NegativeCache::put(const string& key, WeatherErrorCode code, const string& message, int64_t ttl) {
+    int64_t now = time(nullptr);
+    int64_t expiry = now + ttl;
+    
+    if (shared_) {
+        // 共享缓存中的格式：错误类型一个字节，之后是错误信息
+        string bytes(1, static_cast<char>(code));
+        bytes += message;
+        shared_->put(sharedKey(key), bytes, expiry);
+    }
+    
+    lock_guard<mutex> lock(mutex_);
+    
+    // 大量不同的无效查询不能让负缓存无限增长：先清理过期项，仍然满了就整体清空
+    if (entries_.size() >= max_entries_ && entries_.find(key) == entries_.end()) {
+        size_t before = entries_.size();
+        for (auto it = entries_.begin(); it != entries_.end();) {
+            it = now >= it->second.expiry ? entries_.erase(it) : next(it);
+        }
+        if (entries_.size() >= max_entries_) {
+            entries_.clear();
+        }
+        evicted_.fetch_add(before - entries_.size(), memory_order_relaxed);
+    }
+    
+    entries_[key] = {code, message, expiry};
+    size_.store(entries_.size(), memory_order_relaxed);
+}
+
+bool NegativeCache::get(const string& key, Entry& entry) {
+    Trace::Span span("negative_cache.get");
+    int64_t now = time(nullptr);
+    {
+        lock_guard<mutex> lock(mutex_);
+        
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            if (now < it->second.expiry) {
+                entry = it->second;
+                return true;
+            }
+            entries_.erase(it);
+            size_.store(entries_.size(), memory_order_relaxed);
+        }
+    }
+    
+    string bytes;
+    int64_t expiry;
+    if (!shared_ || !shared_->get(sharedKey(key), bytes, expiry) || bytes.empty()) {
+        return false;
+    }
+    
+    entry.error_code = static_cast<WeatherErrorCode>(static_cast<unsigned char>(bytes[0]));
+    entry.error_message = bytes.substr(1);
+    entry.expiry = expiry;
+    
+    lock_guard<mutex> lock(mutex_);
+    if (entries_.size() < max_entries_) {
+        entries_[key] = entry;
+        size_.store(entries_.size(), memory_order_relaxed);
+    }
+    return true;
+}
+
+void NegativeCache::clear() {
+    lock_guard<mutex> lock(mutex_);
+    entries_.clear();
+    size_.store(0, memory_order_relaxed);
+}
+
+size_t NegativeCache::size() {
+    lock_guard<mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void NegativeCache::setSharedCache(SharedMemoryCache* shared) {
+    shared_ = shared;
+}
+
+NegativeCache::Statistics NegativeCache::getStatistics() const {
+    return {evicted_.load(memory_order_relaxed), size_.load(memory_order_relaxed)};
+}
+
+// WeatherService实现
+WeatherService::WeatherService() 
+    : cache_enabled_(true)
+    , language_("zh")
+    , units_("metric") {
+    
+    api_client_ = make_unique<APIClient>();
+    cache_ = make_unique<WeatherCache>(300); // 5分钟缓存
+    negative_cache_ = make_unique<NegativeCache>();
+    executor_ = make_unique<WorkStealingExecutor>();
+    admission_ = make_unique<AdmissionController>(admission_options_, executor_->threadCount());
+    subscriptions_ = make_unique<SubscriptionManager>(this);
+    delta_encoder_ = make_unique<ForecastDeltaEncoder>();
+
+}
+
+WeatherService::~WeatherService() {
+    // 先停止订阅刷新和线程池，保证排队中的请求不会访问已销毁的成员
+    subscriptions_->stop();
+    executor_->shutdown();
+}
+
+bool WeatherService::initialize() {
+    // 初始化API客户端
+    api_client_->setEndpoint("https://api.open-meteo.com/v1");
+    
+    // 清理过期缓存
+    cache_->cleanup();
+    
+    return true;
+}
+
+string WeatherService::getConditionFromCode(int code, const string& language) {
+    // WMO天气代码翻译
+    static const unordered_map<int, string> zh_cn = {
+        {0, "晴天"},
+        {1, "大部晴朗"},
+        {2, "部分多云"},
+        {3, "阴天"},
+        {45, "有雾"},
+        {48, "有雾"},
+        {51, "小雨"},
+        {53, "中雨"},
+        {55, "大雨"},
+        {56, "冻毛毛雨"},
+        {57, "强冻毛毛雨"},
+        {61, "小雨"},
+        {63, "中雨"},
+        {65, "大雨"},
+        {66, "冻雨"},
+        {67, "强冻雨"},
+        {71, "小雪"},
+        {73, "中雪"},
+        {75, "大雪"},
+        {77, "雪粒"},
+        {80, "小阵雨"},
+        {81, "中阵雨"},
+        {82, "强阵雨"},
+        {85, "小阵雪"},
+        {86, "大阵雪"},
+        {95, "雷暴"},
+        {96, "小雹雷暴"},
+        {99, "大雹雷暴"}
+    };
+    
+    static const unordered_map<int, string> en = {
+        {0, "Clear sky"},
+        {1, "Mainly clear"},
+        {2, "Partly cloudy"},
+        {3, "Overcast"},
+        {45, "Fog"},
+        {48, "Fog"},
+        {51, "Light drizzle"},
+        {53, "Moderate drizzle"},
+        {55, "Dense drizzle"},
+        {56, "Light freezing drizzle"},
+        {57, "Dense freezing drizzle"},
+        {61, "Slight rain"},
+        {63, "Moderate rain"},
+        {65, "Heavy rain"},
+        {66, "Light freezing rain"},
+        {67, "Heavy freezing rain"},
+        {71, "Slight snow fall"},
+        {73, "Moderate snow fall"},
+        {75, "Heavy snow fall"},
+        {77, "Snow grains"},
+        {80, "Slight rain showers"},
+        {81, "Moderate rain showers"},
+        {82, "Violent rain showers"},
+        {85, "Slight snow showers"},
+        {86, "Heavy snow showers"},
+        {95, "Thunderstorm"},
+        {96, "Thunderstorm with slight hail"},
+        {99, "Thunderstorm with heavy hail"}
+    };
+    
+    if (language == "zh" || language == "zh-CN") {
+        auto it = zh_cn.find(code);
+        return it != zh_cn.end() ? it->second : "未知";
+    } else {
+        auto it = en.find(code);
+        return it != en.end() ? it->second : "Unknown";
+    }
+}
+
+string WeatherService::getIconNameFromCode(int code, bool is_day) {
+    // 根据WMO天气代码和白天/夜晚返回图标名称。毛毛雨在客户端有单独的图标，
+    // 服务端渲染时按别名映射到雨（见weather_icons.h）
+    if (code >= 51 && code <= 57) return "drizzle";
+    return string(iconName(iconForWeatherCode(code, is_day)));
+}
+
+string WeatherService::formatTemperature(double temp, const string& units) {
+    stringstream ss;
+    ss << fixed << setprecision(1) << temp;
+    
+    if (units == "metric") {
+        ss << "°C";
+    } else if (units == "imperial") {
+        ss << "°F";
+    }
+    
+    return ss.str();
+}
+
+string WeatherService::formatWindSpeed(double speed, const string& units) {
+    stringstream ss;
+    ss << fixed << setprecision(1) << speed;
+    
+    if (units == "metric") {
+        ss << " km/h";
+    } else if (units == "imperial") {
+        ss << " mph";
+    }
+    
+    return ss.str();
+}
+
+string WeatherService::formatPressure(double pressure) {
+    stringstream ss;
+    ss << fixed << setprecision(0) << pressure << " hPa";
+    return ss.str();
+}
+
+// 追踪中请求的名称，下标为WeatherRequest::RequestType
+static const char* const REQUEST_TRACE_NAMES[] = {
+    "request.current", "request.forecast", "request.search", "request.geo", "request.batch"
+};
+
+WeatherResponse WeatherService::processRequest(const WeatherRequest& request) {
+    RequestStatistics::Scope scope(stats_, request.type);
+    size_t type = static_cast<size_t>(request.type);
+    Trace::Request trace(type < RequestStatistics::TYPE_COUNT ? REQUEST_TRACE_NAMES[type] : "request");
+    
+    WeatherResponse response;
+    response.success = false;
+    
+    try {
+        switch (request.type) {
+            case WeatherRequest::CURRENT_WEATHER:
+                response = handleCurrentWeather(request);
+                break;
+            case WeatherRequest::FORECAST:
+                response = handleForecast(request);
+                break;
+            case WeatherRequest::SEARCH_CITY:
+                response = handleCitySearch(request);
+                break;
+            case WeatherRequest::GEO_LOCATION:
+                response = handleGeoLocation(request);
+                break;
+            case WeatherRequest::BATCH:
+                response = handleBatch(request);
+                break;
+            default:
+                response.error_message = "未知请求类型";
+                break;
+        }
+    } catch (const exception& e) {
+        response.error_message = string("处理请求时出错: ") + e.what();
+    }
+    
+    scope.setError(!response.success);
+    return response;
+}
+
+void WeatherService::submitRequest(const WeatherRequest& request, ResponseCallback callback) {
+    executor_->submit([this, request, callback = move(callback)]() {
+        callback(processRequest(request));
+    }, getRequestPriority(request));
+}
+
+future<WeatherResponse> WeatherService::processRequestAsync(const WeatherRequest& request) {
+    return executor_->async([this, request]() {
+        return processRequest(request);
+    }, getRequestPriority(request));
+}
+
+WorkStealingExecutor::Priority WeatherService::getRequestPriority(const WeatherRequest& request) {
+    // 当前天气最常用且最轻，城市搜索只用于输入提示
+    switch (request.type) {
+        case WeatherRequest::CURRENT_WEATHER:
+        case WeatherRequest::GEO_LOCATION:
+            return WorkStealingExecutor::HIGH;
+        case WeatherRequest::SEARCH_CITY:
+            return WorkStealingExecutor::LOW;
+        default:
+            return WorkStealingExecutor::NORMAL;
+    }
+}
+
+shared_ptr<const WeatherData> WeatherService::getCachedCurrent(const string& cache_key) {
+    return cache_enabled_ ? cache_->getShared(cache_key) : nullptr;
+}
+
+void WeatherService::setBodyEncoder(BodyEncoder encoder) {
+    body_encoder_ = move(encoder);
+    
+    // 其他进程写入共享缓存的当前天气在本进程第一次命中时编码
+    cache_->setPromoteEncoder([encoder = body_encoder_](const string& key, const WeatherData& data)
+                              -> shared_ptr<const EncodedBody> {
+        if (!encoder || key.compare(0, 8, "current_") != 0) {
+            return nullptr;
+        }
+        return encoder(data);
+    });
+}
+
+void WeatherService::setSharedCache(SharedMemoryCache* shared) {
+    cache_->setSharedCache(shared);
+    negative_cache_->setSharedCache(shared);
+}
+
+// 写入当前天气缓存并通知订阅者（数据未变化时订阅管理器不会推送）
+// 响应体在这里编码一次，之后的缓存命中直接复用
+shared_ptr<const EncodedBody> WeatherService::storeCurrent(const string& cache_key,
+                                                          const shared_ptr<const WeatherData>& data) {
+    shared_ptr<const EncodedBody> encoded;
+    if (body_encoder_) {
+        Trace::Span span("encode.body");
+        encoded = body_encoder_(*data);
+    }
+    
+    if (cache_enabled_) {
+        cache_->put(cache_key, data, encoded);
+    }
+    subscriptions_->onUpdate(cache_key, data);
+    return encoded;
+}
+
+WeatherResponse WeatherService::handleCurrentWeather(const WeatherRequest& request) {
+    WeatherResponse response;
+    
+    // 生成缓存键
+    string cache_key = "current_" + request.city_name + "_" + request.country_code;
+    
+    // 尝试从缓存获取
+    if (cache_enabled_) {
+        WeatherCache::Lookup cached = cache_->getEntry(cache_key);
+        if (cached.data) {
+            countCacheHits();
+            // 调用方能直接发送预编码的响应体时，命中路径不复制也不序列化
+            if (request.want_encoded && cached.encoded) {
+                response.encoded_body = move(cached.encoded);
+            } else {
+                response.current_weather = *cached.data;
+            }
+            response.success = true;
+            return response;
+        }
+    }
+    
+    // 最近失败过的城市在负缓存有效期内直接返回错误，不占用上游许可
+    if (lookupFailure(geocodeCacheKey(request.city_name, request.country_code),
+                      response.error_code, response.error_message) ||
+        lookupFailure(cache_key, response.error_code, response.error_message)) {
+        return response;
+    }
+    
+    // 从API获取
+    AdmissionController::Permit permit;
+    if (!admitUpstream(request, permit, response)) {
+        return response;
+    }
+    
+    GeocodeResult location = getCityCoordinates(request.city_name, request.country_code);
+    if (location.error_code != ERR_NONE) {
+        response.error_code = location.error_code;
+        response.error_message = location.error_message;
+        return response;
+    }
+    auto coords = location.coords;
+    
+    UpstreamError error;
+    WeatherData weather = api_client_->getCurrentWeather(
+        coords.first, coords.second, "auto", request.language.empty() ? language_ : request.language,
+        &error);
+    
+    countApiCall();
+    
+    // 失败或无效的数据不进入缓存
+    if (!error.ok()) {
+        response.error_code = recordFailure(cache_key, error, response.error_message);
+        return response;
+    }
+    
+    weather.city = request.city_name;
+    weather.country = request.country_code;
+    weather.latitude = coords.first;
+    weather.longitude = coords.second;
+    
+    // 缓存结果
+    shared_ptr<const EncodedBody> encoded = storeCurrent(cache_key, make_shared<const WeatherData>(weather));
+    if (request.want_encoded) {
+        response.encoded_body = move(encoded);
+    }
+    
+    response.current_weather = weather;
+    response.success = true;
+    
+    return response;
+}
+
+// 复制当前天气字段，不复制逐小时/每日数组
+static WeatherData copyCurrentConditions(const WeatherData& src) {
+    WeatherData dst;
+    dst.temperature = src.temperature;
+    dst.feels_like = src.feels_like;
+    dst.humidity = src.humidity;
+    dst.wind_speed = src.wind_speed;
+    dst.wind_direction = src.wind_direction;
+    dst.pressure = src.pressure;
+    dst.precipitation = src.precipitation;
+    dst.cloud_cover = src.cloud_cover;
+    dst.uv_index = src.uv_index;
+    dst.condition = src.condition;
+    dst.description = src.description;
+    dst.weather_code = src.weather_code;
+    dst.icon_name = src.icon_name;
+    dst.is_day = src.is_day;
+    dst.timestamp = src.timestamp;
+    dst.city = src.city;
+    dst.country = src.country;
+    dst.latitude = src.latitude;
+    dst.longitude = src.longitude;
+    dst.timezone = src.timezone;
+    return dst;
+}
+
+// 完整预报时域按城市只缓存一份，不同天数和小时范围的请求共用
+string WeatherService::forecastCacheKey(const WeatherRequest& request) {
+    return "forecast_" + request.city_name + "_" + request.country_code;
+}
+
+shared_ptr<const WeatherData> WeatherService::loadForecast(const WeatherRequest& request,
+                                                          WeatherResponse& response) {
+    string cache_key = forecastCacheKey(request);
+    
+    shared_ptr<const WeatherData> forecast;
+    if (cache_enabled_) {
+        forecast = cache_->getShared(cache_key);
+        if (forecast) {
+            countCacheHits();
+            return forecast;
+        }
+    }
+    
+    if (lookupFailure(geocodeCacheKey(request.city_name, request.country_code),
+                      response.error_code, response.error_message) ||
+        lookupFailure(cache_key, response.error_code, response.error_message)) {
+        return nullptr;
+    }
+    
+    AdmissionController::Permit permit;
+    if (!admitUpstream(request, permit, response)) {
+        return nullptr;
+    }
+    
+    GeocodeResult location = getCityCoordinates(request.city_name, request.country_code);
+    if (location.error_code != ERR_NONE) {
+        response.error_code = location.error_code;
+        response.error_message = location.error_message;
+        return nullptr;
+    }
+    
+    UpstreamError error;
+    WeatherData weather = api_client_->getForecast(
+        location.coords.first, location.coords.second, APIClient::MAX_FORECAST_DAYS, "auto", 
+        request.language.empty() ? language_ : request.language, &error);
+    
+    countApiCall();
+    
+    if (!error.ok()) {
+        response.error_code = recordFailure(cache_key, error, response.error_message);
+        return nullptr;
+    }
+    
+    weather.city = request.city_name;
+    weather.country = request.country_code;
+    
+    forecast = make_shared<const WeatherData>(move(weather));
+    if (cache_enabled_) {
+        cache_->put(cache_key, forecast);
+    }
+    
+    return forecast;
+}
+
+WeatherResponse WeatherService::handleForecast(const WeatherRequest& request) {
+    WeatherResponse response;
+    
+    shared_ptr<const WeatherData> forecast = loadForecast(request, response);
+    if (!forecast) {
+        return response;
+    }
+    
+    int days = request.days > 0 ? min(request.days, APIClient::MAX_FORECAST_DAYS) : 3;
+    size_t day_count = min(static_cast<size_t>(days), forecast->daily_forecast.size());
+    
+    response.current_weather = copyCurrentConditions(*forecast);
+    
+    // 增量编码：数组只通过forecast_delta返回
+    if (request.delta_encoding) {
+        response.forecast_delta = delta_encoder_->encode(
+            forecastCacheKey(request), forecast, day_count, request.base_version);
+        response.success = true;
+        return response;
+    }
+    
+    response.current_weather.daily_forecast.assign(
+        forecast->daily_forecast.begin(), forecast->daily_forecast.begin() + day_count);
+    
+    // 提取每日预报到响应中
+    for (size_t i = 0; i < day_count; i++) {
+        WeatherData daily;
+        daily.temperature = forecast->daily_forecast[i].temp_max;
+        daily.weather_code = forecast->daily_forecast[i].weather_code;
+        daily.icon_name = getIconNameFromCode(daily.weather_code, true);
+        daily.condition = getConditionFromCode(daily.weather_code, language_);
+        response.forecast.push_back(daily);
+    }
+    
+    fillHourlyRange(request, forecast, response);
+    response.success = true;
+    
+    return response;
+}
+
+void WeatherService::fillHourlyRange(const WeatherRequest& request,
+                                     const shared_ptr<const WeatherData>& forecast,
+                                     WeatherResponse& response) {
+    size_t total = forecast->hourly_forecast.size();
+    
+    if (request.hourly_count <= 0) {
+        // 兼容旧行为：未指定范围时附带前24小时
+        size_t count = min(total, static_cast<size_t>(24));
+        response.current_weather.hourly_forecast.assign(
+            forecast->hourly_forecast.begin(), forecast->hourly_forecast.begin() + count);
+        return;
+    }
+    
+    // 范围查询：返回缓存数组的视图，不复制数据
+    size_t start = min(static_cast<size_t>(max(request.hourly_start, 0)), total);
+    size_t count = min(static_cast<size_t>(request.hourly_count), total - start);
+    
+    response.hourly_range.source = forecast;
+    response.hourly_range.start = start;
+    response.hourly_range.count = count;
+    response.hourly_range.variables = request.hourly_variables & WeatherRequest::HOURLY_ALL;
+}
+
+void WeatherService::streamForecast(const WeatherRequest& request,
+                                    const ForecastChunkCallback& callback,
+                                    size_t hourly_chunk_size) {
+    RequestStatistics::Scope scope(stats_, WeatherRequest::FORECAST);
+    Trace::Request trace("request.forecast_stream");
+    
+    if (hourly_chunk_size == 0) {
+        hourly_chunk_size = 24;
+    }
+    
+    ForecastChunk chunk;
+    
+    try {
+        // 预报未缓存时需要访问上游，先把缓存中的当前天气推送出去
+        bool current_sent = false;
+        if (cache_enabled_ && !cache_->getShared(forecastCacheKey(request))) {
+            auto current = cache_->getShared("current_" + request.city_name + "_" + request.country_code);
+            if (current) {
+                chunk.kind = ForecastChunk::CURRENT_CONDITIONS;
+                chunk.source = current;
+                if (!callback(chunk)) {
+                    return;
+                }
+                current_sent = true;
+            }
+        }
+        
+        WeatherResponse status;
+        shared_ptr<const WeatherData> forecast = loadForecast(request, status);
+        if (!forecast) {
+            scope.setError(true);
+            chunk = ForecastChunk();
+            chunk.kind = ForecastChunk::STREAM_ERROR;
+            chunk.error_code = status.error_code;
+            chunk.error_message = status.error_message;
+            callback(chunk);
+            return;
+        }
+        
+        if (!current_sent) {
+            chunk.kind = ForecastChunk::CURRENT_CONDITIONS;
+            chunk.source = forecast;
+            if (!callback(chunk)) {
+                return;
+            }
+        }
+        
+        int days = request.days > 0 ? min(request.days, APIClient::MAX_FORECAST_DAYS) : 3;
+        chunk.kind = ForecastChunk::DAILY_FORECAST;
+        chunk.source = forecast;
+        chunk.start = 0;
+        chunk.count = min(static_cast<size_t>(days), forecast->daily_forecast.size());
+        if (!callback(chunk)) {
+            return;
+        }
+        
+        // 未指定范围时推送所请求天数内的全部小时
+        size_t total = forecast->hourly_forecast.size();
+        size_t start = 0;
+        size_t count = min(total, static_cast<size_t>(days) * 24);
+        if (request.hourly_count > 0) {
+            start = min(static_cast<size_t>(max(request.hourly_start, 0)), total);
+            count = min(static_cast<size_t>(request.hourly_count), total - start);
+        }
+        
+        chunk.kind = ForecastChunk::HOURLY_FORECAST;
+        chunk.source.reset();
+        chunk.count = 0;
+        chunk.hourly.source = forecast;
+        chunk.hourly.variables = request.hourly_variables & WeatherRequest::HOURLY_ALL;
+        for (size_t offset = 0; offset < count; offset += hourly_chunk_size) {
+            chunk.hourly.start = start + offset;
+            chunk.hourly.count = min(hourly_chunk_size, count - offset);
+            if (!callback(chunk)) {
+                return;
+            }
+        }
+    } catch (const exception& e) {
+        scope.setError(true);
+        chunk = ForecastChunk();
+        chunk.kind = ForecastChunk::STREAM_ERROR;
+        chunk.error_message = string("处理请求时出错: ") + e.what();
+        callback(chunk);
+    }
+}
+
+WeatherResponse WeatherService::handleCitySearch(const WeatherRequest& request) {
+    WeatherResponse response;
+    
+    if (request.city_name.empty()) {
+        response.error_message = "搜索查询不能为空";
+        return response;
+    }
+    
+    // 没有结果的查询（多为输入中途或拼写错误）短期内不再访问上游
+    string search_key = "search_" + request.city_name;
+    if (lookupFailure(search_key, response.error_code, response.error_message)) {
+        return response;
+    }
+    
+    AdmissionController::Permit permit;
+    if (!admitUpstream(request, permit, response)) {
+        return response;
+    }
+    
+    UpstreamError error;
+    auto results = api_client_->searchCity(request.city_name, 10, &error);
+    if (error.ok() && results.empty()) {
+        error.kind = UpstreamError::NOT_FOUND;
+    }
+    
+    if (!error.ok()) {
+        response.error_code = recordFailure(search_key, error, response.error_message);
+        if (response.error_code == ERR_NOT_FOUND) {
+            response.error_message = "未找到匹配的城市";
+        }
+        return response;
+    }
+    
+    response.city_suggestions = results;
+    response.success = true;
+    
+    return response;
+}
+
+WeatherResponse WeatherService::handleGeoLocation(const WeatherRequest& request) {
+    WeatherResponse response;
+    
+    if (request.latitude == 0.0 && request.longitude == 0.0) {
+        response.error_message = "无效的经纬度";
+        return response;
+    }
+    
+    AdmissionController::Permit permit;
+    if (!admitUpstream(request, permit, response)) {
+        return response;
+    }
+    
+    UpstreamError error;
+    WeatherData weather = api_client_->getCurrentWeather(
+        request.latitude, request.longitude, "auto", language_, &error);
+    
+    countApiCall();
+    
+    // 任意坐标不做负缓存，只报告错误
+    if (!error.ok()) {
+        stats_.add(RequestStatistics::UPSTREAM_ERRORS);
+        response.error_code = ERR_UPSTREAM;
+        response.error_message = "获取天气数据失败: " + error.message;
+        return response;
+    }
+    
+    response.current_weather = weather;
+    response.success = true;
+    
+    return response;
+}
+
+// 城市名的缓存键与handleCurrentWeather一致，两者共享缓存
+string WeatherService::currentCacheKey(const WeatherLocation& location) {
+    if (!location.city_name.empty()) {
+        return "current_" + location.city_name + "_" + location.country_code;
+    }
+    
+    char key[64];
+    snprintf(key, sizeof(key), "current_@%.4f,%.4f", location.latitude, location.longitude);
+    return key;
+}
+
+WeatherResponse WeatherService::handleBatch(const WeatherRequest& request) {
+    WeatherResponse response;
+    
+    if (request.locations.empty()) {
+        response.error_message = "批量请求的位置列表为空";
+        return response;
+    }
+    
+    if (request.locations.size() > MAX_BATCH_SIZE) {
+        response.error_message = "批量请求最多包含" + to_string(MAX_BATCH_SIZE) + "个位置";
+        return response;
+    }
+    
+    // 未命中缓存的位置，相同位置只查询一次
+    struct PendingLocation {
+        string cache_key;
+        const WeatherLocation* location;
+        vector<size_t> indices;
+        pair<double, double> coords;
+    };
+    
+    vector<PendingLocation> misses;
+    unordered_map<string, size_t> miss_index;
+    response.batch_results.resize(request.locations.size());
+    
+    // 先处理缓存命中
+    int hits = 0;
+    for (size_t i = 0; i < request.locations.size(); i++) {
+        const WeatherLocation& location = request.locations[i];
+        BatchItemResult& item = response.batch_results[i];
+        
+        if (location.city_name.empty() && location.latitude == 0.0 && location.longitude == 0.0) {
+            item.error_message = "缺少城市或经纬度";
+            continue;
+        }
+        
+        string key = currentCacheKey(location);
+        if (cache_enabled_) {
+            item.weather = cache_->getShared(key);
+            if (item.weather) {
+                item.success = true;
+                item.from_cache = true;
+                hits++;
+                continue;
+            }
+        }
+        
+        if ((!location.city_name.empty() &&
+             lookupFailure(geocodeCacheKey(location.city_name, location.country_code),
+                           item.error_code, item.error_message)) ||
+            lookupFailure(key, item.error_code, item.error_message)) {
+            continue;
+        }
+        
+        auto it = miss_index.find(key);
+        if (it != miss_index.end()) {
+            misses[it->second].indices.push_back(i);
+        } else {
+            miss_index.emplace(key, misses.size());
+            misses.push_back({key, &location, {i}, {location.latitude, location.longitude}});
+        }
+    }
+    
+    if (hits > 0) {
+        countCacheHits(hits);
+    }
+    
+    auto fail = [&response](const PendingLocation& miss, const string& message,
+                            WeatherErrorCode code = ERR_NONE) {
+        for (size_t index : miss.indices) {
+            response.batch_results[index].error_code = code;
+            response.batch_results[index].error_message = message;
+        }
+    };
+    
+    // 每个上游请求（各城市的地理编码、每批坐标查询）占一个许可，客户端令牌按地点扣除。
+    // 容量不足时只拿到部分许可，上游请求按许可数分轮进行。被拒绝时缓存命中的结果照常返回
+    AdmissionController::Permit permit;
+    if (!misses.empty()) {
+        size_t upstream_calls = (misses.size() + APIClient::MAX_BATCH_LOCATIONS - 1) / APIClient::MAX_BATCH_LOCATIONS;
+        for (const auto& miss : misses) {
+            if (!miss.location->city_name.empty()) {
+                upstream_calls++;
+            }
+        }
+        WeatherResponse status;
+        if (!admitUpstream(request, permit, status, upstream_calls, misses.size())) {
+            for (const auto& miss : misses) {
+                fail(miss, status.error_message, status.error_code);
+            }
+            response.success = true;
+            return response;
+        }
+    }
+    size_t concurrency = max<size_t>(1, permit.count());
+    
+    // 地理编码无法批量，每轮并行查询concurrency个城市
+    vector<size_t> resolved;
+    resolved.reserve(misses.size());
+    size_t next = 0;
+    while (next < misses.size()) {
+        vector<pair<size_t, future<GeocodeResult>>> wave;
+        for (; next < misses.size() && wave.size() < concurrency; next++) {
+            const WeatherLocation* location = misses[next].location;
+            if (location->city_name.empty()) {
+                resolved.push_back(next);
+                continue;
+            }
+            wave.emplace_back(next, executor_->async([this, location, trace = Trace::currentRequest()]() {
+                Trace::Adopt adopt(trace);
+                return getCityCoordinates(location->city_name, location->country_code);
+            }, WorkStealingExecutor::HIGH));
+        }
+        
+        for (auto& [m, geocode] : wave) {
+            GeocodeResult location = executor_->awaitHelping(geocode);
+            if (location.error_code != ERR_NONE) {
+                fail(misses[m], location.error_message, location.error_code);
+                continue;
+            }
+            misses[m].coords = location.coords;
+            resolved.push_back(m);
+        }
+    }
+    
+    // 合并为尽量少的上游批量请求，每轮并行concurrency批
+    string language = request.language.empty() ? language_ : request.language;
+    struct BatchFetch {
+        vector<WeatherData> weather;
+        UpstreamError error;
+        vector<UpstreamError> item_errors;
+    };
+    size_t batch_count = (resolved.size() + APIClient::MAX_BATCH_LOCATIONS - 1) / APIClient::MAX_BATCH_LOCATIONS;
+    for (size_t wave = 0; wave < batch_count; wave += concurrency) {
+        size_t wave_end = min(batch_count, wave + concurrency);
+        vector<future<BatchFetch>> fetches;
+        for (size_t b = wave; b < wave_end; b++) {
+            size_t begin = b * APIClient::MAX_BATCH_LOCATIONS;
+            size_t end = min(resolved.size(), begin + APIClient::MAX_BATCH_LOCATIONS);
+            vector<pair<double, double>> coords;
+            coords.reserve(end - begin);
+            for (size_t k = begin; k < end; k++) {
+                coords.push_back(misses[resolved[k]].coords);
+            }
+            
+            fetches.push_back(executor_->async([this, coords = move(coords), language,
+                                                trace = Trace::currentRequest()]() {
+                Trace::Adopt adopt(trace);
+                BatchFetch fetch;
+                fetch.weather = api_client_->getCurrentWeatherBatch(coords, "auto", language,
+                                                                    &fetch.error, &fetch.item_errors);
+                return fetch;
+            }, WorkStealingExecutor::HIGH));
+        }
+        
+        for (size_t b = wave; b < wave_end; b++) {
+            BatchFetch fetch = executor_->awaitHelping(fetches[b - wave]);
+        
+            countApiCall();
+        
+            size_t begin = b * APIClient::MAX_BATCH_LOCATIONS;
+            size_t end = min(resolved.size(), begin + APIClient::MAX_BATCH_LOCATIONS);
+            for (size_t k = begin; k < end; k++) {
+                PendingLocation& miss = misses[resolved[k]];
+                const UpstreamError& error = fetch.error.ok() ? fetch.item_errors[k - begin] : fetch.error;
+                if (!error.ok()) {
+                    string message;
+                    WeatherErrorCode code = recordFailure(miss.cache_key, error, message);
+                    fail(miss, message, code);
+                    continue;
+                }
+            
+                WeatherData& data = fetch.weather[k - begin];
+                data.city = miss.location->city_name;
+                data.country = miss.location->country_code;
+                data.latitude = miss.coords.first;
+                data.longitude = miss.coords.second;
+            
+                auto shared = make_shared<const WeatherData>(move(data));
+                storeCurrent(miss.cache_key, shared);
+            
+                for (size_t index : miss.indices) {
+                    response.batch_results[index].success = true;
+                    response.batch_results[index].weather = shared;
+                }
+            }
+        }
+    }
+    
+    response.success = true;
+    return response;
+}
+
+bool WeatherService::admitUpstream(const WeatherRequest& request,
+                                   AdmissionController::Permit& permit,
+                                   WeatherResponse& response,
+                                   size_t upstream_calls,
+                                   size_t locations) {
+    switch (admission_->admit(request.client_id, getRequestPriority(request), permit,
+                              upstream_calls, static_cast<double>(locations))) {
+        case AdmissionController::ADMITTED:
+            return true;
+        case AdmissionController::RATE_LIMITED:
+            response.error_code = ERR_RATE_LIMITED;
+            response.error_message = "请求过于频繁，请稍后重试";
+            return false;
+        default:
+            response.error_code = ERR_OVERLOADED;
+            response.error_message = "服务繁忙，请稍后重试";
+            return false;
+    }
+}
+
+string WeatherService::geocodeCacheKey(const string& city, const string& country) {
+    return "geo_" + city + "_" + country;
+}
+
+bool WeatherService::lookupFailure(const string& key, WeatherErrorCode& code, string& message) {
+    NegativeCache::Entry entry;
+    if (!negative_cache_->get(key, entry)) {
+        return false;
+    }
+    
+    code = entry.error_code;
+    message = entry.error_message;
+    
+    stats_.add(RequestStatistics::NEGATIVE_HITS);
+    return true;
+}
+
+WeatherErrorCode WeatherService::recordFailure(const string& key, const UpstreamError& error,
+                                               string& message) {
+    WeatherErrorCode code;
+    int64_t ttl;
+    if (error.kind == UpstreamError::NOT_FOUND) {
+        code = ERR_NOT_FOUND;
+        ttl = NOT_FOUND_TTL;
+        message = "无法找到城市坐标";
+    } else {
+        code = ERR_UPSTREAM;
+        ttl = error.transient() ? TRANSIENT_FAILURE_TTL : UPSTREAM_FAILURE_TTL;
+        message = "上游服务错误: " + error.message;
+    }
+    
+    negative_cache_->put(key, code, message, ttl);
+    
+    if (code == ERR_UPSTREAM) {
+        stats_.add(RequestStatistics::UPSTREAM_ERRORS);
+    }
+    return code;
+}
+
+WeatherService::GeocodeResult WeatherService::getCityCoordinates(const string& city, 
+                                                                 const string& country) {
+    Trace::Span span("geocode");
+    GeocodeResult result;
+    string key = geocodeCacheKey(city, country);
+    int64_t now = time(nullptr);
+    
+    {
+        lock_guard<mutex> lock(coordinates_mutex_);
+        auto it = coordinates_.find(key);
+        if (it != coordinates_.end() && now < it->second.expiry) {
+            result.coords = it->second.coords;
+            return result;
+        }
+    }
+    
+    if (lookupFailure(key, result.error_code, result.error_message)) {
+        return result;
+    }
+    
+    UpstreamError error;
+    result.coords = api_client_->getCoordinates(city, country, &error);
+    if (!error.ok()) {
+        result.error_code = recordFailure(key, error, result.error_message);
+        return result;
+    }
+    
+    lock_guard<mutex> lock(coordinates_mutex_);
+    // 城市数量有限，超出上限说明有大量随机查询，整体清空即可
+    if (coordinates_.size() >= MAX_CACHED_COORDINATES) {
+        coordinates_.clear();
+    }
+    coordinates_[key] = {result.coords, now + COORDINATES_TTL};
+    return result;
+}
+
+void WeatherService::setCacheEnabled(bool enabled) {
+    cache_enabled_ = enabled;
+}
+
+void WeatherService::setCacheTTL(int64_t ttl_seconds) {
+    cache_ = make_unique<WeatherCache>(ttl_seconds);
+}
+
+void WeatherService::setLanguage(const string& language) {
+    language_ = language;
+}
+
+void WeatherService::setUnits(const string& units) {
+    units_ = units;
+}
+
+void WeatherService::setWorkerThreads(size_t threads) {
+    // 只应在开始处理请求之前调用
+    executor_->shutdown();
+    executor_ = make_unique<WorkStealingExecutor>(threads);
+    admission_ = make_unique<AdmissionController>(admission_options_, executor_->threadCount());
+}
+
+void WeatherService::setAdmissionOptions(const AdmissionController::Options& options) {
+    // 只应在开始处理请求之前调用
+    admission_options_ = options;
+    admission_ = make_unique<AdmissionController>(admission_options_, executor_->threadCount());
+}
+
+void WeatherService::countCacheHits(uint64_t hits) {
+    stats_.add(RequestStatistics::CACHE_HITS, hits);
+}
+
+void WeatherService::countApiCall() {
+    stats_.add(RequestStatistics::API_CALLS);
+    RequestStatistics::Scope::markUpstream();
+}
+
+static WeatherService::LatencySummary summarize(const LatencyHistogram& histogram) {
+    WeatherService::LatencySummary summary;
+    summary.count = histogram.count();
+    summary.mean_us = histogram.mean();
+    summary.p50_us = histogram.percentile(0.5);
+    summary.p90_us = histogram.percentile(0.9);
+    summary.p99_us = histogram.percentile(0.99);
+    summary.p999_us = histogram.percentile(0.999);
+    summary.max_us = histogram.maxValue();
+    return summary;
+}
+
+WeatherService::Statistics WeatherService::getStatistics() const {
+    RequestStatistics::Snapshot snapshot = stats_.snapshot();
+    
+    Statistics stats;
+    stats.total_requests = snapshot.counters[RequestStatistics::REQUESTS];
+    stats.cache_hits = snapshot.counters[RequestStatistics::CACHE_HITS];
+    stats.api_calls = snapshot.counters[RequestStatistics::API_CALLS];
+    stats.negative_hits = snapshot.counters[RequestStatistics::NEGATIVE_HITS];
+    stats.upstream_errors = snapshot.counters[RequestStatistics::UPSTREAM_ERRORS];
+    stats.latency = summarize(snapshot.total());
+    for (size_t type = 0; type < RequestStatistics::TYPE_COUNT; type++) {
+        for (size_t outcome = 0; outcome < RequestStatistics::OUTCOME_COUNT; outcome++) {
+            stats.latency_by_type[type][outcome] = summarize(snapshot.latency[type][outcome]);
+        }
+    }
+    return stats;
+}
+
+RequestStatistics::Snapshot WeatherService::getRequestStatistics() const {
+    return stats_.snapshot();
+}
+
+WorkStealingExecutor::Statistics WeatherService::getExecutorStatistics() const {
+    return executor_->getStatistics();
+}
+
+AdmissionController::Statistics WeatherService::getAdmissionStatistics() const {
+    return admission_->getStatistics();
+}
+
+ForecastDeltaEncoder::Statistics WeatherService::getDeltaStatistics() const {
+    return delta_encoder_->getStatistics();
+}
+
+WeatherCache::Statistics WeatherService::getCacheStatistics() const {
+    return cache_->getStatistics();
+}
+
+NegativeCache::Statistics WeatherService::getNegativeCacheStatistics() const {
+    return negative_cache_->getStatistics();
+}
+
+APIClient::Statistics WeatherService::getUpstreamStatistics() const {
+    return api_client_->getStatistics();
+}
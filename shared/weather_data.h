@@ -1,85 +1,210 @@
-#ifndef WEATHER_DATA_H
-#define WEATHER_DATA_H
-
-#include <string>
-#include <vector>
-#include <cstdint>
-
-// 基本天气数据
-struct WeatherData {
-    double temperature;         // 温度 (°C)
-    double feels_like;          // 体感温度
-    int humidity;              // 湿度 (%)
-    double wind_speed;         // 风速 (km/h)
-    int wind_direction;        // 风向 (度)
-    double pressure;           // 气压 (hPa)
-    double precipitation;      // 降水量 (mm)
-    int cloud_cover;           // 云量 (%)
-    int uv_index;              // UV指数
-    std::string condition;     // 天气状况
-    std::string description;   // 详细描述
-    int weather_code;          // WMO天气代码
-    std::string icon_name;     // 图标名称
-    int64_t timestamp;         // 时间戳
-    
-    // 位置信息
-    std::string city;
-    std::string country;
-    double latitude;
-    double longitude;
-    std::string timezone;
-    
-    // 逐小时预报
-    struct HourlyData {
-        int64_t timestamp;
-        double temperature;
-        double precipitation_probability;
-        int weather_code;
-    };
-    
-    std::vector<HourlyData> hourly_forecast;
-    
-    // 每日预报
-    struct DailyData {
-        int64_t date;
-        double temp_max;
-        double temp_min;
-        double precipitation_sum;
-        int weather_code;
-        std::string sunrise;
-        std::string sunset;
-    };
-    
-    std::vector<DailyData> daily_forecast;
-    
-    WeatherData();
-};
-
-// RPC通信数据结构
-struct WeatherRequest {
-    enum RequestType {
-        CURRENT_WEATHER = 0,
-        FORECAST = 1,
-        SEARCH_CITY = 2,
-        GEO_LOCATION = 3
-    };
-    
-    RequestType type;
-    std::string city_name;
-    std::string country_code;
-    int days;  // 预报天数
-    double latitude;
-    double longitude;
-    std::string language;  // 语言
-    std::string units;     // 单位制 (metric/imperial)
-};
-
-struct WeatherResponse {
-    bool success;
-    std::string error_message;
-    WeatherData current_weather;
-    std::vector<WeatherData> forecast;
-    std::vector<std::pair<std::string, std::string>> city_suggestions; // 城市搜索建议
-};
-
-#endif // WEATHER_DATA_H
\ No newline at end of file
+#ifndef WEATHER_DATA_H
+#define WEATHER_DATA_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+
+// 基本天气数据
+struct WeatherData {
+    double temperature;         // 温度 (°C)
+    double feels_like;          // 体感温度
+    int humidity;              // 湿度 (%)
+    double wind_speed;         // 风速 (km/h)
+    int wind_direction;        // 风向 (度)
+    double pressure;           // 气压 (hPa)
+    double precipitation;      // 降水量 (mm)
+    int cloud_cover;           // 云量 (%)
+    int uv_index;              // UV指数
+    std::string condition;     // 天气状况
+    std::string description;   // 详细描述
+    int weather_code;          // WMO天气代码
+    std::string icon_name;     // 图标名称
+    bool is_day;               // 是否白天（选择日/夜图标）
+    int64_t timestamp;         // 时间戳
+    
+    // 位置信息
+    std::string city;
+    std::string country;
+    double latitude;
+    double longitude;
+    std::string timezone;
+    
+    // 逐小时预报
+    struct HourlyData {
+        int64_t timestamp;
+        double temperature;
+        double precipitation_probability;
+        int weather_code;
+    };
+    
+    std::vector<HourlyData> hourly_forecast;
+    
+    // 每日预报
+    struct DailyData {
+        int64_t date;
+        double temp_max;
+        double temp_min;
+        double precipitation_sum;
+        int weather_code;
+        std::string sunrise;
+        std::string sunset;
+    };
+    
+    std::vector<DailyData> daily_forecast;
+    
+    WeatherData();
+};
+
+// 错误类型，便于HTTP/RPC层映射为对应的状态码
+enum WeatherErrorCode {
+    ERR_NONE = 0,
+    ERR_RATE_LIMITED = 1,    // 客户端请求过于频繁
+    ERR_OVERLOADED = 2,      // 服务过载，上游请求被拒绝
+    ERR_NOT_FOUND = 3,       // 找不到城市
+    ERR_UPSTREAM = 4         // 上游服务故障或返回的数据无效
+};
+
+// 批量查询中的一个位置，city_name为空时使用经纬度
+struct WeatherLocation {
+    std::string city_name;
+    std::string country_code;
+    double latitude = 0.0;
+    double longitude = 0.0;
+};
+
+// RPC通信数据结构
+struct WeatherRequest {
+    enum RequestType {
+        CURRENT_WEATHER = 0,
+        FORECAST = 1,
+        SEARCH_CITY = 2,
+        GEO_LOCATION = 3,
+        BATCH = 4              // 批量查询多个位置的当前天气
+    };
+    
+    RequestType type;
+    std::string city_name;
+    std::string country_code;
+    int days;  // 预报天数
+    double latitude;
+    double longitude;
+    std::string language;  // 语言
+    std::string units;     // 单位制 (metric/imperial)
+    
+    // 逐小时变量掩码
+    enum HourlyVariable : uint32_t {
+        HOURLY_TEMPERATURE = 1u << 0,
+        HOURLY_PRECIPITATION_PROBABILITY = 1u << 1,
+        HOURLY_WEATHER_CODE = 1u << 2,
+        HOURLY_ALL = 0x7
+    };
+    
+    // 逐小时范围查询（hourly_count 为 0 时返回默认的24小时）
+    int hourly_start = 0;                     // 起始小时偏移
+    int hourly_count = 0;                     // 小时数
+    uint32_t hourly_variables = HOURLY_ALL;   // 需要的变量
+    
+    std::vector<WeatherLocation> locations;   // 批量查询的位置列表
+    std::string client_id;                    // 客户端标识，用于限速，为空时不限速
+    
+    // 预报增量编码：返回相对客户端已确认版本的增量，base_version 为 0 或未知时返回完整快照
+    bool delta_encoding = false;
+    uint64_t base_version = 0;
+    
+    // 调用方可以直接发送预编码的响应体，缓存命中时不再复制WeatherData
+    bool want_encoded = false;
+};
+
+// 逐小时数据视图：直接引用缓存中的数组，不做复制
+struct HourlySlice {
+    std::shared_ptr<const WeatherData> source; // 持有缓存数据，保证视图有效
+    size_t start = 0;
+    size_t count = 0;
+    uint32_t variables = WeatherRequest::HOURLY_ALL;
+    
+    const WeatherData::HourlyData* begin() const {
+        return source ? source->hourly_forecast.data() + start : nullptr;
+    }
+    const WeatherData::HourlyData* end() const {
+        return source ? begin() + count : nullptr;
+    }
+    const WeatherData::HourlyData& operator[](size_t i) const {
+        return source->hourly_forecast[start + i];
+    }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+};
+
+// 批量查询中单个位置的结果
+struct BatchItemResult {
+    bool success = false;
+    bool from_cache = false;
+    WeatherErrorCode error_code = ERR_NONE;
+    std::string error_message;
+    std::shared_ptr<const WeatherData> weather;   // 与缓存共享，不复制
+};
+
+// 预先编码好的完整响应体，写入缓存时生成一次，命中时直接发送
+struct EncodedBody {
+    std::shared_ptr<const std::string> json;
+    std::shared_ptr<const std::string> gzip;   // 压缩没有收益时为空
+};
+
+// 增量编码中的一列，数值均量化为整数：实际值 = 量化值 / scale
+struct ForecastColumnDelta {
+    std::string name;
+    int scale = 1;
+    std::vector<uint32_t> indices;   // 变化的下标；完整快照时为空
+    std::vector<int64_t> values;     // 完整快照为整列量化值，增量为对应下标的量化差值
+};
+
+// 逐小时或每日数组的增量
+struct ForecastSectionDelta {
+    uint32_t shift = 0;    // 基准数组先丢弃前shift项（预报窗口前移）
+    uint32_t length = 0;   // 新数组长度，超出基准的部分相对0计算差值
+    std::vector<ForecastColumnDelta> columns;   // 增量中省略没有变化的列
+};
+
+// 预报快照相对客户端已确认版本的增量
+struct ForecastDelta {
+    uint64_t version = 0;
+    uint64_t base_version = 0;
+    bool full = true;      // 基准未知或增量不划算时为完整快照
+    ForecastSectionDelta hourly;
+    ForecastSectionDelta daily;
+};
+
+struct WeatherResponse {
+    bool success;
+    std::string error_message;
+    WeatherErrorCode error_code = ERR_NONE;
+    WeatherData current_weather;
+    std::vector<WeatherData> forecast;
+    std::vector<std::pair<std::string, std::string>> city_suggestions; // 城市搜索建议
+    HourlySlice hourly_range;   // 逐小时范围查询结果
+    std::vector<BatchItemResult> batch_results; // 批量查询结果，与请求中的位置一一对应
+    std::shared_ptr<const ForecastDelta> forecast_delta; // 增量编码的预报
+    std::shared_ptr<const EncodedBody> encoded_body;     // 非空时可直接作为响应体发送
+};
+
+// 流式预报的一个分块，数据引用缓存中的不可变对象
+struct ForecastChunk {
+    enum Kind {
+        CURRENT_CONDITIONS = 0,   // 当前天气（不含数组）
+        DAILY_FORECAST = 1,       // source->daily_forecast[start, start + count)
+        HOURLY_FORECAST = 2,      // hourly视图
+        STREAM_ERROR = 3
+    };
+    
+    Kind kind = CURRENT_CONDITIONS;
+    std::shared_ptr<const WeatherData> source;
+    size_t start = 0;
+    size_t count = 0;
+    HourlySlice hourly;
+    WeatherErrorCode error_code = ERR_NONE;
+    std::string error_message;
+};
+
+#endif // WEATHER_DATA_H